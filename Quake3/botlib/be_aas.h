@@ -219,3 +219,10 @@ typedef struct aas_predictroute_s
 	int numareas;			//number of areas predicted ahead
 	int time;				//time predicted ahead (in hundreth of a sec)
 } aas_predictroute_t;
+
+typedef struct aas_routequery_s
+{
+	int areanum;			//area to start in
+	int goalareanum;		//area to go to
+	int travelflags;		//allowed travel types
+} aas_routequery_t;
@@ -263,6 +263,11 @@ typedef struct aas_s
 	//areas the reachabilities go through
 	int *reachabilityareaindex;
 	aas_reachabilityareas_t *reachabilityareas;
+	//uniform grid with the node to start the tree descent for every cell
+	int *areagrid;
+	vec3_t areagridorigin;
+	float areagridcellsize;
+	int areagridsize[3];
 } aas_t;
 
 #define AASINTERN
@@ -182,6 +182,26 @@ int AAS_StartFrame(float time)
 		LibVarSet("saveroutingcache", "0");
 	} //end if
 	//
+	if (LibVarGetValue("routesearchbench"))
+	{
+		AAS_RouteSearchBenchmark((int) LibVarGetValue("routesearchbench"));
+		LibVarSet("routesearchbench", "0");
+	} //end if
+	//
+	if (LibVarChanged("aasrecord"))
+	{
+		AAS_RecordAreaQueries(LibVarGetString("aasrecord"));
+		LibVarSetNotModified("aasrecord");
+	} //end if
+	if (LibVarChanged("aasbench"))
+	{
+		if (*LibVarGetString("aasbench"))
+		{
+			AAS_AreaGridBenchmark(LibVarGetString("aasbench"), (int) LibVarGetValue("aasbenchpasses"));
+		} //end if
+		LibVarSetNotModified("aasbench");
+	} //end if
+	//
 	aasworld.numframes++;
 	return BLERR_NOERROR;
 } //end of the function AAS_StartFrame
@@ -258,6 +278,9 @@ int AAS_LoadMap(const char *mapname)
 	} //end if
 	//
 	aasworld.initialized = qfalse;
+	//queries recorded on another map are useless
+	AAS_RecordAreaQueries(NULL);
+	AAS_FreeAreaGrid();
 	//NOTE: free the routing caches before loading a new map because
 	// to free the caches the old number of areas, number of clusters
 	// and number of areas in a clusters must be available
@@ -271,6 +294,8 @@ int AAS_LoadMap(const char *mapname)
 	} //end if
 	//
 	AAS_InitSettings();
+	//build the area grid for the point and trace queries
+	AAS_InitAreaGrid();
 	//initialize the AAS link heap for the new map
 	AAS_InitAASLinkHeap();
 	//initialize the AAS linked entities for the new map
@@ -323,6 +348,10 @@ void AAS_Shutdown(void)
 	AAS_FreeAASLinkHeap();
 	//free aas linked entities
 	AAS_FreeAASLinkedEntities();
+	//free the area grid
+	AAS_FreeAreaGrid();
+	//stop recording queries
+	AAS_RecordAreaQueries(NULL);
 	//free the aas data
 	AAS_DumpAASData();
 	//free the entities
@@ -58,6 +58,9 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 //maximum number of routing updates each frame
 #define MAX_FRAMEROUTINGUPDATES		10
 
+//memory for the caches built by one batch of routing jobs
+#define ROUTINGJOBS_POOLSIZE		(2 * 1024 * 1024)
+
 
 /*
 
@@ -84,6 +87,175 @@ int numportalcacheupdates;
 int routingcachesize;
 int max_routingcachesize;
 
+//scratch space for the routing updates, one per thread building caches
+typedef struct aas_routingscratch_s
+{
+	aas_routingupdate_t *areaupdate;
+	aas_routingupdate_t *portalupdate;
+	int outofmemory;							//a routing cache couldn't be allocated
+	int routesearch;							//search for routes without an area routing cache
+} aas_routingscratch_t;
+
+/*
+
+  routing queries on the worker threads:
+  while AAS_WarmRoutingCaches runs its jobs the cache lists are shared
+  between threads and only touched with routingjobs.mutex held, the
+  travel times of a new cache are calculated outside the lock
+  the jobs may not allocate from the zone so new caches are carved out of
+  a pool, afterwards the main thread moves them into their own memory
+  the same cache may be built by two threads at once, the second one
+  finds the first in the list and drops its copy
+
+*/
+
+typedef struct aas_routingjobs_s
+{
+	void *mutex;
+	int active;									//jobs are running
+	byte *pool;									//memory for caches built by the jobs
+	int poolsize;
+	int poolused;
+	aas_routequery_t *queries;
+	int numqueries;
+	int nextquery;
+	aas_routingscratch_t *scratch;				//one for every job
+	int numscratch;
+} aas_routingjobs_t;
+
+/*
+
+  route tables:
+  travel times precomputed for the whole map at load time or read from
+  the maps/<mapname>.rtb file, only for routing with TFL_DEFAULT
+  for every cluster the tables store the travel time and reachability
+  from every reachability area of the cluster to every portal of the
+  cluster and the travel time from every portal to every area, besides
+  that the shortest travel times between all the portals are stored
+  a route between two clusters then is a lookup over the portals of the
+  start and goal cluster instead of a portal routing cache update
+  routes within one cluster still use the area routing cache
+  the tables are not used while areas are enabled or disabled different
+  from the moment the tables were made
+
+*/
+
+typedef struct aas_routetables_s
+{
+	int loaded;									//the tables are available
+	int travelflags;							//travel flags the tables are made for
+	int numchanged;								//areas with a disabled state other than in the tables
+	byte *disabled;								//disabled state of every area for the tables
+	int numentries;
+	int *firstentry;							//first entry of every cluster
+	unsigned short int *areaportaltimes;		//travel time from every cluster area to every cluster portal
+	unsigned char *areaportalreach;				//reachability towards the portal
+	unsigned short int *portalareatimes;		//travel time from every cluster portal to every cluster area
+	unsigned short int *portaltimes;			//travel times between all portals
+} aas_routetables_t;
+
+//the route tables file header
+//this header is followed by the portal travel times, the area portal travel
+//times, the portal area travel times and the area portal reachabilities
+typedef struct routetableheader_s
+{
+	int ident;
+	int version;
+	int numareas;
+	int numclusters;
+	int numportals;
+	int areacrc;
+	int clustercrc;
+	int areasettingscrc;
+	int reachabilitycrc;
+	int travelflags;
+	int numentries;
+} routetableheader_t;
+
+#define RTID						(('L'<<24)+('B'<<16)+('T'<<8)+'R')
+#define RTVERSION					1
+
+//more portals make the portal travel times table too large
+#define MAX_ROUTETABLEPORTALS		2048
+
+/*
+
+  goal directed route search:
+  a route within one cluster to a goal area without an area routing cache
+  is searched for with A* instead of flooding the whole cluster
+  the search runs backwards from the goal area just like the cache update
+  and stops as soon as the start area is expanded, only the areas between
+  the start and the goal area are visited
+  the travel time through an area depends on the reachability it was
+  entered with, the cache update looks at an area again each time it gets
+  a shorter travel time and so the travel times can differ a little
+  the estimate is the straight line distance at walking speed, without
+  falling down which is faster, the few reachabilities that are faster
+  than walking, like teleporters and jump pads, are chained into a lower
+  bound over those shortcuts
+  found routes are kept until areas are enabled or disabled, a goal area
+  that keeps being asked for gets its area routing cache after all
+
+*/
+
+typedef struct aas_searchnode_s
+{
+	int weight;									//travel time plus estimate
+	int traveltime;								//travel time when the node was added
+	int areanum;
+} aas_searchnode_t;
+
+typedef struct aas_searchroute_s
+{
+	int areanum;
+	int goalareanum;
+	int travelflags;
+	int generation;
+	unsigned short int traveltime;				//zero when the goal area can't be reached
+	unsigned char reachability;
+} aas_searchroute_t;
+
+//number of found routes kept, power of two
+#define MAX_SEARCHROUTES			1024
+//searches towards one goal area before it gets an area routing cache
+#define MAX_GOALSEARCHES			8
+//with more shortcuts the estimate costs more than it saves
+#define MAX_SEARCHSHORTCUTS			256
+//a bit below walking speed because the area travel times are rounded down
+#define SEARCHDISTANCEFACTOR		0.3f
+
+typedef struct aas_routesearch_s
+{
+	int searchnum;
+	int *labelled;								//search the area last got a travel time in
+	int *expanded;								//search the area was last expanded in
+	unsigned short int *traveltimes;
+	unsigned char *reachabilities;
+	unsigned short int *estimates;
+	aas_searchnode_t *heap;
+	int heapsize;
+	int maxheapsize;
+	int *shortcuts;								//reachabilities faster than walking
+	int numshortcuts;
+	int *searchshortcuts;						//shortcuts the current search can use
+	int numsearchshortcuts;
+	float *shortcuttimes;						//lower bound to the end of those shortcuts
+	byte *shortcutdone;
+	int noestimate;								//too many shortcuts
+	int generation;								//changes when areas are enabled or disabled
+	aas_searchroute_t routes[MAX_SEARCHROUTES];
+	byte *goalsearches;							//searches towards every goal area
+	int numexpanded;							//areas expanded by all searches
+} aas_routesearch_t;
+
+aas_routingscratch_t mainscratch;
+aas_routingjobs_t routingjobs;
+aas_routetables_t routetables;
+aas_routesearch_t routesearch;
+//caches read from the route cache file share this block of memory
+byte *routecacheblock;
+int routecacheblocksize;
+
 //===========================================================================
 //
 // Parameter:			-
@@ -196,6 +368,26 @@ int AAS_TravelFlagForType(int traveltype)
 // Returns:				-
 // Changes Globals:		-
 //===========================================================================
+static ID_INLINE void AAS_LockRoutingCache(void)
+{
+	if (routingjobs.active) botimport.LockMutex(routingjobs.mutex);
+} //end of the function AAS_LockRoutingCache
+//===========================================================================
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+static ID_INLINE void AAS_UnlockRoutingCache(void)
+{
+	if (routingjobs.active) botimport.UnlockMutex(routingjobs.mutex);
+} //end of the function AAS_UnlockRoutingCache
+//===========================================================================
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
 void AAS_UnlinkCache(aas_routingcache_t *cache)
 {
 	if (cache->time_next) cache->time_next->time_prev = cache->time_prev;
@@ -232,9 +424,23 @@ void AAS_LinkCache(aas_routingcache_t *cache)
 // Returns:				-
 // Changes Globals:		-
 //===========================================================================
+static ID_INLINE qboolean AAS_CacheInBlock(aas_routingcache_t *cache)
+{
+	return (byte *) cache >= routecacheblock &&
+			(byte *) cache < routecacheblock + routecacheblocksize;
+} //end of the function AAS_CacheInBlock
+//===========================================================================
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
 void AAS_FreeRoutingCache(aas_routingcache_t *cache)
 {
 	AAS_UnlinkCache(cache);
+	//the block with the caches from the route cache file is freed at once
+	//and never counted in the routing cache size
+	if (AAS_CacheInBlock(cache)) return;
 	routingcachesize -= cache->size;
 	FreeMemory(cache);
 } //end of the function AAS_FreeRoutingCache
@@ -329,6 +535,14 @@ int AAS_EnableRoutingArea(int areanum, int enable)
 	{
 		//remove all routing cache involving this area
 		AAS_RemoveRoutingCacheUsingArea( areanum );
+		//and the routes found without routing cache
+		AAS_InvalidateRouteSearch();
+		//the route tables are only valid with the areas the tables were made with
+		if (routetables.loaded)
+		{
+			if (routetables.disabled[areanum] == flags) routetables.numchanged++;
+			else routetables.numchanged--;
+		} //end if
 	} //end if
 	return !flags;
 } //end of the function AAS_EnableRoutingArea
@@ -704,6 +918,10 @@ int AAS_FreeOldestCache(void)
 		if (cache->type == CACHETYPE_AREA && aasworld.areasettings[cache->areanum].cluster < 0) {
 			continue;
 		}
+		// evicting a cache from the route cache file releases no memory
+		if (AAS_CacheInBlock(cache)) {
+			continue;
+		}
 		break;
 	}
 	if (cache) {
@@ -733,15 +951,25 @@ int AAS_FreeOldestCache(void)
 // Returns:				-
 // Changes Globals:		-
 //===========================================================================
+static ID_INLINE int AAS_RoutingCacheSize(int numtraveltimes)
+{
+	return sizeof(aas_routingcache_t)
+						+ numtraveltimes * sizeof(unsigned short int)
+						+ numtraveltimes * sizeof(unsigned char);
+} //end of the function AAS_RoutingCacheSize
+//===========================================================================
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
 aas_routingcache_t *AAS_AllocRoutingCache(int numtraveltimes)
 {
 	aas_routingcache_t *cache;
 	int size;
 
 	//
-	size = sizeof(aas_routingcache_t)
-						+ numtraveltimes * sizeof(unsigned short int)
-						+ numtraveltimes * sizeof(unsigned char);
+	size = AAS_RoutingCacheSize(numtraveltimes);
 	//
 	routingcachesize += size;
 	//
@@ -752,6 +980,44 @@ aas_routingcache_t *AAS_AllocRoutingCache(int numtraveltimes)
 	return cache;
 } //end of the function AAS_AllocRoutingCache
 //===========================================================================
+// allocates a routing cache from the job pool, the routing cache lock
+// must be held
+//
+// Parameter:			numtraveltimes	: number of travel times in the cache
+// Returns:				the cache or NULL when the pool is used up
+// Changes Globals:		-
+//===========================================================================
+static aas_routingcache_t *AAS_AllocJobRoutingCache(int numtraveltimes)
+{
+	aas_routingcache_t *cache;
+	int size;
+
+	size = AAS_RoutingCacheSize(numtraveltimes);
+	if (routingjobs.poolused + size > routingjobs.poolsize) return NULL;
+	//
+	cache = (aas_routingcache_t *) (routingjobs.pool + routingjobs.poolused);
+	routingjobs.poolused += PAD(size, sizeof(void *));
+	//
+	Com_Memset(cache, 0, size);
+	cache->reachabilities = (unsigned char *) cache + sizeof(aas_routingcache_t)
+								+ numtraveltimes * sizeof(unsigned short int);
+	cache->size = size;
+	return cache;
+} //end of the function AAS_AllocJobRoutingCache
+//===========================================================================
+// allocates a routing cache from the zone or, while routing jobs are
+// running, from the job pool
+//
+// Parameter:			numtraveltimes	: number of travel times in the cache
+// Returns:				the cache or NULL when the job pool is used up
+// Changes Globals:		-
+//===========================================================================
+static aas_routingcache_t *AAS_NewRoutingCache(int numtraveltimes)
+{
+	if (routingjobs.active) return AAS_AllocJobRoutingCache(numtraveltimes);
+	return AAS_AllocRoutingCache(numtraveltimes);
+} //end of the function AAS_NewRoutingCache
+//===========================================================================
 //
 // Parameter:			-
 // Returns:				-
@@ -856,6 +1122,25 @@ void AAS_InitPortalCache(void)
 // Returns:					-
 // Changes Globals:		-
 //===========================================================================
+void AAS_FreeRoutingJobs(void)
+{
+	int i;
+
+	for (i = 0; i < routingjobs.numscratch; i++)
+	{
+		FreeMemory(routingjobs.scratch[i].areaupdate);
+		FreeMemory(routingjobs.scratch[i].portalupdate);
+	} //end for
+	if (routingjobs.scratch) FreeMemory(routingjobs.scratch);
+	if (routingjobs.mutex) botimport.DestroyMutex(routingjobs.mutex);
+	Com_Memset(&routingjobs, 0, sizeof(routingjobs));
+} //end of the function AAS_FreeRoutingJobs
+//===========================================================================
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
 void AAS_InitRoutingUpdate(void)
 {
 	int i, maxreachabilityareas;
@@ -879,6 +1164,26 @@ void AAS_InitRoutingUpdate(void)
 	//allocate memory for the portal update fields
 	aasworld.portalupdate = (aas_routingupdate_t *) GetClearedMemory(
 									(aasworld.numportals+1) * sizeof(aas_routingupdate_t));
+	//
+	mainscratch.areaupdate = aasworld.areaupdate;
+	mainscratch.portalupdate = aasworld.portalupdate;
+	mainscratch.outofmemory = qfalse;
+	//the routing jobs each need their own update fields
+	AAS_FreeRoutingJobs();
+	if (botimport.NumWorkers() > 0)
+	{
+		routingjobs.mutex = botimport.CreateMutex();
+		routingjobs.numscratch = botimport.NumWorkers() + 1;
+		routingjobs.scratch = (aas_routingscratch_t *) GetClearedMemory(
+									routingjobs.numscratch * sizeof(aas_routingscratch_t));
+		for (i = 0; i < routingjobs.numscratch; i++)
+		{
+			routingjobs.scratch[i].areaupdate = (aas_routingupdate_t *) GetClearedMemory(
+									maxreachabilityareas * sizeof(aas_routingupdate_t));
+			routingjobs.scratch[i].portalupdate = (aas_routingupdate_t *) GetClearedMemory(
+									(aasworld.numportals+1) * sizeof(aas_routingupdate_t));
+		} //end for
+	} //end if
 } //end of the function AAS_InitRoutingUpdate
 //===========================================================================
 //
@@ -916,7 +1221,9 @@ void AAS_CreateAllRoutingCache(void)
 
 //the route cache header
 //this header is followed by numportalcache + numareacache aas_routingcache_t
-//structures that store routing cache
+//structures that store routing cache, every cache is stored the way it is
+//in memory at an offset padded to the size of a pointer, so the file is
+//read into one block of memory and the caches are used where they are
 typedef struct routecacheheader_s
 {
 	int ident;
@@ -925,34 +1232,80 @@ typedef struct routecacheheader_s
 	int numclusters;
 	int areacrc;
 	int clustercrc;
+	int reachabilitycrc;
+	int cachestructsize;
 	int numportalcache;
 	int numareacache;
+	int cachesize;
 } routecacheheader_t;
 
 #define RCID						(('C'<<24)+('R'<<16)+('E'<<8)+'M')
-#define RCVERSION					2
+#define RCVERSION					3
 
-//void AAS_DecompressVis(byte *in, int numareas, byte *decompressed);
-//int AAS_CompressVis(byte *vis, int numareas, byte *dest);
+//===========================================================================
+// fills in the route cache header for the current map
+//
+// Parameter:			header			: header to fill in
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+static void AAS_RouteCacheHeader(routecacheheader_t *header)
+{
+	Com_Memset(header, 0, sizeof(routecacheheader_t));
+	header->ident = RCID;
+	header->version = RCVERSION;
+	header->numareas = aasworld.numareas;
+	header->numclusters = aasworld.numclusters;
+	header->areacrc = CRC_ProcessString( (unsigned char *)aasworld.areas, sizeof(aas_area_t) * aasworld.numareas );
+	header->clustercrc = CRC_ProcessString( (unsigned char *)aasworld.clusters, sizeof(aas_cluster_t) * aasworld.numclusters );
+	header->reachabilitycrc = CRC_ProcessString( (unsigned char *)aasworld.reachability, sizeof(aas_reachability_t) * aasworld.reachabilitysize );
+	header->cachestructsize = sizeof(aas_routingcache_t);
+} //end of the function AAS_RouteCacheHeader
+//===========================================================================
+// copies the cache into the route cache file data without the pointers
+//
+// Parameter:			data			: file data
+//						offset			: offset of the cache in the file data
+//						cache			: cache to store
+// Returns:				offset of the next cache
+// Changes Globals:		-
+//===========================================================================
+static int AAS_StoreCache(byte *data, int offset, aas_routingcache_t *cache)
+{
+	aas_routingcache_t *stored;
 
+	stored = (aas_routingcache_t *) (data + offset);
+	Com_Memcpy(stored, cache, cache->size);
+	stored->prev = stored->next = NULL;
+	stored->time_prev = stored->time_next = NULL;
+	stored->reachabilities = NULL;
+	return offset + PAD(cache->size, sizeof(void *));
+} //end of the function AAS_StoreCache
+//===========================================================================
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
 void AAS_WriteRouteCache(void)
 {
-	int i, j, numportalcache, numareacache, totalsize;
+	int i, j, offset;
 	aas_routingcache_t *cache;
 	aas_cluster_t *cluster;
 	fileHandle_t fp;
 	char filename[MAX_QPATH];
 	routecacheheader_t routecacheheader;
+	byte *data;
 
-	numportalcache = 0;
+	AAS_RouteCacheHeader(&routecacheheader);
 	for (i = 0; i < aasworld.numareas; i++)
 	{
 		for (cache = aasworld.portalcache[i]; cache; cache = cache->next)
 		{
-			numportalcache++;
+			routecacheheader.numportalcache++;
+			routecacheheader.cachesize += PAD(cache->size, sizeof(void *));
 		} //end for
 	} //end for
-	numareacache = 0;
 	for (i = 0; i < aasworld.numclusters; i++)
 	{
 		cluster = &aasworld.clusters[i];
@@ -960,7 +1313,8 @@ void AAS_WriteRouteCache(void)
 		{
 			for (cache = aasworld.clusterareacache[i][j]; cache; cache = cache->next)
 			{
-				numareacache++;
+				routecacheheader.numareacache++;
+				routecacheheader.cachesize += PAD(cache->size, sizeof(void *));
 			} //end for
 		} //end for
 	} //end for
@@ -972,26 +1326,14 @@ void AAS_WriteRouteCache(void)
 		AAS_Error("Unable to open file: %s\n", filename);
 		return;
 	} //end if
-	//create the header
-	routecacheheader.ident = RCID;
-	routecacheheader.version = RCVERSION;
-	routecacheheader.numareas = aasworld.numareas;
-	routecacheheader.numclusters = aasworld.numclusters;
-	routecacheheader.areacrc = CRC_ProcessString( (unsigned char *)aasworld.areas, sizeof(aas_area_t) * aasworld.numareas );
-	routecacheheader.clustercrc = CRC_ProcessString( (unsigned char *)aasworld.clusters, sizeof(aas_cluster_t) * aasworld.numclusters );
-	routecacheheader.numportalcache = numportalcache;
-	routecacheheader.numareacache = numareacache;
-	//write the header
-	botimport.FS_Write(&routecacheheader, sizeof(routecacheheader_t), fp);
-	//
-	totalsize = 0;
-	//write all the cache
+	//all the cache is written at once
+	data = (byte *) GetClearedMemory(routecacheheader.cachesize);
+	offset = 0;
 	for (i = 0; i < aasworld.numareas; i++)
 	{
 		for (cache = aasworld.portalcache[i]; cache; cache = cache->next)
 		{
-			botimport.FS_Write(cache, cache->size, fp);
-			totalsize += cache->size;
+			offset = AAS_StoreCache(data, offset, cache);
 		} //end for
 	} //end for
 	for (i = 0; i < aasworld.numclusters; i++)
@@ -1001,139 +1343,134 @@ void AAS_WriteRouteCache(void)
 		{
 			for (cache = aasworld.clusterareacache[i][j]; cache; cache = cache->next)
 			{
-				botimport.FS_Write(cache, cache->size, fp);
-				totalsize += cache->size;
+				offset = AAS_StoreCache(data, offset, cache);
 			} //end for
 		} //end for
 	} //end for
-	// write the visareas
-	/*
-	for (i = 0; i < aasworld.numareas; i++)
-	{
-		if (!aasworld.areavisibility[i]) {
-			size = 0;
-			botimport.FS_Write(&size, sizeof(int), fp);
-			continue;
-		}
-		AAS_DecompressVis( aasworld.areavisibility[i], aasworld.numareas, aasworld.decompressedvis );
-		size = AAS_CompressVis( aasworld.decompressedvis, aasworld.numareas, aasworld.decompressedvis );
-		botimport.FS_Write(&size, sizeof(int), fp);
-		botimport.FS_Write(aasworld.decompressedvis, size, fp);
-	}
-	*/
-	//
+	botimport.FS_Write(&routecacheheader, sizeof(routecacheheader_t), fp);
+	botimport.FS_Write(data, routecacheheader.cachesize, fp);
 	botimport.FS_FCloseFile(fp);
+	FreeMemory(data);
 	botimport.Print(PRT_MESSAGE, "\nroute cache written to %s\n", filename);
-	botimport.Print(PRT_MESSAGE, "written %d bytes of routing cache\n", totalsize);
+	botimport.Print(PRT_MESSAGE, "written %d bytes of routing cache\n", routecacheheader.cachesize);
 } //end of the function AAS_WriteRouteCache
 //===========================================================================
+// returns the cache at the offset in the route cache block or NULL when
+// it isn't a valid cache for the current map
 //
-// Parameter:			-
-// Returns:				-
+// Parameter:			offset			: offset of the cache in the block
+//						portalcache		: qtrue for a portal cache
+// Returns:				the cache
 // Changes Globals:		-
 //===========================================================================
-aas_routingcache_t *AAS_ReadCache(fileHandle_t fp)
+static aas_routingcache_t *AAS_RouteCacheBlockCache(int offset, int portalcache)
 {
-	int size;
+	int numtraveltimes;
 	aas_routingcache_t *cache;
 
-	botimport.FS_Read(&size, sizeof(size), fp);
-	cache = (aas_routingcache_t *) GetMemory(size);
-	cache->size = size;
-	botimport.FS_Read((unsigned char *)cache + sizeof(size), size - sizeof(size), fp);
-	cache->reachabilities = (unsigned char *) cache + sizeof(aas_routingcache_t) - sizeof(unsigned short) +
-		(size - sizeof(aas_routingcache_t) + sizeof(unsigned short)) / 3 * 2;
+	if (offset + (int) sizeof(aas_routingcache_t) > routecacheblocksize) return NULL;
+	cache = (aas_routingcache_t *) (routecacheblock + offset);
+	if (cache->areanum <= 0 || cache->areanum >= aasworld.numareas) return NULL;
+	if (cache->cluster < 0 || cache->cluster >= aasworld.numclusters) return NULL;
+	if (portalcache) numtraveltimes = aasworld.numportals;
+	else
+	{
+		if (AAS_ClusterAreaNum(cache->cluster, cache->areanum) >= aasworld.clusters[cache->cluster].numareas) return NULL;
+		numtraveltimes = aasworld.clusters[cache->cluster].numreachabilityareas;
+	} //end else
+	if (cache->size != AAS_RoutingCacheSize(numtraveltimes)) return NULL;
+	if (offset + cache->size > routecacheblocksize) return NULL;
 	return cache;
-} //end of the function AAS_ReadCache
+} //end of the function AAS_RouteCacheBlockCache
 //===========================================================================
+// reads the route cache file into one block of memory and links all the
+// caches in it
 //
 // Parameter:			-
-// Returns:				-
+// Returns:				qtrue when the route cache was read
 // Changes Globals:		-
 //===========================================================================
 int AAS_ReadRouteCache(void)
 {
-	int i, clusterareanum;//, size;
+	int i, length, offset, numcache, clusterareanum;
 	fileHandle_t fp;
 	char filename[MAX_QPATH];
-	routecacheheader_t routecacheheader;
+	routecacheheader_t routecacheheader, fileheader;
 	aas_routingcache_t *cache;
 
 	Com_sprintf(filename, MAX_QPATH, "maps/%s.rcd", aasworld.mapname);
-	botimport.FS_FOpenFile( filename, &fp, FS_READ );
+	length = botimport.FS_FOpenFile( filename, &fp, FS_READ );
 	if (!fp)
 	{
 		return qfalse;
 	} //end if
-	botimport.FS_Read(&routecacheheader, sizeof(routecacheheader_t), fp );
-	if (routecacheheader.ident != RCID)
+	Com_Memset(&fileheader, 0, sizeof(routecacheheader_t));
+	if (length >= (int) sizeof(routecacheheader_t))
 	{
-		AAS_Error("%s is not a route cache dump\n", filename);
-		return qfalse;
-	} //end if
-	if (routecacheheader.version != RCVERSION)
-	{
-		AAS_Error("route cache dump has wrong version %d, should be %d\n", routecacheheader.version, RCVERSION);
-		return qfalse;
-	} //end if
-	if (routecacheheader.numareas != aasworld.numareas)
-	{
-		//AAS_Error("route cache dump has wrong number of areas\n");
-		return qfalse;
-	} //end if
-	if (routecacheheader.numclusters != aasworld.numclusters)
-	{
-		//AAS_Error("route cache dump has wrong number of clusters\n");
-		return qfalse;
+		botimport.FS_Read(&fileheader, sizeof(routecacheheader_t), fp );
 	} //end if
-	if (routecacheheader.areacrc !=
-		CRC_ProcessString( (unsigned char *)aasworld.areas, sizeof(aas_area_t) * aasworld.numareas ))
-	{
-		//AAS_Error("route cache dump area CRC incorrect\n");
+	AAS_RouteCacheHeader(&routecacheheader);
+	routecacheheader.numportalcache = fileheader.numportalcache;
+	routecacheheader.numareacache = fileheader.numareacache;
+	routecacheheader.cachesize = fileheader.cachesize;
+	//a route cache of another version or for other AAS data is not used
+	if (memcmp(&routecacheheader, &fileheader, sizeof(routecacheheader_t)) ||
+			length != sizeof(routecacheheader_t) + fileheader.cachesize)
+	{
+		botimport.FS_FCloseFile(fp);
+		botimport.Print(PRT_MESSAGE, "%s is out of date\n", filename);
 		return qfalse;
 	} //end if
-	if (routecacheheader.clustercrc !=
-		CRC_ProcessString( (unsigned char *)aasworld.clusters, sizeof(aas_cluster_t) * aasworld.numclusters ))
+	routecacheblocksize = fileheader.cachesize;
+	routecacheblock = (byte *) GetMemory(routecacheblocksize);
+	botimport.FS_Read(routecacheblock, routecacheblocksize, fp);
+	botimport.FS_FCloseFile(fp);
+	//check all the caches before any of them is used
+	numcache = fileheader.numportalcache + fileheader.numareacache;
+	for (i = 0, offset = 0; i < numcache; i++)
 	{
-		//AAS_Error("route cache dump cluster CRC incorrect\n");
-		return qfalse;
-	} //end if
-	//read all the portal cache
-	for (i = 0; i < routecacheheader.numportalcache; i++)
-	{
-		cache = AAS_ReadCache(fp);
-		cache->next = aasworld.portalcache[cache->areanum];
-		cache->prev = NULL;
-		if (aasworld.portalcache[cache->areanum])
-			aasworld.portalcache[cache->areanum]->prev = cache;
-		aasworld.portalcache[cache->areanum] = cache;
-	} //end for
-	//read all the cluster area cache
-	for (i = 0; i < routecacheheader.numareacache; i++)
-	{
-		cache = AAS_ReadCache(fp);
-		clusterareanum = AAS_ClusterAreaNum(cache->cluster, cache->areanum);
-		cache->next = aasworld.clusterareacache[cache->cluster][clusterareanum];
-		cache->prev = NULL;
-		if (aasworld.clusterareacache[cache->cluster][clusterareanum])
-			aasworld.clusterareacache[cache->cluster][clusterareanum]->prev = cache;
-		aasworld.clusterareacache[cache->cluster][clusterareanum] = cache;
+		cache = AAS_RouteCacheBlockCache(offset, i < fileheader.numportalcache);
+		if (!cache)
+		{
+			FreeMemory(routecacheblock);
+			routecacheblock = NULL;
+			routecacheblocksize = 0;
+			botimport.Print(PRT_WARNING, "%s is corrupt\n", filename);
+			return qfalse;
+		} //end if
+		offset += PAD(cache->size, sizeof(void *));
 	} //end for
-	// read the visareas
-	/*
-	aasworld.areavisibility = (byte **) GetClearedMemory(aasworld.numareas * sizeof(byte *));
-	aasworld.decompressedvis = (byte *) GetClearedMemory(aasworld.numareas * sizeof(byte));
-	for (i = 0; i < aasworld.numareas; i++)
+	//link the caches where they are
+	for (i = 0, offset = 0; i < numcache; i++)
 	{
-		botimport.FS_Read(&size, sizeof(size), fp );
-		if (size) {
-			aasworld.areavisibility[i] = (byte *) GetMemory(size);
-			botimport.FS_Read(aasworld.areavisibility[i], size, fp );
-		}
-	}
-	*/
-	//
-	botimport.FS_FCloseFile(fp);
+		cache = (aas_routingcache_t *) (routecacheblock + offset);
+		offset += PAD(cache->size, sizeof(void *));
+		if (i < fileheader.numportalcache)
+		{
+			cache->type = CACHETYPE_PORTAL;
+			cache->reachabilities = (unsigned char *) cache + sizeof(aas_routingcache_t)
+										+ aasworld.numportals * sizeof(unsigned short int);
+			cache->prev = NULL;
+			cache->next = aasworld.portalcache[cache->areanum];
+			if (aasworld.portalcache[cache->areanum])
+				aasworld.portalcache[cache->areanum]->prev = cache;
+			aasworld.portalcache[cache->areanum] = cache;
+		} //end if
+		else
+		{
+			cache->type = CACHETYPE_AREA;
+			cache->reachabilities = (unsigned char *) cache + sizeof(aas_routingcache_t)
+										+ aasworld.clusters[cache->cluster].numreachabilityareas * sizeof(unsigned short int);
+			clusterareanum = AAS_ClusterAreaNum(cache->cluster, cache->areanum);
+			cache->prev = NULL;
+			cache->next = aasworld.clusterareacache[cache->cluster][clusterareanum];
+			if (aasworld.clusterareacache[cache->cluster][clusterareanum])
+				aasworld.clusterareacache[cache->cluster][clusterareanum]->prev = cache;
+			aasworld.clusterareacache[cache->cluster][clusterareanum] = cache;
+		} //end else
+		cache->time = AAS_RoutingTime();
+		AAS_LinkCache(cache);
+	} //end for
 	return qtrue;
 } //end of the function AAS_ReadRouteCache
 //===========================================================================
@@ -1245,6 +1582,10 @@ void AAS_InitRouting(void)
 	max_routingcachesize = 1024 * (int) LibVarValue("max_routingcache", "4096");
 	// read any routing cache if available
 	AAS_ReadRouteCache();
+	// read or calculate the route tables
+	AAS_InitRouteTables();
+	// set up the goal directed route search
+	AAS_InitRouteSearch();
 } //end of the function AAS_InitRouting
 //===========================================================================
 //
@@ -1258,6 +1599,10 @@ void AAS_FreeRoutingCaches(void)
 	AAS_FreeAllClusterAreaCache();
 	// free all the existing portal cache
 	AAS_FreeAllPortalCache();
+	// free the caches read from the route cache file
+	if (routecacheblock) FreeMemory(routecacheblock);
+	routecacheblock = NULL;
+	routecacheblocksize = 0;
 	// free cached travel times within areas
 	if (aasworld.areatraveltimes) FreeMemory(aasworld.areatraveltimes);
 	aasworld.areatraveltimes = NULL;
@@ -1272,6 +1617,8 @@ void AAS_FreeRoutingCaches(void)
 	aasworld.areaupdate = NULL;
 	if (aasworld.portalupdate) FreeMemory(aasworld.portalupdate);
 	aasworld.portalupdate = NULL;
+	Com_Memset(&mainscratch, 0, sizeof(mainscratch));
+	AAS_FreeRoutingJobs();
 	// free lists with areas the reachabilities go through
 	if (aasworld.reachabilityareas) FreeMemory(aasworld.reachabilityareas);
 	aasworld.reachabilityareas = NULL;
@@ -1281,15 +1628,20 @@ void AAS_FreeRoutingCaches(void)
 	// free area contents travel flags look up table
 	if (aasworld.areacontentstravelflags) FreeMemory(aasworld.areacontentstravelflags);
 	aasworld.areacontentstravelflags = NULL;
+	// free the route tables
+	AAS_FreeRouteTables();
+	// free the route search
+	AAS_FreeRouteSearch();
 } //end of the function AAS_FreeRoutingCaches
 //===========================================================================
 // update the given routing cache
 //
-// Parameter:			areacache		: routing cache to update
+// Parameter:			scratch			: update fields to use
+//						areacache		: routing cache to update
 // Returns:				-
 // Changes Globals:		-
 //===========================================================================
-void AAS_UpdateAreaRoutingCache(aas_routingcache_t *areacache)
+void AAS_UpdateAreaRoutingCache(aas_routingscratch_t *scratch, aas_routingcache_t *areacache)
 {
 	int i, nextareanum, cluster, badtravelflags, clusterareanum, linknum;
 	int numreachabilityareas;
@@ -1299,13 +1651,8 @@ void AAS_UpdateAreaRoutingCache(aas_routingcache_t *areacache)
 	aas_reversedreachability_t *revreach;
 	aas_reversedlink_t *revlink;
 
-#ifdef ROUTING_DEBUG
-	numareacacheupdates++;
-#endif //ROUTING_DEBUG
 	//number of reachability areas within this cluster
 	numreachabilityareas = aasworld.clusters[areacache->cluster].numreachabilityareas;
-	//
-	aasworld.frameroutingupdates++;
 	//clear the routing update fields
 //	Com_Memset(aasworld.areaupdate, 0, aasworld.numareas * sizeof(aas_routingupdate_t));
 	//
@@ -1316,7 +1663,7 @@ void AAS_UpdateAreaRoutingCache(aas_routingcache_t *areacache)
 	//
 	Com_Memset(startareatraveltimes, 0, sizeof(startareatraveltimes));
 	//
-	curupdate = &aasworld.areaupdate[clusterareanum];
+	curupdate = &scratch->areaupdate[clusterareanum];
 	curupdate->areanum = areacache->areanum;
 	//VectorCopy(areacache->origin, curupdate->start);
 	curupdate->areatraveltimes = startareatraveltimes;
@@ -1372,7 +1719,7 @@ void AAS_UpdateAreaRoutingCache(aas_routingcache_t *areacache)
 			{
 				areacache->traveltimes[clusterareanum] = t;
 				areacache->reachabilities[clusterareanum] = linknum - aasworld.areasettings[nextareanum].firstreachablearea;
-				nextupdate = &aasworld.areaupdate[clusterareanum];
+				nextupdate = &scratch->areaupdate[clusterareanum];
 				nextupdate->areanum = nextareanum;
 				nextupdate->tmptraveltime = t;
 				//VectorCopy(reach->start, nextupdate->start);
@@ -1400,35 +1747,71 @@ void AAS_UpdateAreaRoutingCache(aas_routingcache_t *areacache)
 // Returns:				-
 // Changes Globals:		-
 //===========================================================================
-aas_routingcache_t *AAS_GetAreaRoutingCache(int clusternum, int areanum, int travelflags)
+static aas_routingcache_t *AAS_FindAreaRoutingCache(int clusternum, int clusterareanum, int travelflags)
 {
-	int clusterareanum;
-	aas_routingcache_t *cache, *clustercache;
+	aas_routingcache_t *cache;
 
-	//number of the area in the cluster
-	clusterareanum = AAS_ClusterAreaNum(clusternum, areanum);
-	//pointer to the cache for the area in the cluster
-	clustercache = aasworld.clusterareacache[clusternum][clusterareanum];
 	//find the cache without undesired travel flags
-	for (cache = clustercache; cache; cache = cache->next)
+	for (cache = aasworld.clusterareacache[clusternum][clusterareanum]; cache; cache = cache->next)
 	{
 		//if there aren't used any undesired travel types for the cache
 		if (cache->travelflags == travelflags) break;
 	} //end for
+	return cache;
+} //end of the function AAS_FindAreaRoutingCache
+//===========================================================================
+//
+// Parameter:			-
+// Returns:				NULL when a routing job ran out of cache memory
+// Changes Globals:		-
+//===========================================================================
+aas_routingcache_t *AAS_GetAreaRoutingCache(aas_routingscratch_t *scratch, int clusternum, int areanum, int travelflags)
+{
+	int clusterareanum;
+	aas_routingcache_t *cache, *clustercache;
+
+	//number of the area in the cluster
+	clusterareanum = AAS_ClusterAreaNum(clusternum, areanum);
+	//
+	AAS_LockRoutingCache();
+	cache = AAS_FindAreaRoutingCache(clusternum, clusterareanum, travelflags);
 	//if there was no cache
 	if (!cache)
 	{
-		cache = AAS_AllocRoutingCache(aasworld.clusters[clusternum].numreachabilityareas);
+		cache = AAS_NewRoutingCache(aasworld.clusters[clusternum].numreachabilityareas);
+		AAS_UnlockRoutingCache();
+		if (!cache)
+		{
+			scratch->outofmemory = qtrue;
+			return NULL;
+		} //end if
 		cache->cluster = clusternum;
 		cache->areanum = areanum;
 		VectorCopy(aasworld.areas[areanum].center, cache->origin);
 		cache->starttraveltime = 1;
 		cache->travelflags = travelflags;
-		cache->prev = NULL;
-		cache->next = clustercache;
-		if (clustercache) clustercache->prev = cache;
-		aasworld.clusterareacache[clusternum][clusterareanum] = cache;
-		AAS_UpdateAreaRoutingCache(cache);
+		AAS_UpdateAreaRoutingCache(scratch, cache);
+		//
+		AAS_LockRoutingCache();
+		//another routing job may have built the same cache in the meantime
+		clustercache = AAS_FindAreaRoutingCache(clusternum, clusterareanum, travelflags);
+		if (clustercache)
+		{
+			cache = clustercache;
+			AAS_UnlinkCache(cache);
+		} //end if
+		else
+		{
+			clustercache = aasworld.clusterareacache[clusternum][clusterareanum];
+			cache->prev = NULL;
+			cache->next = clustercache;
+			if (clustercache) clustercache->prev = cache;
+			aasworld.clusterareacache[clusternum][clusterareanum] = cache;
+			aasworld.frameroutingupdates++;
+#ifdef ROUTING_DEBUG
+			numareacacheupdates++;
+#endif //ROUTING_DEBUG
+		} //end else
 	} //end if
 	else
 	{
@@ -1438,6 +1821,7 @@ aas_routingcache_t *AAS_GetAreaRoutingCache(int clusternum, int areanum, int tra
 	cache->time = AAS_RoutingTime();
 	cache->type = CACHETYPE_AREA;
 	AAS_LinkCache(cache);
+	AAS_UnlockRoutingCache();
 	return cache;
 } //end of the function AAS_GetAreaRoutingCache
 //===========================================================================
@@ -1446,7 +1830,7 @@ aas_routingcache_t *AAS_GetAreaRoutingCache(int clusternum, int areanum, int tra
 // Returns:				-
 // Changes Globals:		-
 //===========================================================================
-void AAS_UpdatePortalRoutingCache(aas_routingcache_t *portalcache)
+void AAS_UpdatePortalRoutingCache(aas_routingscratch_t *scratch, aas_routingcache_t *portalcache)
 {
 	int i, portalnum, clusterareanum, clusternum;
 	unsigned short int t;
@@ -1455,13 +1839,10 @@ void AAS_UpdatePortalRoutingCache(aas_routingcache_t *portalcache)
 	aas_routingcache_t *cache;
 	aas_routingupdate_t *updateliststart, *updatelistend, *curupdate, *nextupdate;
 
-#ifdef ROUTING_DEBUG
-	numportalcacheupdates++;
-#endif //ROUTING_DEBUG
 	//clear the routing update fields
 //	Com_Memset(aasworld.portalupdate, 0, (aasworld.numportals+1) * sizeof(aas_routingupdate_t));
 	//
-	curupdate = &aasworld.portalupdate[aasworld.numportals];
+	curupdate = &scratch->portalupdate[aasworld.numportals];
 	curupdate->cluster = portalcache->cluster;
 	curupdate->areanum = portalcache->areanum;
 	curupdate->tmptraveltime = portalcache->starttraveltime;
@@ -1489,8 +1870,9 @@ void AAS_UpdatePortalRoutingCache(aas_routingcache_t *portalcache)
 		//
 		cluster = &aasworld.clusters[curupdate->cluster];
 		//
-		cache = AAS_GetAreaRoutingCache(curupdate->cluster,
+		cache = AAS_GetAreaRoutingCache(scratch, curupdate->cluster,
 								curupdate->areanum, portalcache->travelflags);
+		if (!cache) return;
 		//take all portals of the cluster
 		for (i = 0; i < cluster->numportals; i++)
 		{
@@ -1510,7 +1892,7 @@ void AAS_UpdatePortalRoutingCache(aas_routingcache_t *portalcache)
 					portalcache->traveltimes[portalnum] > t)
 			{
 				portalcache->traveltimes[portalnum] = t;
-				nextupdate = &aasworld.portalupdate[portalnum];
+				nextupdate = &scratch->portalupdate[portalnum];
 				if (portal->frontcluster == curupdate->cluster)
 				{
 					nextupdate->cluster = portal->backcluster;
@@ -1544,7 +1926,7 @@ void AAS_UpdatePortalRoutingCache(aas_routingcache_t *portalcache)
 // Returns:				-
 // Changes Globals:		-
 //===========================================================================
-aas_routingcache_t *AAS_GetPortalRoutingCache(int clusternum, int areanum, int travelflags)
+static aas_routingcache_t *AAS_FindPortalRoutingCache(int areanum, int travelflags)
 {
 	aas_routingcache_t *cache;
 
@@ -1553,22 +1935,59 @@ aas_routingcache_t *AAS_GetPortalRoutingCache(int clusternum, int areanum, int t
 	{
 		if (cache->travelflags == travelflags) break;
 	} //end for
+	return cache;
+} //end of the function AAS_FindPortalRoutingCache
+//===========================================================================
+//
+// Parameter:			-
+// Returns:				NULL when a routing job ran out of cache memory
+// Changes Globals:		-
+//===========================================================================
+aas_routingcache_t *AAS_GetPortalRoutingCache(aas_routingscratch_t *scratch, int clusternum, int areanum, int travelflags)
+{
+	aas_routingcache_t *cache, *portalcache;
+
+	AAS_LockRoutingCache();
+	cache = AAS_FindPortalRoutingCache(areanum, travelflags);
 	//if the portal routing isn't cached
 	if (!cache)
 	{
-		cache = AAS_AllocRoutingCache(aasworld.numportals);
+		cache = AAS_NewRoutingCache(aasworld.numportals);
+		AAS_UnlockRoutingCache();
+		if (!cache)
+		{
+			scratch->outofmemory = qtrue;
+			return NULL;
+		} //end if
 		cache->cluster = clusternum;
 		cache->areanum = areanum;
 		VectorCopy(aasworld.areas[areanum].center, cache->origin);
 		cache->starttraveltime = 1;
 		cache->travelflags = travelflags;
-		//add the cache to the cache list
-		cache->prev = NULL;
-		cache->next = aasworld.portalcache[areanum];
-		if (aasworld.portalcache[areanum]) aasworld.portalcache[areanum]->prev = cache;
-		aasworld.portalcache[areanum] = cache;
 		//update the cache
-		AAS_UpdatePortalRoutingCache(cache);
+		AAS_UpdatePortalRoutingCache(scratch, cache);
+		//an incomplete cache is never stored, the pool memory is lost until the jobs finish
+		if (scratch->outofmemory) return NULL;
+		//
+		AAS_LockRoutingCache();
+		//another routing job may have built the same cache in the meantime
+		portalcache = AAS_FindPortalRoutingCache(areanum, travelflags);
+		if (portalcache)
+		{
+			cache = portalcache;
+			AAS_UnlinkCache(cache);
+		} //end if
+		else
+		{
+			//add the cache to the cache list
+			cache->prev = NULL;
+			cache->next = aasworld.portalcache[areanum];
+			if (aasworld.portalcache[areanum]) aasworld.portalcache[areanum]->prev = cache;
+			aasworld.portalcache[areanum] = cache;
+#ifdef ROUTING_DEBUG
+			numportalcacheupdates++;
+#endif //ROUTING_DEBUG
+		} //end else
 	} //end if
 	else
 	{
@@ -1578,28 +1997,951 @@ aas_routingcache_t *AAS_GetPortalRoutingCache(int clusternum, int areanum, int t
 	cache->time = AAS_RoutingTime();
 	cache->type = CACHETYPE_PORTAL;
 	AAS_LinkCache(cache);
+	AAS_UnlockRoutingCache();
 	return cache;
 } //end of the function AAS_GetPortalRoutingCache
 //===========================================================================
+// frees the route tables
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		routetables
+//===========================================================================
+void AAS_FreeRouteTables(void)
+{
+	if (routetables.firstentry) FreeMemory(routetables.firstentry);
+	Com_Memset(&routetables, 0, sizeof(aas_routetables_t));
+} //end of the function AAS_FreeRouteTables
+//===========================================================================
+// allocates all the route tables in one block of memory
 //
 // Parameter:			-
 // Returns:				-
+// Changes Globals:		routetables
+//===========================================================================
+static void AAS_AllocRouteTables(void)
+{
+	int i, numentries, numportaltimes;
+	char *ptr;
+
+	numentries = 0;
+	for (i = 0; i < aasworld.numclusters; i++)
+	{
+		numentries += aasworld.clusters[i].numreachabilityareas * aasworld.clusters[i].numportals;
+	} //end for
+	numportaltimes = aasworld.numportals * aasworld.numportals;
+	//
+	ptr = (char *) GetClearedMemory(aasworld.numclusters * sizeof(int) +
+						(numportaltimes + numentries * 2) * sizeof(unsigned short int) +
+						numentries * sizeof(unsigned char) +
+						aasworld.numareas * sizeof(byte));
+	routetables.firstentry = (int *) ptr;
+	ptr += aasworld.numclusters * sizeof(int);
+	routetables.portaltimes = (unsigned short int *) ptr;
+	ptr += numportaltimes * sizeof(unsigned short int);
+	routetables.areaportaltimes = (unsigned short int *) ptr;
+	ptr += numentries * sizeof(unsigned short int);
+	routetables.portalareatimes = (unsigned short int *) ptr;
+	ptr += numentries * sizeof(unsigned short int);
+	routetables.areaportalreach = (unsigned char *) ptr;
+	ptr += numentries * sizeof(unsigned char);
+	routetables.disabled = (byte *) ptr;
+	routetables.numentries = numentries;
+	//
+	numentries = 0;
+	for (i = 0; i < aasworld.numclusters; i++)
+	{
+		routetables.firstentry[i] = numentries;
+		numentries += aasworld.clusters[i].numreachabilityareas * aasworld.clusters[i].numportals;
+	} //end for
+} //end of the function AAS_AllocRouteTables
+//===========================================================================
+// returns the first route table entry of the cluster area, the entries
+// of the cluster portals follow
+//
+// Parameter:			clusternum		: cluster the area is in
+//						clusterareanum	: number of the area in the cluster
+// Returns:				index in the area portal and portal area tables
 // Changes Globals:		-
 //===========================================================================
-int AAS_AreaRouteToGoalArea(int areanum, vec3_t origin, int goalareanum, int travelflags, int *traveltime, int *reachnum)
+static ID_INLINE int AAS_RouteTableEntry(int clusternum, int clusterareanum)
 {
-	int clusternum, goalclusternum, portalnum, i, clusterareanum, bestreachnum;
-	unsigned short int t, besttime;
+	return routetables.firstentry[clusternum] +
+				clusterareanum * aasworld.clusters[clusternum].numportals;
+} //end of the function AAS_RouteTableEntry
+//===========================================================================
+// calculates the shortest travel times between all the portals from the
+// area portal travel times, going from one portal to the next through a
+// cluster the maximum travel time through the next portal is added just
+// like the portal routing cache does
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		routetables
+//===========================================================================
+static void AAS_CalculatePortalTravelTimes(void)
+{
+	int i, j, side, numportals, goalportalnum, portalnum, prevportalnum;
+	int clusternum, clusterareanum, t, first, last;
+	int *clusterportalindex, *traveltimes, *queue;
+	byte *inqueue;
 	aas_portal_t *portal;
 	aas_cluster_t *cluster;
-	aas_routingcache_t *areacache, *portalcache;
-	aas_reachability_t *reach;
-
-	if (!aasworld.initialized) return qfalse;
 
-	if (areanum == goalareanum)
-	{
-		*traveltime = 1;
+	numportals = aasworld.numportals;
+	if (!numportals) return;
+	clusterportalindex = (int *) GetClearedMemory(numportals * 4 * sizeof(int) + numportals * sizeof(byte));
+	traveltimes = clusterportalindex + numportals * 2;
+	queue = traveltimes + numportals;
+	inqueue = (byte *) (queue + numportals);
+	//index of every portal in the portal list of its front and back cluster
+	for (i = 0; i < numportals; i++)
+	{
+		portal = &aasworld.portals[i];
+		for (side = 0; side < 2; side++)
+		{
+			cluster = &aasworld.clusters[side ? portal->backcluster : portal->frontcluster];
+			for (j = 0; j < cluster->numportals; j++)
+			{
+				if (aasworld.portalindex[cluster->firstportal + j] == i) break;
+			} //end for
+			clusterportalindex[i * 2 + side] = j;
+		} //end for
+	} //end for
+	//travel times from all the portals towards every goal portal
+	for (goalportalnum = 0; goalportalnum < numportals; goalportalnum++)
+	{
+		for (i = 0; i < numportals; i++) traveltimes[i] = -1;
+		traveltimes[goalportalnum] = 0;
+		queue[0] = goalportalnum;
+		inqueue[goalportalnum] = qtrue;
+		first = 0;
+		last = 1;
+		while (first != last)
+		{
+			portalnum = queue[first];
+			first = (first + 1) % numportals;
+			inqueue[portalnum] = qfalse;
+			portal = &aasworld.portals[portalnum];
+			//the portals of both clusters the portal is in lead to it
+			for (side = 0; side < 2; side++)
+			{
+				clusternum = side ? portal->backcluster : portal->frontcluster;
+				cluster = &aasworld.clusters[clusternum];
+				if (clusterportalindex[portalnum * 2 + side] >= cluster->numportals) continue;
+				for (j = 0; j < cluster->numportals; j++)
+				{
+					prevportalnum = aasworld.portalindex[cluster->firstportal + j];
+					if (prevportalnum == portalnum) continue;
+					clusterareanum = AAS_ClusterAreaNum(clusternum, aasworld.portals[prevportalnum].areanum);
+					if (clusterareanum >= cluster->numreachabilityareas) continue;
+					t = routetables.areaportaltimes[AAS_RouteTableEntry(clusternum, clusterareanum) +
+												clusterportalindex[portalnum * 2 + side]];
+					if (!t) continue;
+					t += traveltimes[portalnum] + aasworld.portalmaxtraveltimes[portalnum];
+					if (traveltimes[prevportalnum] >= 0 && traveltimes[prevportalnum] <= t) continue;
+					traveltimes[prevportalnum] = t;
+					if (!inqueue[prevportalnum])
+					{
+						queue[last] = prevportalnum;
+						last = (last + 1) % numportals;
+						inqueue[prevportalnum] = qtrue;
+					} //end if
+				} //end for
+			} //end for
+		} //end while
+		for (i = 0; i < numportals; i++)
+		{
+			if (i == goalportalnum || traveltimes[i] < 0) continue;
+			if (traveltimes[i] > 0xffff) traveltimes[i] = 0xffff;
+			routetables.portaltimes[i * numportals + goalportalnum] = traveltimes[i];
+		} //end for
+	} //end for
+	FreeMemory(clusterportalindex);
+} //end of the function AAS_CalculatePortalTravelTimes
+//===========================================================================
+// calculates the route tables, for every cluster an area routing cache is
+// made towards every area of the cluster
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		routetables
+//===========================================================================
+static void AAS_CalculateRouteTables(void)
+{
+	int i, j, n, clusternum, areanum, clusterareanum, maxareas, portalnum, entry;
+	int *clusterareas;
+	aas_cluster_t *cluster;
+	aas_portal_t *portal;
+	aas_routingcache_t *cache;
+
+	maxareas = 0;
+	for (i = 0; i < aasworld.numclusters; i++)
+	{
+		if (aasworld.clusters[i].numreachabilityareas > maxareas)
+		{
+			maxareas = aasworld.clusters[i].numreachabilityareas;
+		} //end if
+	} //end for
+	clusterareas = (int *) GetMemory(maxareas * sizeof(int));
+	//one routing cache that is reused for all the areas
+	cache = (aas_routingcache_t *) GetClearedMemory(AAS_RoutingCacheSize(maxareas));
+	cache->reachabilities = (unsigned char *) cache + sizeof(aas_routingcache_t)
+								+ maxareas * sizeof(unsigned short int);
+	cache->size = AAS_RoutingCacheSize(maxareas);
+	//
+	for (clusternum = 0; clusternum < aasworld.numclusters; clusternum++)
+	{
+		cluster = &aasworld.clusters[clusternum];
+		if (!cluster->numportals) continue;
+		//find the areas of the cluster, including the portals
+		Com_Memset(clusterareas, 0, maxareas * sizeof(int));
+		for (areanum = 1; areanum < aasworld.numareas; areanum++)
+		{
+			n = aasworld.areasettings[areanum].cluster;
+			if (n > 0)
+			{
+				if (n != clusternum) continue;
+			} //end if
+			else if (n < 0)
+			{
+				portal = &aasworld.portals[-n];
+				if (portal->frontcluster != clusternum && portal->backcluster != clusternum) continue;
+			} //end else if
+			else
+			{
+				continue;
+			} //end else
+			clusterareanum = AAS_ClusterAreaNum(clusternum, areanum);
+			if (clusterareanum >= cluster->numreachabilityareas) continue;
+			clusterareas[clusterareanum] = areanum;
+		} //end for
+		//
+		for (i = 0; i < cluster->numreachabilityareas; i++)
+		{
+			areanum = clusterareas[i];
+			if (!areanum) continue;
+			//travel times from all the areas in the cluster towards this area
+			Com_Memset(cache->traveltimes, 0, cluster->numreachabilityareas * sizeof(unsigned short int));
+			Com_Memset(cache->reachabilities, 0, cluster->numreachabilityareas * sizeof(unsigned char));
+			cache->cluster = clusternum;
+			cache->areanum = areanum;
+			VectorCopy(aasworld.areas[areanum].center, cache->origin);
+			cache->starttraveltime = 1;
+			cache->travelflags = routetables.travelflags;
+			AAS_UpdateAreaRoutingCache(&mainscratch, cache);
+			//
+			for (j = 0; j < cluster->numportals; j++)
+			{
+				portalnum = aasworld.portalindex[cluster->firstportal + j];
+				portal = &aasworld.portals[portalnum];
+				clusterareanum = AAS_ClusterAreaNum(clusternum, portal->areanum);
+				if (clusterareanum >= cluster->numreachabilityareas) continue;
+				routetables.portalareatimes[AAS_RouteTableEntry(clusternum, i) + j] =
+												cache->traveltimes[clusterareanum];
+				//if this area is the portal store the travel times towards it
+				if (portal->areanum != areanum) continue;
+				for (n = 0; n < cluster->numreachabilityareas; n++)
+				{
+					entry = AAS_RouteTableEntry(clusternum, n) + j;
+					routetables.areaportaltimes[entry] = cache->traveltimes[n];
+					routetables.areaportalreach[entry] = cache->reachabilities[n];
+				} //end for
+			} //end for
+		} //end for
+	} //end for
+	FreeMemory(cache);
+	FreeMemory(clusterareas);
+	//
+	AAS_CalculatePortalTravelTimes();
+} //end of the function AAS_CalculateRouteTables
+//===========================================================================
+// fills in the route tables header for the current map
+//
+// Parameter:			header			: header to fill in
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+static void AAS_RouteTableHeader(routetableheader_t *header)
+{
+	header->ident = RTID;
+	header->version = RTVERSION;
+	header->numareas = aasworld.numareas;
+	header->numclusters = aasworld.numclusters;
+	header->numportals = aasworld.numportals;
+	header->areacrc = CRC_ProcessString( (unsigned char *)aasworld.areas, sizeof(aas_area_t) * aasworld.numareas );
+	header->clustercrc = CRC_ProcessString( (unsigned char *)aasworld.clusters, sizeof(aas_cluster_t) * aasworld.numclusters );
+	header->areasettingscrc = CRC_ProcessString( (unsigned char *)aasworld.areasettings, sizeof(aas_areasettings_t) * aasworld.numareasettings );
+	header->reachabilitycrc = CRC_ProcessString( (unsigned char *)aasworld.reachability, sizeof(aas_reachability_t) * aasworld.reachabilitysize );
+	header->travelflags = routetables.travelflags;
+	header->numentries = routetables.numentries;
+} //end of the function AAS_RouteTableHeader
+//===========================================================================
+// writes the route tables to maps/<mapname>.rtb
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+static void AAS_WriteRouteTables(void)
+{
+	fileHandle_t fp;
+	char filename[MAX_QPATH];
+	routetableheader_t header;
+
+	Com_sprintf(filename, MAX_QPATH, "maps/%s.rtb", aasworld.mapname);
+	botimport.FS_FOpenFile( filename, &fp, FS_WRITE );
+	if (!fp)
+	{
+		botimport.Print(PRT_ERROR, "Unable to open file: %s\n", filename);
+		return;
+	} //end if
+	AAS_RouteTableHeader(&header);
+	botimport.FS_Write(&header, sizeof(routetableheader_t), fp);
+	botimport.FS_Write(routetables.portaltimes, aasworld.numportals * aasworld.numportals * sizeof(unsigned short int), fp);
+	botimport.FS_Write(routetables.areaportaltimes, routetables.numentries * sizeof(unsigned short int), fp);
+	botimport.FS_Write(routetables.portalareatimes, routetables.numentries * sizeof(unsigned short int), fp);
+	botimport.FS_Write(routetables.areaportalreach, routetables.numentries * sizeof(unsigned char), fp);
+	botimport.FS_FCloseFile(fp);
+	botimport.Print(PRT_MESSAGE, "route tables written to %s\n", filename);
+} //end of the function AAS_WriteRouteTables
+//===========================================================================
+// reads the route tables from maps/<mapname>.rtb, the file is only used
+// when it was made for the same AAS data
+//
+// Parameter:			-
+// Returns:				qtrue when the route tables were read
+// Changes Globals:		routetables
+//===========================================================================
+static int AAS_ReadRouteTables(void)
+{
+	int length, size;
+	fileHandle_t fp;
+	char filename[MAX_QPATH];
+	routetableheader_t header, fileheader;
+
+	Com_sprintf(filename, MAX_QPATH, "maps/%s.rtb", aasworld.mapname);
+	length = botimport.FS_FOpenFile( filename, &fp, FS_READ );
+	if (!fp)
+	{
+		return qfalse;
+	} //end if
+	AAS_RouteTableHeader(&header);
+	size = sizeof(routetableheader_t) +
+			aasworld.numportals * aasworld.numportals * sizeof(unsigned short int) +
+			routetables.numentries * (2 * sizeof(unsigned short int) + sizeof(unsigned char));
+	if (length == size)
+	{
+		botimport.FS_Read(&fileheader, sizeof(routetableheader_t), fp);
+	} //end if
+	//the tables are made again when the file doesn't match the AAS data
+	if (length != size || memcmp(&header, &fileheader, sizeof(routetableheader_t)))
+	{
+		botimport.FS_FCloseFile(fp);
+		botimport.Print(PRT_MESSAGE, "%s is out of date\n", filename);
+		return qfalse;
+	} //end if
+	botimport.FS_Read(routetables.portaltimes, aasworld.numportals * aasworld.numportals * sizeof(unsigned short int), fp);
+	botimport.FS_Read(routetables.areaportaltimes, routetables.numentries * sizeof(unsigned short int), fp);
+	botimport.FS_Read(routetables.portalareatimes, routetables.numentries * sizeof(unsigned short int), fp);
+	botimport.FS_Read(routetables.areaportalreach, routetables.numentries * sizeof(unsigned char), fp);
+	botimport.FS_FCloseFile(fp);
+	return qtrue;
+} //end of the function AAS_ReadRouteTables
+//===========================================================================
+// reads or calculates the route tables, with the libvar routetables set
+// to 2 calculated tables are written to the route tables file
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		routetables
+//===========================================================================
+void AAS_InitRouteTables(void)
+{
+	int i, mode, starttime;
+
+	AAS_FreeRouteTables();
+	mode = (int) LibVarValue("routetables", "1");
+	if (!mode) return;
+	if (aasworld.numportals > MAX_ROUTETABLEPORTALS)
+	{
+		botimport.Print(PRT_WARNING, "%d cluster portals, no route tables\n", aasworld.numportals);
+		return;
+	} //end if
+	AAS_AllocRouteTables();
+	routetables.travelflags = TFL_DEFAULT;
+	if (!AAS_ReadRouteTables())
+	{
+		starttime = Sys_MilliSeconds();
+		AAS_CalculateRouteTables();
+		botimport.Print(PRT_MESSAGE, "route tables calculated in %d msec\n", Sys_MilliSeconds() - starttime);
+		if (mode > 1) AAS_WriteRouteTables();
+	} //end if
+	//remember which areas are disabled in the tables
+	for (i = 0; i < aasworld.numareas; i++)
+	{
+		routetables.disabled[i] = aasworld.areasettings[i].areaflags & AREA_DISABLED;
+	} //end for
+	routetables.loaded = qtrue;
+} //end of the function AAS_InitRouteTables
+//===========================================================================
+// returns the travel time from the portal to the goal area using the
+// route tables, the travel time through the portal itself is not included
+//
+// Parameter:			portalnum		: portal to start at
+//						goalareanum		: area to travel to
+// Returns:				the travel time or zero when the goal can't be reached
+// Changes Globals:		-
+//===========================================================================
+static int AAS_RouteTablePortalToGoalArea(int portalnum, int goalareanum)
+{
+	int i, side, clusternum, goalclusternum, clusterareanum, goalportalnum;
+	int entry, t, portaltime, besttime;
+	aas_cluster_t *cluster;
+
+	goalclusternum = aasworld.areasettings[goalareanum].cluster;
+	besttime = 0;
+	//a portal goal area is reached from both its clusters
+	for (side = 0; side < 2; side++)
+	{
+		if (goalclusternum > 0)
+		{
+			if (side) break;
+			clusternum = goalclusternum;
+		} //end if
+		else if (side) clusternum = aasworld.portals[-goalclusternum].backcluster;
+		else clusternum = aasworld.portals[-goalclusternum].frontcluster;
+		//
+		cluster = &aasworld.clusters[clusternum];
+		clusterareanum = AAS_ClusterAreaNum(clusternum, goalareanum);
+		if (clusterareanum >= cluster->numreachabilityareas) continue;
+		entry = AAS_RouteTableEntry(clusternum, clusterareanum);
+		//enter the goal cluster through any of its portals
+		for (i = 0; i < cluster->numportals; i++)
+		{
+			goalportalnum = aasworld.portalindex[cluster->firstportal + i];
+			//the same start travel time as the portal routing cache
+			if (goalportalnum == -goalclusternum) t = 1;
+			else
+			{
+				t = routetables.portalareatimes[entry + i];
+				if (!t) continue;
+				t += 1;
+			} //end else
+			if (goalportalnum != portalnum)
+			{
+				portaltime = routetables.portaltimes[portalnum * aasworld.numportals + goalportalnum];
+				if (!portaltime) continue;
+				t += portaltime;
+			} //end if
+			if (!besttime || t < besttime) besttime = t;
+		} //end for
+	} //end for
+	return besttime;
+} //end of the function AAS_RouteTablePortalToGoalArea
+//===========================================================================
+// finds the route from the area to a goal area in another cluster using
+// the route tables
+//
+// Parameter:			areanum			: area to start in
+//						origin			: start origin in the area or NULL
+//						goalareanum		: area to travel to
+//						traveltime		: set to the travel time
+//						reachnum		: set to the reachability to take
+// Returns:				qtrue when the goal area can be reached
+// Changes Globals:		-
+//===========================================================================
+static int AAS_RouteTableToGoalArea(int areanum, vec3_t origin, int goalareanum, int *traveltime, int *reachnum)
+{
+	int i, side, clusternum, areaclusternum, goalclusternum, clusterareanum, portalnum;
+	int entry, t, goaltime, besttime, bestreachnum;
+	aas_cluster_t *cluster;
+	aas_reachability_t *reach;
+
+	areaclusternum = aasworld.areasettings[areanum].cluster;
+	goalclusternum = aasworld.areasettings[goalareanum].cluster;
+	besttime = 0;
+	bestreachnum = -1;
+	//a portal area leaves through both its clusters
+	for (side = 0; side < 2; side++)
+	{
+		if (areaclusternum > 0)
+		{
+			if (side) break;
+			clusternum = areaclusternum;
+		} //end if
+		else if (side) clusternum = aasworld.portals[-areaclusternum].backcluster;
+		else clusternum = aasworld.portals[-areaclusternum].frontcluster;
+		//
+		cluster = &aasworld.clusters[clusternum];
+		clusterareanum = AAS_ClusterAreaNum(clusternum, areanum);
+		if (clusterareanum >= cluster->numreachabilityareas) continue;
+		entry = AAS_RouteTableEntry(clusternum, clusterareanum);
+		//leave the cluster through any of its portals
+		for (i = 0; i < cluster->numportals; i++)
+		{
+			portalnum = aasworld.portalindex[cluster->firstportal + i];
+			if (portalnum == -areaclusternum) continue;
+			t = routetables.areaportaltimes[entry + i];
+			if (!t) continue;
+			//travel through the portal unless it is the goal area
+			if (portalnum != -goalclusternum)
+			{
+				goaltime = AAS_RouteTablePortalToGoalArea(portalnum, goalareanum);
+				if (!goaltime) continue;
+				t += aasworld.portalmaxtraveltimes[portalnum] + goaltime;
+			} //end if
+			if (origin)
+			{
+				reach = &aasworld.reachability[aasworld.areasettings[areanum].firstreachablearea +
+												routetables.areaportalreach[entry + i]];
+				t += AAS_AreaTravelTime(areanum, origin, reach->start);
+			} //end if
+			if (!besttime || t < besttime)
+			{
+				besttime = t;
+				bestreachnum = aasworld.areasettings[areanum].firstreachablearea +
+									routetables.areaportalreach[entry + i];
+			} //end if
+		} //end for
+	} //end for
+	if (bestreachnum < 0) return qfalse;
+	*traveltime = besttime;
+	*reachnum = bestreachnum;
+	return qtrue;
+} //end of the function AAS_RouteTableToGoalArea
+//===========================================================================
+// distance to travel from the first box to the second one, falling down
+// costs nothing because it can be a lot faster than walking
+//
+// Parameter:			mins1, maxs1	: box to start in
+//						mins2, maxs2	: box to travel to
+// Returns:				the distance, zero when the boxes touch
+// Changes Globals:		-
+//===========================================================================
+static float AAS_SearchDistance(vec3_t mins1, vec3_t maxs1, vec3_t mins2, vec3_t maxs2)
+{
+	int i;
+	float d, dist;
+
+	dist = 0;
+	for (i = 0; i < 2; i++)
+	{
+		if (mins2[i] > maxs1[i]) d = mins2[i] - maxs1[i];
+		else if (mins1[i] > maxs2[i]) d = mins1[i] - maxs2[i];
+		else continue;
+		dist += d * d;
+	} //end for
+	if (mins2[2] > maxs1[2])
+	{
+		d = mins2[2] - maxs1[2];
+		dist += d * d;
+	} //end if
+	return sqrt(dist);
+} //end of the function AAS_SearchDistance
+//===========================================================================
+// finds the reachabilities that are faster than walking
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+static void AAS_InitSearchShortcuts(void)
+{
+	int i;
+	aas_reachability_t *reach;
+
+	routesearch.numshortcuts = 0;
+	for (i = 1; i < aasworld.reachabilitysize; i++)
+	{
+		reach = &aasworld.reachability[i];
+		if (reach->traveltime >= AAS_SearchDistance(reach->start, reach->start, reach->end, reach->end) *
+										SEARCHDISTANCEFACTOR) continue;
+		routesearch.numshortcuts++;
+	} //end for
+	if (routesearch.numshortcuts > MAX_SEARCHSHORTCUTS)
+	{
+		routesearch.noestimate = qtrue;
+		routesearch.numshortcuts = 0;
+		return;
+	} //end if
+	routesearch.numshortcuts = 0;
+	for (i = 1; i < aasworld.reachabilitysize; i++)
+	{
+		reach = &aasworld.reachability[i];
+		if (reach->traveltime >= AAS_SearchDistance(reach->start, reach->start, reach->end, reach->end) *
+										SEARCHDISTANCEFACTOR) continue;
+		routesearch.shortcuts[routesearch.numshortcuts++] = i;
+	} //end for
+} //end of the function AAS_InitSearchShortcuts
+//===========================================================================
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+void AAS_InitRouteSearch(void)
+{
+	char *ptr;
+
+	AAS_FreeRouteSearch();
+	if (!(int) LibVarValue("routesearch", "1")) return;
+	//
+	routesearch.maxheapsize = aasworld.reachabilitysize + aasworld.numareas;
+	ptr = (char *) GetClearedMemory(aasworld.numareas * (2 * sizeof(int) + 2 * sizeof(unsigned short int) +
+									sizeof(unsigned char) + sizeof(byte)) +
+									routesearch.maxheapsize * sizeof(aas_searchnode_t) +
+									MAX_SEARCHSHORTCUTS * (2 * sizeof(int) + sizeof(float) + sizeof(byte)));
+	routesearch.heap = (aas_searchnode_t *) ptr;
+	ptr += routesearch.maxheapsize * sizeof(aas_searchnode_t);
+	routesearch.labelled = (int *) ptr;
+	ptr += aasworld.numareas * sizeof(int);
+	routesearch.expanded = (int *) ptr;
+	ptr += aasworld.numareas * sizeof(int);
+	routesearch.shortcuts = (int *) ptr;
+	ptr += MAX_SEARCHSHORTCUTS * sizeof(int);
+	routesearch.searchshortcuts = (int *) ptr;
+	ptr += MAX_SEARCHSHORTCUTS * sizeof(int);
+	routesearch.shortcuttimes = (float *) ptr;
+	ptr += MAX_SEARCHSHORTCUTS * sizeof(float);
+	routesearch.traveltimes = (unsigned short int *) ptr;
+	ptr += aasworld.numareas * sizeof(unsigned short int);
+	routesearch.estimates = (unsigned short int *) ptr;
+	ptr += aasworld.numareas * sizeof(unsigned short int);
+	routesearch.reachabilities = (unsigned char *) ptr;
+	ptr += aasworld.numareas * sizeof(unsigned char);
+	routesearch.goalsearches = (byte *) ptr;
+	ptr += aasworld.numareas * sizeof(byte);
+	routesearch.shortcutdone = (byte *) ptr;
+	//
+	AAS_InitSearchShortcuts();
+	routesearch.generation = 1;
+	mainscratch.routesearch = qtrue;
+} //end of the function AAS_InitRouteSearch
+//===========================================================================
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+void AAS_FreeRouteSearch(void)
+{
+	if (routesearch.heap) FreeMemory(routesearch.heap);
+	Com_Memset(&routesearch, 0, sizeof(aas_routesearch_t));
+	mainscratch.routesearch = qfalse;
+} //end of the function AAS_FreeRouteSearch
+//===========================================================================
+// forgets the found routes after areas were enabled or disabled
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+void AAS_InvalidateRouteSearch(void)
+{
+	if (!routesearch.heap) return;
+	routesearch.generation++;
+	Com_Memset(routesearch.goalsearches, 0, aasworld.numareas * sizeof(byte));
+} //end of the function AAS_InvalidateRouteSearch
+//===========================================================================
+//
+// Parameter:			-
+// Returns:				qtrue when the area is in the cluster or one of its portals
+// Changes Globals:		-
+//===========================================================================
+static int AAS_AreaInCluster(int clusternum, int areanum)
+{
+	int areaclusternum;
+	aas_portal_t *portal;
+
+	areaclusternum = aasworld.areasettings[areanum].cluster;
+	if (areaclusternum > 0) return areaclusternum == clusternum;
+	portal = &aasworld.portals[-areaclusternum];
+	return portal->frontcluster == clusternum || portal->backcluster == clusternum;
+} //end of the function AAS_AreaInCluster
+//===========================================================================
+// calculates a lower bound of the travel time from the start area to the
+// end of every shortcut in the cluster
+//
+// Parameter:			clusternum		: cluster searched
+//						areanum			: start area
+//						travelflags		: allowed travel types
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+static void AAS_SearchShortcutTimes(int clusternum, int areanum, int travelflags)
+{
+	int i, j, best, numshortcuts;
+	float t, *shortcuttimes;
+	byte *shortcutdone;
+	aas_area_t *area;
+	aas_reachability_t *reach, *nextreach;
+
+	area = &aasworld.areas[areanum];
+	shortcuttimes = routesearch.shortcuttimes;
+	shortcutdone = routesearch.shortcutdone;
+	numshortcuts = 0;
+	for (i = 0; i < routesearch.numshortcuts; i++)
+	{
+		reach = &aasworld.reachability[routesearch.shortcuts[i]];
+		if (AAS_TravelFlagForType_inline(reach->traveltype) & ~travelflags) continue;
+		if (!AAS_AreaInCluster(clusternum, reach->areanum)) continue;
+		routesearch.searchshortcuts[numshortcuts] = routesearch.shortcuts[i];
+		//walk straight to the start of the shortcut
+		shortcuttimes[numshortcuts] = AAS_SearchDistance(area->mins, area->maxs, reach->start, reach->start) *
+											SEARCHDISTANCEFACTOR + reach->traveltime;
+		shortcutdone[numshortcuts] = qfalse;
+		numshortcuts++;
+	} //end for
+	routesearch.numsearchshortcuts = numshortcuts;
+	//shortest times over chained shortcuts
+	while(1)
+	{
+		best = -1;
+		for (i = 0; i < numshortcuts; i++)
+		{
+			if (shortcutdone[i]) continue;
+			if (best < 0 || shortcuttimes[i] < shortcuttimes[best]) best = i;
+		} //end for
+		if (best < 0) break;
+		shortcutdone[best] = qtrue;
+		reach = &aasworld.reachability[routesearch.searchshortcuts[best]];
+		for (j = 0; j < numshortcuts; j++)
+		{
+			if (shortcutdone[j]) continue;
+			nextreach = &aasworld.reachability[routesearch.searchshortcuts[j]];
+			t = shortcuttimes[best] + nextreach->traveltime +
+					AAS_SearchDistance(reach->end, reach->end, nextreach->start, nextreach->start) * SEARCHDISTANCEFACTOR;
+			if (t < shortcuttimes[j]) shortcuttimes[j] = t;
+		} //end for
+	} //end while
+} //end of the function AAS_SearchShortcutTimes
+//===========================================================================
+// lower bound of the travel time from the start area to the area
+//
+// Parameter:			areanum			: area to estimate for
+//						startareanum	: start area of the route
+// Returns:				the estimated travel time
+// Changes Globals:		-
+//===========================================================================
+static int AAS_SearchEstimate(int areanum, int startareanum)
+{
+	int i;
+	float t, besttime;
+	aas_area_t *area, *startarea;
+	aas_reachability_t *reach;
+
+	if (routesearch.noestimate) return 0;
+	area = &aasworld.areas[areanum];
+	startarea = &aasworld.areas[startareanum];
+	besttime = AAS_SearchDistance(startarea->mins, startarea->maxs, area->mins, area->maxs) * SEARCHDISTANCEFACTOR;
+	for (i = 0; i < routesearch.numsearchshortcuts; i++)
+	{
+		if (routesearch.shortcuttimes[i] >= besttime) continue;
+		reach = &aasworld.reachability[routesearch.searchshortcuts[i]];
+		t = routesearch.shortcuttimes[i] +
+				AAS_SearchDistance(reach->end, reach->end, area->mins, area->maxs) * SEARCHDISTANCEFACTOR;
+		if (t < besttime) besttime = t;
+	} //end for
+	return (int) besttime;
+} //end of the function AAS_SearchEstimate
+//===========================================================================
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+static void AAS_PushSearchNode(int weight, int traveltime, int areanum)
+{
+	int i, parent;
+	aas_searchnode_t *heap;
+
+	heap = routesearch.heap;
+	for (i = routesearch.heapsize++; i > 0; i = parent)
+	{
+		parent = (i - 1) >> 1;
+		if (heap[parent].weight <= weight) break;
+		heap[i] = heap[parent];
+	} //end for
+	heap[i].weight = weight;
+	heap[i].traveltime = traveltime;
+	heap[i].areanum = areanum;
+} //end of the function AAS_PushSearchNode
+//===========================================================================
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+static void AAS_PopSearchNode(aas_searchnode_t *node)
+{
+	int i, child;
+	aas_searchnode_t *heap, *last;
+
+	heap = routesearch.heap;
+	*node = heap[0];
+	last = &heap[--routesearch.heapsize];
+	for (i = 0; (child = 2 * i + 1) < routesearch.heapsize; i = child)
+	{
+		if (child + 1 < routesearch.heapsize && heap[child + 1].weight < heap[child].weight) child++;
+		if (last->weight <= heap[child].weight) break;
+		heap[i] = heap[child];
+	} //end for
+	heap[i] = *last;
+} //end of the function AAS_PopSearchNode
+//===========================================================================
+// searches for the route from the area to a goal area in the same cluster
+// using the same travel times as the area routing cache update
+//
+// Parameter:			clusternum		: cluster of both areas
+//						areanum			: area to start in
+//						goalareanum		: area to travel to
+//						travelflags		: allowed travel types
+//						traveltime		: set to the travel time, zero when the goal can't be reached
+//						reachability	: set to the index of the reachability to take
+// Returns:				qfalse when the search ran out of room
+// Changes Globals:		-
+//===========================================================================
+static int AAS_SearchClusterRoute(int clusternum, int areanum, int goalareanum, int travelflags, int *traveltime, int *reachability)
+{
+	int i, badtravelflags, linknum, curareanum, nextareanum, nextclusternum, numreachabilityareas;
+	unsigned short int t, *areatraveltimes;
+	aas_searchnode_t node;
+	aas_reachability_t *reach;
+	aas_reversedlink_t *revlink;
+
+	numreachabilityareas = aasworld.clusters[clusternum].numreachabilityareas;
+	badtravelflags = ~travelflags;
+	routesearch.searchnum++;
+	AAS_SearchShortcutTimes(clusternum, areanum, travelflags);
+	//start at the goal area
+	routesearch.heapsize = 0;
+	routesearch.labelled[goalareanum] = routesearch.searchnum;
+	routesearch.traveltimes[goalareanum] = 1;
+	routesearch.reachabilities[goalareanum] = 0;
+	AAS_PushSearchNode(1, 1, goalareanum);
+	while(routesearch.heapsize)
+	{
+		AAS_PopSearchNode(&node);
+		curareanum = node.areanum;
+		//the area got a shorter travel time after the node was added
+		if (node.traveltime != routesearch.traveltimes[curareanum]) continue;
+		if (routesearch.expanded[curareanum] == routesearch.searchnum) continue;
+		routesearch.expanded[curareanum] = routesearch.searchnum;
+		routesearch.numexpanded++;
+		//
+		if (curareanum == areanum)
+		{
+			*traveltime = routesearch.traveltimes[areanum];
+			*reachability = routesearch.reachabilities[areanum];
+			return qtrue;
+		} //end if
+		//travel times through the area towards the reachability taken
+		if (curareanum == goalareanum) areatraveltimes = NULL;
+		else areatraveltimes = aasworld.areatraveltimes[curareanum][routesearch.reachabilities[curareanum]];
+		//
+		for (i = 0, revlink = aasworld.reversedreachability[curareanum].first; revlink; revlink = revlink->next, i++)
+		{
+			linknum = revlink->linknum;
+			reach = &aasworld.reachability[linknum];
+			//same restrictions as the area routing cache update
+			if (AAS_TravelFlagForType_inline(reach->traveltype) & badtravelflags) continue;
+			if (aasworld.areasettings[reach->areanum].areaflags & AREA_DISABLED) continue;
+			if (AAS_AreaContentsTravelFlags_inline(reach->areanum) & badtravelflags) continue;
+			nextareanum = revlink->areanum;
+			nextclusternum = aasworld.areasettings[nextareanum].cluster;
+			if (nextclusternum > 0 && nextclusternum != clusternum) continue;
+			if (AAS_ClusterAreaNum(clusternum, nextareanum) >= numreachabilityareas) continue;
+			//
+			t = routesearch.traveltimes[curareanum] + reach->traveltime;
+			if (areatraveltimes) t += areatraveltimes[i];
+			if (routesearch.labelled[nextareanum] == routesearch.searchnum)
+			{
+				if (routesearch.traveltimes[nextareanum] <= t) continue;
+			} //end if
+			else
+			{
+				routesearch.labelled[nextareanum] = routesearch.searchnum;
+				routesearch.estimates[nextareanum] = AAS_SearchEstimate(nextareanum, areanum);
+			} //end else
+			routesearch.traveltimes[nextareanum] = t;
+			routesearch.reachabilities[nextareanum] = linknum - aasworld.areasettings[nextareanum].firstreachablearea;
+			//the estimate isn't exact, an expanded area may need another look
+			routesearch.expanded[nextareanum] = 0;
+			if (routesearch.heapsize >= routesearch.maxheapsize) return qfalse;
+			AAS_PushSearchNode(t + routesearch.estimates[nextareanum], t, nextareanum);
+		} //end for
+	} //end while
+	//the goal area can't be reached from the start area
+	*traveltime = 0;
+	*reachability = 0;
+	return qtrue;
+} //end of the function AAS_SearchClusterRoute
+//===========================================================================
+// finds the route from the area to a goal area in the same cluster without
+// an area routing cache
+//
+// Parameter:			clusternum		: cluster of both areas
+//						areanum			: area to start in
+//						goalareanum		: area to travel to
+//						travelflags		: allowed travel types
+//						traveltime		: set to the travel time, zero when the goal can't be reached
+//						reachability	: set to the index of the reachability to take
+// Returns:				qfalse when the area routing cache should be used
+// Changes Globals:		-
+//===========================================================================
+static int AAS_RouteSearchToGoalArea(int clusternum, int areanum, int goalareanum, int travelflags, int *traveltime, int *reachability)
+{
+	int t, reach;
+	aas_searchroute_t *route;
+
+	//use the area routing cache when there is one
+	if (AAS_FindAreaRoutingCache(clusternum, AAS_ClusterAreaNum(clusternum, goalareanum), travelflags)) return qfalse;
+	//
+	route = &routesearch.routes[(areanum * 31 + goalareanum * 7 + travelflags) & (MAX_SEARCHROUTES - 1)];
+	if (route->generation == routesearch.generation && route->areanum == areanum &&
+			route->goalareanum == goalareanum && route->travelflags == travelflags)
+	{
+		*traveltime = route->traveltime;
+		*reachability = route->reachability;
+		return qtrue;
+	} //end if
+	//a goal area that keeps being asked for gets its area routing cache
+	if (routesearch.goalsearches[goalareanum] >= MAX_GOALSEARCHES) return qfalse;
+	if (!AAS_SearchClusterRoute(clusternum, areanum, goalareanum, travelflags, &t, &reach)) return qfalse;
+	routesearch.goalsearches[goalareanum]++;
+	//
+	route->areanum = areanum;
+	route->goalareanum = goalareanum;
+	route->travelflags = travelflags;
+	route->generation = routesearch.generation;
+	route->traveltime = t;
+	route->reachability = reach;
+	*traveltime = t;
+	*reachability = reach;
+	return qtrue;
+} //end of the function AAS_RouteSearchToGoalArea
+//===========================================================================
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+static int AAS_RouteToGoalArea(aas_routingscratch_t *scratch, int areanum, vec3_t origin, int goalareanum, int travelflags, int *traveltime, int *reachnum)
+{
+	int clusternum, goalclusternum, portalnum, i, clusterareanum, bestreachnum;
+	int routetime, routereach;
+	unsigned short int t, besttime;
+	aas_portal_t *portal;
+	aas_cluster_t *cluster;
+	aas_routingcache_t *areacache, *portalcache;
+	aas_reachability_t *reach;
+
+	if (!aasworld.initialized) return qfalse;
+
+	if (areanum == goalareanum)
+	{
+		*traveltime = 1;
 		*reachnum = 0;
 		return qtrue;
 	}
@@ -1624,8 +2966,9 @@ int AAS_AreaRouteToGoalArea(int areanum, vec3_t origin, int goalareanum, int tra
 	{
 		return qfalse;
 	} //end if
-	// make sure the routing cache doesn't grow to large
-	while(AvailableMemory() < 1 * 1024 * 1024) {
+	// make sure the routing cache doesn't grow to large, the routing jobs
+	// are limited by their pool instead
+	while(!routingjobs.active && AvailableMemory() < 1 * 1024 * 1024) {
 		if (!AAS_FreeOldestCache()) break;
 	}
 	//
@@ -1670,30 +3013,40 @@ int AAS_AreaRouteToGoalArea(int areanum, vec3_t origin, int goalareanum, int tra
 	//NOTE: there might be a shorter route via another cluster!!! but we don't care
 	if (clusternum > 0 && goalclusternum > 0 && clusternum == goalclusternum)
 	{
-		//
-		areacache = AAS_GetAreaRoutingCache(clusternum, goalareanum, travelflags);
 		//the number of the area in the cluster
 		clusterareanum = AAS_ClusterAreaNum(clusternum, areanum);
 		//the cluster the area is in
 		cluster = &aasworld.clusters[clusternum];
 		//if the area is NOT a reachability area
 		if (clusterareanum >= cluster->numreachabilityareas) return 0;
+		//search for the route when the goal area has no routing cache
+		if (!scratch->routesearch || !AAS_RouteSearchToGoalArea(clusternum, areanum, goalareanum,
+												travelflags, &routetime, &routereach))
+		{
+			areacache = AAS_GetAreaRoutingCache(scratch, clusternum, goalareanum, travelflags);
+			if (!areacache) return qfalse;
+			routetime = areacache->traveltimes[clusterareanum];
+			routereach = areacache->reachabilities[clusterareanum];
+		} //end if
 		//if it is possible to travel to the goal area through this cluster
-		if (areacache->traveltimes[clusterareanum] != 0)
+		if (routetime != 0)
 		{
-			*reachnum = aasworld.areasettings[areanum].firstreachablearea +
-							areacache->reachabilities[clusterareanum];
+			*reachnum = aasworld.areasettings[areanum].firstreachablearea + routereach;
 			if (!origin) {
-				*traveltime = areacache->traveltimes[clusterareanum];
+				*traveltime = routetime;
 				return qtrue;
 			}
 			reach = &aasworld.reachability[*reachnum];
-			*traveltime = areacache->traveltimes[clusterareanum] +
-							AAS_AreaTravelTime(areanum, origin, reach->start);
+			*traveltime = routetime + AAS_AreaTravelTime(areanum, origin, reach->start);
 			//
 			return qtrue;
 		} //end if
 	} //end if
+	//routes to other clusters come from the route tables when available
+	if (routetables.loaded && !routetables.numchanged && travelflags == routetables.travelflags)
+	{
+		return AAS_RouteTableToGoalArea(areanum, origin, goalareanum, traveltime, reachnum);
+	} //end if
 	//
 	clusternum = aasworld.areasettings[areanum].cluster;
 	goalclusternum = aasworld.areasettings[goalareanum].cluster;
@@ -1705,7 +3058,8 @@ int AAS_AreaRouteToGoalArea(int areanum, vec3_t origin, int goalareanum, int tra
 		goalclusternum = portal->frontcluster;
 	} //end if
 	//get the portal routing cache
-	portalcache = AAS_GetPortalRoutingCache(goalclusternum, goalareanum, travelflags);
+	portalcache = AAS_GetPortalRoutingCache(scratch, goalclusternum, goalareanum, travelflags);
+	if (!portalcache) return qfalse;
 	//if the area is a cluster portal, read directly from the portal cache
 	if (clusternum < 0)
 	{
@@ -1728,7 +3082,8 @@ int AAS_AreaRouteToGoalArea(int areanum, vec3_t origin, int goalareanum, int tra
 		//
 		portal = &aasworld.portals[portalnum];
 		//get the cache of the portal area
-		areacache = AAS_GetAreaRoutingCache(clusternum, portal->areanum, travelflags);
+		areacache = AAS_GetAreaRoutingCache(scratch, clusternum, portal->areanum, travelflags);
+		if (!areacache) return qfalse;
 		//current area inside the current cluster
 		clusterareanum = AAS_ClusterAreaNum(clusternum, areanum);
 		//if the area is NOT a reachability area
@@ -1765,6 +3120,16 @@ int AAS_AreaRouteToGoalArea(int areanum, vec3_t origin, int goalareanum, int tra
 	*reachnum = bestreachnum;
 	*traveltime = besttime;
 	return qtrue;
+} //end of the function AAS_RouteToGoalArea
+//===========================================================================
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+int AAS_AreaRouteToGoalArea(int areanum, vec3_t origin, int goalareanum, int travelflags, int *traveltime, int *reachnum)
+{
+	return AAS_RouteToGoalArea(&mainscratch, areanum, origin, goalareanum, travelflags, traveltime, reachnum);
 } //end of the function AAS_AreaRouteToGoalArea
 //===========================================================================
 //
@@ -1799,6 +3164,299 @@ int AAS_AreaReachabilityToGoalArea(int areanum, vec3_t origin, int goalareanum,
 	return 0;
 } //end of the function AAS_AreaReachabilityToGoalArea
 //===========================================================================
+// answers routing queries until they run out, runs on the worker threads
+//
+// Parameter:			data			: unused
+//						index			: job number, selects the update fields
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+static void AAS_RoutingJob(void *data, int index)
+{
+	aas_routingscratch_t *scratch;
+	aas_routequery_t *query;
+	int traveltime, reachnum;
+
+	scratch = &routingjobs.scratch[index];
+	scratch->outofmemory = qfalse;
+	while(!scratch->outofmemory)
+	{
+		botimport.LockMutex(routingjobs.mutex);
+		if (routingjobs.nextquery >= routingjobs.numqueries)
+		{
+			botimport.UnlockMutex(routingjobs.mutex);
+			break;
+		} //end if
+		query = &routingjobs.queries[routingjobs.nextquery++];
+		botimport.UnlockMutex(routingjobs.mutex);
+		//out of range areas would be reported, no printing from here
+		if (query->areanum <= 0 || query->areanum >= aasworld.numareas) continue;
+		if (query->goalareanum <= 0 || query->goalareanum >= aasworld.numareas) continue;
+		//
+		AAS_RouteToGoalArea(scratch, query->areanum, NULL, query->goalareanum,
+								query->travelflags, &traveltime, &reachnum);
+	} //end while
+} //end of the function AAS_RoutingJob
+//===========================================================================
+// moves the caches the routing jobs built in the pool into memory of their
+// own so the pool can be freed
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+static void AAS_MoveJobRoutingCaches(void)
+{
+	aas_routingcache_t *cache, *nextcache, *newcache;
+	unsigned char *reachabilities;
+
+	for (cache = aasworld.oldestcache; cache; cache = nextcache)
+	{
+		nextcache = cache->time_next;
+		if ((byte *) cache < routingjobs.pool ||
+				(byte *) cache >= routingjobs.pool + routingjobs.poolused) continue;
+		//
+		if (cache->type == CACHETYPE_AREA)
+		{
+			newcache = AAS_AllocRoutingCache(aasworld.clusters[cache->cluster].numreachabilityareas);
+		} //end if
+		else
+		{
+			newcache = AAS_AllocRoutingCache(aasworld.numportals);
+		} //end else
+		reachabilities = newcache->reachabilities;
+		Com_Memcpy(newcache, cache, cache->size);
+		newcache->reachabilities = reachabilities;
+		//take the place of the pool cache in the lists
+		if (cache->prev) cache->prev->next = newcache;
+		else if (cache->type == CACHETYPE_AREA)
+		{
+			aasworld.clusterareacache[cache->cluster][AAS_ClusterAreaNum(cache->cluster, cache->areanum)] = newcache;
+		} //end else if
+		else aasworld.portalcache[cache->areanum] = newcache;
+		if (cache->next) cache->next->prev = newcache;
+		//
+		if (cache->time_prev) cache->time_prev->time_next = newcache;
+		else aasworld.oldestcache = newcache;
+		if (cache->time_next) cache->time_next->time_prev = newcache;
+		else aasworld.newestcache = newcache;
+	} //end for
+} //end of the function AAS_MoveJobRoutingCaches
+//===========================================================================
+// builds the routing caches for the given queries on the worker threads,
+// later queries for the same routes are answered from the caches
+//
+// Parameter:			queries			: routes to look up
+//						numqueries		: number of queries
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+void AAS_WarmRoutingCaches(aas_routequery_t *queries, int numqueries)
+{
+	int available;
+
+	if (!aasworld.initialized) return;
+	if (!routingjobs.numscratch || numqueries <= 0) return;
+	// make sure the routing cache doesn't grow to large
+	while(AvailableMemory() < 1 * 1024 * 1024) {
+		if (!AAS_FreeOldestCache()) break;
+	}
+	//the pool is copied out again afterwards, leave room for that
+	available = (AvailableMemory() - 1 * 1024 * 1024) / 2;
+	routingjobs.poolsize = ROUTINGJOBS_POOLSIZE;
+	if (routingjobs.poolsize > available) routingjobs.poolsize = available;
+	if (routingjobs.poolsize < 64 * 1024) return;
+	routingjobs.pool = (byte *) GetMemory(routingjobs.poolsize);
+	routingjobs.poolused = 0;
+	//
+	routingjobs.queries = queries;
+	routingjobs.numqueries = numqueries;
+	routingjobs.nextquery = 0;
+	routingjobs.active = qtrue;
+	botimport.RunJobs(AAS_RoutingJob, NULL, routingjobs.numscratch);
+	routingjobs.active = qfalse;
+	//
+	AAS_MoveJobRoutingCaches();
+	FreeMemory(routingjobs.pool);
+	routingjobs.pool = NULL;
+	routingjobs.poolsize = 0;
+	routingjobs.poolused = 0;
+	routingjobs.queries = NULL;
+	routingjobs.numqueries = 0;
+} //end of the function AAS_WarmRoutingCaches
+//===========================================================================
+// builds the routing caches the bots need at the start of a map unless
+// they were read from the route cache file, afterwards the caches are
+// written to that file so the next time the map starts with them
+//
+// Parameter:			queries			: routes to look up
+//						numqueries		: number of queries
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+void AAS_WarmMapRoutingCaches(aas_routequery_t *queries, int numqueries)
+{
+	int i, starttime, traveltime, reachnum, search;
+
+	if (!aasworld.initialized) return;
+	if (!(int) LibVarValue("warmroutingcache", "1")) return;
+	//the caches came from the route cache file
+	if (routecacheblock) return;
+	if (numqueries <= 0) return;
+	//
+	starttime = Sys_MilliSeconds();
+	if (routingjobs.numscratch)
+	{
+		AAS_WarmRoutingCaches(queries, numqueries);
+	} //end if
+	else
+	{
+		//the caches are wanted, not just the routes
+		search = mainscratch.routesearch;
+		mainscratch.routesearch = qfalse;
+		for (i = 0; i < numqueries; i++)
+		{
+			AAS_RouteToGoalArea(&mainscratch, queries[i].areanum, NULL, queries[i].goalareanum,
+									queries[i].travelflags, &traveltime, &reachnum);
+		} //end for
+		mainscratch.routesearch = search;
+	} //end else
+	botimport.Print(PRT_MESSAGE, "%d routes warmed in %d msec\n", numqueries, Sys_MilliSeconds() - starttime);
+	//
+	AAS_WriteRouteCache();
+} //end of the function AAS_WarmMapRoutingCaches
+//===========================================================================
+// compares the route search with the area routing cache update for random
+// routes within the clusters
+//
+// Parameter:			numroutes		: number of routes to compare
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+void AAS_RouteSearchBenchmark(int numroutes)
+{
+	int i, j, n, seed, clusternum, numreachabilityareas, maxareas, starttime, floodtime, searchtime;
+	int floodareas, numexpanded, numlonger, numshorter, difference, numfailed, traveltime, reachability;
+	int *areas, *goalareas;
+	unsigned short int *traveltimes;
+	aas_routingcache_t *cache;
+
+	if (!aasworld.initialized) return;
+	if (!routesearch.heap)
+	{
+		botimport.Print(PRT_MESSAGE, "route search is disabled\n");
+		return;
+	} //end if
+	if (numroutes <= 0) return;
+	//the random picking below only ends if there is an area to start from
+	for (n = 1; n < aasworld.numareas; n++)
+	{
+		clusternum = aasworld.areasettings[n].cluster;
+		if (clusternum > 0 && aasworld.areasettings[n].numreachableareas &&
+				aasworld.areasettings[n].clusterareanum < aasworld.clusters[clusternum].numreachabilityareas) break;
+	} //end for
+	if (n >= aasworld.numareas)
+	{
+		botimport.Print(PRT_MESSAGE, "no cluster areas with reachabilities to route between\n");
+		return;
+	} //end if
+	//
+	areas = (int *) GetMemory(numroutes * (2 * sizeof(int) + sizeof(unsigned short int)));
+	goalareas = areas + numroutes;
+	traveltimes = (unsigned short int *) (goalareas + numroutes);
+	//random routes between reachability areas of the same cluster
+	seed = 12345;
+	for (i = 0; i < numroutes; i++)
+	{
+		do
+		{
+			seed = seed * 1103515245 + 12345;
+			areas[i] = 1 + ((seed >> 8) & 0xffffff) % (aasworld.numareas - 1);
+			clusternum = aasworld.areasettings[areas[i]].cluster;
+		} while(clusternum <= 0 || !aasworld.areasettings[areas[i]].numreachableareas ||
+				aasworld.areasettings[areas[i]].clusterareanum >= aasworld.clusters[clusternum].numreachabilityareas);
+		//the first area of the cluster from a random area on
+		seed = seed * 1103515245 + 12345;
+		goalareas[i] = areas[i];
+		n = 1 + ((seed >> 8) & 0xffffff) % (aasworld.numareas - 1);
+		for (j = 1; j < aasworld.numareas; j++, n = n % (aasworld.numareas - 1) + 1)
+		{
+			if (n == areas[i]) continue;
+			if (aasworld.areasettings[n].cluster != clusternum) continue;
+			if (!aasworld.areasettings[n].numreachableareas) continue;
+			if (aasworld.areasettings[n].clusterareanum >= aasworld.clusters[clusternum].numreachabilityareas) continue;
+			goalareas[i] = n;
+			break;
+		} //end for
+	} //end for
+	//one routing cache that is reused for all the routes, it's never
+	//linked in the cache lists so the live caches are left alone
+	maxareas = 0;
+	for (i = 0; i < aasworld.numclusters; i++)
+	{
+		if (aasworld.clusters[i].numreachabilityareas > maxareas)
+			maxareas = aasworld.clusters[i].numreachabilityareas;
+	} //end for
+	cache = AAS_AllocRoutingCache(maxareas);
+	//the whole cluster is flooded for every route
+	floodareas = 0;
+	starttime = Sys_MilliSeconds();
+	for (i = 0; i < numroutes; i++)
+	{
+		clusternum = aasworld.areasettings[areas[i]].cluster;
+		numreachabilityareas = aasworld.clusters[clusternum].numreachabilityareas;
+		Com_Memset(cache->traveltimes, 0, numreachabilityareas * sizeof(unsigned short int));
+		Com_Memset(cache->reachabilities, 0, numreachabilityareas * sizeof(unsigned char));
+		cache->cluster = clusternum;
+		cache->areanum = goalareas[i];
+		cache->starttraveltime = 1;
+		cache->travelflags = TFL_DEFAULT;
+		AAS_UpdateAreaRoutingCache(&mainscratch, cache);
+		traveltimes[i] = cache->traveltimes[aasworld.areasettings[areas[i]].clusterareanum];
+		floodareas += numreachabilityareas;
+	} //end for
+	floodtime = Sys_MilliSeconds() - starttime;
+	routingcachesize -= cache->size;
+	FreeMemory(cache);
+	//the search stops at the start area
+	numexpanded = routesearch.numexpanded;
+	numlonger = 0;
+	numshorter = 0;
+	difference = 0;
+	numfailed = 0;
+	starttime = Sys_MilliSeconds();
+	for (i = 0; i < numroutes; i++)
+	{
+		clusternum = aasworld.areasettings[areas[i]].cluster;
+		if (!AAS_SearchClusterRoute(clusternum, areas[i], goalareas[i], TFL_DEFAULT, &traveltime, &reachability))
+		{
+			numfailed++;
+		} //end if
+		else if (traveltime > traveltimes[i])
+		{
+			numlonger++;
+			difference += traveltime - traveltimes[i];
+		} //end else if
+		else if (traveltime < traveltimes[i])
+		{
+			numshorter++;
+			difference += traveltimes[i] - traveltime;
+		} //end else if
+	} //end for
+	searchtime = Sys_MilliSeconds() - starttime;
+	numexpanded = routesearch.numexpanded - numexpanded;
+	//
+	botimport.Print(PRT_MESSAGE, "%d routes\n", numroutes);
+	botimport.Print(PRT_MESSAGE, "cache update: %d msec, %d usec and %d areas per route\n",
+						floodtime, floodtime * 1000 / numroutes, floodareas / numroutes);
+	botimport.Print(PRT_MESSAGE, "route search: %d msec, %d usec and %d areas per route\n",
+						searchtime, searchtime * 1000 / numroutes, numexpanded / numroutes);
+	botimport.Print(PRT_MESSAGE, "%d routes longer and %d shorter than the cache by %d on average\n",
+						numlonger, numshorter, (numlonger + numshorter) ? difference / (numlonger + numshorter) : 0);
+	if (numfailed) botimport.Print(PRT_MESSAGE, "%d searches ran out of room\n", numfailed);
+	FreeMemory(areas);
+} //end of the function AAS_RouteSearchBenchmark
+//===========================================================================
 // predict the route and stop on one of the stop events
 //
 // Parameter:			-
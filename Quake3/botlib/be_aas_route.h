@@ -39,6 +39,18 @@ unsigned short int AAS_AreaTravelTime(int areanum, vec3_t start, vec3_t end);
 //
 void AAS_CreateAllRoutingCache(void);
 void AAS_WriteRouteCache(void);
+//read or calculate the route tables
+void AAS_InitRouteTables(void);
+//free the route tables
+void AAS_FreeRouteTables(void);
+//set up the goal directed route search
+void AAS_InitRouteSearch(void);
+//free the route search
+void AAS_FreeRouteSearch(void);
+//forget the routes found after areas were enabled or disabled
+void AAS_InvalidateRouteSearch(void);
+//compare the route search with the routing cache updates
+void AAS_RouteSearchBenchmark(int numroutes);
 //
 void AAS_RoutingInfo(void);
 #endif //AASINTERN
@@ -59,6 +71,10 @@ int AAS_EnableRoutingArea(int areanum, int enable);
 unsigned short int AAS_AreaTravelTime(int areanum, vec3_t start, vec3_t end);
 //returns the travel time from the area to the goal area using the given travel flags
 int AAS_AreaTravelTimeToGoalArea(int areanum, vec3_t origin, int goalareanum, int travelflags);
+//build the routing caches for the given routes on the worker threads
+void AAS_WarmRoutingCaches(struct aas_routequery_s *queries, int numqueries);
+//build the routing caches for the start of a map and write them to the route cache file
+void AAS_WarmMapRoutingCaches(struct aas_routequery_s *queries, int numqueries);
 //predict a route up to a stop event
 int AAS_PredictRoute(struct aas_predictroute_s *route, int areanum, vec3_t origin,
 							int goalareanum, int travelflags, int maxareas, int maxtime,
@@ -44,6 +44,14 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 #include "be_aas_funcs.h"
 #include "be_aas_def.h"
 
+#if defined( __SSE__ ) || defined( _M_X64 )
+#include <xmmintrin.h>
+#define AAS_SIMD_SSE
+#elif ( defined( __ARM_NEON ) || defined( __ARM_NEON__ ) ) && defined( __ARM_FEATURE_FMA )
+#include <arm_neon.h>
+#define AAS_SIMD_NEON
+#endif
+
 
 //#define AAS_SAMPLE_DEBUG
 
@@ -53,6 +61,14 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 
 #define TRACEPLANE_EPSILON			0.125
 
+//smallest size of the area grid cells
+#define AREAGRID_CELLSIZE			64
+//maximum number of area grid cells, the cells grow until the grid fits
+#define MAX_AREAGRIDCELLS			(256 * 1024)
+//the cell boxes are grown this much so a point close to a cell border
+//is never on another side of a node plane than the rest of the cell
+#define AREAGRID_EPSILON			1
+
 typedef struct aas_tracestack_s
 {
 	vec3_t start;		//start point of the piece of line to trace
@@ -63,6 +79,28 @@ typedef struct aas_tracestack_s
 
 int numaaslinks;
 
+#ifndef BSPC
+//recorded point and trace queries
+#define AASRECORD_ID				(('C'<<24)+('E'<<16)+('R'<<8)+'A')
+#define AASRECORD_VERSION			1
+
+typedef struct aasrecordheader_s
+{
+	int ident;
+	int version;
+	char mapname[MAX_QPATH];	//the queries only make sense on this map
+} aasrecordheader_t;
+
+typedef struct aasrecord_s
+{
+	int trace;					//true for AAS_TraceAreas, false for AAS_PointAreaNum
+	vec3_t start;
+	vec3_t end;
+} aasrecord_t;
+
+fileHandle_t aasrecordfile;
+#endif //BSPC
+
 //===========================================================================
 //
 // Parameter:				-
@@ -203,6 +241,63 @@ void AAS_FreeAASLinkedEntities(void)
 	aasworld.arealinkedentities = NULL;
 } //end of the function AAS_InitAASLinkedEntities
 //===========================================================================
+// returns the area grid cell the point is in or -1 if outside the grid
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+int AAS_AreaGridCell(vec3_t point)
+{
+	int i, cell[3];
+	float f;
+
+	if (!aasworld.areagrid) return -1;
+	for (i = 0; i < 3; i++)
+	{
+		f = (point[i] - aasworld.areagridorigin[i]) / aasworld.areagridcellsize;
+		//also catches NaN coordinates
+		if (!(f >= 0 && f < aasworld.areagridsize[i])) return -1;
+		cell[i] = (int) f;
+	} //end for
+	return (cell[2] * aasworld.areagridsize[1] + cell[1]) * aasworld.areagridsize[0] + cell[0];
+} //end of the function AAS_AreaGridCell
+//===========================================================================
+// returns the node to start the tree descent for the point with, all points
+// in an area grid cell go down the tree the same way up to this node, zero
+// or a negative area number if the whole cell is in one leaf
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+int AAS_AreaGridNode(vec3_t point)
+{
+	int cell;
+
+	cell = AAS_AreaGridCell(point);
+	if (cell < 0) return 1;
+	return aasworld.areagrid[cell];
+} //end of the function AAS_AreaGridNode
+#ifndef BSPC
+//===========================================================================
+// stores a point or trace query in the open recording
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+void AAS_RecordQuery(int trace, vec3_t start, vec3_t end)
+{
+	aasrecord_t record;
+
+	record.trace = trace;
+	VectorCopy(start, record.start);
+	VectorCopy(end, record.end);
+	botimport.FS_Write(&record, sizeof(aasrecord_t), aasrecordfile);
+} //end of the function AAS_RecordQuery
+#endif //BSPC
+//===========================================================================
 // returns the AAS area the point is in
 //
 // Parameter:				-
@@ -221,9 +316,12 @@ int AAS_PointAreaNum(vec3_t point)
 		botimport.Print(PRT_ERROR, "AAS_PointAreaNum: aas not loaded\n");
 		return 0;
 	} //end if
-
-	//start with node 1 because node zero is a dummy used for solid leafs
-	nodenum = 1;
+#ifndef BSPC
+	if (aasrecordfile) AAS_RecordQuery(qfalse, point, point);
+#endif //BSPC
+	//start at the node the area grid cell of the point leads to, this is
+	//node 1 outside the grid because node zero is a dummy used for solid leafs
+	nodenum = AAS_AreaGridNode(point);
 	while (nodenum > 0)
 	{
 //		botimport.Print(PRT_MESSAGE, "[%d]", nodenum);
@@ -257,6 +355,156 @@ int AAS_PointAreaNum(vec3_t point)
 	return -nodenum;
 } //end of the function AAS_PointAreaNum
 //===========================================================================
+// distances of four points to four node planes, one point per plane
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+static ID_INLINE void AAS_PlaneDistances4(aas_plane_t **planes, float *px, float *py, float *pz, float *dists)
+{
+#if defined( AAS_SIMD_SSE )
+	__m128 nx, ny, nz, pd;
+
+	//normal and dist are adjacent in aas_plane_t
+	nx = _mm_loadu_ps(planes[0]->normal);
+	ny = _mm_loadu_ps(planes[1]->normal);
+	nz = _mm_loadu_ps(planes[2]->normal);
+	pd = _mm_loadu_ps(planes[3]->normal);
+	_MM_TRANSPOSE4_PS(nx, ny, nz, pd);
+	//same order of operations as DotProduct, which isn't fused without -mfma,
+	//so both round alike
+	_mm_storeu_ps(dists, _mm_sub_ps(_mm_add_ps(_mm_add_ps(
+		_mm_mul_ps(_mm_loadu_ps(px), nx),
+		_mm_mul_ps(_mm_loadu_ps(py), ny)),
+		_mm_mul_ps(_mm_loadu_ps(pz), nz)), pd));
+#elif defined( AAS_SIMD_NEON )
+	float32x4_t nx, ny, nz, pd;
+	float32x4x2_t t01, t23;
+
+	//normal and dist are adjacent in aas_plane_t
+	t01 = vtrnq_f32(vld1q_f32(planes[0]->normal), vld1q_f32(planes[1]->normal));
+	t23 = vtrnq_f32(vld1q_f32(planes[2]->normal), vld1q_f32(planes[3]->normal));
+	nx = vcombine_f32(vget_low_f32(t01.val[0]), vget_low_f32(t23.val[0]));
+	ny = vcombine_f32(vget_low_f32(t01.val[1]), vget_low_f32(t23.val[1]));
+	nz = vcombine_f32(vget_high_f32(t01.val[0]), vget_high_f32(t23.val[0]));
+	pd = vcombine_f32(vget_high_f32(t01.val[1]), vget_high_f32(t23.val[1]));
+	//fused the way compilers for arm contract DotProduct, that isn't
+	//guaranteed though, a point within rounding of a plane may go to the
+	//other side than in AAS_PointAreaNum, both areas touch it then
+	vst1q_f32(dists, vsubq_f32(vfmaq_f32(vfmaq_f32(
+		vmulq_f32(vld1q_f32(px), nx),
+		vld1q_f32(py), ny),
+		vld1q_f32(pz), nz), pd));
+#else
+	int i;
+
+	for (i = 0; i < 4; i++)
+	{
+		dists[i] = px[i] * planes[i]->normal[0] + py[i] * planes[i]->normal[1] +
+						pz[i] * planes[i]->normal[2] - planes[i]->dist;
+	} //end for
+#endif
+} //end of the function AAS_PlaneDistances4
+//===========================================================================
+// returns the next point that has to go down the tree from the node its
+// area grid cell leads to, the areas of the points in between are stored
+// right away because their whole cell is in one leaf
+//
+// Parameter:				-
+// Returns:					index of the point or -1 if there are none left
+// Changes Globals:		-
+//===========================================================================
+static int AAS_NextTreePoint(vec3_t *points, int *areanums, int numpoints, int *next, int *nodenum, int *numareas)
+{
+	int i;
+
+	while (*next < numpoints)
+	{
+		i = (*next)++;
+#ifndef BSPC
+		if (aasrecordfile) AAS_RecordQuery(qfalse, points[i], points[i]);
+#endif //BSPC
+		*nodenum = AAS_AreaGridNode(points[i]);
+		if (*nodenum > 0) return i;
+		areanums[i] = -*nodenum;
+		if (*nodenum) (*numareas)++;
+	} //end while
+	return -1;
+} //end of the function AAS_NextTreePoint
+//===========================================================================
+// stores the AAS area of every point in areanums, same as calling
+// AAS_PointAreaNum for every point. Four points go down the tree at the
+// same time, each at its own node, so the node and plane loads of one
+// point don't wait for those of another.
+//
+// Parameter:				-
+// Returns:					number of points not in solid
+// Changes Globals:		-
+//===========================================================================
+int AAS_PointAreaNums(vec3_t *points, int *areanums, int numpoints)
+{
+	int i, next, numactive, numareas;
+	int lanes[4], nodes[4];
+	float px[4], py[4], pz[4], dists[4];
+	aas_plane_t *planes[4];
+
+	if (!aasworld.loaded)
+	{
+		botimport.Print(PRT_ERROR, "AAS_PointAreaNums: aas not loaded\n");
+		for (i = 0; i < numpoints; i++) areanums[i] = 0;
+		return 0;
+	} //end if
+	//
+	for (i = 0; i < 4; i++)
+	{
+		lanes[i] = -1;
+		nodes[i] = 0;
+		px[i] = py[i] = pz[i] = 0;
+		//idle lanes test against any plane
+		planes[i] = &aasworld.planes[0];
+	} //end for
+	next = 0;
+	numactive = 0;
+	numareas = 0;
+	while (1)
+	{
+		for (i = 0; i < 4; i++)
+		{
+			if (nodes[i] > 0) continue;
+			//the point of the lane reached a leaf or the lane has no point yet
+			if (lanes[i] >= 0)
+			{
+				areanums[lanes[i]] = -nodes[i];
+				if (nodes[i]) numareas++;
+				numactive--;
+			} //end if
+			lanes[i] = AAS_NextTreePoint(points, areanums, numpoints, &next, &nodes[i], &numareas);
+			if (lanes[i] < 0)
+			{
+				//keep the lane idle
+				nodes[i] = 1;
+				continue;
+			} //end if
+			px[i] = points[lanes[i]][0];
+			py[i] = points[lanes[i]][1];
+			pz[i] = points[lanes[i]][2];
+			planes[i] = &aasworld.planes[aasworld.nodes[nodes[i]].planenum];
+			numactive++;
+		} //end for
+		if (!numactive) break;
+		//
+		AAS_PlaneDistances4(planes, px, py, pz, dists);
+		for (i = 0; i < 4; i++)
+		{
+			if (lanes[i] < 0) continue;
+			nodes[i] = aasworld.nodes[nodes[i]].children[!(dists[i] > 0)];
+			if (nodes[i] > 0) planes[i] = &aasworld.planes[aasworld.nodes[nodes[i]].planenum];
+		} //end for
+	} //end while
+	return numareas;
+} //end of the function AAS_PointAreaNums
+//===========================================================================
 //
 // Parameter:			-
 // Returns:				-
@@ -725,7 +973,7 @@ aas_trace_t AAS_TraceClientBBox(vec3_t start, vec3_t end, int presencetype,
 int AAS_TraceAreas(vec3_t start, vec3_t end, int *areas, vec3_t *points, int maxareas)
 {
 	int side, nodenum, tmpplanenum;
-	int numareas;
+	int numareas, cell;
 	float front, back, frac;
 	vec3_t cur_start, cur_end, cur_mid;
 	aas_tracestack_t tracestack[127];
@@ -736,14 +984,21 @@ int AAS_TraceAreas(vec3_t start, vec3_t end, int *areas, vec3_t *points, int max
 	numareas = 0;
 	areas[0] = 0;
 	if (!aasworld.loaded) return numareas;
+#ifndef BSPC
+	if (aasrecordfile) AAS_RecordQuery(qtrue, start, end);
+#endif //BSPC
 
 	tstack_p = tracestack;
 	//we start with the whole line on the stack
 	VectorCopy(start, tstack_p->start);
 	VectorCopy(end, tstack_p->end);
 	tstack_p->planenum = 0;
-	//start with node 1 because node zero is a dummy for a solid leaf
-	tstack_p->nodenum = 1;		//starting at the root of the tree
+	//if the whole line is in one area grid cell it goes down the tree the
+	//same way as the cell up to the cell node, otherwise start with node 1
+	//because node zero is a dummy for a solid leaf
+	cell = AAS_AreaGridCell(start);
+	if (cell >= 0 && cell == AAS_AreaGridCell(end)) tstack_p->nodenum = aasworld.areagrid[cell];
+	else tstack_p->nodenum = 1;		//starting at the root of the tree
 	tstack_p++;
 
 	while (1)
@@ -1156,6 +1411,305 @@ int AAS_BoxOnPlaneSide2(vec3_t absmins, vec3_t absmaxs, aas_plane_t *p)
 // Returns:					-
 // Changes Globals:		-
 //===========================================================================
+void AAS_FreeAreaGrid(void)
+{
+	if (aasworld.areagrid) FreeMemory(aasworld.areagrid);
+	aasworld.areagrid = NULL;
+} //end of the function AAS_FreeAreaGrid
+//===========================================================================
+// builds a uniform grid over the areas with for every cell the node where
+// the points in the cell go down the tree in different ways. Point and
+// trace queries start at that node instead of at the root of the tree.
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+void AAS_InitAreaGrid(void)
+{
+	int i, x, y, z, side, nodenum, depth, totaldepth, numleafcells, numcells;
+	float cellsize;
+	vec3_t mins, maxs, cellmins, cellmaxs;
+	aas_node_t *node;
+
+	AAS_FreeAreaGrid();
+	if (aasworld.numareas <= 1) return;
+	//
+	ClearBounds(mins, maxs);
+	for (i = 1; i < aasworld.numareas; i++)
+	{
+		AddPointToBounds(aasworld.areas[i].mins, mins, maxs);
+		AddPointToBounds(aasworld.areas[i].maxs, mins, maxs);
+	} //end for
+	//grow the cells until the grid isn't too large
+	for (cellsize = AREAGRID_CELLSIZE; ; cellsize *= 2)
+	{
+		numcells = 1;
+		for (i = 0; i < 3; i++)
+		{
+			aasworld.areagridsize[i] = (int) ((maxs[i] - mins[i]) / cellsize) + 1;
+			numcells *= aasworld.areagridsize[i];
+		} //end for
+		if (numcells <= MAX_AREAGRIDCELLS) break;
+	} //end for
+	VectorCopy(mins, aasworld.areagridorigin);
+	aasworld.areagridcellsize = cellsize;
+	aasworld.areagrid = (int *) GetMemory(numcells * sizeof(int));
+	//
+	totaldepth = 0;
+	numleafcells = 0;
+	i = 0;
+	for (z = 0; z < aasworld.areagridsize[2]; z++)
+	{
+		for (y = 0; y < aasworld.areagridsize[1]; y++)
+		{
+			for (x = 0; x < aasworld.areagridsize[0]; x++, i++)
+			{
+				cellmins[0] = mins[0] + x * cellsize - AREAGRID_EPSILON;
+				cellmins[1] = mins[1] + y * cellsize - AREAGRID_EPSILON;
+				cellmins[2] = mins[2] + z * cellsize - AREAGRID_EPSILON;
+				cellmaxs[0] = cellmins[0] + cellsize + 2 * AREAGRID_EPSILON;
+				cellmaxs[1] = cellmins[1] + cellsize + 2 * AREAGRID_EPSILON;
+				cellmaxs[2] = cellmins[2] + cellsize + 2 * AREAGRID_EPSILON;
+				//go down the tree while the whole cell is at one side of the node planes,
+				//a point goes to the back child when it's on the plane so the cell has
+				//to be completely at the front to go to the front child
+				nodenum = 1;
+				depth = 0;
+				while (nodenum > 0)
+				{
+					node = &aasworld.nodes[nodenum];
+					side = AAS_BoxOnPlaneSide2(cellmins, cellmaxs, &aasworld.planes[node->planenum]);
+					if (side == 1) nodenum = node->children[0];
+					else if (side == 2) nodenum = node->children[1];
+					else break;
+					depth++;
+				} //end while
+				aasworld.areagrid[i] = nodenum;
+				totaldepth += depth;
+				if (nodenum <= 0) numleafcells++;
+			} //end for
+		} //end for
+	} //end for
+#ifndef BSPC
+	if (botDeveloper)
+	{
+		botimport.Print(PRT_MESSAGE, "area grid: %d x %d x %d cells of %d units, %d%% in a single area, %1.1f nodes skipped on average\n",
+					aasworld.areagridsize[0], aasworld.areagridsize[1], aasworld.areagridsize[2], (int) cellsize,
+					numleafcells * 100 / numcells, (float) totaldepth / numcells);
+	} //end if
+#endif //BSPC
+} //end of the function AAS_InitAreaGrid
+#ifndef BSPC
+//===========================================================================
+// starts recording the point and trace queries to aasrecords/<name>.arec,
+// an empty name only stops the current recording
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+void AAS_RecordAreaQueries(const char *name)
+{
+	char filename[MAX_QPATH];
+	aasrecordheader_t header;
+
+	if (aasrecordfile)
+	{
+		botimport.FS_FCloseFile(aasrecordfile);
+		aasrecordfile = 0;
+		botimport.Print(PRT_MESSAGE, "stopped recording AAS queries\n");
+	} //end if
+	if (!name || !*name) return;
+	if (!aasworld.loaded)
+	{
+		botimport.Print(PRT_ERROR, "AAS_RecordAreaQueries: aas not loaded\n");
+		return;
+	} //end if
+	//
+	Com_sprintf(filename, MAX_QPATH, "aasrecords/%s.arec", name);
+	botimport.FS_FOpenFile(filename, &aasrecordfile, FS_WRITE);
+	if (!aasrecordfile)
+	{
+		AAS_Error("Unable to open file: %s\n", filename);
+		return;
+	} //end if
+	Com_Memset(&header, 0, sizeof(aasrecordheader_t));
+	header.ident = AASRECORD_ID;
+	header.version = AASRECORD_VERSION;
+	Q_strncpyz(header.mapname, aasworld.mapname, sizeof(header.mapname));
+	botimport.FS_Write(&header, sizeof(aasrecordheader_t), aasrecordfile);
+	botimport.Print(PRT_MESSAGE, "recording AAS queries to %s\n", filename);
+} //end of the function AAS_RecordAreaQueries
+//===========================================================================
+// replays recorded point and trace queries with and without the area grid
+// and in batches, and checks that all of them give the same areas
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+#define MAX_BENCHTRACEAREAS		64
+
+void AAS_AreaGridBenchmark(const char *name, int passes)
+{
+	int i, j, pass, length, numrecords, numpoints, numtraces, starttime;
+	int treetime, gridtime, batchtime, tracetreetime, tracegridtime;
+	int pointmismatches, batchmismatches, tracemismatches, n1, n2;
+	int areas1[MAX_BENCHTRACEAREAS], areas2[MAX_BENCHTRACEAREAS];
+	int *grid, *treeareanums, *gridareanums, *batchareanums;
+	char filename[MAX_QPATH];
+	fileHandle_t fp, recordfile;
+	aasrecordheader_t header;
+	aasrecord_t *records;
+	vec3_t *points, *starts, *ends;
+
+	if (!aasworld.loaded)
+	{
+		botimport.Print(PRT_ERROR, "AAS_AreaGridBenchmark: aas not loaded\n");
+		return;
+	} //end if
+	if (passes < 1) passes = 1;
+	//
+	Com_sprintf(filename, MAX_QPATH, "aasrecords/%s.arec", name);
+	length = botimport.FS_FOpenFile(filename, &fp, FS_READ);
+	if (!fp)
+	{
+		botimport.Print(PRT_ERROR, "can't open %s\n", filename);
+		return;
+	} //end if
+	if (length < (int) sizeof(aasrecordheader_t))
+	{
+		botimport.Print(PRT_ERROR, "%s is too short\n", filename);
+		botimport.FS_FCloseFile(fp);
+		return;
+	} //end if
+	botimport.FS_Read(&header, sizeof(aasrecordheader_t), fp);
+	header.mapname[MAX_QPATH-1] = '\0';
+	if (header.ident != AASRECORD_ID || header.version != AASRECORD_VERSION)
+	{
+		botimport.Print(PRT_ERROR, "%s is not a version %d AAS recording\n", filename, AASRECORD_VERSION);
+		botimport.FS_FCloseFile(fp);
+		return;
+	} //end if
+	if (Q_stricmp(header.mapname, aasworld.mapname))
+	{
+		botimport.Print(PRT_ERROR, "%s was recorded on %s\n", filename, header.mapname);
+		botimport.FS_FCloseFile(fp);
+		return;
+	} //end if
+	numrecords = (length - sizeof(aasrecordheader_t)) / sizeof(aasrecord_t);
+	if (!numrecords)
+	{
+		botimport.Print(PRT_MESSAGE, "%s has no queries\n", filename);
+		botimport.FS_FCloseFile(fp);
+		return;
+	} //end if
+	records = (aasrecord_t *) GetMemory(numrecords * sizeof(aasrecord_t));
+	botimport.FS_Read(records, numrecords * sizeof(aasrecord_t), fp);
+	botimport.FS_FCloseFile(fp);
+	//
+	points = (vec3_t *) GetMemory(numrecords * (3 * sizeof(vec3_t) + 3 * sizeof(int)));
+	starts = points + numrecords;
+	ends = starts + numrecords;
+	treeareanums = (int *) (ends + numrecords);
+	gridareanums = treeareanums + numrecords;
+	batchareanums = gridareanums + numrecords;
+	numpoints = 0;
+	numtraces = 0;
+	for (i = 0; i < numrecords; i++)
+	{
+		if (records[i].trace)
+		{
+			VectorCopy(records[i].start, starts[numtraces]);
+			VectorCopy(records[i].end, ends[numtraces]);
+			numtraces++;
+		} //end if
+		else
+		{
+			VectorCopy(records[i].start, points[numpoints]);
+			numpoints++;
+		} //end else
+	} //end for
+	FreeMemory(records);
+	//don't record the replayed queries
+	recordfile = aasrecordfile;
+	aasrecordfile = 0;
+	grid = aasworld.areagrid;
+	//
+	treetime = gridtime = batchtime = tracetreetime = tracegridtime = 0;
+	for (pass = 0; pass < passes; pass++)
+	{
+		aasworld.areagrid = NULL;
+		starttime = Sys_MilliSeconds();
+		for (i = 0; i < numpoints; i++)
+		{
+			treeareanums[i] = AAS_PointAreaNum(points[i]);
+		} //end for
+		treetime += Sys_MilliSeconds() - starttime;
+		starttime = Sys_MilliSeconds();
+		for (i = 0; i < numtraces; i++)
+		{
+			AAS_TraceAreas(starts[i], ends[i], areas1, NULL, MAX_BENCHTRACEAREAS);
+		} //end for
+		tracetreetime += Sys_MilliSeconds() - starttime;
+		//
+		aasworld.areagrid = grid;
+		starttime = Sys_MilliSeconds();
+		for (i = 0; i < numpoints; i++)
+		{
+			gridareanums[i] = AAS_PointAreaNum(points[i]);
+		} //end for
+		gridtime += Sys_MilliSeconds() - starttime;
+		starttime = Sys_MilliSeconds();
+		AAS_PointAreaNums(points, batchareanums, numpoints);
+		batchtime += Sys_MilliSeconds() - starttime;
+		starttime = Sys_MilliSeconds();
+		for (i = 0; i < numtraces; i++)
+		{
+			AAS_TraceAreas(starts[i], ends[i], areas2, NULL, MAX_BENCHTRACEAREAS);
+		} //end for
+		tracegridtime += Sys_MilliSeconds() - starttime;
+	} //end for
+	//
+	pointmismatches = 0;
+	batchmismatches = 0;
+	for (i = 0; i < numpoints; i++)
+	{
+		if (gridareanums[i] != treeareanums[i]) pointmismatches++;
+		if (batchareanums[i] != treeareanums[i]) batchmismatches++;
+	} //end for
+	tracemismatches = 0;
+	for (i = 0; i < numtraces; i++)
+	{
+		aasworld.areagrid = NULL;
+		n1 = AAS_TraceAreas(starts[i], ends[i], areas1, NULL, MAX_BENCHTRACEAREAS);
+		aasworld.areagrid = grid;
+		n2 = AAS_TraceAreas(starts[i], ends[i], areas2, NULL, MAX_BENCHTRACEAREAS);
+		for (j = 0; j < n1 && j < n2; j++)
+		{
+			if (areas1[j] != areas2[j]) break;
+		} //end for
+		if (n1 != n2 || j < n1) tracemismatches++;
+	} //end for
+	aasrecordfile = recordfile;
+	FreeMemory(points);
+	//
+	botimport.Print(PRT_MESSAGE, "%d points and %d traces recorded on %s, %d passes\n",
+					numpoints, numtraces, header.mapname, passes);
+	botimport.Print(PRT_MESSAGE, "points tree: %d msec\n", treetime);
+	botimport.Print(PRT_MESSAGE, "points grid: %d msec, %d different\n", gridtime, pointmismatches);
+	botimport.Print(PRT_MESSAGE, "points batched: %d msec, %d different\n", batchtime, batchmismatches);
+	botimport.Print(PRT_MESSAGE, "traces tree: %d msec\n", tracetreetime);
+	botimport.Print(PRT_MESSAGE, "traces grid: %d msec, %d different\n", tracegridtime, tracemismatches);
+} //end of the function AAS_AreaGridBenchmark
+#endif //BSPC
+//===========================================================================
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
 //int AAS_BoxOnPlaneSide(vec3_t absmins, vec3_t absmaxs, aas_plane_t *p)
 #define AAS_BoxOnPlaneSide(absmins, absmaxs, p) (\
 	( (p)->type < 3) ?\
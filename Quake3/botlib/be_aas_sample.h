@@ -42,6 +42,14 @@ aas_link_t *AAS_LinkEntityClientBBox(vec3_t absmins, vec3_t absmaxs, int entnum,
 qboolean AAS_PointInsideFace(int facenum, vec3_t point, float epsilon);
 qboolean AAS_InsideFace(aas_face_t *face, vec3_t pnormal, vec3_t point, float epsilon);
 void AAS_UnlinkFromAreas(aas_link_t *areas);
+void AAS_InitAreaGrid(void);
+void AAS_FreeAreaGrid(void);
+int AAS_AreaGridNode(vec3_t point);
+#ifndef BSPC
+void AAS_RecordQuery(int trace, vec3_t start, vec3_t end);
+void AAS_RecordAreaQueries(const char *name);
+void AAS_AreaGridBenchmark(const char *name, int passes);
+#endif //BSPC
 #endif //AASINTERN
 
 //returns the mins and maxs of the bounding box for the given presence type
@@ -62,6 +70,8 @@ int AAS_BBoxAreas(vec3_t absmins, vec3_t absmaxs, int *areas, int maxareas);
 int AAS_AreaInfo( int areanum, aas_areainfo_t *info );
 //returns the area the point is in
 int AAS_PointAreaNum(vec3_t point);
+//stores the area numbers of the points, returns the number of points not in solid
+int AAS_PointAreaNums(vec3_t *points, int *areanums, int numpoints);
 //
 int AAS_PointReachabilityAreaIndex( vec3_t point );
 //returns the plane the given face is in
@@ -59,6 +59,8 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 #define AVOID_DROPPED_TIME		10
 //
 #define TRAVELTIME_SCALE		0.01
+//routes looked up ahead each frame on the worker threads
+#define MAX_WARMROUTES			4096
 //item flags
 #define IFL_NOTFREE				1		//not in free for all
 #define IFL_NOTTEAM				2		//not in team play
@@ -174,6 +176,10 @@ typedef struct bot_goalstate_s
 	//
 	int avoidgoals[MAX_AVOIDGOALS];				//goals to avoid
 	float avoidgoaltimes[MAX_AVOIDGOALS];		//times to avoid the goals
+	//
+	int lasttravelflags;						//travel flags of the last goal choice
+	int warmedcluster;							//cluster the item routes were built from
+	int warmedtravelflags;						//travel flags they were built with
 } bot_goalstate_t;
 
 bot_goalstate_t *botgoalstates[MAX_CLIENTS + 1]; // FIXME: init?
@@ -184,6 +190,8 @@ levelitem_t *levelitemheap = NULL;
 levelitem_t *freelevelitems = NULL;
 levelitem_t *levelitems = NULL;
 int numlevelitems = 0;
+//routes towards the level items have been warmed for this map
+int levelitemroutes = qfalse;
 //map locations
 maplocation_t *maplocations = NULL;
 //camp spots
@@ -549,6 +557,8 @@ void BotInitLevelItems(void)
 
 	//initialize the map locations and camp spots
 	BotInitInfoEntities();
+	//the routes towards the items are warmed once the routing is initialized
+	levelitemroutes = qfalse;
 
 	//initialize the level item heap
 	InitLevelItemHeap();
@@ -1313,6 +1323,7 @@ int BotChooseLTGItem(int goalstate, vec3_t origin, int *inventory, int travelfla
 	} //end if
 	//remember the last area with reachabilities the bot was in
 	gs->lastreachabilityarea = areanum;
+	gs->lasttravelflags = travelflags;
 	//if still in solid
 	if (!areanum)
 		return qfalse;
@@ -1481,6 +1492,7 @@ int BotChooseNBGItem(int goalstate, vec3_t origin, int *inventory, int travelfla
 	} //end if
 	//remember the last area with reachabilities the bot was in
 	gs->lastreachabilityarea = areanum;
+	gs->lasttravelflags = travelflags;
 	//if still in solid
 	if (!areanum)
 		return qfalse;
@@ -1751,6 +1763,133 @@ int BotAllocGoalState(int client)
 	return 0;
 } //end of the function BotAllocGoalState
 //========================================================================
+// builds the routes from the spawn points and from next to every item
+// towards all level items once the routing of a new map is initialized,
+// freshly spawned bots going for items take these first
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//========================================================================
+void BotWarmLevelItemRoutes(void)
+{
+	static aas_routequery_t queries[MAX_WARMROUTES];
+	char classname[MAX_EPAIRKEY];
+	int ent, numqueries, areanum, reachnum;
+	vec3_t origin, goalorigin;
+	vec3_t mins = {-15, -15, -24}, maxs = {15, 15, 32};
+	aas_reachability_t reach;
+	levelitem_t *li;
+
+	if (levelitemroutes || !AAS_Initialized())
+		return;
+	levelitemroutes = qtrue;
+	//
+	numqueries = 0;
+	//the last part of the route within the cluster of the item
+	for (li = levelitems; li && numqueries < MAX_WARMROUTES; li = li->next)
+	{
+		if (!li->goalareanum)
+			continue;
+		reachnum = AAS_NextAreaReachability(li->goalareanum, 0);
+		if (!reachnum)
+			continue;
+		AAS_ReachabilityFromNum(reachnum, &reach);
+		queries[numqueries].areanum = reach.areanum;
+		queries[numqueries].goalareanum = li->goalareanum;
+		queries[numqueries].travelflags = TFL_DEFAULT;
+		numqueries++;
+	} //end for
+	//the routes from all the spawn points
+	for (ent = AAS_NextBSPEntity(0); ent; ent = AAS_NextBSPEntity(ent))
+	{
+		if (!AAS_ValueForBSPEpairKey(ent, "classname", classname, MAX_EPAIRKEY))
+			continue;
+		if (strcmp(classname, "info_player_deathmatch") && strcmp(classname, "info_player_start") &&
+				strcmp(classname, "team_CTF_redplayer") && strcmp(classname, "team_CTF_blueplayer") &&
+				strcmp(classname, "team_CTF_redspawn") && strcmp(classname, "team_CTF_bluespawn"))
+			continue;
+		if (!AAS_VectorForBSPEpairKey(ent, "origin", origin))
+			continue;
+		areanum = AAS_BestReachableArea(origin, mins, maxs, goalorigin);
+		if (!areanum)
+			continue;
+		for (li = levelitems; li && numqueries < MAX_WARMROUTES; li = li->next)
+		{
+			if (!li->goalareanum)
+				continue;
+			queries[numqueries].areanum = areanum;
+			queries[numqueries].goalareanum = li->goalareanum;
+			queries[numqueries].travelflags = TFL_DEFAULT;
+			numqueries++;
+		} //end for
+	} //end for
+	AAS_WarmMapRoutingCaches(queries, numqueries);
+} //end of the function BotWarmLevelItemRoutes
+//========================================================================
+// builds the routes towards all level items on the worker threads for
+// every bot that entered another cluster since the last time, so the
+// goal evaluation of the bots finds them cached
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//========================================================================
+void BotWarmGoalRoutes(void)
+{
+	static aas_routequery_t queries[MAX_WARMROUTES];
+	int i, numqueries, numbots, areanum, cluster;
+	vec3_t origins[MAX_CLIENTS];
+	int areanums[MAX_CLIENTS];
+	bot_goalstate_t *goalstates[MAX_CLIENTS];
+	bot_goalstate_t *gs;
+	levelitem_t *li;
+
+	if (!AAS_Initialized() || !botimport.NumWorkers())
+		return;
+	//
+	numbots = 0;
+	for (i = 1; i <= MAX_CLIENTS; i++)
+	{
+		gs = botgoalstates[i];
+		//only bots that chose a goal before, nothing is known about their travel flags otherwise
+		if (!gs || !gs->lasttravelflags)
+			continue;
+		//the origin from the last frame, the entities are updated after this
+		AAS_EntityOrigin(gs->client, origins[numbots]);
+		goalstates[numbots] = gs;
+		numbots++;
+	} //end for
+	//the areas of all the bots at once
+	AAS_PointAreaNums(origins, areanums, numbots);
+	//
+	numqueries = 0;
+	for (i = 0; i < numbots; i++)
+	{
+		gs = goalstates[i];
+		areanum = areanums[i];
+		if (!areanum || !AAS_AreaReachability(areanum))
+			continue;
+		//the routes only depend on the cluster the bot is in
+		cluster = AAS_AreaCluster(areanum);
+		if (cluster == gs->warmedcluster && gs->lasttravelflags == gs->warmedtravelflags)
+			continue;
+		gs->warmedcluster = cluster;
+		gs->warmedtravelflags = gs->lasttravelflags;
+		//
+		for (li = levelitems; li && numqueries < MAX_WARMROUTES; li = li->next)
+		{
+			if (!li->goalareanum)
+				continue;
+			queries[numqueries].areanum = areanum;
+			queries[numqueries].goalareanum = li->goalareanum;
+			queries[numqueries].travelflags = gs->lasttravelflags;
+			numqueries++;
+		} //end for
+	} //end for
+	AAS_WarmRoutingCaches(queries, numqueries);
+} //end of the function BotWarmGoalRoutes
+//========================================================================
 //
 // Parameter:				-
 // Returns:					-
@@ -112,6 +112,10 @@ void BotFreeItemWeights(int goalstate);
 int BotAllocGoalState(int client);
 //free the given goal state
 void BotFreeGoalState(int handle);
+//build the routes towards the items at the start of a map
+void BotWarmLevelItemRoutes(void);
+//build the routes the goal evaluation of the bots will need on the worker threads
+void BotWarmGoalRoutes(void);
 //setup the goal AI
 int BotSetupGoalAI(void);
 //shut down the goal AI
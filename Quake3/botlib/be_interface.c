@@ -247,8 +247,16 @@ int Export_BotLibVarGet(const char *var_name, char *value, int size)
 //===========================================================================
 int Export_BotLibStartFrame(float time)
 {
+	int errnum;
+
 	if (!BotLibSetup("BotStartFrame")) return BLERR_LIBRARYNOTSETUP;
-	return AAS_StartFrame(time);
+	errnum = AAS_StartFrame(time);
+	if (errnum != BLERR_NOERROR) return errnum;
+	//route towards the items once the routing of a new map is initialized
+	BotWarmLevelItemRoutes();
+	//route ahead for the bots on the worker threads before they think one by one
+	BotWarmGoalRoutes();
+	return BLERR_NOERROR;
 } //end of the function Export_BotLibStartFrame
 //===========================================================================
 //
@@ -203,6 +203,13 @@ typedef struct botlib_import_s
 	//
 	int			(*DebugPolygonCreate)(int color, int numPoints, vec3_t *points);
 	void		(*DebugPolygonDelete)(int id);
+	//worker threads
+	void		*(*CreateMutex)(void);
+	void		(*DestroyMutex)(void *mutex);
+	void		(*LockMutex)(void *mutex);
+	void		(*UnlockMutex)(void *mutex);
+	int			(*NumWorkers)(void);							// threads besides the calling one
+	void		(*RunJobs)(void (*func)(void *data, int index), void *data, int count);
 } botlib_import_t;
 
 typedef struct aas_export_s
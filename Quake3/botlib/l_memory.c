@@ -462,3 +462,108 @@ void PrintMemoryLabels(void)
 } //end of the function PrintMemoryLabels
 
 #endif
+
+//memory arenas hand out memory from large blocks and free it all at once,
+//for data with the lifetime of a single load like the precompiler tokens
+#define ARENA_ALIGN			8
+
+typedef struct memoryarenablock_s
+{
+	struct memoryarenablock_s *next;
+	int size;							//bytes available in the block
+	int used;							//bytes handed out
+} memoryarenablock_t;
+
+struct memoryarena_s
+{
+	int blocksize;						//size of the blocks the arena grows with
+	memoryarenablock_t *blocks;			//first block is the one allocated from
+};
+
+#define ARENA_BLOCK_HEADER	PAD(sizeof(memoryarenablock_t), ARENA_ALIGN)
+
+//===========================================================================
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+memoryarena_t *AllocMemoryArena(int blocksize)
+{
+	memoryarena_t *arena;
+
+	arena = (memoryarena_t *) GetMemory(sizeof(memoryarena_t));
+	arena->blocksize = blocksize;
+	arena->blocks = NULL;
+	return arena;
+} //end of the function AllocMemoryArena
+//===========================================================================
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+void *GetArenaMemory(memoryarena_t *arena, unsigned long size)
+{
+	int blocksize;
+	memoryarenablock_t *block;
+
+	size = PAD(size, ARENA_ALIGN);
+	block = arena->blocks;
+	if (block && block->used + size <= block->size)
+	{
+		block->used += size;
+		return (char *) block + ARENA_BLOCK_HEADER + block->used - size;
+	} //end if
+	//large allocations get a block of their own behind the current one
+	//so the space left in the current block isn't wasted
+	if (block && size > arena->blocksize / 4)
+	{
+		block = (memoryarenablock_t *) GetMemory(ARENA_BLOCK_HEADER + size);
+		block->size = size;
+		block->used = size;
+		block->next = arena->blocks->next;
+		arena->blocks->next = block;
+		return (char *) block + ARENA_BLOCK_HEADER;
+	} //end if
+	//start a new block
+	blocksize = arena->blocksize;
+	if (size > blocksize) blocksize = size;
+	block = (memoryarenablock_t *) GetMemory(ARENA_BLOCK_HEADER + blocksize);
+	block->size = blocksize;
+	block->used = size;
+	block->next = arena->blocks;
+	arena->blocks = block;
+	return (char *) block + ARENA_BLOCK_HEADER;
+} //end of the function GetArenaMemory
+//===========================================================================
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+void *GetClearedArenaMemory(memoryarena_t *arena, unsigned long size)
+{
+	void *ptr;
+
+	ptr = GetArenaMemory(arena, size);
+	Com_Memset(ptr, 0, size);
+	return ptr;
+} //end of the function GetClearedArenaMemory
+//===========================================================================
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+void FreeMemoryArena(memoryarena_t *arena)
+{
+	memoryarenablock_t *block, *next;
+
+	for (block = arena->blocks; block; block = next)
+	{
+		next = block->next;
+		FreeMemory(block);
+	} //end for
+	FreeMemory(arena);
+} //end of the function FreeMemoryArena
@@ -74,3 +74,14 @@ void PrintMemoryLabels(void);
 int MemoryByteSize(void *ptr);
 //free all allocated memory
 void DumpMemory(void);
+
+//memory arena, the memory allocated from it is freed all at once
+typedef struct memoryarena_s memoryarena_t;
+//allocate an arena that grows in blocks of the given size
+memoryarena_t *AllocMemoryArena(int blocksize);
+//allocate a memory block of the given size from the arena
+void *GetArenaMemory(memoryarena_t *arena, unsigned long size);
+//allocate a memory block of the given size from the arena and clear it
+void *GetClearedArenaMemory(memoryarena_t *arena, unsigned long size);
+//free the arena with all memory allocated from it
+void FreeMemoryArena(memoryarena_t *arena);
@@ -109,6 +109,9 @@ typedef struct directive_s
 
 #define TOKEN_HEAP_SIZE		4096
 
+//size of the blocks the source arenas grow with
+#define SOURCE_ARENA_BLOCKSIZE	(64 * 1024)
+
 int numtokens;
 /*
 int tokenheapinitialized;				//true when the token heap is initialized
@@ -119,6 +122,8 @@ token_t *freetokens;					//free tokens from the heap
 //list with global defines added to every source loaded
 define_t *globaldefines;
 
+define_t *PC_CopyDefine(source_t *source, define_t *define);
+
 //============================================================================
 //
 // Parameter:				-
@@ -259,12 +264,45 @@ void PC_InitTokenHeap(void)
 // Returns:				-
 // Changes Globals:		-
 //============================================================================
-token_t *PC_CopyToken(token_t *token)
+void *PC_GetMemory(source_t *source, unsigned long size)
+{
+	if (source && source->arena) return GetArenaMemory(source->arena, size);
+	return GetMemory(size);
+} //end of the function PC_GetMemory
+//============================================================================
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//============================================================================
+void PC_FreeMemory(source_t *source, void *ptr)
+{
+	//memory from the source arena is freed together with the source
+	if (source && source->arena) return;
+	FreeMemory(ptr);
+} //end of the function PC_FreeMemory
+//============================================================================
+// copies the token, sources reuse their freed tokens, the global
+// defines are built without a source and keep their own memory
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//============================================================================
+token_t *PC_CopyToken(source_t *source, token_t *token)
 {
 	token_t *t;
 
 //	t = (token_t *) malloc(sizeof(token_t));
-	t = (token_t *) GetMemory(sizeof(token_t));
+	if (source && source->freetokens)
+	{
+		t = source->freetokens;
+		source->freetokens = t->next;
+	} //end if
+	else
+	{
+		t = (token_t *) PC_GetMemory(source, sizeof(token_t));
+	} //end else
 //	t = freetokens;
 	if (!t)
 	{
@@ -287,10 +325,18 @@ token_t *PC_CopyToken(token_t *token)
 // Returns:					-
 // Changes Globals:		-
 //============================================================================
-void PC_FreeToken(token_t *token)
+void PC_FreeToken(source_t *source, token_t *token)
 {
 	//free(token);
-	FreeMemory(token);
+	if (source && source->arena)
+	{
+		token->next = source->freetokens;
+		source->freetokens = token;
+	} //end if
+	else
+	{
+		FreeMemory(token);
+	} //end else
 //	token->next = freetokens;
 //	freetokens = token;
 	numtokens--;
@@ -335,7 +381,7 @@ int PC_ReadSourceToken(source_t *source, token_t *token)
 	//free the read token
 	t = source->tokens;
 	source->tokens = source->tokens->next;
-	PC_FreeToken(t);
+	PC_FreeToken(source, t);
 	return qtrue;
 } //end of the function PC_ReadSourceToken
 //============================================================================
@@ -348,7 +394,7 @@ int PC_UnreadSourceToken(source_t *source, token_t *token)
 {
 	token_t *t;
 
-	t = PC_CopyToken(token);
+	t = PC_CopyToken(source, token);
 	t->next = source->tokens;
 	source->tokens = t;
 	return qtrue;
@@ -440,7 +486,7 @@ int PC_ReadDefineParms(source_t *source, define_t *define, token_t **parms, int
 			if (numparms < define->numparms)
 			{
 				//
-				t = PC_CopyToken(&token);
+				t = PC_CopyToken(source, &token);
 				t->next = NULL;
 				if (last) last->next = t;
 				else parms[numparms] = t;
@@ -635,7 +681,7 @@ int PC_FindDefineParm(define_t *define, char *name)
 // Returns:					-
 // Changes Globals:		-
 //============================================================================
-void PC_FreeDefine(define_t *define)
+void PC_FreeDefine(source_t *source, define_t *define)
 {
 	token_t *t, *next;
 
@@ -643,17 +689,17 @@ void PC_FreeDefine(define_t *define)
 	for (t = define->parms; t; t = next)
 	{
 		next = t->next;
-		PC_FreeToken(t);
+		PC_FreeToken(source, t);
 	} //end for
 	//free the define tokens
 	for (t = define->tokens; t; t = next)
 	{
 		next = t->next;
-		PC_FreeToken(t);
+		PC_FreeToken(source, t);
 	} //end for
 	//free the define
-	FreeMemory(define->name);
-	FreeMemory(define);
+	PC_FreeMemory(source, define->name);
+	PC_FreeMemory(source, define);
 } //end of the function PC_FreeDefine
 //============================================================================
 //
@@ -680,9 +726,9 @@ void PC_AddBuiltinDefines(source_t *source)
 
 	for (i = 0; builtin[i].string; i++)
 	{
-		define = (define_t *) GetMemory(sizeof(define_t));
+		define = (define_t *) PC_GetMemory(source, sizeof(define_t));
 		Com_Memset(define, 0, sizeof(define_t));
-		define->name = (char *) GetMemory(strlen(builtin[i].string) + 1);
+		define->name = (char *) PC_GetMemory(source, strlen(builtin[i].string) + 1);
 		strcpy(define->name, builtin[i].string);
 		define->flags |= DEFINE_FIXED;
 		define->builtin = builtin[i].builtin;
@@ -709,7 +755,7 @@ int PC_ExpandBuiltinDefine(source_t *source, token_t *deftoken, define_t *define
 	
 	char *curtime;
 
-	token = PC_CopyToken(deftoken);
+	token = PC_CopyToken(source, deftoken);
 	switch(define->builtin)
 	{
 		case BUILTIN_LINE:
@@ -823,7 +869,7 @@ int PC_ExpandDefine(source_t *source, token_t *deftoken, define_t *define,
 		{
 			for (pt = parms[parmnum]; pt; pt = pt->next)
 			{
-				t = PC_CopyToken(pt);
+				t = PC_CopyToken(source, pt);
 				//add the token to the list
 				t->next = NULL;
 				if (last) last->next = t;
@@ -850,7 +896,7 @@ int PC_ExpandDefine(source_t *source, token_t *deftoken, define_t *define,
 						SourceError(source, "can't stringize tokens");
 						return qfalse;
 					} //end if
-					t = PC_CopyToken(&token);
+					t = PC_CopyToken(source, &token);
 				} //end if
 				else
 				{
@@ -860,7 +906,7 @@ int PC_ExpandDefine(source_t *source, token_t *deftoken, define_t *define,
 			} //end if
 			else
 			{
-				t = PC_CopyToken(dt);
+				t = PC_CopyToken(source, dt);
 			} //end else
 			//add the token to the list
 			t->next = NULL;
@@ -886,10 +932,10 @@ int PC_ExpandDefine(source_t *source, token_t *deftoken, define_t *define,
 						SourceError(source, "can't merge %s with %s", t1->string, t2->string);
 						return qfalse;
 					} //end if
-					PC_FreeToken(t1->next);
+					PC_FreeToken(source, t1->next);
 					t1->next = t2->next;
 					if (t2 == last) last = t1;
-					PC_FreeToken(t2);
+					PC_FreeToken(source, t2);
 					continue;
 				} //end if
 			} //end if
@@ -905,7 +951,7 @@ int PC_ExpandDefine(source_t *source, token_t *deftoken, define_t *define,
 		for (pt = parms[i]; pt; pt = nextpt)
 		{
 			nextpt = pt->next;
-			PC_FreeToken(pt);
+			PC_FreeToken(source, pt);
 		} //end for
 	} //end for
 	//
@@ -1139,7 +1185,7 @@ int PC_Directive_undef(source_t *source)
 			{
 				if (lastdefine) lastdefine->hashnext = define->hashnext;
 				else source->definehash[hash] = define->hashnext;
-				PC_FreeDefine(define);
+				PC_FreeDefine(source, define);
 			} //end else
 			break;
 		} //end if
@@ -1158,7 +1204,7 @@ int PC_Directive_undef(source_t *source)
 			{
 				if (lastdefine) lastdefine->next = define->next;
 				else source->defines = define->next;
-				PC_FreeDefine(define);
+				PC_FreeDefine(source, define);
 			} //end else
 			break;
 		} //end if
@@ -1210,9 +1256,9 @@ int PC_Directive_define(source_t *source)
 		if (!PC_Directive_undef(source)) return qfalse;
 	} //end if
 	//allocate define
-	define = (define_t *) GetMemory(sizeof(define_t));
+	define = (define_t *) PC_GetMemory(source, sizeof(define_t));
 	Com_Memset(define, 0, sizeof(define_t));
-	define->name = (char *) GetMemory(strlen(token.string) + 1);
+	define->name = (char *) PC_GetMemory(source, strlen(token.string) + 1);
 	strcpy(define->name, token.string);
 	//add the define to the source
 #if DEFINEHASHING
@@ -1250,7 +1296,7 @@ int PC_Directive_define(source_t *source)
 					return qfalse;
 				} //end if
 				//add the define parm
-				t = PC_CopyToken(&token);
+				t = PC_CopyToken(source, &token);
 				PC_ClearTokenWhiteSpace(t);
 				t->next = NULL;
 				if (last) last->next = t;
@@ -1279,7 +1325,7 @@ int PC_Directive_define(source_t *source)
 	last = NULL;
 	do
 	{
-		t = PC_CopyToken(&token);
+		t = PC_CopyToken(source, &token);
 		if (t->type == TT_NAME && !strcmp(t->string, define->name))
 		{
 			SourceError(source, "recursive define (removed recursion)");
@@ -1334,7 +1380,7 @@ define_t *PC_DefineFromString(char *string)
 	for (t = src.tokens; t; t = src.tokens)
 	{
 		src.tokens = src.tokens->next;
-		PC_FreeToken(t);
+		PC_FreeToken(&src, t);
 	} //end for
 #ifdef DEFINEHASHING
 	def = NULL;
@@ -1358,7 +1404,7 @@ define_t *PC_DefineFromString(char *string)
 	//if the define was created successfully
 	if (res > 0) return def;
 	//free the define is created
-	if (src.defines) PC_FreeDefine(def);
+	if (src.defines) PC_FreeDefine(&src, def);
 	//
 	return NULL;
 } //end of the function PC_DefineFromString
@@ -1370,10 +1416,13 @@ define_t *PC_DefineFromString(char *string)
 //============================================================================
 int PC_AddDefine(source_t *source, char *string)
 {
-	define_t *define;
+	define_t *define, *newdefine;
 
-	define = PC_DefineFromString(string);
-	if (!define) return qfalse;
+	newdefine = PC_DefineFromString(string);
+	if (!newdefine) return qfalse;
+	//the source frees its defines together with its arena
+	define = PC_CopyDefine(source, newdefine);
+	PC_FreeDefine(NULL, newdefine);
 #if DEFINEHASHING
 	PC_AddDefineToHash(define, source->definehash);
 #else //DEFINEHASHING
@@ -1413,7 +1462,7 @@ int PC_RemoveGlobalDefine(char *name)
 	define = PC_FindDefine(globaldefines, name);
 	if (define)
 	{
-		PC_FreeDefine(define);
+		PC_FreeDefine(NULL, define);
 		return qtrue;
 	} //end if
 	return qfalse;
@@ -1432,7 +1481,7 @@ void PC_RemoveAllGlobalDefines(void)
 	for (define = globaldefines; define; define = globaldefines)
 	{
 		globaldefines = globaldefines->next;
-		PC_FreeDefine(define);
+		PC_FreeDefine(NULL, define);
 	} //end for
 } //end of the function PC_RemoveAllGlobalDefines
 //============================================================================
@@ -1446,9 +1495,9 @@ define_t *PC_CopyDefine(source_t *source, define_t *define)
 	define_t *newdefine;
 	token_t *token, *newtoken, *lasttoken;
 
-	newdefine = (define_t *) GetMemory(sizeof(define_t));
+	newdefine = (define_t *) PC_GetMemory(source, sizeof(define_t));
 	//copy the define name
-	newdefine->name = (char *) GetMemory(strlen(define->name) + 1);
+	newdefine->name = (char *) PC_GetMemory(source, strlen(define->name) + 1);
 	strcpy(newdefine->name, define->name);
 	newdefine->flags = define->flags;
 	newdefine->builtin = define->builtin;
@@ -1460,7 +1509,7 @@ define_t *PC_CopyDefine(source_t *source, define_t *define)
 	newdefine->tokens = NULL;
 	for (lasttoken = NULL, token = define->tokens; token; token = token->next)
 	{
-		newtoken = PC_CopyToken(token);
+		newtoken = PC_CopyToken(source, token);
 		newtoken->next = NULL;
 		if (lasttoken) lasttoken->next = newtoken;
 		else newdefine->tokens = newtoken;
@@ -1470,7 +1519,7 @@ define_t *PC_CopyDefine(source_t *source, define_t *define)
 	newdefine->parms = NULL;
 	for (lasttoken = NULL, token = define->parms; token; token = token->next)
 	{
-		newtoken = PC_CopyToken(token);
+		newtoken = PC_CopyToken(source, token);
 		newtoken->next = NULL;
 		if (lasttoken) lasttoken->next = newtoken;
 		else newdefine->parms = newtoken;
@@ -2156,7 +2205,7 @@ int PC_Evaluate(source_t *source, signed long int *intvalue,
 			if (defined)
 			{
 				defined = qfalse;
-				t = PC_CopyToken(&token);
+				t = PC_CopyToken(source, &token);
 				t->next = NULL;
 				if (lasttoken) lasttoken->next = t;
 				else firsttoken = t;
@@ -2165,7 +2214,7 @@ int PC_Evaluate(source_t *source, signed long int *intvalue,
 			else if (!strcmp(token.string, "defined"))
 			{
 				defined = qtrue;
-				t = PC_CopyToken(&token);
+				t = PC_CopyToken(source, &token);
 				t->next = NULL;
 				if (lasttoken) lasttoken->next = t;
 				else firsttoken = t;
@@ -2190,7 +2239,7 @@ int PC_Evaluate(source_t *source, signed long int *intvalue,
 		//if the token is a number or a punctuation
 		else if (token.type == TT_NUMBER || token.type == TT_PUNCTUATION)
 		{
-			t = PC_CopyToken(&token);
+			t = PC_CopyToken(source, &token);
 			t->next = NULL;
 			if (lasttoken) lasttoken->next = t;
 			else firsttoken = t;
@@ -2214,7 +2263,7 @@ int PC_Evaluate(source_t *source, signed long int *intvalue,
 		Log_Write(" %s", t->string);
 #endif //DEBUG_EVAL
 		nexttoken = t->next;
-		PC_FreeToken(t);
+		PC_FreeToken(source, t);
 	} //end for
 #ifdef DEBUG_EVAL
 	if (integer) Log_Write("eval result: %d", *intvalue);
@@ -2261,7 +2310,7 @@ int PC_DollarEvaluate(source_t *source, signed long int *intvalue,
 			if (defined)
 			{
 				defined = qfalse;
-				t = PC_CopyToken(&token);
+				t = PC_CopyToken(source, &token);
 				t->next = NULL;
 				if (lasttoken) lasttoken->next = t;
 				else firsttoken = t;
@@ -2270,7 +2319,7 @@ int PC_DollarEvaluate(source_t *source, signed long int *intvalue,
 			else if (!strcmp(token.string, "defined"))
 			{
 				defined = qtrue;
-				t = PC_CopyToken(&token);
+				t = PC_CopyToken(source, &token);
 				t->next = NULL;
 				if (lasttoken) lasttoken->next = t;
 				else firsttoken = t;
@@ -2298,7 +2347,7 @@ int PC_DollarEvaluate(source_t *source, signed long int *intvalue,
 			if (*token.string == '(') indent++;
 			else if (*token.string == ')') indent--;
 			if (indent <= 0) break;
-			t = PC_CopyToken(&token);
+			t = PC_CopyToken(source, &token);
 			t->next = NULL;
 			if (lasttoken) lasttoken->next = t;
 			else firsttoken = t;
@@ -2322,7 +2371,7 @@ int PC_DollarEvaluate(source_t *source, signed long int *intvalue,
 		Log_Write(" %s", t->string);
 #endif //DEBUG_EVAL
 		nexttoken = t->next;
-		PC_FreeToken(t);
+		PC_FreeToken(source, t);
 	} //end for
 #ifdef DEBUG_EVAL
 	if (integer) Log_Write("$eval result: %d", *intvalue);
@@ -3007,9 +3056,12 @@ source_t *LoadSourceFile(const char *filename)
 	source->defines = NULL;
 	source->indentstack = NULL;
 	source->skip = 0;
+	//the tokens and defines of the source are freed all at once
+	source->arena = AllocMemoryArena(SOURCE_ARENA_BLOCKSIZE);
+	source->freetokens = NULL;
 
 #if DEFINEHASHING
-	source->definehash = GetClearedMemory(DEFINEHASHSIZE * sizeof(define_t *));
+	source->definehash = GetClearedArenaMemory(source->arena, DEFINEHASHSIZE * sizeof(define_t *));
 #endif //DEFINEHASHING
 	PC_AddGlobalDefinesToSource(source);
 	return source;
@@ -3040,9 +3092,12 @@ source_t *LoadSourceMemory(char *ptr, int length, char *name)
 	source->defines = NULL;
 	source->indentstack = NULL;
 	source->skip = 0;
+	//the tokens and defines of the source are freed all at once
+	source->arena = AllocMemoryArena(SOURCE_ARENA_BLOCKSIZE);
+	source->freetokens = NULL;
 
 #if DEFINEHASHING
-	source->definehash = GetClearedMemory(DEFINEHASHSIZE * sizeof(define_t *));
+	source->definehash = GetClearedArenaMemory(source->arena, DEFINEHASHSIZE * sizeof(define_t *));
 #endif //DEFINEHASHING
 	PC_AddGlobalDefinesToSource(source);
 	return source;
@@ -3056,10 +3111,7 @@ source_t *LoadSourceMemory(char *ptr, int length, char *name)
 void FreeSource(source_t *source)
 {
 	script_t *script;
-	token_t *token;
-	define_t *define;
 	indent_t *indent;
-	int i;
 
 	//PC_PrintDefineHashTable(source->definehash);
 	//free all the scripts
@@ -3069,32 +3121,6 @@ void FreeSource(source_t *source)
 		source->scriptstack = source->scriptstack->next;
 		FreeScript(script);
 	} //end for
-	//free all the tokens
-	while(source->tokens)
-	{
-		token = source->tokens;
-		source->tokens = source->tokens->next;
-		PC_FreeToken(token);
-	} //end for
-#if DEFINEHASHING
-	for (i = 0; i < DEFINEHASHSIZE; i++)
-	{
-		while(source->definehash[i])
-		{
-			define = source->definehash[i];
-			source->definehash[i] = source->definehash[i]->hashnext;
-			PC_FreeDefine(define);
-		} //end while
-	} //end for
-#else //DEFINEHASHING
-	//free all defines
-	while(source->defines)
-	{
-		define = source->defines;
-		source->defines = source->defines->next;
-		PC_FreeDefine(define);
-	} //end for
-#endif //DEFINEHASHING
 	//free all indents
 	while(source->indentstack)
 	{
@@ -3102,10 +3128,8 @@ void FreeSource(source_t *source)
 		source->indentstack = source->indentstack->next;
 		FreeMemory(indent);
 	} //end for
-#if DEFINEHASHING
-	//
-	if (source->definehash) FreeMemory(source->definehash);
-#endif //DEFINEHASHING
+	//free all the tokens and defines, and the define hash table
+	FreeMemoryArena(source->arena);
 	//free the source itself
 	FreeMemory(source);
 } //end of the function FreeSource
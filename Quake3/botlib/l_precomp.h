@@ -100,6 +100,8 @@ typedef struct source_s
 	indent_t *indentstack;					//stack with indents
 	int skip;								// > 0 if skipping conditional code
 	token_t token;							//last read token
+	struct memoryarena_s *arena;			//memory for the tokens and defines
+	token_t *freetokens;					//tokens to reuse
 } source_t;
 
 
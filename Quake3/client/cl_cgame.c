@@ -392,6 +392,9 @@ void CL_ShutdownCGame( void ) {
 	VM_Call( cgvm, CG_SHUTDOWN );
 	VM_Free( cgvm );
 	cgvm = NULL;
+
+	// a load that was cut short may have left prefetches behind
+	FS_DropPrefetches();
 }
 
 static int	FloatAsInt( float f ) {
@@ -711,7 +714,9 @@ Should only be called by CL_StartHunkUsers
 void CL_InitCGame( void ) {
 	const char			*info;
 	const char			*mapname;
+	const char			*model;
 	int					t1, t2;
+	int					i;
 	vmInterpret_t		interpret;
 
 	t1 = Sys_Milliseconds();
@@ -724,6 +729,19 @@ void CL_InitCGame( void ) {
 	mapname = Info_ValueForKey( info, "mapname" );
 	Com_sprintf( cl.mapname, sizeof( cl.mapname ), "maps/%s.bsp", mapname );
 
+	// the cgame loads the map and the registered models first thing, get
+	// the io threads started on them while the vm is created
+	FS_PrefetchFile( cl.mapname );
+	for ( i = 1 ; i < MAX_MODELS ; i++ ) {
+		model = cl.gameState.stringData + cl.gameState.stringOffsets[ CS_MODELS + i ];
+		if ( !model[0] ) {
+			break;
+		}
+		if ( model[0] != '*' ) {
+			FS_PrefetchFile( model );
+		}
+	}
+
 	// load the dll or bytecode
 	interpret = Cvar_VariableValue("vm_cgame");
 	if(cl_connectedToPureServer)
@@ -760,6 +778,9 @@ void CL_InitCGame( void ) {
 	// on the card even if the driver does deferred loading
 	re.EndRegistration();
 
+	// everything the load was going to read has been read
+	FS_DropPrefetches();
+
 	// make sure everything is paged in
 	if (!Sys_LowPhysicalMemory()) {
 		Com_TouchMemory();
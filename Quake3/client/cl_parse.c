@@ -53,35 +53,6 @@ MESSAGE PARSING
 =========================================================================
 */
 
-/*
-==================
-CL_DeltaEntity
-
-Parses deltas from the given base and adds the resulting entity
-to the current frame
-==================
-*/
-void CL_DeltaEntity (msg_t *msg, clSnapshot_t *frame, int newnum, entityState_t *old, 
-					 qboolean unchanged) {
-	entityState_t	*state;
-
-	// save the parsed entity state into the big circular buffer so
-	// it can be used as the source for a later delta
-	state = &cl.parseEntities[cl.parseEntitiesNum & (MAX_PARSE_ENTITIES-1)];
-
-	if ( unchanged ) {
-		*state = *old;
-	} else {
-		MSG_ReadDeltaEntity( msg, old, state, newnum );
-	}
-
-	if ( state->number == (MAX_GENTITIES-1) ) {
-		return;		// entity was delta removed
-	}
-	cl.parseEntitiesNum++;
-	frame->numEntities++;
-}
-
 /*
 ==================
 CL_ParsePacketEntities
@@ -89,104 +60,16 @@ CL_ParsePacketEntities
 ==================
 */
 void CL_ParsePacketEntities( msg_t *msg, clSnapshot_t *oldframe, clSnapshot_t *newframe) {
-	int			newnum;
-	entityState_t	*oldstate;
-	int			oldindex, oldnum;
-
 	newframe->parseEntitiesNum = cl.parseEntitiesNum;
-	newframe->numEntities = 0;
-
-	// delta from the entities present in oldframe
-	oldindex = 0;
-	oldstate = NULL;
-	if (!oldframe) {
-		oldnum = 99999;
-	} else {
-		if ( oldindex >= oldframe->numEntities ) {
-			oldnum = 99999;
-		} else {
-			oldstate = &cl.parseEntities[
-				(oldframe->parseEntitiesNum + oldindex) & (MAX_PARSE_ENTITIES-1)];
-			oldnum = oldstate->number;
-		}
-	}
-
-	while ( 1 ) {
-		// read the entity index number
-		newnum = MSG_ReadBits( msg, GENTITYNUM_BITS );
-
-		if ( newnum == (MAX_GENTITIES-1) ) {
-			break;
-		}
 
-		if ( msg->readcount > msg->cursize ) {
-			Com_Error (ERR_DROP,"CL_ParsePacketEntities: end of message");
-		}
-
-		while ( oldnum < newnum ) {
-			// one or more entities from the old packet are unchanged
-			if ( cl_shownet->integer == 3 ) {
-				Com_Printf ("%3i:  unchanged: %i\n", msg->readcount, oldnum);
-			}
-			CL_DeltaEntity( msg, newframe, oldnum, oldstate, qtrue );
-			
-			oldindex++;
-
-			if ( oldindex >= oldframe->numEntities ) {
-				oldnum = 99999;
-			} else {
-				oldstate = &cl.parseEntities[
-					(oldframe->parseEntitiesNum + oldindex) & (MAX_PARSE_ENTITIES-1)];
-				oldnum = oldstate->number;
-			}
-		}
-		if (oldnum == newnum) {
-			// delta from previous state
-			if ( cl_shownet->integer == 3 ) {
-				Com_Printf ("%3i:  delta: %i\n", msg->readcount, newnum);
-			}
-			CL_DeltaEntity( msg, newframe, newnum, oldstate, qfalse );
-
-			oldindex++;
-
-			if ( oldindex >= oldframe->numEntities ) {
-				oldnum = 99999;
-			} else {
-				oldstate = &cl.parseEntities[
-					(oldframe->parseEntitiesNum + oldindex) & (MAX_PARSE_ENTITIES-1)];
-				oldnum = oldstate->number;
-			}
-			continue;
-		}
-
-		if ( oldnum > newnum ) {
-			// delta from baseline
-			if ( cl_shownet->integer == 3 ) {
-				Com_Printf ("%3i:  baseline: %i\n", msg->readcount, newnum);
-			}
-			CL_DeltaEntity( msg, newframe, newnum, &cl.entityBaselines[newnum], qfalse );
-			continue;
-		}
-
-	}
-
-	// any remaining entities in the old frame are copied over
-	while ( oldnum != 99999 ) {
-		// one or more entities from the old packet are unchanged
-		if ( cl_shownet->integer == 3 ) {
-			Com_Printf ("%3i:  unchanged: %i\n", msg->readcount, oldnum);
-		}
-		CL_DeltaEntity( msg, newframe, oldnum, oldstate, qtrue );
-		
-		oldindex++;
+	// delta from the entities present in oldframe, the parsed states go into
+	// the big circular buffer so they can be used as the source for a later delta
+	newframe->numEntities = MSG_ReadPacketEntities( msg, cl.parseEntities, MAX_PARSE_ENTITIES - 1,
+		&cl.parseEntitiesNum, oldframe ? oldframe->parseEntitiesNum : 0, oldframe ? oldframe->numEntities : 0,
+		cl.entityBaselines, cl_shownet->integer == 3 );
 
-		if ( oldindex >= oldframe->numEntities ) {
-			oldnum = 99999;
-		} else {
-			oldstate = &cl.parseEntities[
-				(oldframe->parseEntitiesNum + oldindex) & (MAX_PARSE_ENTITIES-1)];
-			oldnum = oldstate->number;
-		}
+	if ( newframe->numEntities < 0 ) {
+		Com_Error (ERR_DROP,"CL_ParsePacketEntities: end of message");
 	}
 }
 
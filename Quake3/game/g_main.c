@@ -231,6 +231,10 @@ Q_EXPORT intptr_t vmMain( int command, int arg0, int arg1, int arg2, int arg3, i
 		return ConsoleCommand();
 	case BOTAI_START_FRAME:
 		return BotAIStartFrame( arg0 );
+#ifndef Q3_VM
+	case GAME_DIRECT_IMPORTS:
+		return trap_DirectImports( arg0 );
+#endif
 	}
 
 	return -1;
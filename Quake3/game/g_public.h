@@ -230,6 +230,9 @@ typedef enum {
 	// 1.32
 	G_FS_SEEK,
 
+	G_DIRECT_IMPORTS,	// ( gameDirectImports_t *imports, int version );
+	// native modules only, see GAME_DIRECT_IMPORTS
+
 	BOTLIB_SETUP = 200,				// ( void );
 	BOTLIB_SHUTDOWN,				// ( void );
 	BOTLIB_LIBVAR_SET,
@@ -425,6 +428,29 @@ typedef enum {
 	// The game can issue trap_argc() / trap_argv() commands to get the command
 	// and parameters.  Return qfalse if the game doesn't recognize it as a command.
 
-	BOTAI_START_FRAME				// ( int time );
+	BOTAI_START_FRAME,				// ( int time );
+
+	GAME_DIRECT_IMPORTS				// ( int version );
+	// Only sent to native modules, before GAME_INIT.  A module that knows
+	// the version answers with G_DIRECT_IMPORTS and may then call the
+	// gameDirectImports_t functions instead of the matching syscalls.
+	// Older modules return -1 and keep using syscalls.
 } gameExport_t;
 
+#define	GAME_DIRECT_IMPORTS_VERSION	1
+
+// the hottest syscalls as plain function calls, same arguments as the
+// matching G_* syscall
+typedef struct {
+	void		(*Trace)( trace_t *results, const vec3_t start, const vec3_t mins, const vec3_t maxs, const vec3_t end, int passEntityNum, int contentmask );
+	void		(*TraceCapsule)( trace_t *results, const vec3_t start, const vec3_t mins, const vec3_t maxs, const vec3_t end, int passEntityNum, int contentmask );
+	int			(*PointContents)( const vec3_t point, int passEntityNum );
+	qboolean	(*InPVS)( const vec3_t p1, const vec3_t p2 );
+	void		(*LinkEntity)( sharedEntity_t *ent );
+	void		(*UnlinkEntity)( sharedEntity_t *ent );
+	int			(*EntitiesInBox)( const vec3_t mins, const vec3_t maxs, int *list, int maxcount );
+	qboolean	(*EntityContact)( const vec3_t mins, const vec3_t maxs, const sharedEntity_t *ent );
+	qboolean	(*EntityContactCapsule)( const vec3_t mins, const vec3_t maxs, const sharedEntity_t *ent );
+	void		(*GetUsercmd)( int clientNum, usercmd_t *cmd );
+} gameDirectImports_t;
+
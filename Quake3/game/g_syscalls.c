@@ -30,9 +30,27 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 
 static intptr_t (QDECL *syscall)( intptr_t arg, ... ) = (intptr_t (QDECL *)( intptr_t, ...))-1;
 
+// filled in by engines that offer them, otherwise the traps use syscall
+static gameDirectImports_t	direct;
+
 
 Q_EXPORT void dllEntry( intptr_t (QDECL *syscallptr)( intptr_t arg,... ) ) {
 	syscall = syscallptr;
+	memset( &direct, 0, sizeof( direct ) );
+}
+
+/*
+================
+trap_DirectImports
+
+Answer to GAME_DIRECT_IMPORTS
+================
+*/
+int trap_DirectImports( int version ) {
+	if ( version != GAME_DIRECT_IMPORTS_VERSION ) {
+		return -1;
+	}
+	return syscall( G_DIRECT_IMPORTS, &direct, version );
 }
 
 int PASSFLOAT( float x ) {
@@ -150,19 +168,33 @@ void trap_SetBrushModel( gentity_t *ent, const char *name ) {
 }
 
 void trap_Trace( trace_t *results, const vec3_t start, const vec3_t mins, const vec3_t maxs, const vec3_t end, int passEntityNum, int contentmask ) {
+	if ( direct.Trace ) {
+		direct.Trace( results, start, mins, maxs, end, passEntityNum, contentmask );
+		return;
+	}
 	syscall( G_TRACE, results, start, mins, maxs, end, passEntityNum, contentmask );
 }
 
 void trap_TraceCapsule( trace_t *results, const vec3_t start, const vec3_t mins, const vec3_t maxs, const vec3_t end, int passEntityNum, int contentmask ) {
+	if ( direct.TraceCapsule ) {
+		direct.TraceCapsule( results, start, mins, maxs, end, passEntityNum, contentmask );
+		return;
+	}
 	syscall( G_TRACECAPSULE, results, start, mins, maxs, end, passEntityNum, contentmask );
 }
 
 int trap_PointContents( const vec3_t point, int passEntityNum ) {
+	if ( direct.PointContents ) {
+		return direct.PointContents( point, passEntityNum );
+	}
 	return syscall( G_POINT_CONTENTS, point, passEntityNum );
 }
 
 
 qboolean trap_InPVS( const vec3_t p1, const vec3_t p2 ) {
+	if ( direct.InPVS ) {
+		return direct.InPVS( p1, p2 );
+	}
 	return syscall( G_IN_PVS, p1, p2 );
 }
 
@@ -179,22 +211,39 @@ qboolean trap_AreasConnected( int area1, int area2 ) {
 }
 
 void trap_LinkEntity( gentity_t *ent ) {
+	if ( direct.LinkEntity ) {
+		direct.LinkEntity( (sharedEntity_t *)ent );
+		return;
+	}
 	syscall( G_LINKENTITY, ent );
 }
 
 void trap_UnlinkEntity( gentity_t *ent ) {
+	if ( direct.UnlinkEntity ) {
+		direct.UnlinkEntity( (sharedEntity_t *)ent );
+		return;
+	}
 	syscall( G_UNLINKENTITY, ent );
 }
 
 int trap_EntitiesInBox( const vec3_t mins, const vec3_t maxs, int *list, int maxcount ) {
+	if ( direct.EntitiesInBox ) {
+		return direct.EntitiesInBox( mins, maxs, list, maxcount );
+	}
 	return syscall( G_ENTITIES_IN_BOX, mins, maxs, list, maxcount );
 }
 
 qboolean trap_EntityContact( const vec3_t mins, const vec3_t maxs, const gentity_t *ent ) {
+	if ( direct.EntityContact ) {
+		return direct.EntityContact( mins, maxs, (const sharedEntity_t *)ent );
+	}
 	return syscall( G_ENTITY_CONTACT, mins, maxs, ent );
 }
 
 qboolean trap_EntityContactCapsule( const vec3_t mins, const vec3_t maxs, const gentity_t *ent ) {
+	if ( direct.EntityContactCapsule ) {
+		return direct.EntityContactCapsule( mins, maxs, (const sharedEntity_t *)ent );
+	}
 	return syscall( G_ENTITY_CONTACTCAPSULE, mins, maxs, ent );
 }
 
@@ -207,6 +256,10 @@ void trap_BotFreeClient( int clientNum ) {
 }
 
 void trap_GetUsercmd( int clientNum, usercmd_t *cmd ) {
+	if ( direct.GetUsercmd ) {
+		direct.GetUsercmd( clientNum, cmd );
+		return;
+	}
 	syscall( G_GET_USERCMD, clientNum, cmd );
 }
 
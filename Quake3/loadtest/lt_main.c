@@ -0,0 +1,1083 @@
+/*
+===========================================================================
+Copyright (C) 1999-2005 Id Software, Inc.
+
+This file is part of Quake III Arena source code.
+
+Quake III Arena source code is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the License,
+or (at your option) any later version.
+
+Quake III Arena source code is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Quake III Arena source code; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+===========================================================================
+*/
+// lt_main.c -- headless load test client
+//
+// Simulates a number of players against a server on this machine.  Every
+// player has its own UDP port, does the challenge / connect handshake,
+// parses the gamestate and delta compressed snapshots the same way the
+// client does, and sends scripted movement commands.  The renderer, sound
+// and cgame are never involved.
+//
+// The entity delta walk is shared with the client through
+// MSG_ReadPacketEntities, the rest of the protocol is handled here.  The
+// client keeps its one connection in the cl and clc globals and isn't
+// linked into this binary, and Netchan_Transmit and NET_OutOfBandData send
+// from the shared client socket with the qport cvar, while every player
+// here has a socket and qport of its own.
+//
+// The binary is a dedicated server with this module linked in, so a map
+// can be loaded in the same process and its frame times measured directly:
+//
+//   ioq3loadtest +map q3dm17 +loadtest 32 60
+//
+// or it can be pointed at another server on this machine:
+//
+//   ioq3loadtest +loadtest 32 60 127.0.0.1:27961
+
+#include "../server/server.h"
+
+#define	LT_PARSE_ENTITIES		2048
+#define	LT_RESEND_MSEC			1000
+#define	LT_TIMEOUT_MSEC			10000
+#define	LT_MAX_PACKETLEN		1400	// MAX_PACKETLEN in net_chan.c
+
+// latencies are kept in 250 usec buckets, server frames in 25 usec buckets
+#define	LT_HISTOGRAM_BUCKETS	4096
+
+typedef enum {
+	LTS_FREE,
+	LTS_CHALLENGING,	// sending getchallenge
+	LTS_CONNECTING,		// sending connect
+	LTS_CONNECTED,		// netchan set up, waiting for the gamestate
+	LTS_PRIMED,			// gamestate parsed, sending usercmds
+	LTS_ACTIVE			// snapshots arriving
+} ltState_t;
+
+typedef struct {
+	qboolean		valid;
+	int				messageNum;
+	int				deltaNum;
+	int				serverTime;
+	int				parseEntitiesNum;
+	int				numEntities;
+	playerState_t	ps;
+} ltSnapshot_t;
+
+typedef struct {
+	int64_t			realtime;		// Sys_Microseconds when sent
+	int				serverTime;		// of the usercmd in the packet
+} ltOutPacket_t;
+
+typedef struct {
+	ltState_t		state;
+	int				index;
+	int				socket;
+	int				qport;
+	int				challenge;		// client challenge until the server answers
+	int				lastSendTime;
+	int				lastPacketTime;
+
+	netchan_t		netchan;
+	int				serverId;
+	int				clientNum;
+	int				checksumFeed;
+	int				serverMessageSequence;
+
+	int				serverCommandSequence;
+	char			serverCommands[MAX_RELIABLE_COMMANDS][MAX_STRING_CHARS];
+	int				reliableSequence;
+	int				reliableAcknowledge;
+	char			reliableCommands[MAX_RELIABLE_COMMANDS][MAX_STRING_CHARS];
+	char			bigConfigString[BIG_INFO_STRING];
+
+	entityState_t	baselines[MAX_GENTITIES];
+	entityState_t	parseEntities[LT_PARSE_ENTITIES];
+	int				parseEntitiesNum;
+	ltSnapshot_t	snap;
+	ltSnapshot_t	snapshots[PACKET_BACKUP];
+	int				snapTime;		// Sys_Milliseconds when snap arrived
+	ltOutPacket_t	outPackets[PACKET_BACKUP];
+	int				cmdServerTime;
+} ltClient_t;
+
+typedef struct {
+	int				scale;			// usec per bucket
+	int				count;
+	int				max;
+	int				buckets[LT_HISTOGRAM_BUCKETS];
+} ltHistogram_t;
+
+typedef struct {
+	qboolean		running;
+	netadr_t		serverAddress;
+	int				numClients;
+	ltClient_t		*clients[MAX_CLIENTS];
+	int				startTime;
+	int				endTime;		// 0 runs until "loadtest stop"
+	int				lastServerTime;
+
+	int64_t			bytesIn;
+	int64_t			bytesOut;
+	int				snapshots;
+	int				fullSnapshots;
+	int				droppedSnapshots;
+
+	ltHistogram_t	latency;
+	ltHistogram_t	serverFrame;
+} loadTest_t;
+
+static loadTest_t	lt;
+
+static cvar_t		*lt_maxpackets;
+
+static void QDECL LT_OutOfBandData( ltClient_t *c, const char *format, ... ) __attribute__ ((format (printf, 2, 3)));
+
+/*
+=============================================================================
+
+STATISTICS
+
+=============================================================================
+*/
+
+/*
+==================
+LT_AddSample
+==================
+*/
+static void LT_AddSample( ltHistogram_t *h, int usec ) {
+	int		bucket;
+
+	if ( usec < 0 ) {
+		usec = 0;
+	}
+	bucket = usec / h->scale;
+	if ( bucket >= LT_HISTOGRAM_BUCKETS ) {
+		bucket = LT_HISTOGRAM_BUCKETS - 1;
+	}
+	h->buckets[bucket]++;
+	h->count++;
+	if ( usec > h->max ) {
+		h->max = usec;
+	}
+}
+
+/*
+==================
+LT_Percentile
+
+Upper edge of the bucket holding the given fraction of the samples
+==================
+*/
+static int LT_Percentile( const ltHistogram_t *h, float frac ) {
+	int		i, want, sum;
+
+	if ( !h->count ) {
+		return 0;
+	}
+	want = ceil( h->count * frac );
+	for ( i = 0, sum = 0 ; i < LT_HISTOGRAM_BUCKETS ; i++ ) {
+		sum += h->buckets[i];
+		if ( sum >= want ) {
+			break;
+		}
+	}
+	if ( i == LT_HISTOGRAM_BUCKETS - 1 ) {
+		return h->max;
+	}
+	return MIN( ( i + 1 ) * h->scale, h->max );
+}
+
+/*
+==================
+LT_PrintHistogram
+==================
+*/
+static void LT_PrintHistogram( const char *name, const ltHistogram_t *h ) {
+	if ( !h->count ) {
+		Com_Printf( "%-18s no samples\n", name );
+		return;
+	}
+	Com_Printf( "%-18s p50 %6.2f  p90 %6.2f  p99 %6.2f  max %6.2f msec  (%i samples)\n", name,
+		LT_Percentile( h, 0.5f ) * 0.001f, LT_Percentile( h, 0.9f ) * 0.001f,
+		LT_Percentile( h, 0.99f ) * 0.001f, h->max * 0.001f, h->count );
+}
+
+/*
+==================
+LT_Report
+==================
+*/
+static void LT_Report( void ) {
+	int		i, active, msec;
+	float	sec;
+
+	for ( i = 0, active = 0 ; i < lt.numClients ; i++ ) {
+		if ( lt.clients[i] && lt.clients[i]->state == LTS_ACTIVE ) {
+			active++;
+		}
+	}
+	msec = Sys_Milliseconds() - lt.startTime;
+	sec = msec > 0 ? msec * 0.001f : 1.0f;
+
+	Com_Printf( "loadtest %s: %i/%i players active after %.1f sec against %s\n",
+		lt.running ? "running" : "finished", active, lt.numClients, msec * 0.001f,
+		NET_AdrToStringwPort( lt.serverAddress ) );
+	if ( lt.serverFrame.count ) {
+		LT_PrintHistogram( "server frame:", &lt.serverFrame );
+	} else {
+		Com_Printf( "%-18s not available, the server runs in another process\n", "server frame:" );
+	}
+	LT_PrintHistogram( "snapshot latency:", &lt.latency );
+	Com_Printf( "%-18s in %.1f kB/s (%.1f per player), out %.1f kB/s (%.1f per player)\n", "bandwidth:",
+		lt.bytesIn / 1024.0f / sec, active ? lt.bytesIn / 1024.0f / sec / active : 0.0f,
+		lt.bytesOut / 1024.0f / sec, active ? lt.bytesOut / 1024.0f / sec / active : 0.0f );
+	Com_Printf( "%-18s %i received, %i uncompressed, %i undecodable deltas\n", "snapshots:",
+		lt.snapshots, lt.fullSnapshots, lt.droppedSnapshots );
+}
+
+/*
+=============================================================================
+
+TRANSPORT
+
+=============================================================================
+*/
+
+/*
+==================
+LT_SendPacket
+==================
+*/
+static void LT_SendPacket( ltClient_t *c, int length, const void *data ) {
+	NET_SendPrivatePacket( c->socket, length, data, lt.serverAddress );
+	lt.bytesOut += length;
+	c->lastSendTime = Sys_Milliseconds();
+}
+
+/*
+==================
+LT_OutOfBandData
+
+Same framing as NET_OutOfBandData, sent from the player's own port
+==================
+*/
+static void QDECL LT_OutOfBandData( ltClient_t *c, const char *format, ... ) {
+	va_list		argptr;
+	byte		string[MAX_MSGLEN*2];
+	int			len;
+	msg_t		mbuf;
+
+	string[0] = 0xff;
+	string[1] = 0xff;
+	string[2] = 0xff;
+	string[3] = 0xff;
+
+	va_start( argptr, format );
+	Q_vsnprintf( (char *)string + 4, MAX_MSGLEN - 4, format, argptr );
+	va_end( argptr );
+	len = strlen( (char *)string + 4 ) + 4;
+
+	// only connect packets are compressed
+	if ( !Q_strncmp( "connect", (char *)string + 4, 7 ) ) {
+		mbuf.data = string;
+		mbuf.cursize = len;
+		Huff_Compress( &mbuf, 12 );
+		len = mbuf.cursize;
+	}
+
+	LT_SendPacket( c, len, string );
+}
+
+/*
+==================
+LT_Transmit
+
+Netchan_Transmit for a private socket, writing the player's own qport.
+Only small unfragmented messages are ever sent by the load test.
+==================
+*/
+static void LT_Transmit( ltClient_t *c, msg_t *msg ) {
+	msg_t	send;
+	byte	send_buf[LT_MAX_PACKETLEN];
+
+	MSG_WriteByte( msg, clc_EOF );
+	if ( msg->cursize + 10 > sizeof( send_buf ) ) {
+		Com_Printf( "lt%i: oversize packet dropped\n", c->index );
+		return;
+	}
+
+	MSG_InitOOB( &send, send_buf, sizeof( send_buf ) );
+	MSG_WriteLong( &send, c->netchan.outgoingSequence );
+	MSG_WriteShort( &send, c->qport );
+	MSG_WriteLong( &send, NETCHAN_GENCHECKSUM( c->netchan.challenge, c->netchan.outgoingSequence ) );
+	c->netchan.outgoingSequence++;
+	MSG_WriteData( &send, msg->data, msg->cursize );
+
+	LT_SendPacket( c, send.cursize, send.data );
+}
+
+/*
+=============================================================================
+
+PLAYERS
+
+=============================================================================
+*/
+
+/*
+==================
+LT_AddReliableCommand
+==================
+*/
+static void LT_AddReliableCommand( ltClient_t *c, const char *cmd ) {
+	if ( c->reliableSequence - c->reliableAcknowledge >= MAX_RELIABLE_COMMANDS ) {
+		return;
+	}
+	c->reliableSequence++;
+	Q_strncpyz( c->reliableCommands[c->reliableSequence & ( MAX_RELIABLE_COMMANDS - 1 )], cmd,
+		sizeof( c->reliableCommands[0] ) );
+}
+
+/*
+==================
+LT_ScriptedCommand
+
+Runs forward while turning, strafes back and forth, jumps every few
+seconds and fires half of the time.  Players are phase shifted so they
+spread over the map instead of moving in lockstep.
+==================
+*/
+static void LT_ScriptedCommand( ltClient_t *c, usercmd_t *cmd, int serverTime ) {
+	int		t;
+
+	Com_Memset( cmd, 0, sizeof( *cmd ) );
+	t = serverTime + c->index * 397;
+
+	cmd->serverTime = serverTime;
+	cmd->angles[YAW] = ANGLE2SHORT( ( t % 4000 ) * ( 360.0f / 4000 ) );
+	cmd->angles[PITCH] = ANGLE2SHORT( 10 );
+	cmd->forwardmove = 127;
+	cmd->rightmove = ( t / 1500 ) & 1 ? 127 : -127;
+	if ( t % 3000 < 100 ) {
+		cmd->upmove = 127;
+	}
+	if ( ( t / 1000 ) & 1 ) {
+		cmd->buttons |= BUTTON_ATTACK;
+	}
+	cmd->weapon = c->snap.ps.weapon;
+}
+
+/*
+==================
+LT_WritePacket
+
+Mirrors CL_WritePacket with one usercmd per packet
+==================
+*/
+static void LT_WritePacket( ltClient_t *c ) {
+	msg_t		buf;
+	byte		data[MAX_MSGLEN];
+	usercmd_t	nullcmd, cmd;
+	int			i, key, now, serverTime;
+	ltOutPacket_t	*out;
+
+	MSG_Init( &buf, data, sizeof( data ) );
+	MSG_Bitstream( &buf );
+
+	MSG_WriteLong( &buf, c->serverId );
+	MSG_WriteLong( &buf, c->serverMessageSequence );
+	MSG_WriteLong( &buf, c->serverCommandSequence );
+
+	for ( i = c->reliableAcknowledge + 1 ; i <= c->reliableSequence ; i++ ) {
+		MSG_WriteByte( &buf, clc_clientCommand );
+		MSG_WriteLong( &buf, i );
+		MSG_WriteString( &buf, c->reliableCommands[i & ( MAX_RELIABLE_COMMANDS - 1 )] );
+	}
+
+	out = &c->outPackets[c->netchan.outgoingSequence & PACKET_MASK];
+	out->realtime = Sys_Microseconds();
+	out->serverTime = 0;
+
+	if ( c->state >= LTS_PRIMED ) {
+		// run the clock forward from the last snapshot like the client would
+		now = Sys_Milliseconds();
+		serverTime = c->snap.serverTime + ( now - c->snapTime );
+		if ( serverTime <= c->cmdServerTime ) {
+			serverTime = c->cmdServerTime + 1;
+		}
+		c->cmdServerTime = serverTime;
+		LT_ScriptedCommand( c, &cmd, serverTime );
+
+		if ( !c->snap.valid || c->serverMessageSequence != c->snap.messageNum ) {
+			MSG_WriteByte( &buf, clc_moveNoDelta );
+		} else {
+			MSG_WriteByte( &buf, clc_move );
+		}
+		MSG_WriteByte( &buf, 1 );
+
+		key = c->checksumFeed;
+		key ^= c->serverMessageSequence;
+		key ^= MSG_HashKey( c->serverCommands[c->serverCommandSequence & ( MAX_RELIABLE_COMMANDS - 1 )], 32 );
+
+		Com_Memset( &nullcmd, 0, sizeof( nullcmd ) );
+		MSG_WriteDeltaUsercmdKey( &buf, key, &nullcmd, &cmd );
+		out->serverTime = serverTime;
+	}
+
+	LT_Transmit( c, &buf );
+}
+
+/*
+==================
+LT_FreeClient
+==================
+*/
+static void LT_FreeClient( ltClient_t *c ) {
+	lt.clients[c->index] = NULL;
+	NET_ClosePrivateSocket( c->socket );
+	free( c );
+}
+
+/*
+==================
+LT_DropClient
+
+Disconnects politely when the server still knows about the player
+==================
+*/
+static void LT_DropClient( ltClient_t *c, const char *reason ) {
+	int		i;
+
+	if ( reason ) {
+		Com_Printf( "lt%i: %s\n", c->index, reason );
+	}
+	if ( c->state >= LTS_CONNECTED ) {
+		LT_AddReliableCommand( c, "disconnect" );
+		for ( i = 0 ; i < 3 ; i++ ) {
+			LT_WritePacket( c );
+		}
+	}
+	LT_FreeClient( c );
+}
+
+/*
+==================
+LT_SystemInfoChanged
+==================
+*/
+static void LT_SystemInfoChanged( ltClient_t *c, const char *systemInfo ) {
+	c->serverId = atoi( Info_ValueForKey( systemInfo, "sv_serverid" ) );
+	if ( c->index == 0 && atoi( Info_ValueForKey( systemInfo, "sv_pure" ) ) ) {
+		Com_Printf( "loadtest: the server is pure, set sv_pure 0 there or players will be dropped\n" );
+	}
+}
+
+/*
+==================
+LT_ServerCommand
+
+Handles the few server commands that change connection state
+==================
+*/
+static void LT_ServerCommand( ltClient_t *c, const char *s ) {
+	const char	*cmd;
+	int			index;
+
+	Cmd_TokenizeString( s );
+	cmd = Cmd_Argv( 0 );
+
+	if ( !strcmp( cmd, "disconnect" ) ) {
+		Com_Printf( "lt%i: disconnected: %s\n", c->index, Cmd_Argv( 1 ) );
+		c->state = LTS_FREE;		// freed by LT_Frame, the server has dropped us
+		return;
+	}
+
+	if ( !strcmp( cmd, "bcs0" ) ) {
+		Com_sprintf( c->bigConfigString, sizeof( c->bigConfigString ), "cs %s \"%s", Cmd_Argv( 1 ), Cmd_Argv( 2 ) );
+		return;
+	}
+	if ( !strcmp( cmd, "bcs1" ) || !strcmp( cmd, "bcs2" ) ) {
+		Q_strcat( c->bigConfigString, sizeof( c->bigConfigString ), Cmd_Argv( 2 ) );
+		if ( cmd[3] == '2' ) {
+			Q_strcat( c->bigConfigString, sizeof( c->bigConfigString ), "\"" );
+			LT_ServerCommand( c, c->bigConfigString );
+		}
+		return;
+	}
+
+	if ( !strcmp( cmd, "cs" ) ) {
+		index = atoi( Cmd_Argv( 1 ) );
+		if ( index == CS_SYSTEMINFO ) {
+			LT_SystemInfoChanged( c, Cmd_ArgsFrom( 2 ) );
+		}
+	}
+}
+
+/*
+==================
+LT_ParseCommandString
+==================
+*/
+static void LT_ParseCommandString( ltClient_t *c, msg_t *msg ) {
+	char	*s;
+	int		seq;
+	int		index;
+
+	seq = MSG_ReadLong( msg );
+	s = MSG_ReadString( msg );
+
+	if ( c->serverCommandSequence >= seq ) {
+		return;
+	}
+	c->serverCommandSequence = seq;
+
+	index = seq & ( MAX_RELIABLE_COMMANDS - 1 );
+	Q_strncpyz( c->serverCommands[index], s, sizeof( c->serverCommands[index] ) );
+
+	LT_ServerCommand( c, c->serverCommands[index] );
+}
+
+/*
+==================
+LT_ParseGamestate
+==================
+*/
+static qboolean LT_ParseGamestate( ltClient_t *c, msg_t *msg ) {
+	entityState_t	nullstate;
+	int				cmd, i;
+	char			*s;
+
+	c->serverCommandSequence = MSG_ReadLong( msg );
+
+	Com_Memset( c->baselines, 0, sizeof( c->baselines ) );
+	Com_Memset( c->snapshots, 0, sizeof( c->snapshots ) );
+	Com_Memset( &c->snap, 0, sizeof( c->snap ) );
+	c->parseEntitiesNum = 0;
+
+	while ( 1 ) {
+		cmd = MSG_ReadByte( msg );
+
+		if ( cmd == svc_EOF ) {
+			break;
+		}
+
+		if ( cmd == svc_configstring ) {
+			i = MSG_ReadShort( msg );
+			if ( i < 0 || i >= MAX_CONFIGSTRINGS ) {
+				return qfalse;
+			}
+			s = MSG_ReadBigString( msg );
+			if ( i == CS_SYSTEMINFO ) {
+				LT_SystemInfoChanged( c, s );
+			}
+		} else if ( cmd == svc_baseline ) {
+			i = MSG_ReadBits( msg, GENTITYNUM_BITS );
+			Com_Memset( &nullstate, 0, sizeof( nullstate ) );
+			MSG_ReadDeltaEntity( msg, &nullstate, &c->baselines[i], i );
+		} else {
+			return qfalse;
+		}
+	}
+
+	c->clientNum = MSG_ReadLong( msg );
+	c->checksumFeed = MSG_ReadLong( msg );
+	c->state = LTS_PRIMED;
+
+	return qtrue;
+}
+
+/*
+==================
+LT_ParsePacketEntities
+==================
+*/
+static void LT_ParsePacketEntities( ltClient_t *c, msg_t *msg, ltSnapshot_t *oldframe, ltSnapshot_t *newframe ) {
+	newframe->parseEntitiesNum = c->parseEntitiesNum;
+	newframe->numEntities = MSG_ReadPacketEntities( msg, c->parseEntities, LT_PARSE_ENTITIES - 1,
+		&c->parseEntitiesNum, oldframe ? oldframe->parseEntitiesNum : 0, oldframe ? oldframe->numEntities : 0,
+		c->baselines, qfalse );
+
+	// a truncated message is dropped by LT_ParseServerMessage
+	if ( newframe->numEntities < 0 ) {
+		newframe->numEntities = 0;
+		newframe->valid = qfalse;
+	}
+}
+
+/*
+==================
+LT_ParseSnapshot
+
+Same validity rules as CL_ParseSnapshot.  The latency sample is the time
+from sending the newest usercmd the server has run to receiving the
+snapshot that shows it, which is what the client reports as ping.
+==================
+*/
+static void LT_ParseSnapshot( ltClient_t *c, msg_t *msg ) {
+	ltSnapshot_t	newSnap, *old;
+	byte			areamask[MAX_MAP_AREA_BYTES];
+	int				deltaNum, oldMessageNum, len, i, packetNum;
+	int64_t			now;
+
+	Com_Memset( &newSnap, 0, sizeof( newSnap ) );
+	newSnap.serverTime = MSG_ReadLong( msg );
+	newSnap.messageNum = c->serverMessageSequence;
+
+	deltaNum = MSG_ReadByte( msg );
+	newSnap.deltaNum = deltaNum ? newSnap.messageNum - deltaNum : -1;
+	MSG_ReadByte( msg );	// snapFlags
+
+	old = NULL;
+	if ( newSnap.deltaNum <= 0 ) {
+		newSnap.valid = qtrue;
+		lt.fullSnapshots++;
+	} else {
+		old = &c->snapshots[newSnap.deltaNum & PACKET_MASK];
+		if ( old->valid && old->messageNum == newSnap.deltaNum
+			&& c->parseEntitiesNum - old->parseEntitiesNum <= LT_PARSE_ENTITIES - MAX_SNAPSHOT_ENTITIES ) {
+			newSnap.valid = qtrue;
+		}
+	}
+
+	len = MSG_ReadByte( msg );
+	if ( len > MAX_MAP_AREA_BYTES ) {
+		msg->readcount = msg->cursize + 1;	// abandon the message
+		return;
+	}
+	MSG_ReadData( msg, areamask, len );
+
+	MSG_ReadDeltaPlayerstate( msg, old ? &old->ps : NULL, &newSnap.ps );
+	LT_ParsePacketEntities( c, msg, old, &newSnap );
+
+	if ( !newSnap.valid ) {
+		lt.droppedSnapshots++;
+		return;
+	}
+
+	oldMessageNum = c->snap.messageNum + 1;
+	if ( newSnap.messageNum - oldMessageNum >= PACKET_BACKUP ) {
+		oldMessageNum = newSnap.messageNum - ( PACKET_BACKUP - 1 );
+	}
+	for ( ; oldMessageNum < newSnap.messageNum ; oldMessageNum++ ) {
+		c->snapshots[oldMessageNum & PACKET_MASK].valid = qfalse;
+	}
+
+	c->snap = newSnap;
+	c->snapshots[newSnap.messageNum & PACKET_MASK] = newSnap;
+	c->snapTime = Sys_Milliseconds();
+	c->state = LTS_ACTIVE;
+	lt.snapshots++;
+
+	now = Sys_Microseconds();
+	for ( i = 0 ; i < PACKET_BACKUP ; i++ ) {
+		packetNum = ( c->netchan.outgoingSequence - 1 - i ) & PACKET_MASK;
+		if ( c->outPackets[packetNum].serverTime && newSnap.ps.commandTime >= c->outPackets[packetNum].serverTime ) {
+			LT_AddSample( &lt.latency, now - c->outPackets[packetNum].realtime );
+			c->outPackets[packetNum].serverTime = 0;	// count each command once
+			break;
+		}
+	}
+}
+
+/*
+==================
+LT_ParseServerMessage
+==================
+*/
+static void LT_ParseServerMessage( ltClient_t *c, msg_t *msg ) {
+	int		cmd;
+
+	MSG_Bitstream( msg );
+
+	c->reliableAcknowledge = MSG_ReadLong( msg );
+	if ( c->reliableAcknowledge < c->reliableSequence - MAX_RELIABLE_COMMANDS ) {
+		c->reliableAcknowledge = c->reliableSequence;
+	}
+
+	while ( c->state != LTS_FREE ) {
+		if ( msg->readcount > msg->cursize ) {
+			Com_DPrintf( "lt%i: read past end of server message\n", c->index );
+			break;
+		}
+
+		cmd = MSG_ReadByte( msg );
+		if ( cmd == svc_EOF ) {
+			break;
+		}
+
+		switch ( cmd ) {
+		case svc_nop:
+			break;
+		case svc_serverCommand:
+			LT_ParseCommandString( c, msg );
+			break;
+		case svc_gamestate:
+			if ( !LT_ParseGamestate( c, msg ) ) {
+				Com_Printf( "lt%i: bad gamestate\n", c->index );
+				return;
+			}
+			break;
+		case svc_snapshot:
+			LT_ParseSnapshot( c, msg );
+			break;
+		default:
+			// downloads and voip are never requested
+			Com_DPrintf( "lt%i: unexpected server message %i\n", c->index, cmd );
+			return;
+		}
+	}
+}
+
+/*
+==================
+LT_ConnectionlessPacket
+==================
+*/
+static void LT_ConnectionlessPacket( ltClient_t *c, msg_t *msg ) {
+	char	*s;
+
+	MSG_BeginReadingOOB( msg );
+	MSG_ReadLong( msg );	// skip the -1
+
+	s = MSG_ReadStringLine( msg );
+	Cmd_TokenizeString( s );
+	s = Cmd_Argv( 0 );
+
+	if ( !Q_stricmp( s, "challengeResponse" ) ) {
+		if ( c->state != LTS_CHALLENGING || atoi( Cmd_Argv( 2 ) ) != c->challenge ) {
+			return;
+		}
+		c->challenge = atoi( Cmd_Argv( 1 ) );
+		c->state = LTS_CONNECTING;
+		c->lastSendTime = -99999;
+		return;
+	}
+
+	if ( !Q_stricmp( s, "connectResponse" ) ) {
+		if ( c->state != LTS_CONNECTING || atoi( Cmd_Argv( 1 ) ) != c->challenge ) {
+			return;
+		}
+		Netchan_Setup( NS_CLIENT, &c->netchan, lt.serverAddress, c->qport, c->challenge, qfalse );
+		c->state = LTS_CONNECTED;
+		c->lastSendTime = -99999;
+		return;
+	}
+
+	if ( !Q_stricmp( s, "print" ) && c->state < LTS_CONNECTED ) {
+		// refused, the reason is all the server sends back
+		s = MSG_ReadString( msg );
+		Com_Printf( "lt%i: %s", c->index, s );
+		c->state = LTS_FREE;
+	}
+}
+
+/*
+==================
+LT_ReadPackets
+==================
+*/
+static void LT_ReadPackets( ltClient_t *c ) {
+	byte		bufData[MAX_MSGLEN + 1];
+	netadr_t	from;
+	msg_t		msg;
+
+	while ( c->state != LTS_FREE ) {
+		MSG_Init( &msg, bufData, sizeof( bufData ) );
+		if ( !NET_GetPrivatePacket( c->socket, &from, &msg ) ) {
+			break;
+		}
+		lt.bytesIn += msg.cursize;
+
+		if ( !NET_CompareAdr( from, lt.serverAddress ) || msg.cursize < 4 ) {
+			continue;
+		}
+		c->lastPacketTime = Sys_Milliseconds();
+
+		if ( *(int *)msg.data == -1 ) {
+			LT_ConnectionlessPacket( c, &msg );
+			continue;
+		}
+
+		if ( c->state < LTS_CONNECTED || !Netchan_Process( &c->netchan, &msg ) ) {
+			continue;
+		}
+
+		c->serverMessageSequence = LittleLong( *(int *)msg.data );
+		LT_ParseServerMessage( c, &msg );
+	}
+}
+
+/*
+==================
+LT_SendPackets
+
+Resends the handshake until it is answered, then sends movement at
+lt_maxpackets per second
+==================
+*/
+static void LT_SendPackets( ltClient_t *c ) {
+	char	userinfo[MAX_INFO_STRING];
+	int		now;
+
+	now = Sys_Milliseconds();
+
+	switch ( c->state ) {
+	case LTS_CHALLENGING:
+		if ( now - c->lastSendTime >= LT_RESEND_MSEC ) {
+			LT_OutOfBandData( c, "getchallenge %d %s", c->challenge, com_gamename->string );
+		}
+		break;
+
+	case LTS_CONNECTING:
+		if ( now - c->lastSendTime >= LT_RESEND_MSEC ) {
+			userinfo[0] = '\0';
+			Info_SetValueForKey( userinfo, "name", va( "lt%i", c->index ) );
+			Info_SetValueForKey( userinfo, "rate", "25000" );
+			Info_SetValueForKey( userinfo, "snaps", "40" );
+			Info_SetValueForKey( userinfo, "model", "sarge" );
+			Info_SetValueForKey( userinfo, "protocol", va( "%i", com_protocol->integer ) );
+			Info_SetValueForKey( userinfo, "qport", va( "%i", c->qport ) );
+			Info_SetValueForKey( userinfo, "challenge", va( "%i", c->challenge ) );
+			LT_OutOfBandData( c, "connect \"%s\"", userinfo );
+		}
+		break;
+
+	case LTS_CONNECTED:
+		if ( now - c->lastSendTime >= LT_RESEND_MSEC / 10 ) {
+			LT_WritePacket( c );
+		}
+		break;
+
+	case LTS_PRIMED:
+	case LTS_ACTIVE:
+		if ( now - c->lastSendTime >= 1000 / lt_maxpackets->integer ) {
+			LT_WritePacket( c );
+		}
+		break;
+
+	default:
+		break;
+	}
+}
+
+/*
+==================
+LT_StartClient
+==================
+*/
+static void LT_StartClient( int index ) {
+	ltClient_t	*c;
+	int			socket;
+
+	socket = NET_OpenPrivateSocket();
+	if ( socket < 0 ) {
+		Com_Printf( "lt%i: couldn't open a socket\n", index );
+		return;
+	}
+
+	c = calloc( 1, sizeof( *c ) );
+	if ( !c ) {
+		NET_ClosePrivateSocket( socket );
+		Com_Printf( "lt%i: out of memory\n", index );
+		return;
+	}
+
+	c->index = index;
+	c->socket = socket;
+	c->state = LTS_CHALLENGING;
+	c->lastSendTime = -99999;
+	c->lastPacketTime = Sys_Milliseconds();
+
+	Com_RandomBytes( (byte *)&c->challenge, sizeof( c->challenge ) );
+	Com_RandomBytes( (byte *)&c->qport, sizeof( c->qport ) );
+	c->qport &= 0xffff;
+
+	lt.clients[index] = c;
+}
+
+/*
+==================
+LT_Stop
+==================
+*/
+static void LT_Stop( void ) {
+	int		i;
+
+	if ( lt.running ) {
+		lt.running = qfalse;
+		LT_Report();
+	}
+	for ( i = 0 ; i < lt.numClients ; i++ ) {
+		if ( lt.clients[i] ) {
+			LT_DropClient( lt.clients[i], NULL );
+		}
+	}
+}
+
+/*
+==================
+LT_Loadtest_f
+
+loadtest <players> [seconds] [address]
+loadtest stop
+loadtest
+==================
+*/
+static void LT_Loadtest_f( void ) {
+	netadr_t	adr;
+	int			count, seconds, i;
+
+	if ( Cmd_Argc() < 2 ) {
+		if ( !lt.numClients ) {
+			Com_Printf( "usage: loadtest <players> [seconds] [address]\n"
+				"       loadtest stop\n" );
+			return;
+		}
+		LT_Report();
+		return;
+	}
+
+	if ( !Q_stricmp( Cmd_Argv( 1 ), "stop" ) ) {
+		LT_Stop();
+		return;
+	}
+
+	count = atoi( Cmd_Argv( 1 ) );
+	seconds = Cmd_Argc() > 2 ? atoi( Cmd_Argv( 2 ) ) : 0;
+
+	if ( Cmd_Argc() > 3 ) {
+		if ( !NET_StringToAdr( Cmd_Argv( 3 ), &adr, NA_IP ) ) {
+			Com_Printf( "Bad server address %s\n", Cmd_Argv( 3 ) );
+			return;
+		}
+	} else {
+		NET_StringToAdr( va( "127.0.0.1:%i", Cvar_VariableIntegerValue( "net_port" ) ), &adr, NA_IP );
+	}
+	if ( !adr.port ) {
+		adr.port = BigShort( PORT_SERVER );
+	}
+
+	// never point simulated players at somebody else's server
+	if ( adr.type != NA_IP || adr.ip[0] != 127 ) {
+		Com_Printf( "loadtest only connects to servers on this machine (127.x.x.x)\n" );
+		return;
+	}
+
+	if ( count < 1 || count > MAX_CLIENTS ) {
+		Com_Printf( "loadtest: players must be between 1 and %i\n", MAX_CLIENTS );
+		return;
+	}
+	if ( com_sv_running->integer && count > sv_maxclients->integer ) {
+		Com_Printf( "loadtest: only %i slots, raise sv_maxclients before the map is loaded\n", sv_maxclients->integer );
+	}
+
+	LT_Stop();
+	Com_Memset( &lt, 0, sizeof( lt ) );
+	lt.latency.scale = 250;
+	lt.serverFrame.scale = 25;
+
+	lt.running = qtrue;
+	lt.serverAddress = adr;
+	lt.numClients = count;
+	lt.startTime = Sys_Milliseconds();
+	lt.endTime = seconds > 0 ? lt.startTime + seconds * 1000 : 0;
+	lt.lastServerTime = svs.time;
+
+	for ( i = 0 ; i < count ; i++ ) {
+		LT_StartClient( i );
+	}
+
+	Com_Printf( "loadtest: %i players against %s\n", count, NET_AdrToStringwPort( adr ) );
+}
+
+/*
+=============================================================================
+
+FRAME
+
+=============================================================================
+*/
+
+/*
+==================
+LT_Init
+==================
+*/
+void LT_Init( void ) {
+	lt_maxpackets = Cvar_Get( "lt_maxpackets", "30", CVAR_ARCHIVE );
+	Cvar_CheckRange( lt_maxpackets, 15, 125, qtrue );
+
+	Cmd_AddCommand( "loadtest", LT_Loadtest_f );
+}
+
+/*
+==================
+LT_FrameMsec
+
+The players are polled from the main loop, so keep it spinning often
+enough that receive times stay accurate while a test runs
+==================
+*/
+int LT_FrameMsec( int minMsec ) {
+	if ( lt.running && minMsec > 2 ) {
+		return 2;
+	}
+	return minMsec;
+}
+
+/*
+==================
+LT_Frame
+
+serverUsec is how long SV_Frame took this time around.  It is only kept
+when the server actually advanced, the rest are idle calls.
+==================
+*/
+void LT_Frame( int msec, int serverUsec ) {
+	ltClient_t	*c;
+	int			i, active;
+
+	if ( !lt.running ) {
+		return;
+	}
+
+	if ( com_sv_running->integer && svs.time != lt.lastServerTime ) {
+		lt.lastServerTime = svs.time;
+		LT_AddSample( &lt.serverFrame, serverUsec );
+	}
+
+	for ( i = 0, active = 0 ; i < lt.numClients ; i++ ) {
+		c = lt.clients[i];
+		if ( !c ) {
+			continue;
+		}
+
+		LT_ReadPackets( c );
+
+		if ( c->state == LTS_FREE ) {
+			LT_FreeClient( c );
+			continue;
+		}
+		if ( Sys_Milliseconds() - c->lastPacketTime > LT_TIMEOUT_MSEC ) {
+			LT_DropClient( c, "timed out" );
+			continue;
+		}
+
+		LT_SendPackets( c );
+		active++;
+	}
+
+	if ( !active || ( lt.endTime && Sys_Milliseconds() >= lt.endTime ) ) {
+		LT_Stop();
+	}
+}
@@ -55,6 +55,10 @@ int		Sys_Milliseconds (void) {
 	return 0;
 }
 
+int64_t	Sys_Microseconds (void) {
+	return 0;
+}
+
 FILE	*Sys_FOpen(const char *ospath, const char *mode) {
 	return fopen( ospath, mode );
 }
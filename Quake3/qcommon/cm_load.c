@@ -609,7 +609,8 @@ void CM_LoadMap( const char *name, qboolean clientload, int *checksum ) {
 	// load the file
 	//
 #ifndef BSPC
-	length = FS_ReadFile( name, &buf.v );
+	// only read from here on, a stored bsp is used straight from the pk3
+	length = FS_ReadFileMapped( name, (const void **)&buf.v );
 #else
 	length = LoadQuakeFile((quakefile_t *) name, &buf.v);
 #endif
@@ -647,6 +648,9 @@ void CM_LoadMap( const char *name, qboolean clientload, int *checksum ) {
 	CMod_LoadVisibility( &header.lumps[LUMP_VISIBILITY] );
 	CMod_LoadPatches( &header.lumps[LUMP_SURFACES], &header.lumps[LUMP_DRAWVERTS] );
 
+	// batched traces can't share the checkcounts in the brushes and patches
+	cm.batchChecks = Hunk_Alloc( MAX_TRACE_BATCH * ( cm.numBrushes + cm.numSurfaces ) * sizeof( *cm.batchChecks ), h_high );
+
 	// we are NOT freeing the file, because it is cached for the ref
 	FS_FreeFile (buf.v);
 
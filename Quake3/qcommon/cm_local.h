@@ -126,8 +126,13 @@ typedef struct {
 
 	int			floodvalid;
 	int			checkcount;					// incremented on each trace
+
+	int			*batchChecks;				// per slot brush and patch checkcounts for CM_TraceBatch
 } clipMap_t;
 
+// traces that CM_TraceBatch walks through the tree together
+#define	MAX_TRACE_BATCH		8
+
 
 // keep 1/8 unit away to keep the position valid before network snapping
 // and to avoid various numeric issues
@@ -164,6 +169,9 @@ typedef struct {
 	qboolean	isPoint;	// optimized case
 	trace_t		trace;		// returned from trace call
 	sphere_t	sphere;		// sphere for oriendted capsule collision
+	int			checkcount;	// to avoid testing a brush or patch twice
+	int			*brushChecks;	// NULL to use the checkcounts in the brushes and patches
+	int			*patchChecks;
 } traceWork_t;
 
 typedef struct leafList_s {
@@ -45,6 +45,9 @@ void		CM_TransformedBoxTrace( trace_t *results, const vec3_t start, const vec3_t
 						  vec3_t mins, vec3_t maxs,
 						  clipHandle_t model, int brushmask,
 						  const vec3_t origin, const vec3_t angles, int capsule );
+// traces the same box along many lines, results are the same as one CM_BoxTrace for each
+void		CM_TraceBatch( trace_t *results, const vec3_t *starts, const vec3_t *ends, int count,
+						  vec3_t mins, vec3_t maxs, clipHandle_t model, int brushmask, int capsule );
 
 byte		*CM_ClusterPVS (int cluster);
 
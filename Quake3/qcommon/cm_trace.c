@@ -21,6 +21,14 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 */
 #include "cm_local.h"
 
+#if defined( __SSE__ ) || defined( _M_X64 )
+#include <xmmintrin.h>
+#define CM_SIMD_SSE
+#elif defined( __ARM_NEON ) || defined( __ARM_NEON__ )
+#include <arm_neon.h>
+#define CM_SIMD_NEON
+#endif
+
 // always use bbox vs. bbox collision and never capsule vs. bbox or vice versa
 //#define ALWAYS_BBOX_VS_BBOX
 // always use capsule vs. capsule collision and never capsule vs. bbox or vice versa
@@ -474,17 +482,113 @@ void CM_TraceThroughPatch( traceWork_t *tw, cPatch_t *patch ) {
 	}
 }
 
+/*
+================
+CM_BrushSideDistances
+
+Finds the distances of the trace start and end from up to four brush sides,
+with the planes moved out for the box size.  Four sides at a time are done
+in vector registers, every brush is split the same way whether the trace is
+batched or not, so both always round alike.
+================
+*/
+static ID_INLINE void CM_BrushSideDistances( const traceWork_t *tw, const cbrushside_t *sides, int numSides, float *d1, float *d2 ) {
+	const cplane_t	*plane;
+	float		dist;
+	int			i;
+
+#if defined( CM_SIMD_SSE )
+	if ( numSides == 4 ) {
+		__m128	nx, ny, nz, pd, neg, ox, oy, oz;
+		const __m128 zero = _mm_setzero_ps();
+
+		// normal and dist are adjacent in cplane_t
+		nx = _mm_loadu_ps( sides[0].plane->normal );
+		ny = _mm_loadu_ps( sides[1].plane->normal );
+		nz = _mm_loadu_ps( sides[2].plane->normal );
+		pd = _mm_loadu_ps( sides[3].plane->normal );
+		_MM_TRANSPOSE4_PS( nx, ny, nz, pd );
+
+		// pick the box corner the same way plane->signbits does
+		neg = _mm_cmplt_ps( nx, zero );
+		ox = _mm_or_ps( _mm_and_ps( neg, _mm_set1_ps( tw->size[1][0] ) ), _mm_andnot_ps( neg, _mm_set1_ps( tw->size[0][0] ) ) );
+		neg = _mm_cmplt_ps( ny, zero );
+		oy = _mm_or_ps( _mm_and_ps( neg, _mm_set1_ps( tw->size[1][1] ) ), _mm_andnot_ps( neg, _mm_set1_ps( tw->size[0][1] ) ) );
+		neg = _mm_cmplt_ps( nz, zero );
+		oz = _mm_or_ps( _mm_and_ps( neg, _mm_set1_ps( tw->size[1][2] ) ), _mm_andnot_ps( neg, _mm_set1_ps( tw->size[0][2] ) ) );
+
+		pd = _mm_sub_ps( pd, _mm_add_ps( _mm_add_ps( _mm_mul_ps( ox, nx ), _mm_mul_ps( oy, ny ) ), _mm_mul_ps( oz, nz ) ) );
+
+		_mm_storeu_ps( d1, _mm_sub_ps( _mm_add_ps( _mm_add_ps(
+			_mm_mul_ps( _mm_set1_ps( tw->start[0] ), nx ),
+			_mm_mul_ps( _mm_set1_ps( tw->start[1] ), ny ) ),
+			_mm_mul_ps( _mm_set1_ps( tw->start[2] ), nz ) ), pd ) );
+		_mm_storeu_ps( d2, _mm_sub_ps( _mm_add_ps( _mm_add_ps(
+			_mm_mul_ps( _mm_set1_ps( tw->end[0] ), nx ),
+			_mm_mul_ps( _mm_set1_ps( tw->end[1] ), ny ) ),
+			_mm_mul_ps( _mm_set1_ps( tw->end[2] ), nz ) ), pd ) );
+		return;
+	}
+#elif defined( CM_SIMD_NEON )
+	if ( numSides == 4 ) {
+		float32x4_t	nx, ny, nz, pd, ox, oy, oz;
+		float32x4x2_t	t01, t23;
+		uint32x4_t	neg;
+		const float32x4_t zero = vdupq_n_f32( 0 );
+
+		// normal and dist are adjacent in cplane_t
+		t01 = vtrnq_f32( vld1q_f32( sides[0].plane->normal ), vld1q_f32( sides[1].plane->normal ) );
+		t23 = vtrnq_f32( vld1q_f32( sides[2].plane->normal ), vld1q_f32( sides[3].plane->normal ) );
+		nx = vcombine_f32( vget_low_f32( t01.val[0] ), vget_low_f32( t23.val[0] ) );
+		ny = vcombine_f32( vget_low_f32( t01.val[1] ), vget_low_f32( t23.val[1] ) );
+		nz = vcombine_f32( vget_high_f32( t01.val[0] ), vget_high_f32( t23.val[0] ) );
+		pd = vcombine_f32( vget_high_f32( t01.val[1] ), vget_high_f32( t23.val[1] ) );
+
+		// pick the box corner the same way plane->signbits does
+		neg = vcltq_f32( nx, zero );
+		ox = vbslq_f32( neg, vdupq_n_f32( tw->size[1][0] ), vdupq_n_f32( tw->size[0][0] ) );
+		neg = vcltq_f32( ny, zero );
+		oy = vbslq_f32( neg, vdupq_n_f32( tw->size[1][1] ), vdupq_n_f32( tw->size[0][1] ) );
+		neg = vcltq_f32( nz, zero );
+		oz = vbslq_f32( neg, vdupq_n_f32( tw->size[1][2] ), vdupq_n_f32( tw->size[0][2] ) );
+
+		pd = vsubq_f32( pd, vaddq_f32( vaddq_f32( vmulq_f32( ox, nx ), vmulq_f32( oy, ny ) ), vmulq_f32( oz, nz ) ) );
+
+		vst1q_f32( d1, vsubq_f32( vaddq_f32( vaddq_f32(
+			vmulq_f32( vdupq_n_f32( tw->start[0] ), nx ),
+			vmulq_f32( vdupq_n_f32( tw->start[1] ), ny ) ),
+			vmulq_f32( vdupq_n_f32( tw->start[2] ), nz ) ), pd ) );
+		vst1q_f32( d2, vsubq_f32( vaddq_f32( vaddq_f32(
+			vmulq_f32( vdupq_n_f32( tw->end[0] ), nx ),
+			vmulq_f32( vdupq_n_f32( tw->end[1] ), ny ) ),
+			vmulq_f32( vdupq_n_f32( tw->end[2] ), nz ) ), pd ) );
+		return;
+	}
+#endif
+
+	for ( i = 0 ; i < numSides ; i++ ) {
+		plane = sides[i].plane;
+
+		// adjust the plane distance appropriately for mins/maxs
+		dist = plane->dist - DotProduct( tw->offsets[ plane->signbits ], plane->normal );
+
+		d1[i] = DotProduct( tw->start, plane->normal ) - dist;
+		d2[i] = DotProduct( tw->end, plane->normal ) - dist;
+	}
+}
+
 /*
 ================
 CM_TraceThroughBrush
 ================
 */
 void CM_TraceThroughBrush( traceWork_t *tw, cbrush_t *brush ) {
-	int			i;
+	int			i, j, n;
 	cplane_t	*plane, *clipplane;
 	float		dist;
 	float		enterFrac, leaveFrac;
 	float		d1, d2;
+	float		dists[2][4];
 	qboolean	getout, startout;
 	float		f;
 	cbrushside_t	*side, *leadside;
@@ -584,11 +688,14 @@ void CM_TraceThroughBrush( traceWork_t *tw, cbrush_t *brush ) {
 			side = brush->sides + i;
 			plane = side->plane;
 
-			// adjust the plane distance appropriately for mins/maxs
-			dist = plane->dist - DotProduct( tw->offsets[ plane->signbits ], plane->normal );
-
-			d1 = DotProduct( tw->start, plane->normal ) - dist;
-			d2 = DotProduct( tw->end, plane->normal ) - dist;
+			// the distances are found four sides at a time
+			j = i & 3;
+			if ( !j ) {
+				n = brush->numsides - i;
+				CM_BrushSideDistances( tw, side, n > 4 ? 4 : n, dists[0], dists[1] );
+			}
+			d1 = dists[0][j];
+			d2 = dists[1][j];
 
 			if (d2 > 0) {
 				getout = qtrue;	// endpoint is not in solid
@@ -669,6 +776,7 @@ CM_TraceThroughLeaf
 void CM_TraceThroughLeaf( traceWork_t *tw, cLeaf_t *leaf ) {
 	int			k;
 	int			brushnum;
+	int			*check;
 	cbrush_t	*b;
 	cPatch_t	*patch;
 
@@ -677,10 +785,11 @@ void CM_TraceThroughLeaf( traceWork_t *tw, cLeaf_t *leaf ) {
 		brushnum = cm.leafbrushes[leaf->firstLeafBrush+k];
 
 		b = &cm.brushes[brushnum];
-		if ( b->checkcount == cm.checkcount ) {
+		check = tw->brushChecks ? &tw->brushChecks[brushnum] : &b->checkcount;
+		if ( *check == tw->checkcount ) {
 			continue;	// already checked this brush in another leaf
 		}
-		b->checkcount = cm.checkcount;
+		*check = tw->checkcount;
 
 		if ( !(b->contents & tw->contents) ) {
 			continue;
@@ -708,10 +817,11 @@ void CM_TraceThroughLeaf( traceWork_t *tw, cLeaf_t *leaf ) {
 			if ( !patch ) {
 				continue;
 			}
-			if ( patch->checkcount == cm.checkcount ) {
+			check = tw->patchChecks ? &tw->patchChecks[ cm.leafsurfaces[ leaf->firstLeafSurface + k ] ] : &patch->checkcount;
+			if ( *check == tw->checkcount ) {
 				continue;	// already checked this patch in another leaf
 			}
-			patch->checkcount = cm.checkcount;
+			*check = tw->checkcount;
 
 			if ( !(patch->contents & tw->contents) ) {
 				continue;
@@ -1137,131 +1247,313 @@ void CM_TraceThroughTree( traceWork_t *tw, int num, float p1f, float p2f, vec3_t
 }
 
 
-//======================================================================
-
+typedef struct {
+	traceWork_t	*tw;
+	float		p1f, p2f;
+	vec3_t		p1, p2;
+} traceSegment_t;
 
 /*
 ==================
-CM_Trace
+CM_TraceThroughTreeBatch
+
+Walks several traces of the same size down the tree together for as long as
+they stay on the same side of the nodes.  A trace that crosses a node goes on
+by itself, so every trace still visits its leafs in the same order as it
+would in CM_TraceThroughTree and gets the same result.
 ==================
 */
-void CM_Trace( trace_t *results, const vec3_t start, const vec3_t end, vec3_t mins, vec3_t maxs,
-						  clipHandle_t model, const vec3_t origin, int brushmask, int capsule, sphere_t *sphere ) {
-	int			i;
-	traceWork_t	tw;
-	vec3_t		offset;
-	cmodel_t	*cmod;
+static void CM_TraceThroughTreeBatch( int num, traceSegment_t *segs, int numSegs ) {
+	cNode_t		*node;
+	cplane_t	*plane;
+	float		t1, t2, offset;
+	int			i, numFront, numBack;
+	traceSegment_t	*seg;
+	traceSegment_t	front[MAX_TRACE_BATCH], back[MAX_TRACE_BATCH];
+	byte		sides[MAX_TRACE_BATCH];
+
+	while ( 1 ) {
+		// drop the traces that already hit something nearer
+		for ( i = numFront = 0 ; i < numSegs ; i++ ) {
+			if ( segs[i].tw->trace.fraction > segs[i].p1f ) {
+				if ( i != numFront ) {
+					segs[numFront] = segs[i];
+				}
+				numFront++;
+			}
+		}
+		numSegs = numFront;
 
-	cmod = CM_ClipHandleToModel( model );
+		if ( numSegs <= 1 ) {
+			if ( numSegs ) {
+				CM_TraceThroughTree( segs->tw, num, segs->p1f, segs->p2f, segs->p1, segs->p2 );
+			}
+			return;
+		}
 
-	cm.checkcount++;		// for multi-check avoidance
+		// if < 0, we are in a leaf node
+		if ( num < 0 ) {
+			for ( i = 0 ; i < numSegs ; i++ ) {
+				CM_TraceThroughLeaf( segs[i].tw, &cm.leafs[-1-num] );
+			}
+			return;
+		}
 
-	c_traces++;				// for statistics, may be zeroed
+		node = cm.nodes + num;
+		plane = node->plane;
 
-	// fill in a default trace
-	Com_Memset( &tw, 0, sizeof(tw) );
-	tw.trace.fraction = 1;	// assume it goes the entire distance until shown otherwise
-	VectorCopy(origin, tw.modelOrigin);
+		// adjust the plane distance appropriately for mins/maxs,
+		// all the traces in a batch are the same size
+		if ( plane->type < 3 ) {
+			offset = segs->tw->extents[plane->type];
+		} else if ( segs->tw->isPoint ) {
+			offset = 0;
+		} else {
+			// this is silly
+			offset = 2048;
+		}
 
-	if (!cm.numNodes) {
-		*results = tw.trace;
+		// see which sides we need to consider
+		numFront = numBack = 0;
+		for ( i = 0, seg = segs ; i < numSegs ; i++, seg++ ) {
+			if ( plane->type < 3 ) {
+				t1 = seg->p1[plane->type] - plane->dist;
+				t2 = seg->p2[plane->type] - plane->dist;
+			} else {
+				t1 = DotProduct (plane->normal, seg->p1) - plane->dist;
+				t2 = DotProduct (plane->normal, seg->p2) - plane->dist;
+			}
 
-		return;	// map not loaded, shouldn't happen
+			if ( t1 >= offset + 1 && t2 >= offset + 1 ) {
+				sides[i] = 0;
+				numFront++;
+			} else if ( t1 < -offset - 1 && t2 < -offset - 1 ) {
+				sides[i] = 1;
+				numBack++;
+			} else {
+				sides[i] = 2;
+			}
+		}
+
+		if ( numFront == numSegs ) {
+			num = node->children[0];
+			continue;
+		}
+		if ( numBack == numSegs ) {
+			num = node->children[1];
+			continue;
+		}
+		break;
 	}
 
-	// allow NULL to be passed in for 0,0,0
-	if ( !mins ) {
-		mins = vec3_origin;
+	// the group splits up here
+	numFront = numBack = 0;
+	for ( i = 0, seg = segs ; i < numSegs ; i++, seg++ ) {
+		if ( sides[i] == 0 ) {
+			front[numFront++] = *seg;
+		} else if ( sides[i] == 1 ) {
+			back[numBack++] = *seg;
+		} else {
+			CM_TraceThroughTree( seg->tw, num, seg->p1f, seg->p2f, seg->p1, seg->p2 );
+		}
 	}
-	if ( !maxs ) {
-		maxs = vec3_origin;
+
+	if ( numFront ) {
+		CM_TraceThroughTreeBatch( node->children[0], front, numFront );
+	}
+	if ( numBack ) {
+		CM_TraceThroughTreeBatch( node->children[1], back, numBack );
 	}
+}
+
+//======================================================================
+
+
+/*
+==================
+CM_SetupTrace
+
+Fills in everything about a trace but the result, mins and maxs can't be NULL
+==================
+*/
+static void CM_SetupTrace( traceWork_t *tw, const vec3_t start, const vec3_t end, vec3_t mins, vec3_t maxs,
+						  const vec3_t origin, int brushmask, int capsule, sphere_t *sphere ) {
+	int			i;
+	vec3_t		offset;
+
+	// fill in a default trace
+	Com_Memset( tw, 0, sizeof(*tw) );
+	tw->trace.fraction = 1;	// assume it goes the entire distance until shown otherwise
+	VectorCopy(origin, tw->modelOrigin);
 
 	// set basic parms
-	tw.contents = brushmask;
+	tw->contents = brushmask;
 
 	// adjust so that mins and maxs are always symetric, which
 	// avoids some complications with plane expanding of rotated
 	// bmodels
 	for ( i = 0 ; i < 3 ; i++ ) {
 		offset[i] = ( mins[i] + maxs[i] ) * 0.5;
-		tw.size[0][i] = mins[i] - offset[i];
-		tw.size[1][i] = maxs[i] - offset[i];
-		tw.start[i] = start[i] + offset[i];
-		tw.end[i] = end[i] + offset[i];
+		tw->size[0][i] = mins[i] - offset[i];
+		tw->size[1][i] = maxs[i] - offset[i];
+		tw->start[i] = start[i] + offset[i];
+		tw->end[i] = end[i] + offset[i];
 	}
 
 	// if a sphere is already specified
 	if ( sphere ) {
-		tw.sphere = *sphere;
+		tw->sphere = *sphere;
 	}
 	else {
-		tw.sphere.use = capsule;
-		tw.sphere.radius = ( tw.size[1][0] > tw.size[1][2] ) ? tw.size[1][2]: tw.size[1][0];
-		tw.sphere.halfheight = tw.size[1][2];
-		VectorSet( tw.sphere.offset, 0, 0, tw.size[1][2] - tw.sphere.radius );
+		tw->sphere.use = capsule;
+		tw->sphere.radius = ( tw->size[1][0] > tw->size[1][2] ) ? tw->size[1][2]: tw->size[1][0];
+		tw->sphere.halfheight = tw->size[1][2];
+		VectorSet( tw->sphere.offset, 0, 0, tw->size[1][2] - tw->sphere.radius );
 	}
 
-	tw.maxOffset = tw.size[1][0] + tw.size[1][1] + tw.size[1][2];
+	tw->maxOffset = tw->size[1][0] + tw->size[1][1] + tw->size[1][2];
 
-	// tw.offsets[signbits] = vector to appropriate corner from origin
-	tw.offsets[0][0] = tw.size[0][0];
-	tw.offsets[0][1] = tw.size[0][1];
-	tw.offsets[0][2] = tw.size[0][2];
+	// tw->offsets[signbits] = vector to appropriate corner from origin
+	tw->offsets[0][0] = tw->size[0][0];
+	tw->offsets[0][1] = tw->size[0][1];
+	tw->offsets[0][2] = tw->size[0][2];
 
-	tw.offsets[1][0] = tw.size[1][0];
-	tw.offsets[1][1] = tw.size[0][1];
-	tw.offsets[1][2] = tw.size[0][2];
+	tw->offsets[1][0] = tw->size[1][0];
+	tw->offsets[1][1] = tw->size[0][1];
+	tw->offsets[1][2] = tw->size[0][2];
 
-	tw.offsets[2][0] = tw.size[0][0];
-	tw.offsets[2][1] = tw.size[1][1];
-	tw.offsets[2][2] = tw.size[0][2];
+	tw->offsets[2][0] = tw->size[0][0];
+	tw->offsets[2][1] = tw->size[1][1];
+	tw->offsets[2][2] = tw->size[0][2];
 
-	tw.offsets[3][0] = tw.size[1][0];
-	tw.offsets[3][1] = tw.size[1][1];
-	tw.offsets[3][2] = tw.size[0][2];
+	tw->offsets[3][0] = tw->size[1][0];
+	tw->offsets[3][1] = tw->size[1][1];
+	tw->offsets[3][2] = tw->size[0][2];
 
-	tw.offsets[4][0] = tw.size[0][0];
-	tw.offsets[4][1] = tw.size[0][1];
-	tw.offsets[4][2] = tw.size[1][2];
+	tw->offsets[4][0] = tw->size[0][0];
+	tw->offsets[4][1] = tw->size[0][1];
+	tw->offsets[4][2] = tw->size[1][2];
 
-	tw.offsets[5][0] = tw.size[1][0];
-	tw.offsets[5][1] = tw.size[0][1];
-	tw.offsets[5][2] = tw.size[1][2];
+	tw->offsets[5][0] = tw->size[1][0];
+	tw->offsets[5][1] = tw->size[0][1];
+	tw->offsets[5][2] = tw->size[1][2];
 
-	tw.offsets[6][0] = tw.size[0][0];
-	tw.offsets[6][1] = tw.size[1][1];
-	tw.offsets[6][2] = tw.size[1][2];
+	tw->offsets[6][0] = tw->size[0][0];
+	tw->offsets[6][1] = tw->size[1][1];
+	tw->offsets[6][2] = tw->size[1][2];
 
-	tw.offsets[7][0] = tw.size[1][0];
-	tw.offsets[7][1] = tw.size[1][1];
-	tw.offsets[7][2] = tw.size[1][2];
+	tw->offsets[7][0] = tw->size[1][0];
+	tw->offsets[7][1] = tw->size[1][1];
+	tw->offsets[7][2] = tw->size[1][2];
 
 	//
 	// calculate bounds
 	//
-	if ( tw.sphere.use ) {
+	if ( tw->sphere.use ) {
 		for ( i = 0 ; i < 3 ; i++ ) {
-			if ( tw.start[i] < tw.end[i] ) {
-				tw.bounds[0][i] = tw.start[i] - fabs(tw.sphere.offset[i]) - tw.sphere.radius;
-				tw.bounds[1][i] = tw.end[i] + fabs(tw.sphere.offset[i]) + tw.sphere.radius;
+			if ( tw->start[i] < tw->end[i] ) {
+				tw->bounds[0][i] = tw->start[i] - fabs(tw->sphere.offset[i]) - tw->sphere.radius;
+				tw->bounds[1][i] = tw->end[i] + fabs(tw->sphere.offset[i]) + tw->sphere.radius;
 			} else {
-				tw.bounds[0][i] = tw.end[i] - fabs(tw.sphere.offset[i]) - tw.sphere.radius;
-				tw.bounds[1][i] = tw.start[i] + fabs(tw.sphere.offset[i]) + tw.sphere.radius;
+				tw->bounds[0][i] = tw->end[i] - fabs(tw->sphere.offset[i]) - tw->sphere.radius;
+				tw->bounds[1][i] = tw->start[i] + fabs(tw->sphere.offset[i]) + tw->sphere.radius;
 			}
 		}
 	}
 	else {
 		for ( i = 0 ; i < 3 ; i++ ) {
-			if ( tw.start[i] < tw.end[i] ) {
-				tw.bounds[0][i] = tw.start[i] + tw.size[0][i];
-				tw.bounds[1][i] = tw.end[i] + tw.size[1][i];
+			if ( tw->start[i] < tw->end[i] ) {
+				tw->bounds[0][i] = tw->start[i] + tw->size[0][i];
+				tw->bounds[1][i] = tw->end[i] + tw->size[1][i];
 			} else {
-				tw.bounds[0][i] = tw.end[i] + tw.size[0][i];
-				tw.bounds[1][i] = tw.start[i] + tw.size[1][i];
+				tw->bounds[0][i] = tw->end[i] + tw->size[0][i];
+				tw->bounds[1][i] = tw->start[i] + tw->size[1][i];
 			}
 		}
 	}
+}
+
+/*
+==================
+CM_SetupSweep
+
+Position tests never take the point special case
+==================
+*/
+static void CM_SetupSweep( traceWork_t *tw ) {
+	//
+	// check for point special case
+	//
+	if ( tw->size[0][0] == 0 && tw->size[0][1] == 0 && tw->size[0][2] == 0 ) {
+		tw->isPoint = qtrue;
+		VectorClear( tw->extents );
+	} else {
+		tw->isPoint = qfalse;
+		tw->extents[0] = tw->size[1][0];
+		tw->extents[1] = tw->size[1][1];
+		tw->extents[2] = tw->size[1][2];
+	}
+}
+
+/*
+==================
+CM_FinishTrace
+==================
+*/
+static void CM_FinishTrace( traceWork_t *tw, trace_t *results, const vec3_t start, const vec3_t end ) {
+	int			i;
+
+	// generate endpos from the original, unmodified start/end
+	if ( tw->trace.fraction == 1 ) {
+		VectorCopy (end, tw->trace.endpos);
+	} else {
+		for ( i=0 ; i<3 ; i++ ) {
+			tw->trace.endpos[i] = start[i] + tw->trace.fraction * (end[i] - start[i]);
+		}
+	}
+
+        // If allsolid is set (was entirely inside something solid), the plane is not valid.
+        // If fraction == 1.0, we never hit anything, and thus the plane is not valid.
+        // Otherwise, the normal on the plane should have unit length
+        assert(tw->trace.allsolid ||
+               tw->trace.fraction == 1.0 ||
+               VectorLengthSquared(tw->trace.plane.normal) > 0.9999);
+	*results = tw->trace;
+}
+
+/*
+==================
+CM_Trace
+==================
+*/
+void CM_Trace( trace_t *results, const vec3_t start, const vec3_t end, vec3_t mins, vec3_t maxs,
+						  clipHandle_t model, const vec3_t origin, int brushmask, int capsule, sphere_t *sphere ) {
+	traceWork_t	tw;
+	cmodel_t	*cmod;
+
+	cmod = CM_ClipHandleToModel( model );
+
+	cm.checkcount++;		// for multi-check avoidance
+
+	c_traces++;				// for statistics, may be zeroed
+
+	if (!cm.numNodes) {
+		Com_Memset( results, 0, sizeof( *results ) );
+		results->fraction = 1;
+
+		return;	// map not loaded, shouldn't happen
+	}
+
+	// allow NULL to be passed in for 0,0,0
+	if ( !mins ) {
+		mins = vec3_origin;
+	}
+	if ( !maxs ) {
+		maxs = vec3_origin;
+	}
+
+	CM_SetupTrace( &tw, start, end, mins, maxs, origin, brushmask, capsule, sphere );
+	tw.checkcount = cm.checkcount;
 
 	//
 	// check for position test special case
@@ -1295,18 +1587,7 @@ void CM_Trace( trace_t *results, const vec3_t start, const vec3_t end, vec3_t mi
 			CM_PositionTest( &tw );
 		}
 	} else {
-		//
-		// check for point special case
-		//
-		if ( tw.size[0][0] == 0 && tw.size[0][1] == 0 && tw.size[0][2] == 0 ) {
-			tw.isPoint = qtrue;
-			VectorClear( tw.extents );
-		} else {
-			tw.isPoint = qfalse;
-			tw.extents[0] = tw.size[1][0];
-			tw.extents[1] = tw.size[1][1];
-			tw.extents[2] = tw.size[1][2];
-		}
+		CM_SetupSweep( &tw );
 
 		//
 		// general sweeping through world
@@ -1340,22 +1621,82 @@ void CM_Trace( trace_t *results, const vec3_t start, const vec3_t end, vec3_t mi
 		}
 	}
 
-	// generate endpos from the original, unmodified start/end
-	if ( tw.trace.fraction == 1 ) {
-		VectorCopy (end, tw.trace.endpos);
-	} else {
-		for ( i=0 ; i<3 ; i++ ) {
-			tw.trace.endpos[i] = start[i] + tw.trace.fraction * (end[i] - start[i]);
+	CM_FinishTrace( &tw, results, start, end );
+}
+
+/*
+==================
+CM_TraceBatch
+
+Traces a box from each of starts to the matching ends through the world or
+an inline model, the results are the same as calling CM_BoxTrace for each
+==================
+*/
+void CM_TraceBatch( trace_t *results, const vec3_t *starts, const vec3_t *ends, int count,
+						  vec3_t mins, vec3_t maxs, clipHandle_t model, int brushmask, int capsule ) {
+	traceWork_t		tws[MAX_TRACE_BATCH];
+	traceSegment_t	segs[MAX_TRACE_BATCH];
+	int				indexes[MAX_TRACE_BATCH];
+	int				i, n, numSegs;
+	const float		*start, *end;
+
+	// only sweeps through the world tree can share the walk
+	if ( model || !cm.numNodes ) {
+		for ( i = 0 ; i < count ; i++ ) {
+			CM_Trace( &results[i], starts[i], ends[i], mins, maxs, model, vec3_origin, brushmask, capsule, NULL );
 		}
+		return;
 	}
 
-        // If allsolid is set (was entirely inside something solid), the plane is not valid.
-        // If fraction == 1.0, we never hit anything, and thus the plane is not valid.
-        // Otherwise, the normal on the plane should have unit length
-        assert(tw.trace.allsolid ||
-               tw.trace.fraction == 1.0 ||
-               VectorLengthSquared(tw.trace.plane.normal) > 0.9999);
-	*results = tw.trace;
+	// allow NULL to be passed in for 0,0,0
+	if ( !mins ) {
+		mins = vec3_origin;
+	}
+	if ( !maxs ) {
+		maxs = vec3_origin;
+	}
+
+	while ( count > 0 ) {
+		cm.checkcount++;		// for multi-check avoidance, each slot has its own counts
+
+		for ( n = 0, numSegs = 0 ; n < count && numSegs < MAX_TRACE_BATCH ; n++ ) {
+			start = starts[n];
+			end = ends[n];
+
+			// position tests don't walk the tree
+			if ( start[0] == end[0] && start[1] == end[1] && start[2] == end[2] ) {
+				CM_Trace( &results[n], start, end, mins, maxs, model, vec3_origin, brushmask, capsule, NULL );
+				continue;
+			}
+
+			c_traces++;				// for statistics, may be zeroed
+
+			CM_SetupTrace( &tws[numSegs], start, end, mins, maxs, vec3_origin, brushmask, capsule, NULL );
+			CM_SetupSweep( &tws[numSegs] );
+			tws[numSegs].checkcount = cm.checkcount;
+			tws[numSegs].brushChecks = cm.batchChecks + numSegs * ( cm.numBrushes + cm.numSurfaces );
+			tws[numSegs].patchChecks = tws[numSegs].brushChecks + cm.numBrushes;
+
+			segs[numSegs].tw = &tws[numSegs];
+			segs[numSegs].p1f = 0;
+			segs[numSegs].p2f = 1;
+			VectorCopy( tws[numSegs].start, segs[numSegs].p1 );
+			VectorCopy( tws[numSegs].end, segs[numSegs].p2 );
+			indexes[numSegs] = n;
+			numSegs++;
+		}
+
+		CM_TraceThroughTreeBatch( 0, segs, numSegs );
+
+		for ( i = 0 ; i < numSegs ; i++ ) {
+			CM_FinishTrace( &tws[i], &results[indexes[i]], starts[indexes[i]], ends[indexes[i]] );
+		}
+
+		results += n;
+		starts += n;
+		ends += n;
+		count -= n;
+	}
 }
 
 /*
@@ -720,6 +720,22 @@ void Cmd_RemoveCommandSafe( const char *cmd_name )
 	Cmd_RemoveCommand( cmd_name );
 }
 
+/*
+============
+Cmd_CompactCommands
+
+Lets the zone move the commands and their names, see Z_Defrag
+============
+*/
+void Cmd_CompactCommands( void ) {
+	cmd_function_t	**link;
+
+	for ( link = &cmd_functions ; *link ; link = &(*link)->next ) {
+		*link = Z_Move( *link );
+		(*link)->name = Z_Move( (*link)->name );
+	}
+}
+
 /*
 ============
 Cmd_CommandCompletion
@@ -763,12 +763,44 @@ The rover can be left pointing at a non-empty block
 
 The zone calls are pretty much only used for small strings and structures,
 all big things are allocated on the hunk.
+
+Allocations of up to SLAB_MAX_BLOCK bytes, header included, don't walk
+the block list.  They come from slabs: TAG_SLAB zone blocks cut into
+blocks of one size class.  Every thread keeps a few free blocks of each
+class, so most small allocations and frees never take the zone lock.
+Blocks in a slab have the usual header with SLABID, so Z_Free,
+Z_FreeTags and the heap walks treat them like any other block.
+
+If no slab can be started because the zone has no free run of slabSize
+bytes left, small allocations fall back to the block list like large ones.
+
+The zone may be used from jobs.  Everything that walks the heap
+(Z_FreeTags, Z_CheckHeap, Z_LogHeap, meminfo) must only run while no jobs
+are running.  A job must not run the zone out of memory: the Com_Error a
+failed allocation ends in can't unwind a worker thread, so jobs only use
+the zone for allocations the main thread would make as well and
+anything large is allocated before the jobs are started.
 ==============================================================================
 */
 
 #define	ZONEID	0x1d4a11
+#define	SLABID	0x1d4a12
 #define MINFRAGMENT	64
 
+#define	MAINZONE_SLAB_SIZE	16384
+#define	SMALLZONE_SLAB_SIZE	4096
+
+#define	SLAB_NUM_CLASSES	12
+#define	SLAB_MAX_BLOCK		512			// largest slab block, header included
+#define	SLAB_CACHE_SIZE		32			// free blocks a thread keeps per class
+#define	SLAB_CACHE_BATCH	16			// blocks moved between a cache and the slabs at once
+
+#ifdef _MSC_VER
+#define	THREAD_LOCAL	__declspec( thread )
+#else
+#define	THREAD_LOCAL	__thread
+#endif
+
 typedef struct zonedebug_s {
 	char *label;
 	char *file;
@@ -779,26 +811,63 @@ typedef struct zonedebug_s {
 typedef struct memblock_s {
 	int		size;           // including the header and possibly tiny fragments
 	int     tag;            // a tag of 0 is a free block
-	struct memblock_s       *next, *prev;
-	int     id;        		// should be ZONEID
+	struct memblock_s       *next, *prev;	// in a slab: next free block, and the slab_t
+	int     id;        		// should be ZONEID, or SLABID in a slab
 #ifdef ZONE_DEBUG
 	zonedebug_t d;
 #endif
 } memblock_t;
 
+typedef struct slab_s {
+	int				id;				// should be SLABID
+	int				sizeClass;
+	int				numBlocks;
+	int				numCarved;		// blocks handed out at least once, the rest has no headers yet
+	int				numFree;		// blocks in thread caches count as used
+	memblock_t		*free;
+	struct slab_s	*next, *prev;	// slabs of the class with free blocks
+} slab_t;
+
+typedef struct {
+	slab_t		*partial;			// slabs with free blocks
+	int			numSlabs;
+	int			numEmpty;			// a few empty slabs are kept around
+} slabClass_t;
+
 typedef struct {
 	int		size;			// total bytes malloced, including header
 	int		used;			// total bytes used
 	memblock_t	blocklist;	// start / end cap for linked list
 	memblock_t	*rover;
+	int			peakUsed;	// highest used since startup
+	int			slabSize;	// 0 if the zone has no slabs
+	slabClass_t	classes[SLAB_NUM_CLASSES];
 } memzone_t;
 
+// free slab blocks one thread holds on to, kept in arrays so taking one
+// doesn't touch the block that comes after it
+typedef struct {
+	memblock_t	*free[SLAB_NUM_CLASSES][SLAB_CACHE_SIZE + 1];
+	int			count[SLAB_NUM_CLASSES];
+} slabCache_t;
+
+static const int slabBlockSizes[SLAB_NUM_CLASSES] = {
+	48, 64, 80, 96, 112, 128, 160, 192, 256, 320, 384, 512
+};
+static byte slabClassForSize[SLAB_MAX_BLOCK / 16 + 1];
+
 // main zone for all "dynamic" memory allocation
 static memzone_t	*mainzone;
 // we also have a small zone for small allocations that would only
 // fragment the main zone (think of cvar and cmd strings)
 static memzone_t	*smallzone;
 
+static sysMutex_t	*z_mutex;			// the block lists and the slabs
+static qboolean		z_useSlabs = qtrue;
+static qboolean		z_keepSlabs;		// Z_FreeTags is walking them
+static int			z_numMoved;			// by Z_Move, for Z_Defrag
+static THREAD_LOCAL slabCache_t	z_caches[2];	// main and small zone
+
 static void Z_CheckHeap( void );
 
 /*
@@ -806,11 +875,12 @@ static void Z_CheckHeap( void );
 Z_ClearZone
 ========================
 */
-static void Z_ClearZone( memzone_t *zone, int size ) {
+static void Z_ClearZone( memzone_t *zone, int size, int slabSize ) {
 	memblock_t	*block;
 	
 	// set the entire zone to one free block
 
+	Com_Memset( zone, 0, sizeof( *zone ) );
 	zone->blocklist.next = zone->blocklist.prev = block =
 		(memblock_t *)( (byte *)zone + sizeof(memzone_t) );
 	zone->blocklist.tag = 1;	// in use block
@@ -819,6 +889,7 @@ static void Z_ClearZone( memzone_t *zone, int size ) {
 	zone->rover = block;
 	zone->size = size;
 	zone->used = 0;
+	zone->slabSize = slabSize;
 	
 	block->prev = block->next = &zone->blocklist;
 	block->tag = 0;			// free block
@@ -846,46 +917,24 @@ int Z_AvailableMemory( void ) {
 
 /*
 ========================
-Z_Free
+Z_ZoneForTag
 ========================
 */
-void Z_Free( void *ptr ) {
-	memblock_t	*block, *other;
-	memzone_t *zone;
-	
-	if (!ptr) {
-		Com_Error( ERR_DROP, "Z_Free: NULL pointer" );
-	}
-
-	block = (memblock_t *) ( (byte *)ptr - sizeof(memblock_t));
-	if (block->id != ZONEID) {
-		Com_Error( ERR_FATAL, "Z_Free: freed a pointer without ZONEID" );
-	}
-	if (block->tag == 0) {
-		Com_Error( ERR_FATAL, "Z_Free: freed a freed pointer" );
-	}
-	// if static memory
-	if (block->tag == TAG_STATIC) {
-		return;
-	}
+static memzone_t *Z_ZoneForTag( int tag ) {
+	return tag == TAG_SMALL ? smallzone : mainzone;
+}
 
-	// check the memory trash tester
-	if ( *(int *)((byte *)block + block->size - 4 ) != ZONEID ) {
-		Com_Error( ERR_FATAL, "Z_Free: memory block wrote past end" );
-	}
+/*
+========================
+Z_FreeBlock
 
-	if (block->tag == TAG_SMALL) {
-		zone = smallzone;
-	}
-	else {
-		zone = mainzone;
-	}
+Returns a block to the block list, the zone lock must be held
+========================
+*/
+static void Z_FreeBlock( memzone_t *zone, memblock_t *block ) {
+	memblock_t	*other;
 
 	zone->used -= block->size;
-	// set the block to something that should cause problems
-	// if it is referenced...
-	Com_Memset( ptr, 0xaa, block->size - sizeof( *block ) );
-
 	block->tag = 0;		// mark as free
 	
 	other = block->prev;
@@ -911,86 +960,69 @@ void Z_Free( void *ptr ) {
 	}
 }
 
-
 /*
-================
-Z_FreeTags
-================
+========================
+Z_SplitBlock
+
+Allocates size bytes at the start of the free block base, the zone lock
+must be held
+========================
 */
-void Z_FreeTags( int tag ) {
-	memzone_t	*zone;
+static memblock_t *Z_SplitBlock( memzone_t *zone, memblock_t *base, int size, int tag ) {
+	int			extra;
+	memblock_t	*new;
 
-	if ( tag == TAG_SMALL ) {
-		zone = smallzone;
+	extra = base->size - size;
+	if (extra > MINFRAGMENT) {
+		// there will be a free fragment after the allocated block
+		new = (memblock_t *) ((byte *)base + size );
+		new->size = extra;
+		new->tag = 0;			// free block
+		new->prev = base;
+		new->id = ZONEID;
+		new->next = base->next;
+		new->next->prev = new;
+		base->next = new;
+		base->size = size;
 	}
-	else {
-		zone = mainzone;
+	
+	base->tag = tag;			// no longer a free block
+	
+	zone->rover = base->next;	// next allocation will start looking here
+	zone->used += base->size;	//
+	if ( zone->used > zone->peakUsed ) {
+		zone->peakUsed = zone->used;
 	}
-	// use the rover as our pointer, because
-	// Z_Free automatically adjusts it
-	zone->rover = zone->blocklist.next;
-	do {
-		if ( zone->rover->tag == tag ) {
-			Z_Free( (void *)(zone->rover + 1) );
-			continue;
-		}
-		zone->rover = zone->rover->next;
-	} while ( zone->rover != &zone->blocklist );
-}
+	
+	base->id = ZONEID;
 
+	// marker for memory trash testing
+	*(int *)((byte *)base + base->size - 4) = ZONEID;
 
-/*
-================
-Z_TagMalloc
-================
-*/
-#ifdef ZONE_DEBUG
-void *Z_TagMallocDebug( int size, int tag, char *label, char *file, int line ) {
-	int		allocSize;
-#else
-void *Z_TagMalloc( int size, int tag ) {
-#endif
-	int		extra;
-	memblock_t	*start, *rover, *new, *base;
-	memzone_t *zone;
+	return base;
+}
 
-	if (!tag) {
-		Com_Error( ERR_FATAL, "Z_TagMalloc: tried to use a 0 tag" );
-	}
+/*
+========================
+Z_AllocBlock
 
-	if ( tag == TAG_SMALL ) {
-		zone = smallzone;
-	}
-	else {
-		zone = mainzone;
-	}
+First fit from the block list, size includes the header and the trash
+tester.  Returns NULL if nothing is big enough.  The zone lock must be held.
+========================
+*/
+static memblock_t *Z_AllocBlock( memzone_t *zone, int size, int tag ) {
+	memblock_t	*start, *rover, *base;
 
-#ifdef ZONE_DEBUG
-	allocSize = size;
-#endif
 	//
 	// scan through the block list looking for the first free block
 	// of sufficient size
 	//
-	size += sizeof(memblock_t);	// account for size of block header
-	size += 4;					// space for memory trash tester
-	size = PAD(size, sizeof(intptr_t));		// align to 32/64 bit boundary
-	
 	base = rover = zone->rover;
 	start = base->prev;
 	
 	do {
 		if (rover == start)	{
 			// scaned all the way around the list
-#ifdef ZONE_DEBUG
-			Z_LogHeap();
-
-			Com_Error(ERR_FATAL, "Z_Malloc: failed on allocation of %i bytes from the %s zone: %s, line: %d (%s)",
-								size, zone == smallzone ? "small" : "main", file, line, label);
-#else
-			Com_Error(ERR_FATAL, "Z_Malloc: failed on allocation of %i bytes from the %s zone",
-								size, zone == smallzone ? "small" : "main");
-#endif
 			return NULL;
 		}
 		if (rover->tag) {
@@ -1000,420 +1032,1714 @@ void *Z_TagMalloc( int size, int tag ) {
 		}
 	} while (base->tag || base->size < size);
 	
-	//
-	// found a block big enough
-	//
-	extra = base->size - size;
-	if (extra > MINFRAGMENT) {
-		// there will be a free fragment after the allocated block
-		new = (memblock_t *) ((byte *)base + size );
-		new->size = extra;
-		new->tag = 0;			// free block
-		new->prev = base;
-		new->id = ZONEID;
-		new->next = base->next;
-		new->next->prev = new;
-		base->next = new;
-		base->size = size;
-	}
-	
-	base->tag = tag;			// no longer a free block
-	
-	zone->rover = base->next;	// next allocation will start looking here
-	zone->used += base->size;	//
-	
-	base->id = ZONEID;
+	return Z_SplitBlock( zone, base, size, tag );
+}
 
-#ifdef ZONE_DEBUG
-	base->d.label = label;
-	base->d.file = file;
-	base->d.line = line;
-	base->d.allocSize = allocSize;
-#endif
+/*
+========================
+Z_SlabBlock
+========================
+*/
+static memblock_t *Z_SlabBlock( slab_t *slab, int index ) {
+	return (memblock_t *)( (byte *)( slab + 1 ) + index * slabBlockSizes[slab->sizeClass] );
+}
 
-	// marker for memory trash testing
-	*(int *)((byte *)base + base->size - 4) = ZONEID;
+/*
+========================
+Z_LinkSlab
 
-	return (void *) ((byte *)base + sizeof(memblock_t));
+Puts a slab at the head of the partial list of its class
+========================
+*/
+static void Z_LinkSlab( slabClass_t *cl, slab_t *slab ) {
+	slab->prev = NULL;
+	slab->next = cl->partial;
+	if ( cl->partial ) {
+		cl->partial->prev = slab;
+	}
+	cl->partial = slab;
 }
 
 /*
 ========================
-Z_Malloc
+Z_NewSlab
+
+Takes a zone block for blocks of one class, they are cut off as they are
+needed.  The zone lock must be held.
 ========================
 */
-#ifdef ZONE_DEBUG
-void *Z_MallocDebug( int size, char *label, char *file, int line ) {
-#else
-void *Z_Malloc( int size ) {
-#endif
-	void	*buf;
-	
-  //Z_CheckHeap ();	// DEBUG
+static slab_t *Z_NewSlab( memzone_t *zone, int sizeClass ) {
+	memblock_t	*base;
+	slabClass_t	*cl;
+	slab_t		*slab;
 
+	base = Z_AllocBlock( zone, zone->slabSize, TAG_SLAB );
+	if ( !base ) {
+		return NULL;
+	}
 #ifdef ZONE_DEBUG
-	buf = Z_TagMallocDebug( size, TAG_GENERAL, label, file, line );
-#else
-	buf = Z_TagMalloc( size, TAG_GENERAL );
+	base->d.label = "slab";
+	base->d.file = __FILE__;
+	base->d.line = __LINE__;
+	base->d.allocSize = zone->slabSize;
 #endif
-	Com_Memset( buf, 0, size );
 
-	return buf;
-}
+	slab = (slab_t *)( base + 1 );
+	slab->id = SLABID;
+	slab->sizeClass = sizeClass;
+	slab->numBlocks = ( base->size - sizeof( *base ) - sizeof( *slab ) - 4 ) / slabBlockSizes[sizeClass];
+	slab->numCarved = 0;
+	slab->numFree = slab->numBlocks;
+	slab->free = NULL;
 
-#ifdef ZONE_DEBUG
-void *S_MallocDebug( int size, char *label, char *file, int line ) {
-	return Z_TagMallocDebug( size, TAG_SMALL, label, file, line );
-}
-#else
-void *S_Malloc( int size ) {
-	return Z_TagMalloc( size, TAG_SMALL );
+	cl = &zone->classes[sizeClass];
+	Z_LinkSlab( cl, slab );
+	cl->numSlabs++;
+	cl->numEmpty++;
+
+	return slab;
 }
-#endif
 
 /*
 ========================
-Z_CheckHeap
+Z_UnlinkSlab
 ========================
 */
-static void Z_CheckHeap( void ) {
-	memblock_t	*block;
-	
-	for (block = mainzone->blocklist.next ; ; block = block->next) {
-		if (block->next == &mainzone->blocklist) {
-			break;			// all blocks have been hit
-		}
-		if ( (byte *)block + block->size != (byte *)block->next)
-			Com_Error( ERR_FATAL, "Z_CheckHeap: block size does not touch the next block" );
-		if ( block->next->prev != block) {
-			Com_Error( ERR_FATAL, "Z_CheckHeap: next block doesn't have proper back link" );
-		}
-		if ( !block->tag && !block->next->tag ) {
-			Com_Error( ERR_FATAL, "Z_CheckHeap: two consecutive free blocks" );
-		}
+static void Z_UnlinkSlab( slabClass_t *cl, slab_t *slab ) {
+	if ( slab->prev ) {
+		slab->prev->next = slab->next;
+	} else {
+		cl->partial = slab->next;
+	}
+	if ( slab->next ) {
+		slab->next->prev = slab->prev;
 	}
+	slab->next = slab->prev = NULL;
 }
 
 /*
 ========================
-Z_LogZoneHeap
+Z_ReleaseSlab
+
+Gives an empty slab back to the block list, the zone lock must be held
 ========================
 */
-void Z_LogZoneHeap( memzone_t *zone, char *name ) {
-#ifdef ZONE_DEBUG
-	char dump[32], *ptr;
-	int  i, j;
-#endif
-	memblock_t	*block;
-	char		buf[4096];
-	int size, allocSize, numBlocks;
+static void Z_ReleaseSlab( memzone_t *zone, slab_t *slab ) {
+	slabClass_t	*cl;
 
-	if (!logfile || !FS_Initialized())
-		return;
-	size = numBlocks = 0;
-#ifdef ZONE_DEBUG
-	allocSize = 0;
-#endif
-	Com_sprintf(buf, sizeof(buf), "\r\n================\r\n%s log\r\n================\r\n", name);
-	FS_Write(buf, strlen(buf), logfile);
-	for (block = zone->blocklist.next ; block->next != &zone->blocklist; block = block->next) {
-		if (block->tag) {
-#ifdef ZONE_DEBUG
-			ptr = ((char *) block) + sizeof(memblock_t);
-			j = 0;
-			for (i = 0; i < 20 && i < block->d.allocSize; i++) {
-				if (ptr[i] >= 32 && ptr[i] < 127) {
-					dump[j++] = ptr[i];
-				}
-				else {
-					dump[j++] = '_';
-				}
-			}
-			dump[j] = '\0';
-			Com_sprintf(buf, sizeof(buf), "size = %8d: %s, line: %d (%s) [%s]\r\n", block->d.allocSize, block->d.file, block->d.line, block->d.label, dump);
-			FS_Write(buf, strlen(buf), logfile);
-			allocSize += block->d.allocSize;
-#endif
-			size += block->size;
-			numBlocks++;
-		}
-	}
-#ifdef ZONE_DEBUG
-	// subtract debug memory
-	size -= numBlocks * sizeof(zonedebug_t);
-#else
-	allocSize = numBlocks * sizeof(memblock_t); // + 32 bit alignment
-#endif
-	Com_sprintf(buf, sizeof(buf), "%d %s memory in %d blocks\r\n", size, name, numBlocks);
-	FS_Write(buf, strlen(buf), logfile);
-	Com_sprintf(buf, sizeof(buf), "%d %s memory overhead\r\n", size - allocSize, name);
-	FS_Write(buf, strlen(buf), logfile);
+	cl = &zone->classes[slab->sizeClass];
+	Z_UnlinkSlab( cl, slab );
+	cl->numSlabs--;
+	cl->numEmpty--;
+
+	slab->id = 0;
+	Z_FreeBlock( zone, (memblock_t *)slab - 1 );
 }
 
 /*
 ========================
-Z_LogHeap
+Z_TooManyEmptySlabs
+
+A class that needs many slabs keeps more of them empty, so blocks going
+back and forth around a slab boundary don't release and take slabs all
+the time
 ========================
 */
-void Z_LogHeap( void ) {
-	Z_LogZoneHeap( mainzone, "MAIN" );
-	Z_LogZoneHeap( smallzone, "SMALL" );
+static qboolean Z_TooManyEmptySlabs( slabClass_t *cl ) {
+	return cl->numEmpty > 1 + cl->numSlabs / 4;
 }
 
-// static mem blocks to reduce a lot of small zone overhead
-typedef struct memstatic_s {
-	memblock_t b;
-	byte mem[2];
+/*
+========================
+Z_ReleaseEmptySlabs
+
+Releases the empty slabs a zone has more of than Z_ReturnSlabBlock keeps,
+or all of them.  The zone lock must be held.
+========================
+*/
+static int Z_ReleaseEmptySlabs( memzone_t *zone, qboolean all ) {
+	slabClass_t	*cl;
+	slab_t		*slab, *next;
+	int			i, count;
+
+	count = 0;
+	for ( i = 0 ; i < SLAB_NUM_CLASSES ; i++ ) {
+		cl = &zone->classes[i];
+		for ( slab = cl->partial ; slab && ( all || Z_TooManyEmptySlabs( cl ) ) ; slab = next ) {
+			next = slab->next;
+			if ( slab->numFree == slab->numBlocks ) {
+				Z_ReleaseSlab( zone, slab );
+				count++;
+			}
+		}
+	}
+
+	return count;
+}
+
+/*
+========================
+Z_ReturnSlabBlock
+
+The zone lock must be held
+========================
+*/
+static void Z_ReturnSlabBlock( memzone_t *zone, memblock_t *block ) {
+	slabClass_t	*cl;
+	slab_t		*slab;
+
+	slab = (slab_t *)block->prev;
+	cl = &zone->classes[slab->sizeClass];
+
+	if ( !slab->numFree ) {
+		Z_LinkSlab( cl, slab );
+	}
+	block->next = slab->free;
+	slab->free = block;
+	slab->numFree++;
+
+	if ( slab->numFree == slab->numBlocks ) {
+		cl->numEmpty++;
+		if ( slab != cl->partial ) {
+			// fill the empty slab again before cutting into any new one
+			Z_UnlinkSlab( cl, slab );
+			Z_LinkSlab( cl, slab );
+		}
+		if ( Z_TooManyEmptySlabs( cl ) && !z_keepSlabs ) {
+			Z_ReleaseSlab( zone, slab );
+		}
+	}
+}
+
+/*
+========================
+Z_TakeSlabBlock
+
+Takes a free block from a slab on the partial list of its class, the
+zone lock must be held
+========================
+*/
+static memblock_t *Z_TakeSlabBlock( slabClass_t *cl, slab_t *slab ) {
+	memblock_t	*block;
+
+	if ( slab->numFree == slab->numBlocks ) {
+		cl->numEmpty--;
+	}
+	if ( slab->free ) {
+		block = slab->free;
+		slab->free = block->next;
+	} else {
+		block = Z_SlabBlock( slab, slab->numCarved++ );
+		block->size = slabBlockSizes[slab->sizeClass];
+		block->tag = 0;
+		block->prev = (memblock_t *)slab;
+		block->id = SLABID;
+	}
+	if ( !--slab->numFree ) {
+		Z_UnlinkSlab( cl, slab );
+	}
+
+	return block;
+}
+
+/*
+========================
+Z_FillCache
+
+Moves up to SLAB_CACHE_BATCH free blocks of a class into a thread cache,
+the zone lock must be held
+========================
+*/
+static void Z_FillCache( memzone_t *zone, slabCache_t *cache, int sizeClass ) {
+	slabClass_t	*cl;
+	slab_t		*slab;
+	int			i;
+
+	cl = &zone->classes[sizeClass];
+	for ( i = 0 ; i < SLAB_CACHE_BATCH ; i++ ) {
+		slab = cl->partial;
+		if ( !slab ) {
+			// only start a slab for the block that was asked for
+			if ( i ) {
+				break;
+			}
+			slab = Z_NewSlab( zone, sizeClass );
+			if ( !slab ) {
+				break;
+			}
+		}
+
+		cache->free[sizeClass][cache->count[sizeClass]++] = Z_TakeSlabBlock( cl, slab );
+	}
+}
+
+/*
+========================
+Z_DrainCache
+
+Hands the count blocks a thread cache has held longest back to their
+slabs, the zone lock must be held
+========================
+*/
+static void Z_DrainCache( memzone_t *zone, slabCache_t *cache, int sizeClass, int count ) {
+	memblock_t	**free;
+	int			i;
+
+	free = cache->free[sizeClass];
+	if ( count > cache->count[sizeClass] ) {
+		count = cache->count[sizeClass];
+	}
+	for ( i = 0 ; i < count ; i++ ) {
+		Z_ReturnSlabBlock( zone, free[i] );
+	}
+	cache->count[sizeClass] -= count;
+	memmove( free, free + count, cache->count[sizeClass] * sizeof( *free ) );
+}
+
+/*
+========================
+Z_FlushThreadCache
+
+Gives the free slab blocks of the calling thread back, for threads that
+are about to exit
+========================
+*/
+void Z_FlushThreadCache( void ) {
+	int		i, j;
+
+	Sys_LockMutex( z_mutex );
+	for ( i = 0 ; i < 2 ; i++ ) {
+		for ( j = 0 ; j < SLAB_NUM_CLASSES ; j++ ) {
+			Z_DrainCache( i ? smallzone : mainzone, &z_caches[i], j, SLAB_CACHE_SIZE + 1 );
+		}
+	}
+	Sys_UnlockMutex( z_mutex );
+}
+
+/*
+========================
+Z_SlabAlloc
+
+Returns NULL if no slab of the class has a free block and no new slab
+fits in the zone, the caller then takes the block from the block list
+========================
+*/
+static memblock_t *Z_SlabAlloc( memzone_t *zone, int size ) {
+	slabCache_t	*cache;
+	memblock_t	*block;
+	int			sizeClass;
+
+	sizeClass = slabClassForSize[( size + 15 ) >> 4];
+	cache = &z_caches[zone == smallzone];
+
+	if ( !cache->count[sizeClass] ) {
+		Sys_LockMutex( z_mutex );
+		Z_FillCache( zone, cache, sizeClass );
+		Sys_UnlockMutex( z_mutex );
+		if ( !cache->count[sizeClass] ) {
+			return NULL;
+		}
+	}
+
+	block = cache->free[sizeClass][--cache->count[sizeClass]];
+	block->next = NULL;
+
+	return block;
+}
+
+/*
+========================
+Z_SlabFree
+========================
+*/
+static void Z_SlabFree( memzone_t *zone, memblock_t *block ) {
+	slabCache_t	*cache;
+	int			sizeClass;
+
+	// block sizes are the class sizes, no need to look at the slab
+	sizeClass = slabClassForSize[block->size >> 4];
+	cache = &z_caches[zone == smallzone];
+
+	cache->free[sizeClass][cache->count[sizeClass]++] = block;
+	if ( cache->count[sizeClass] > SLAB_CACHE_SIZE ) {
+		Sys_LockMutex( z_mutex );
+		Z_DrainCache( zone, cache, sizeClass, SLAB_CACHE_BATCH );
+		Sys_UnlockMutex( z_mutex );
+	}
+}
+
+/*
+========================
+Z_Free
+========================
+*/
+void Z_Free( void *ptr ) {
+	memblock_t	*block;
+	memzone_t *zone;
+	
+	if (!ptr) {
+		Com_Error( ERR_DROP, "Z_Free: NULL pointer" );
+	}
+
+	block = (memblock_t *) ( (byte *)ptr - sizeof(memblock_t));
+	if (block->id != ZONEID && block->id != SLABID) {
+		Com_Error( ERR_FATAL, "Z_Free: freed a pointer without ZONEID" );
+	}
+	if (block->tag == 0) {
+		Com_Error( ERR_FATAL, "Z_Free: freed a freed pointer" );
+	}
+	// if static memory
+	if (block->tag == TAG_STATIC) {
+		return;
+	}
+
+	// check the memory trash tester
+	if ( *(int *)((byte *)block + block->size - 4 ) != ZONEID ) {
+		Com_Error( ERR_FATAL, "Z_Free: memory block wrote past end" );
+	}
+
+	zone = Z_ZoneForTag( block->tag );
+
+	// set the block to something that should cause problems
+	// if it is referenced...
+	Com_Memset( ptr, 0xaa, block->size - sizeof( *block ) );
+
+	if ( block->id == SLABID ) {
+		block->tag = 0;
+		Z_SlabFree( zone, block );
+		return;
+	}
+
+	Sys_LockMutex( z_mutex );
+	Z_FreeBlock( zone, block );
+	Sys_UnlockMutex( z_mutex );
+}
+
+/*
+========================
+Z_DenserSlabBlock
+
+A free block in the fullest slab of the class that is fuller than the
+one block is in, NULL if block is in a slab that is at least half used.
+The zone lock must be held.
+========================
+*/
+static memblock_t *Z_DenserSlabBlock( memzone_t *zone, memblock_t *block ) {
+	slabClass_t	*cl;
+	slab_t		*slab, *best, *other;
+
+	slab = (slab_t *)block->prev;
+	if ( slab->numFree * 2 <= slab->numBlocks ) {
+		return NULL;
+	}
+
+	cl = &zone->classes[slab->sizeClass];
+	best = NULL;
+	for ( other = cl->partial ; other ; other = other->next ) {
+		if ( other->numFree < slab->numFree && ( !best || other->numFree < best->numFree ) ) {
+			best = other;
+		}
+	}
+	if ( !best ) {
+		return NULL;
+	}
+
+	return Z_TakeSlabBlock( cl, best );
+}
+
+/*
+========================
+Z_LowerBlock
+
+The first free block below block that it fits in, the zone lock must be
+held
+========================
+*/
+static memblock_t *Z_LowerBlock( memzone_t *zone, memblock_t *block ) {
+	memblock_t	*rover;
+
+	for ( rover = zone->blocklist.next ; rover != block ; rover = rover->next ) {
+		if ( !rover->tag && rover->size >= block->size ) {
+			return Z_SplitBlock( zone, rover, block->size, block->tag );
+		}
+	}
+
+	return NULL;
+}
+
+/*
+========================
+Z_Move
+
+Moves a block into a fuller slab or into a free block lower in the zone,
+so the zone can be compacted by whoever owns the pointer.  Returns where
+the data is now, which may be ptr.  Only use while no jobs are running.
+========================
+*/
+void *Z_Move( void *ptr ) {
+	memblock_t	*block, *base;
+	memzone_t	*zone;
+
+	if ( !ptr ) {
+		return NULL;
+	}
+
+	block = (memblock_t *) ( (byte *)ptr - sizeof(memblock_t));
+	if ( block->tag == TAG_STATIC ) {
+		return ptr;
+	}
+	if ( block->id != ZONEID && block->id != SLABID ) {
+		Com_Error( ERR_FATAL, "Z_Move: moved a pointer without ZONEID" );
+	}
+	if ( block->tag == 0 ) {
+		Com_Error( ERR_FATAL, "Z_Move: moved a freed pointer" );
+	}
+
+	zone = Z_ZoneForTag( block->tag );
+
+	Sys_LockMutex( z_mutex );
+	if ( block->id == SLABID ) {
+		base = Z_DenserSlabBlock( zone, block );
+	} else {
+		base = Z_LowerBlock( zone, block );
+	}
+	if ( !base ) {
+		Sys_UnlockMutex( z_mutex );
+		return ptr;
+	}
+
+	base->tag = block->tag;
+#ifdef ZONE_DEBUG
+	base->d = block->d;
+#endif
+	*(int *)((byte *)base + base->size - 4) = ZONEID;
+	Com_Memcpy( base + 1, ptr, block->size - sizeof( *block ) - 4 );
+
+	// straight back to the slab or the block list, not to a thread cache
+	Com_Memset( ptr, 0xaa, block->size - sizeof( *block ) );
+	if ( block->id == SLABID ) {
+		block->tag = 0;
+		Z_ReturnSlabBlock( zone, block );
+	} else {
+		Z_FreeBlock( zone, block );
+	}
+	z_numMoved++;
+	Sys_UnlockMutex( z_mutex );
+
+	return base + 1;
+}
+
+
+/*
+================
+Z_FreeSlabTags
+
+Frees the slab blocks with a tag.  Slabs that empty out are only
+released afterwards, so the block list doesn't change under the walk.
+================
+*/
+static void Z_FreeSlabTags( memzone_t *zone, int tag ) {
+	memblock_t	*block, *slabBlock;
+	slab_t		*slab;
+	int			i;
+
+	z_keepSlabs = qtrue;
+	for ( block = zone->blocklist.next ; block != &zone->blocklist ; block = block->next ) {
+		if ( block->tag != TAG_SLAB ) {
+			continue;
+		}
+		slab = (slab_t *)( block + 1 );
+		for ( i = 0 ; i < slab->numCarved ; i++ ) {
+			slabBlock = Z_SlabBlock( slab, i );
+			if ( slabBlock->tag == tag ) {
+				Z_Free( slabBlock + 1 );
+			}
+		}
+	}
+	z_keepSlabs = qfalse;
+
+	// keep as many empty slabs as Z_ReturnSlabBlock would have
+	Sys_LockMutex( z_mutex );
+	Z_ReleaseEmptySlabs( zone, qfalse );
+	Sys_UnlockMutex( z_mutex );
+}
+
+/*
+================
+Z_FreeTags
+================
+*/
+void Z_FreeTags( int tag ) {
+	memzone_t	*zone;
+
+	zone = Z_ZoneForTag( tag );
+	if ( zone->slabSize ) {
+		Z_FreeSlabTags( zone, tag );
+	}
+
+	// use the rover as our pointer, because
+	// Z_Free automatically adjusts it
+	zone->rover = zone->blocklist.next;
+	do {
+		if ( zone->rover->tag == tag ) {
+			Z_Free( (void *)(zone->rover + 1) );
+			continue;
+		}
+		zone->rover = zone->rover->next;
+	} while ( zone->rover != &zone->blocklist );
+}
+
+
+/*
+================
+Z_TagMalloc
+================
+*/
+#ifdef ZONE_DEBUG
+void *Z_TagMallocDebug( int size, int tag, char *label, char *file, int line ) {
+	int		allocSize;
+#else
+void *Z_TagMalloc( int size, int tag ) {
+#endif
+	memblock_t	*base;
+	memzone_t *zone;
+
+	if (!tag) {
+		Com_Error( ERR_FATAL, "Z_TagMalloc: tried to use a 0 tag" );
+	}
+
+	zone = Z_ZoneForTag( tag );
+
+#ifdef ZONE_DEBUG
+	allocSize = size;
+#endif
+	size += sizeof(memblock_t);	// account for size of block header
+	size += 4;					// space for memory trash tester
+	size = PAD(size, sizeof(intptr_t));		// align to 32/64 bit boundary
+
+	base = NULL;
+	if ( size <= SLAB_MAX_BLOCK && zone->slabSize && z_useSlabs ) {
+		base = Z_SlabAlloc( zone, size );
+	}
+	// a fragmented zone may still have room for the block without a slab
+	if ( !base ) {
+		Sys_LockMutex( z_mutex );
+		base = Z_AllocBlock( zone, size, tag );
+		Sys_UnlockMutex( z_mutex );
+	}
+
+	if ( !base ) {
+#ifdef ZONE_DEBUG
+		Z_LogHeap();
+
+		Com_Error(ERR_FATAL, "Z_Malloc: failed on allocation of %i bytes from the %s zone: %s, line: %d (%s)",
+							size, zone == smallzone ? "small" : "main", file, line, label);
+#else
+		Com_Error(ERR_FATAL, "Z_Malloc: failed on allocation of %i bytes from the %s zone",
+							size, zone == smallzone ? "small" : "main");
+#endif
+		return NULL;
+	}
+
+	base->tag = tag;			// no longer a free block
+
+#ifdef ZONE_DEBUG
+	base->d.label = label;
+	base->d.file = file;
+	base->d.line = line;
+	base->d.allocSize = allocSize;
+#endif
+
+	// marker for memory trash testing
+	*(int *)((byte *)base + base->size - 4) = ZONEID;
+
+	return (void *) ((byte *)base + sizeof(memblock_t));
+}
+
+/*
+========================
+Z_Malloc
+========================
+*/
+#ifdef ZONE_DEBUG
+void *Z_MallocDebug( int size, char *label, char *file, int line ) {
+#else
+void *Z_Malloc( int size ) {
+#endif
+	void	*buf;
+	
+  //Z_CheckHeap ();	// DEBUG
+
+#ifdef ZONE_DEBUG
+	buf = Z_TagMallocDebug( size, TAG_GENERAL, label, file, line );
+#else
+	buf = Z_TagMalloc( size, TAG_GENERAL );
+#endif
+	Com_Memset( buf, 0, size );
+
+	return buf;
+}
+
+#ifdef ZONE_DEBUG
+void *S_MallocDebug( int size, char *label, char *file, int line ) {
+	return Z_TagMallocDebug( size, TAG_SMALL, label, file, line );
+}
+#else
+void *S_Malloc( int size ) {
+	return Z_TagMalloc( size, TAG_SMALL );
+}
+#endif
+
+/*
+========================
+Z_CheckSlab
+========================
+*/
+static void Z_CheckSlab( memblock_t *block ) {
+	memblock_t	*slabBlock;
+	slab_t		*slab;
+	int			i, numFree;
+
+	slab = (slab_t *)( block + 1 );
+	if ( slab->id != SLABID ) {
+		Com_Error( ERR_FATAL, "Z_CheckHeap: slab without SLABID" );
+	}
+
+	if ( slab->numCarved < 0 || slab->numCarved > slab->numBlocks ) {
+		Com_Error( ERR_FATAL, "Z_CheckHeap: bad slab carve count" );
+	}
+
+	for ( i = 0 ; i < slab->numCarved ; i++ ) {
+		slabBlock = Z_SlabBlock( slab, i );
+		if ( slabBlock->id != SLABID || slabBlock->prev != (memblock_t *)slab ||
+			slabBlock->size != slabBlockSizes[slab->sizeClass] ) {
+			Com_Error( ERR_FATAL, "Z_CheckHeap: slab block header trashed" );
+		}
+		if ( slabBlock->tag && *(int *)((byte *)slabBlock + slabBlock->size - 4) != ZONEID ) {
+			Com_Error( ERR_FATAL, "Z_CheckHeap: slab block wrote past end" );
+		}
+	}
+
+	numFree = 0;
+	for ( slabBlock = slab->free ; slabBlock ; slabBlock = slabBlock->next ) {
+		if ( slabBlock->tag || slabBlock->prev != (memblock_t *)slab || ++numFree > slab->numBlocks ) {
+			Com_Error( ERR_FATAL, "Z_CheckHeap: bad slab free list" );
+		}
+	}
+	if ( numFree + slab->numBlocks - slab->numCarved != slab->numFree ) {
+		Com_Error( ERR_FATAL, "Z_CheckHeap: slab free count is off" );
+	}
+}
+
+/*
+========================
+Z_CheckHeap
+========================
+*/
+static void Z_CheckHeap( void ) {
+	memblock_t	*block;
+	
+	for (block = mainzone->blocklist.next ; ; block = block->next) {
+		if ( block->tag == TAG_SLAB ) {
+			Z_CheckSlab( block );
+		}
+		if (block->next == &mainzone->blocklist) {
+			break;			// all blocks have been hit
+		}
+		if ( (byte *)block + block->size != (byte *)block->next)
+			Com_Error( ERR_FATAL, "Z_CheckHeap: block size does not touch the next block" );
+		if ( block->next->prev != block) {
+			Com_Error( ERR_FATAL, "Z_CheckHeap: next block doesn't have proper back link" );
+		}
+		if ( !block->tag && !block->next->tag ) {
+			Com_Error( ERR_FATAL, "Z_CheckHeap: two consecutive free blocks" );
+		}
+	}
+}
+
+/*
+========================
+Z_LogBlock
+========================
+*/
+static void Z_LogBlock( memblock_t *block, int *size, int *allocSize, int *numBlocks ) {
+#ifdef ZONE_DEBUG
+	char dump[32], *ptr;
+	char buf[4096];
+	int  i, j;
+
+	ptr = ((char *) block) + sizeof(memblock_t);
+	j = 0;
+	for (i = 0; i < 20 && i < block->d.allocSize; i++) {
+		if (ptr[i] >= 32 && ptr[i] < 127) {
+			dump[j++] = ptr[i];
+		}
+		else {
+			dump[j++] = '_';
+		}
+	}
+	dump[j] = '\0';
+	Com_sprintf(buf, sizeof(buf), "size = %8d: %s, line: %d (%s) [%s]\r\n", block->d.allocSize, block->d.file, block->d.line, block->d.label, dump);
+	FS_Write(buf, strlen(buf), logfile);
+	*allocSize += block->d.allocSize;
+#endif
+	*size += block->size;
+	(*numBlocks)++;
+}
+
+/*
+========================
+Z_LogZoneHeap
+========================
+*/
+void Z_LogZoneHeap( memzone_t *zone, char *name ) {
+	memblock_t	*block, *slabBlock;
+	slab_t		*slab;
+	char		buf[4096];
+	int size, allocSize, numBlocks, numSlabs, slabBytes;
+	int i;
+
+	if (!logfile || !FS_Initialized())
+		return;
+	size = numBlocks = 0;
+	numSlabs = slabBytes = 0;
+	allocSize = 0;
+	Com_sprintf(buf, sizeof(buf), "\r\n================\r\n%s log\r\n================\r\n", name);
+	FS_Write(buf, strlen(buf), logfile);
+	for (block = zone->blocklist.next ; block->next != &zone->blocklist; block = block->next) {
+		if (block->tag == TAG_SLAB) {
+			// log what is in the slab rather than the slab
+			slab = (slab_t *)( block + 1 );
+			for ( i = 0 ; i < slab->numCarved ; i++ ) {
+				slabBlock = Z_SlabBlock( slab, i );
+				if ( slabBlock->tag ) {
+					Z_LogBlock( slabBlock, &size, &allocSize, &numBlocks );
+				}
+			}
+			numSlabs++;
+			slabBytes += block->size;
+		} else if (block->tag) {
+			Z_LogBlock( block, &size, &allocSize, &numBlocks );
+		}
+	}
+#ifdef ZONE_DEBUG
+	// subtract debug memory
+	size -= numBlocks * sizeof(zonedebug_t);
+#else
+	allocSize = numBlocks * sizeof(memblock_t); // + 32 bit alignment
+#endif
+	Com_sprintf(buf, sizeof(buf), "%d %s memory in %d blocks\r\n", size, name, numBlocks);
+	FS_Write(buf, strlen(buf), logfile);
+	Com_sprintf(buf, sizeof(buf), "%d %s memory overhead\r\n", size - allocSize, name);
+	FS_Write(buf, strlen(buf), logfile);
+	Com_sprintf(buf, sizeof(buf), "%d %s memory in %d slabs\r\n", slabBytes, name, numSlabs);
+	FS_Write(buf, strlen(buf), logfile);
+}
+
+/*
+========================
+Z_LogHeap
+========================
+*/
+void Z_LogHeap( void ) {
+	Z_LogZoneHeap( mainzone, "MAIN" );
+	Z_LogZoneHeap( smallzone, "SMALL" );
+}
+
+// static mem blocks to reduce a lot of small zone overhead
+typedef struct memstatic_s {
+	memblock_t b;
+	byte mem[2];
 } memstatic_t;
 
-memstatic_t emptystring =
-	{ {(sizeof(memblock_t)+2 + 3) & ~3, TAG_STATIC, NULL, NULL, ZONEID}, {'\0', '\0'} };
-memstatic_t numberstring[] = {
-	{ {(sizeof(memstatic_t) + 3) & ~3, TAG_STATIC, NULL, NULL, ZONEID}, {'0', '\0'} },
-	{ {(sizeof(memstatic_t) + 3) & ~3, TAG_STATIC, NULL, NULL, ZONEID}, {'1', '\0'} },
-	{ {(sizeof(memstatic_t) + 3) & ~3, TAG_STATIC, NULL, NULL, ZONEID}, {'2', '\0'} },
-	{ {(sizeof(memstatic_t) + 3) & ~3, TAG_STATIC, NULL, NULL, ZONEID}, {'3', '\0'} },
-	{ {(sizeof(memstatic_t) + 3) & ~3, TAG_STATIC, NULL, NULL, ZONEID}, {'4', '\0'} },
-	{ {(sizeof(memstatic_t) + 3) & ~3, TAG_STATIC, NULL, NULL, ZONEID}, {'5', '\0'} },
-	{ {(sizeof(memstatic_t) + 3) & ~3, TAG_STATIC, NULL, NULL, ZONEID}, {'6', '\0'} },
-	{ {(sizeof(memstatic_t) + 3) & ~3, TAG_STATIC, NULL, NULL, ZONEID}, {'7', '\0'} },
-	{ {(sizeof(memstatic_t) + 3) & ~3, TAG_STATIC, NULL, NULL, ZONEID}, {'8', '\0'} }, 
-	{ {(sizeof(memstatic_t) + 3) & ~3, TAG_STATIC, NULL, NULL, ZONEID}, {'9', '\0'} }
+memstatic_t emptystring =
+	{ {(sizeof(memblock_t)+2 + 3) & ~3, TAG_STATIC, NULL, NULL, ZONEID}, {'\0', '\0'} };
+memstatic_t numberstring[] = {
+	{ {(sizeof(memstatic_t) + 3) & ~3, TAG_STATIC, NULL, NULL, ZONEID}, {'0', '\0'} },
+	{ {(sizeof(memstatic_t) + 3) & ~3, TAG_STATIC, NULL, NULL, ZONEID}, {'1', '\0'} },
+	{ {(sizeof(memstatic_t) + 3) & ~3, TAG_STATIC, NULL, NULL, ZONEID}, {'2', '\0'} },
+	{ {(sizeof(memstatic_t) + 3) & ~3, TAG_STATIC, NULL, NULL, ZONEID}, {'3', '\0'} },
+	{ {(sizeof(memstatic_t) + 3) & ~3, TAG_STATIC, NULL, NULL, ZONEID}, {'4', '\0'} },
+	{ {(sizeof(memstatic_t) + 3) & ~3, TAG_STATIC, NULL, NULL, ZONEID}, {'5', '\0'} },
+	{ {(sizeof(memstatic_t) + 3) & ~3, TAG_STATIC, NULL, NULL, ZONEID}, {'6', '\0'} },
+	{ {(sizeof(memstatic_t) + 3) & ~3, TAG_STATIC, NULL, NULL, ZONEID}, {'7', '\0'} },
+	{ {(sizeof(memstatic_t) + 3) & ~3, TAG_STATIC, NULL, NULL, ZONEID}, {'8', '\0'} }, 
+	{ {(sizeof(memstatic_t) + 3) & ~3, TAG_STATIC, NULL, NULL, ZONEID}, {'9', '\0'} }
+};
+
+/*
+========================
+CopyString
+
+ NOTE:	never write over the memory CopyString returns because
+		memory from a memstatic_t might be returned
+========================
+*/
+char *CopyString( const char *in ) {
+	char	*out;
+
+	if (!in[0]) {
+		return ((char *)&emptystring) + sizeof(memblock_t);
+	}
+	else if (!in[1]) {
+		if (in[0] >= '0' && in[0] <= '9') {
+			return ((char *)&numberstring[in[0]-'0']) + sizeof(memblock_t);
+		}
+	}
+	out = S_Malloc (strlen(in)+1);
+	strcpy (out, in);
+	return out;
+}
+
+/*
+==============================================================================
+
+Goals:
+	reproducible without history effects -- no out of memory errors on weird map to map changes
+	allow restarting of the client without fragmentation
+	minimize total pages in use at run time
+	minimize total pages needed during load time
+
+  Single block of memory with stack allocators coming from both ends towards the middle.
+
+  One side is designated the temporary memory allocator.
+
+  Temporary memory can be allocated and freed in any order.
+
+  A highwater mark is kept of the most in use at any time.
+
+  When there is no temporary memory allocated, the permanent and temp sides
+  can be switched, allowing the already touched temp memory to be used for
+  permanent storage.
+
+  Temp memory must never be allocated on two ends at once, or fragmentation
+  could occur.
+
+  If we have any in-use temp memory, additional temp allocations must come from
+  that side.
+
+  If not, we can choose to make either side the new temp side and push future
+  permanent allocations to the other side.  Permanent allocations should be
+  kept on the side that has the current greatest wasted highwater mark.
+
+==============================================================================
+*/
+
+
+#define	HUNK_MAGIC	0x89537892
+#define	HUNK_FREE_MAGIC	0x89537893
+
+typedef struct {
+	int		magic;
+	int		size;
+} hunkHeader_t;
+
+typedef struct {
+	int		mark;
+	int		permanent;
+	int		temp;
+	int		tempHighwater;
+} hunkUsed_t;
+
+typedef struct hunkblock_s {
+	int size;
+	byte printed;
+	struct hunkblock_s *next;
+	char *label;
+	char *file;
+	int line;
+} hunkblock_t;
+
+static	hunkblock_t *hunkblocks;
+
+static	hunkUsed_t	hunk_low, hunk_high;
+static	hunkUsed_t	*hunk_permanent, *hunk_temp;
+
+static	byte	*s_hunkData = NULL;
+static	int		s_hunkTotal;
+
+static	int		s_zoneTotal;
+static	int		s_smallZoneTotal;
+
+
+/*
+=================
+Com_Meminfo_f
+=================
+*/
+void Com_Meminfo_f( void ) {
+	memblock_t	*block, *slabBlock;
+	slab_t		*slab;
+	int			zoneBytes, zoneBlocks;
+	int			smallZoneBytes;
+	int			botlibBytes, rendererBytes;
+	int			slabBytes, slabFreeBytes, numSlabs;
+	int			unused;
+	int			i;
+
+	zoneBytes = 0;
+	botlibBytes = 0;
+	rendererBytes = 0;
+	zoneBlocks = 0;
+	slabBytes = slabFreeBytes = numSlabs = 0;
+	for (block = mainzone->blocklist.next ; ; block = block->next) {
+		if ( Cmd_Argc() != 1 ) {
+			Com_Printf ("block:%p    size:%7i    tag:%3i\n",
+				(void *)block, block->size, block->tag);
+		}
+		if ( block->tag == TAG_SLAB ) {
+			// count the blocks in the slab instead
+			slab = (slab_t *)( block + 1 );
+			for ( i = 0 ; i < slab->numCarved ; i++ ) {
+				slabBlock = Z_SlabBlock( slab, i );
+				if ( !slabBlock->tag ) {
+					slabFreeBytes += slabBlock->size;
+					continue;
+				}
+				zoneBytes += slabBlock->size;
+				zoneBlocks++;
+				if ( slabBlock->tag == TAG_BOTLIB ) {
+					botlibBytes += slabBlock->size;
+				} else if ( slabBlock->tag == TAG_RENDERER ) {
+					rendererBytes += slabBlock->size;
+				}
+			}
+			slabBytes += block->size;
+			numSlabs++;
+		} else if ( block->tag ) {
+			zoneBytes += block->size;
+			zoneBlocks++;
+			if ( block->tag == TAG_BOTLIB ) {
+				botlibBytes += block->size;
+			} else if ( block->tag == TAG_RENDERER ) {
+				rendererBytes += block->size;
+			}
+		}
+
+		if (block->next == &mainzone->blocklist) {
+			break;			// all blocks have been hit	
+		}
+		if ( (byte *)block + block->size != (byte *)block->next) {
+			Com_Printf ("ERROR: block size does not touch the next block\n");
+		}
+		if ( block->next->prev != block) {
+			Com_Printf ("ERROR: next block doesn't have proper back link\n");
+		}
+		if ( !block->tag && !block->next->tag ) {
+			Com_Printf ("ERROR: two consecutive free blocks\n");
+		}
+	}
+
+	smallZoneBytes = 0;
+	for (block = smallzone->blocklist.next ; ; block = block->next) {
+		if ( block->tag == TAG_SLAB ) {
+			slab = (slab_t *)( block + 1 );
+			for ( i = 0 ; i < slab->numCarved ; i++ ) {
+				slabBlock = Z_SlabBlock( slab, i );
+				if ( slabBlock->tag ) {
+					smallZoneBytes += slabBlock->size;
+				}
+			}
+		} else if ( block->tag ) {
+			smallZoneBytes += block->size;
+		}
+
+		if (block->next == &smallzone->blocklist) {
+			break;			// all blocks have been hit	
+		}
+	}
+
+	Com_Printf( "%8i bytes total hunk\n", s_hunkTotal );
+	Com_Printf( "%8i bytes total zone\n", s_zoneTotal );
+	Com_Printf( "\n" );
+	Com_Printf( "%8i low mark\n", hunk_low.mark );
+	Com_Printf( "%8i low permanent\n", hunk_low.permanent );
+	if ( hunk_low.temp != hunk_low.permanent ) {
+		Com_Printf( "%8i low temp\n", hunk_low.temp );
+	}
+	Com_Printf( "%8i low tempHighwater\n", hunk_low.tempHighwater );
+	Com_Printf( "\n" );
+	Com_Printf( "%8i high mark\n", hunk_high.mark );
+	Com_Printf( "%8i high permanent\n", hunk_high.permanent );
+	if ( hunk_high.temp != hunk_high.permanent ) {
+		Com_Printf( "%8i high temp\n", hunk_high.temp );
+	}
+	Com_Printf( "%8i high tempHighwater\n", hunk_high.tempHighwater );
+	Com_Printf( "\n" );
+	Com_Printf( "%8i total hunk in use\n", hunk_low.permanent + hunk_high.permanent );
+	unused = 0;
+	if ( hunk_low.tempHighwater > hunk_low.permanent ) {
+		unused += hunk_low.tempHighwater - hunk_low.permanent;
+	}
+	if ( hunk_high.tempHighwater > hunk_high.permanent ) {
+		unused += hunk_high.tempHighwater - hunk_high.permanent;
+	}
+	Com_Printf( "%8i unused highwater\n", unused );
+	Com_Printf( "\n" );
+	Com_Printf( "%8i bytes in %i zone blocks\n", zoneBytes, zoneBlocks	);
+	Com_Printf( "        %8i bytes in dynamic botlib\n", botlibBytes );
+	Com_Printf( "        %8i bytes in dynamic renderer\n", rendererBytes );
+	Com_Printf( "        %8i bytes in dynamic other\n", zoneBytes - ( botlibBytes + rendererBytes ) );
+	Com_Printf( "        %8i bytes in small Zone memory\n", smallZoneBytes );
+	Com_Printf( "%8i bytes in %i main zone slabs, %i free\n", slabBytes, numSlabs, slabFreeBytes );
+}
+
+/*
+===============
+Com_TouchMemory
+
+Touch all known used data to make sure it is paged in
+===============
+*/
+void Com_TouchMemory( void ) {
+	int		start, end;
+	int		i, j;
+	unsigned	sum;
+	memblock_t	*block;
+
+	Z_CheckHeap();
+
+	start = Sys_Milliseconds();
+
+	sum = 0;
+
+	j = hunk_low.permanent >> 2;
+	for ( i = 0 ; i < j ; i+=64 ) {			// only need to touch each page
+		sum += ((int *)s_hunkData)[i];
+	}
+
+	i = ( s_hunkTotal - hunk_high.permanent ) >> 2;
+	j = hunk_high.permanent >> 2;
+	for (  ; i < j ; i+=64 ) {			// only need to touch each page
+		sum += ((int *)s_hunkData)[i];
+	}
+
+	for (block = mainzone->blocklist.next ; ; block = block->next) {
+		if ( block->tag ) {
+			j = block->size >> 2;
+			for ( i = 0 ; i < j ; i+=64 ) {				// only need to touch each page
+				sum += ((int *)block)[i];
+			}
+		}
+		if ( block->next == &mainzone->blocklist ) {
+			break;			// all blocks have been hit	
+		}
+	}
+
+	end = Sys_Milliseconds();
+
+	Com_Printf( "Com_TouchMemory: %i msec\n", end - start );
+}
+
+
+
+/*
+==============================================================================
+
+ZONE STATISTICS
+
+Dedicated servers stay up for weeks, so the zone keeps track of how its
+free space is split up.  zonestats prints the details, com_zoneLog prints
+a line for each zone every so many seconds, and Z_Defrag compacts what it
+can when the map changes.
+
+==============================================================================
+*/
+
+#define	ZONE_FREE_BUCKETS	16			// free blocks by size, from under 128 bytes up by powers of two
+
+typedef struct {
+	int		usedBytes, usedBlocks;
+	int		freeBytes, freeBlocks;
+	int		largestFree;
+	int		numSlabs, slabBytes, slabFreeBytes;
+	int		tagBytes[TAG_SLAB], tagBlocks[TAG_SLAB];
+	int		freeSizes[ZONE_FREE_BUCKETS];
+} zoneStats_t;
+
+static const char *zoneTagNames[TAG_SLAB] = {
+	"free", "general", "botlib", "renderer", "small", "static"
 };
 
+static cvar_t	*com_zoneLog;
+static cvar_t	*com_zoneDefrag;
+static int		z_lowestLargestFree[2] = { INT_MAX, INT_MAX };	// main and small zone
+
 /*
 ========================
-CopyString
+Z_CountUsedBlock
+========================
+*/
+static void Z_CountUsedBlock( zoneStats_t *stats, memblock_t *block ) {
+	stats->usedBytes += block->size;
+	stats->usedBlocks++;
+	if ( block->tag > 0 && block->tag < TAG_SLAB ) {
+		stats->tagBytes[block->tag] += block->size;
+		stats->tagBlocks[block->tag]++;
+	}
+}
 
- NOTE:	never write over the memory CopyString returns because
-		memory from a memstatic_t might be returned
+/*
+========================
+Z_ZoneStats
+
+Walks a zone, only while no jobs are running
 ========================
 */
-char *CopyString( const char *in ) {
-	char	*out;
+static void Z_ZoneStats( memzone_t *zone, zoneStats_t *stats ) {
+	memblock_t	*block, *slabBlock;
+	slab_t		*slab;
+	int			i, bucket;
+
+	Com_Memset( stats, 0, sizeof( *stats ) );
+	for ( block = zone->blocklist.next ; block != &zone->blocklist ; block = block->next ) {
+		if ( block->tag == TAG_SLAB ) {
+			slab = (slab_t *)( block + 1 );
+			for ( i = 0 ; i < slab->numCarved ; i++ ) {
+				slabBlock = Z_SlabBlock( slab, i );
+				if ( slabBlock->tag ) {
+					Z_CountUsedBlock( stats, slabBlock );
+				}
+			}
+			stats->numSlabs++;
+			stats->slabBytes += block->size;
+			stats->slabFreeBytes += slab->numFree * slabBlockSizes[slab->sizeClass];
+		} else if ( block->tag ) {
+			Z_CountUsedBlock( stats, block );
+		} else {
+			stats->freeBytes += block->size;
+			stats->freeBlocks++;
+			if ( block->size > stats->largestFree ) {
+				stats->largestFree = block->size;
+			}
+			for ( bucket = 0 ; bucket < ZONE_FREE_BUCKETS - 1 && block->size >= ( 128 << bucket ) ; bucket++ ) {
+			}
+			stats->freeSizes[bucket]++;
+		}
+	}
 
-	if (!in[0]) {
-		return ((char *)&emptystring) + sizeof(memblock_t);
+	if ( stats->largestFree < z_lowestLargestFree[zone == smallzone] ) {
+		z_lowestLargestFree[zone == smallzone] = stats->largestFree;
 	}
-	else if (!in[1]) {
-		if (in[0] >= '0' && in[0] <= '9') {
-			return ((char *)&numberstring[in[0]-'0']) + sizeof(memblock_t);
+}
+
+/*
+========================
+Z_Fragmentation
+
+Percentage of the free bytes that are not in the largest free block
+========================
+*/
+static int Z_Fragmentation( const zoneStats_t *stats ) {
+	if ( !stats->freeBytes ) {
+		return 0;
+	}
+	return (int)( 100.0 * ( stats->freeBytes - stats->largestFree ) / stats->freeBytes );
+}
+
+#ifdef ZONE_DEBUG
+typedef struct {
+	const char	*file;
+	int			line;
+	const char	*label;
+	int			bytes, blocks;
+} zoneSite_t;
+
+#define	MAX_ZONE_SITES		1024
+#define	ZONE_SITES_PRINTED	20
+
+/*
+========================
+Z_CountSite
+========================
+*/
+static void Z_CountSite( zoneSite_t *sites, int *numSites, memblock_t *block ) {
+	int		i;
+
+	for ( i = 0 ; i < *numSites ; i++ ) {
+		if ( sites[i].line == block->d.line && !strcmp( sites[i].file, block->d.file ) ) {
+			break;
 		}
 	}
-	out = S_Malloc (strlen(in)+1);
-	strcpy (out, in);
-	return out;
+	if ( i == *numSites ) {
+		if ( *numSites == MAX_ZONE_SITES ) {
+			return;
+		}
+		sites[i].file = block->d.file;
+		sites[i].line = block->d.line;
+		sites[i].label = block->d.label;
+		sites[i].bytes = sites[i].blocks = 0;
+		(*numSites)++;
+	}
+	sites[i].bytes += block->size;
+	sites[i].blocks++;
 }
 
 /*
-==============================================================================
+========================
+Z_CompareSites
+========================
+*/
+static int Z_CompareSites( const void *a, const void *b ) {
+	return ((const zoneSite_t *)b)->bytes - ((const zoneSite_t *)a)->bytes;
+}
 
-Goals:
-	reproducible without history effects -- no out of memory errors on weird map to map changes
-	allow restarting of the client without fragmentation
-	minimize total pages in use at run time
-	minimize total pages needed during load time
+/*
+========================
+Z_PrintSites
 
-  Single block of memory with stack allocators coming from both ends towards the middle.
+The allocation sites holding the most of a zone
+========================
+*/
+static void Z_PrintSites( memzone_t *zone ) {
+	memblock_t	*block, *slabBlock;
+	slab_t		*slab;
+	zoneSite_t	*sites;
+	int			numSites;
+	int			i;
 
-  One side is designated the temporary memory allocator.
+	sites = malloc( MAX_ZONE_SITES * sizeof( *sites ) );
+	if ( !sites ) {
+		return;
+	}
 
-  Temporary memory can be allocated and freed in any order.
+	numSites = 0;
+	for ( block = zone->blocklist.next ; block != &zone->blocklist ; block = block->next ) {
+		if ( block->tag == TAG_SLAB ) {
+			slab = (slab_t *)( block + 1 );
+			for ( i = 0 ; i < slab->numCarved ; i++ ) {
+				slabBlock = Z_SlabBlock( slab, i );
+				if ( slabBlock->tag ) {
+					Z_CountSite( sites, &numSites, slabBlock );
+				}
+			}
+		} else if ( block->tag ) {
+			Z_CountSite( sites, &numSites, block );
+		}
+	}
 
-  A highwater mark is kept of the most in use at any time.
+	qsort( sites, numSites, sizeof( *sites ), Z_CompareSites );
+	Com_Printf( "  largest allocation sites:\n" );
+	for ( i = 0 ; i < numSites && i < ZONE_SITES_PRINTED ; i++ ) {
+		Com_Printf( "  %9i bytes in %6i blocks  %s:%i (%s)\n", sites[i].bytes, sites[i].blocks,
+			sites[i].file, sites[i].line, sites[i].label );
+	}
 
-  When there is no temporary memory allocated, the permanent and temp sides
-  can be switched, allowing the already touched temp memory to be used for
-  permanent storage.
+	free( sites );
+}
+#endif
 
-  Temp memory must never be allocated on two ends at once, or fragmentation
-  could occur.
+/*
+========================
+Z_PrintZoneStats
+========================
+*/
+static void Z_PrintZoneStats( memzone_t *zone, const char *name ) {
+	zoneStats_t	stats;
+	int			i;
 
-  If we have any in-use temp memory, additional temp allocations must come from
-  that side.
+	Z_ZoneStats( zone, &stats );
 
-  If not, we can choose to make either side the new temp side and push future
-  permanent allocations to the other side.  Permanent allocations should be
-  kept on the side that has the current greatest wasted highwater mark.
+	Com_Printf( "%s zone: %i bytes, %i in use, peak %i\n", name,
+		zone->size, zone->used, zone->peakUsed );
+	Com_Printf( "  %i allocated in %i blocks\n", stats.usedBytes, stats.usedBlocks );
+	Com_Printf( "  %i free in %i blocks, largest %i (lowest seen %i), %i%% fragmented\n",
+		stats.freeBytes, stats.freeBlocks, stats.largestFree,
+		z_lowestLargestFree[zone == smallzone], Z_Fragmentation( &stats ) );
+	if ( stats.numSlabs ) {
+		Com_Printf( "  %i bytes in %i slabs, %i free in them\n",
+			stats.slabBytes, stats.numSlabs, stats.slabFreeBytes );
+	}
 
-==============================================================================
+	Com_Printf( "  free blocks by size:\n" );
+	for ( i = 0 ; i < ZONE_FREE_BUCKETS ; i++ ) {
+		if ( !stats.freeSizes[i] ) {
+			continue;
+		}
+		if ( !i ) {
+			Com_Printf( "  %9s %6i\n", "< 128", stats.freeSizes[i] );
+		} else {
+			Com_Printf( "  %8i+ %6i\n", 64 << i, stats.freeSizes[i] );
+		}
+	}
+
+	Com_Printf( "  used by tag:\n" );
+	for ( i = TAG_GENERAL ; i < TAG_SLAB ; i++ ) {
+		if ( stats.tagBlocks[i] ) {
+			Com_Printf( "  %9i bytes in %6i blocks  %s\n", stats.tagBytes[i], stats.tagBlocks[i], zoneTagNames[i] );
+		}
+	}
+
+#ifdef ZONE_DEBUG
+	Z_PrintSites( zone );
+#endif
+}
+
+/*
+========================
+Z_Stats_f
+========================
+*/
+static void Z_Stats_f( void ) {
+	if ( Cmd_Argc() > 1 && !Q_stricmp( Cmd_Argv( 1 ), "small" ) ) {
+		Z_PrintZoneStats( smallzone, "small" );
+		return;
+	}
+	Z_PrintZoneStats( mainzone, "main" );
+	if ( Cmd_Argc() == 1 ) {
+		Z_PrintZoneStats( smallzone, "small" );
+	}
+}
+
+/*
+========================
+Z_LogLine
+========================
 */
+static void Z_LogLine( memzone_t *zone, const char *name ) {
+	zoneStats_t	stats;
 
+	Z_ZoneStats( zone, &stats );
+	Com_Printf( "zone %s: %i in use (peak %i), %i free in %i blocks, largest %i (lowest %i), %i%% fragmented\n",
+		name, zone->used, zone->peakUsed, stats.freeBytes, stats.freeBlocks,
+		stats.largestFree, z_lowestLargestFree[zone == smallzone], Z_Fragmentation( &stats ) );
+}
 
-#define	HUNK_MAGIC	0x89537892
-#define	HUNK_FREE_MAGIC	0x89537893
+/*
+========================
+Z_LogFrame
 
-typedef struct {
-	int		magic;
-	int		size;
-} hunkHeader_t;
+Called at the end of every Com_Frame, prints the zone lines every
+com_zoneLog seconds
+========================
+*/
+static void Z_LogFrame( void ) {
+	static int	lastLog;
+	int			now;
+
+	if ( com_zoneLog->integer <= 0 ) {
+		return;
+	}
+	now = Sys_Milliseconds();
+	if ( lastLog && now - lastLog < com_zoneLog->integer * 1000 ) {
+		return;
+	}
+	lastLog = now;
+
+	Z_LogLine( mainzone, "main" );
+	Z_LogLine( smallzone, "small" );
+}
+
+/*
+========================
+Z_Defrag
+
+Compacts the zone while nothing else is allocating, like at a map change.
+The cvar and command strings in the small zone are moved into fuller
+slabs or further down, empty slabs are released and allocation starts
+over from the bottom of each zone.  Nothing else can be moved, the zone
+hands out plain pointers.
+========================
+*/
+void Z_Defrag( void ) {
+	zoneStats_t	mainStats, smallStats;
+	int			largestMain, largestSmall;
+	int			released;
+
+	Z_ZoneStats( mainzone, &mainStats );
+	Z_ZoneStats( smallzone, &smallStats );
+	largestMain = mainStats.largestFree;
+	largestSmall = smallStats.largestFree;
+
+	Z_FlushThreadCache();
+
+	z_numMoved = 0;
+	Cvar_CompactStrings();
+	Cmd_CompactCommands();
+
+	Sys_LockMutex( z_mutex );
+	released = Z_ReleaseEmptySlabs( mainzone, qtrue );
+	released += Z_ReleaseEmptySlabs( smallzone, qtrue );
+	mainzone->rover = mainzone->blocklist.next;
+	smallzone->rover = smallzone->blocklist.next;
+	Sys_UnlockMutex( z_mutex );
+
+	Z_ZoneStats( mainzone, &mainStats );
+	Z_ZoneStats( smallzone, &smallStats );
+	Com_Printf( "zone defrag: moved %i blocks, released %i slabs, largest free %i -> %i, small %i -> %i\n",
+		z_numMoved, released, largestMain, mainStats.largestFree, largestSmall, smallStats.largestFree );
+}
+
+/*
+========================
+Z_MapChange
+
+Called by the server between maps
+========================
+*/
+void Z_MapChange( void ) {
+	if ( com_zoneDefrag->integer ) {
+		Z_Defrag();
+	}
+}
+
+/*
+==============================================================================
+
+ZONE BENCHMARK
+
+==============================================================================
+*/
+
+#define	ZONEBENCH_SLOTS			4096
+#define	ZONEBENCH_JOB_SLOTS		256
 
 typedef struct {
-	int		mark;
-	int		permanent;
-	int		temp;
-	int		tempHighwater;
-} hunkUsed_t;
+	int		seed;
+	int		ops;
+	void	*slots[ZONEBENCH_JOB_SLOTS];
+} zoneBenchJob_t;
 
-typedef struct hunkblock_s {
-	int size;
-	byte printed;
-	struct hunkblock_s *next;
-	char *label;
-	char *file;
-	int line;
-} hunkblock_t;
+/*
+=================
+Com_ZoneBenchRand
 
-static	hunkblock_t *hunkblocks;
+Q_rand is a plain LCG, its low bits repeat after a few steps
+=================
+*/
+static int Com_ZoneBenchRand( int *seed, int range ) {
+	return ( ( Q_rand( seed ) >> 8 ) & 0xffffff ) % range;
+}
 
-static	hunkUsed_t	hunk_low, hunk_high;
-static	hunkUsed_t	*hunk_permanent, *hunk_temp;
+/*
+=================
+Com_ZoneBenchSize
 
-static	byte	*s_hunkData = NULL;
-static	int		s_hunkTotal;
+Mostly small structures and strings, some buffers, like the botlib
+=================
+*/
+static int Com_ZoneBenchSize( int *seed ) {
+	int		r;
 
-static	int		s_zoneTotal;
-static	int		s_smallZoneTotal;
+	r = Com_ZoneBenchRand( seed, 100 );
+	if ( r < 80 ) {
+		return 8 + Com_ZoneBenchRand( seed, 248 );
+	}
+	if ( r < 95 ) {
+		return 256 + Com_ZoneBenchRand( seed, 1792 );
+	}
+	return 2048 + Com_ZoneBenchRand( seed, 14336 );
+}
+
+/*
+=================
+Com_ZoneBenchFreeBlocks
+
+Free blocks in the main zone block list, a measure of fragmentation
+=================
+*/
+static int Com_ZoneBenchFreeBlocks( void ) {
+	memblock_t	*block;
+	int			count;
 
+	count = 0;
+	for ( block = mainzone->blocklist.next ; block != &mainzone->blocklist ; block = block->next ) {
+		if ( !block->tag ) {
+			count++;
+		}
+	}
+	return count;
+}
 
 /*
 =================
-Com_Meminfo_f
+Com_ZoneBenchCvars
+
+Cvar_Set frees the old string and copies the new one every time
 =================
 */
-void Com_Meminfo_f( void ) {
-	memblock_t	*block;
-	int			zoneBytes, zoneBlocks;
-	int			smallZoneBytes;
-	int			botlibBytes, rendererBytes;
-	int			unused;
+static int Com_ZoneBenchCvars( int passes ) {
+	int64_t	start;
+	int		i, j;
 
-	zoneBytes = 0;
-	botlibBytes = 0;
-	rendererBytes = 0;
-	zoneBlocks = 0;
-	for (block = mainzone->blocklist.next ; ; block = block->next) {
-		if ( Cmd_Argc() != 1 ) {
-			Com_Printf ("block:%p    size:%7i    tag:%3i\n",
-				(void *)block, block->size, block->tag);
-		}
-		if ( block->tag ) {
-			zoneBytes += block->size;
-			zoneBlocks++;
-			if ( block->tag == TAG_BOTLIB ) {
-				botlibBytes += block->size;
-			} else if ( block->tag == TAG_RENDERER ) {
-				rendererBytes += block->size;
-			}
-		}
+	Cvar_Get( "zonebench", "", CVAR_TEMP );
 
-		if (block->next == &mainzone->blocklist) {
-			break;			// all blocks have been hit	
-		}
-		if ( (byte *)block + block->size != (byte *)block->next) {
-			Com_Printf ("ERROR: block size does not touch the next block\n");
+	start = Sys_Microseconds();
+	for ( i = 0 ; i < passes ; i++ ) {
+		for ( j = 0 ; j < 1024 ; j++ ) {
+			Cvar_Set( "zonebench", va( "%*i", 1 + ( j * 7 ) % 48, j ) );
 		}
-		if ( block->next->prev != block) {
-			Com_Printf ("ERROR: next block doesn't have proper back link\n");
+	}
+	return Sys_Microseconds() - start;
+}
+
+/*
+=================
+Com_ZoneBenchCmds
+=================
+*/
+static int Com_ZoneBenchCmds( int passes ) {
+	int64_t	start;
+	int		i, j;
+
+	start = Sys_Microseconds();
+	for ( i = 0 ; i < passes ; i++ ) {
+		for ( j = 0 ; j < 64 ; j++ ) {
+			Cmd_AddCommand( va( "zonebench%i", j ), NULL );
 		}
-		if ( !block->tag && !block->next->tag ) {
-			Com_Printf ("ERROR: two consecutive free blocks\n");
+		for ( j = 63 ; j >= 0 ; j-- ) {
+			Cmd_RemoveCommand( va( "zonebench%i", j ) );
 		}
 	}
+	return Sys_Microseconds() - start;
+}
 
-	smallZoneBytes = 0;
-	for (block = smallzone->blocklist.next ; ; block = block->next) {
-		if ( block->tag ) {
-			smallZoneBytes += block->size;
-		}
+/*
+=================
+Com_ZoneBenchBotlib
 
-		if (block->next == &smallzone->blocklist) {
-			break;			// all blocks have been hit	
+Random allocations and frees with botlib sizes.  Reports the free blocks
+left in the block list before the cleanup.
+=================
+*/
+static int Com_ZoneBenchBotlib( int passes, int *fragments ) {
+	void	**slots;
+	int64_t	start;
+	int		i, j, seed;
+
+	slots = calloc( ZONEBENCH_SLOTS, sizeof( *slots ) );
+	if ( !slots ) {
+		*fragments = 0;
+		return 0;
+	}
+
+	seed = 0x5eed;
+	start = Sys_Microseconds();
+	for ( i = 0 ; i < passes ; i++ ) {
+		for ( j = 0 ; j < ZONEBENCH_SLOTS ; j++ ) {
+			void	**slot = &slots[Com_ZoneBenchRand( &seed, ZONEBENCH_SLOTS )];
+
+			if ( *slot ) {
+				Z_Free( *slot );
+				*slot = NULL;
+			} else {
+				*slot = Z_TagMalloc( Com_ZoneBenchSize( &seed ), TAG_BOTLIB );
+			}
 		}
 	}
+	*fragments = Com_ZoneBenchFreeBlocks();
 
-	Com_Printf( "%8i bytes total hunk\n", s_hunkTotal );
-	Com_Printf( "%8i bytes total zone\n", s_zoneTotal );
-	Com_Printf( "\n" );
-	Com_Printf( "%8i low mark\n", hunk_low.mark );
-	Com_Printf( "%8i low permanent\n", hunk_low.permanent );
-	if ( hunk_low.temp != hunk_low.permanent ) {
-		Com_Printf( "%8i low temp\n", hunk_low.temp );
-	}
-	Com_Printf( "%8i low tempHighwater\n", hunk_low.tempHighwater );
-	Com_Printf( "\n" );
-	Com_Printf( "%8i high mark\n", hunk_high.mark );
-	Com_Printf( "%8i high permanent\n", hunk_high.permanent );
-	if ( hunk_high.temp != hunk_high.permanent ) {
-		Com_Printf( "%8i high temp\n", hunk_high.temp );
+	for ( j = 0 ; j < ZONEBENCH_SLOTS ; j++ ) {
+		if ( slots[j] ) {
+			Z_Free( slots[j] );
+		}
 	}
-	Com_Printf( "%8i high tempHighwater\n", hunk_high.tempHighwater );
-	Com_Printf( "\n" );
-	Com_Printf( "%8i total hunk in use\n", hunk_low.permanent + hunk_high.permanent );
-	unused = 0;
-	if ( hunk_low.tempHighwater > hunk_low.permanent ) {
-		unused += hunk_low.tempHighwater - hunk_low.permanent;
+	free( slots );
+
+	return Sys_Microseconds() - start;
+}
+
+/*
+=================
+Com_ZoneBenchJob
+=================
+*/
+static void Com_ZoneBenchJob( void *data, int index ) {
+	zoneBenchJob_t	*job;
+	void			**slot;
+	int				i;
+
+	job = (zoneBenchJob_t *)data + index;
+	for ( i = 0 ; i < job->ops ; i++ ) {
+		slot = &job->slots[Com_ZoneBenchRand( &job->seed, ZONEBENCH_JOB_SLOTS )];
+		if ( *slot ) {
+			Z_Free( *slot );
+			*slot = NULL;
+		} else {
+			*slot = Z_TagMalloc( 8 + Com_ZoneBenchRand( &job->seed, 248 ), TAG_GENERAL );
+		}
 	}
-	if ( hunk_high.tempHighwater > hunk_high.permanent ) {
-		unused += hunk_high.tempHighwater - hunk_high.permanent;
+	for ( i = 0 ; i < ZONEBENCH_JOB_SLOTS ; i++ ) {
+		if ( job->slots[i] ) {
+			Z_Free( job->slots[i] );
+			job->slots[i] = NULL;
+		}
 	}
-	Com_Printf( "%8i unused highwater\n", unused );
-	Com_Printf( "\n" );
-	Com_Printf( "%8i bytes in %i zone blocks\n", zoneBytes, zoneBlocks	);
-	Com_Printf( "        %8i bytes in dynamic botlib\n", botlibBytes );
-	Com_Printf( "        %8i bytes in dynamic renderer\n", rendererBytes );
-	Com_Printf( "        %8i bytes in dynamic other\n", zoneBytes - ( botlibBytes + rendererBytes ) );
-	Com_Printf( "        %8i bytes in small Zone memory\n", smallZoneBytes );
 }
 
 /*
-===============
-Com_TouchMemory
+=================
+Com_ZoneBenchJobs
 
-Touch all known used data to make sure it is paged in
-===============
+Small allocations from every thread at once
+=================
 */
-void Com_TouchMemory( void ) {
-	int		start, end;
-	int		i, j;
-	unsigned	sum;
-	memblock_t	*block;
+static int Com_ZoneBenchJobs( int passes, int numJobs ) {
+	zoneBenchJob_t	*jobs;
+	int64_t			start;
+	int				i;
 
-	Z_CheckHeap();
+	jobs = calloc( numJobs, sizeof( *jobs ) );
+	if ( !jobs ) {
+		return 0;
+	}
+	for ( i = 0 ; i < numJobs ; i++ ) {
+		jobs[i].seed = 0x1000 + i;
+		jobs[i].ops = passes * ZONEBENCH_SLOTS;
+	}
 
-	start = Sys_Milliseconds();
+	start = Sys_Microseconds();
+	Com_RunJobs( Com_ZoneBenchJob, jobs, numJobs );
+	i = Sys_Microseconds() - start;
 
-	sum = 0;
+	free( jobs );
+	return i;
+}
 
-	j = hunk_low.permanent >> 2;
-	for ( i = 0 ; i < j ; i+=64 ) {			// only need to touch each page
-		sum += ((int *)s_hunkData)[i];
-	}
+/*
+=================
+Com_ZoneBench_f
 
-	i = ( s_hunkTotal - hunk_high.permanent ) >> 2;
-	j = hunk_high.permanent >> 2;
-	for (  ; i < j ; i+=64 ) {			// only need to touch each page
-		sum += ((int *)s_hunkData)[i];
-	}
+zonebench [passes]
 
-	for (block = mainzone->blocklist.next ; ; block = block->next) {
-		if ( block->tag ) {
-			j = block->size >> 2;
-			for ( i = 0 ; i < j ; i+=64 ) {				// only need to touch each page
-				sum += ((int *)block)[i];
-			}
-		}
-		if ( block->next == &mainzone->blocklist ) {
-			break;			// all blocks have been hit	
+Times allocation heavy work with everything going through the block list
+and with small allocations from the slabs
+=================
+*/
+void Com_ZoneBench_f( void ) {
+	int			cvars[2], cmds[2], botlib[2], fragments[2], jobs[2];
+	int			passes, numJobs, i;
+	qboolean	useSlabs;
+
+	passes = 20;
+	if ( Cmd_Argc() > 1 ) {
+		passes = atoi( Cmd_Argv( 1 ) );
+		if ( passes < 1 ) {
+			passes = 1;
 		}
 	}
+	numJobs = Com_NumWorkers() + 1;
 
-	end = Sys_Milliseconds();
-
-	Com_Printf( "Com_TouchMemory: %i msec\n", end - start );
-}
+	useSlabs = z_useSlabs;
+	for ( i = 0 ; i < 2 ; i++ ) {
+		z_useSlabs = i;
+		cvars[i] = Com_ZoneBenchCvars( passes );
+		cmds[i] = Com_ZoneBenchCmds( passes );
+		botlib[i] = Com_ZoneBenchBotlib( passes, &fragments[i] );
+		jobs[i] = Com_ZoneBenchJobs( passes, numJobs );
+	}
+	z_useSlabs = useSlabs;
 
+	Z_CheckHeap();
 
+	Com_Printf( "%i passes, times in usec\n", passes );
+	Com_Printf( "                   first fit      slabs\n" );
+	Com_Printf( "cvar churn        %10i %10i\n", cvars[0], cvars[1] );
+	Com_Printf( "cmd churn         %10i %10i\n", cmds[0], cmds[1] );
+	Com_Printf( "botlib pattern    %10i %10i\n", botlib[0], botlib[1] );
+	Com_Printf( "  free fragments  %10i %10i\n", fragments[0], fragments[1] );
+	Com_Printf( "%2i threads        %10i %10i\n", numJobs, jobs[0], jobs[1] );
+}
 
 /*
 =================
@@ -1421,12 +2747,22 @@ Com_InitZoneMemory
 =================
 */
 void Com_InitSmallZoneMemory( void ) {
+	int		i, j;
+
+	for ( i = 0, j = 0 ; i <= SLAB_MAX_BLOCK / 16 ; i++ ) {
+		while ( slabBlockSizes[j] < i * 16 ) {
+			j++;
+		}
+		slabClassForSize[i] = j;
+	}
+	z_mutex = Sys_CreateMutex();
+
 	s_smallZoneTotal = 512 * 1024;
 	smallzone = calloc( s_smallZoneTotal, 1 );
 	if ( !smallzone ) {
 		Com_Error( ERR_FATAL, "Small zone data failed to allocate %1.1f megs", (float)s_smallZoneTotal / (1024*1024) );
 	}
-	Z_ClearZone( smallzone, s_smallZoneTotal );
+	Z_ClearZone( smallzone, s_smallZoneTotal, SMALLZONE_SLAB_SIZE );
 }
 
 void Com_InitZoneMemory( void ) {
@@ -1451,7 +2787,15 @@ void Com_InitZoneMemory( void ) {
 	if ( !mainzone ) {
 		Com_Error( ERR_FATAL, "Zone data failed to allocate %i megs", s_zoneTotal / (1024*1024) );
 	}
-	Z_ClearZone( mainzone, s_zoneTotal );
+	Z_ClearZone( mainzone, s_zoneTotal, MAINZONE_SLAB_SIZE );
+
+	// small allocations from slabs, 0 puts everything through the block list
+	cv = Cvar_Get( "com_zoneSlabs", "1", CVAR_LATCH | CVAR_ARCHIVE );
+	z_useSlabs = ( cv->integer != 0 );
+
+	// seconds between zone lines in the log, 0 for none
+	com_zoneLog = Cvar_Get( "com_zoneLog", "0", CVAR_ARCHIVE );
+	com_zoneDefrag = Cvar_Get( "com_zoneDefrag", "1", CVAR_ARCHIVE );
 
 }
 
@@ -1581,6 +2925,9 @@ void Com_InitHunkMemory( void ) {
 	Hunk_Clear();
 
 	Cmd_AddCommand( "meminfo", Com_Meminfo_f );
+	Cmd_AddCommand( "zonebench", Com_ZoneBench_f );
+	Cmd_AddCommand( "zonestats", Z_Stats_f );
+	Cmd_AddCommand( "zonedefrag", Z_Defrag );
 #ifdef ZONE_DEBUG
 	Cmd_AddCommand( "zonelog", Z_LogHeap );
 #endif
@@ -2165,7 +3512,9 @@ void Com_RunAndTimeServerPacket( netadr_t *evFrom, msg_t *buf ) {
 		t1 = Sys_Milliseconds ();
 	}
 
+	PROF_BEGIN( PROF_SV_PACKET );
 	SV_PacketEvent( *evFrom, buf );
+	PROF_END( PROF_SV_PACKET );
 
 	if ( com_speeds->integer ) {
 		t2 = Sys_Milliseconds ();
@@ -2643,6 +3992,195 @@ static void Com_DetectSSE(void)
 
 #endif
 
+/*
+==============================================================================
+
+WORKER THREADS
+
+A small pool of threads for data-parallel work inside a frame.  Com_RunJobs
+hands out job indices to the workers and the calling thread and returns when
+all of them are finished.  Jobs must not call Com_Error, print, allocate from
+the hunk, or start other jobs.  The zone is fine.
+==============================================================================
+*/
+
+#define	MAX_WORKERS		16
+
+typedef struct {
+	sysMutex_t	*mutex;
+	sysCond_t	*wake;			// a batch was posted or the pool is shutting down
+	sysCond_t	*done;			// the last job of a batch has finished
+	sysThread_t	*threads[MAX_WORKERS];
+	int			numThreads;
+	qboolean	quit;
+
+	jobFunc_t	func;
+	void		*data;
+	int			count;
+	int			next;			// next unclaimed job index
+	int			finished;
+} workerPool_t;
+
+static workerPool_t	workers;
+cvar_t	*com_workers;
+
+/*
+=================
+Com_WorkerThread
+=================
+*/
+static void Com_WorkerThread( void *arg ) {
+	int		index;
+
+	Sys_LockMutex( workers.mutex );
+	for ( ;; ) {
+		while ( !workers.quit && workers.next >= workers.count ) {
+			Sys_WaitCond( workers.wake, workers.mutex );
+		}
+		if ( workers.quit ) {
+			break;
+		}
+
+		index = workers.next++;
+		Sys_UnlockMutex( workers.mutex );
+
+		workers.func( workers.data, index );
+
+		Sys_LockMutex( workers.mutex );
+		if ( ++workers.finished == workers.count ) {
+			Sys_SignalCond( workers.done );
+		}
+	}
+	Sys_UnlockMutex( workers.mutex );
+
+	Z_FlushThreadCache();
+}
+
+/*
+=================
+Com_InitWorkers
+
+Called once before the filesystem starts, with com_workers from the command
+line, so pk3 scanning can use the pool, and again after the configs have
+run.  The pool is only rebuilt if the count changed.
+=================
+*/
+void Com_InitWorkers( void ) {
+	int		i, count;
+
+	com_workers = Cvar_Get( "com_workers", "0", CVAR_ARCHIVE | CVAR_LATCH );
+	Cvar_CheckRange( com_workers, 0, MAX_WORKERS, qtrue );
+
+	count = com_workers->integer;
+	if ( workers.mutex ) {
+		if ( count == workers.numThreads ) {
+			return;
+		}
+		Com_ShutdownWorkers();
+	}
+	if ( count <= 0 ) {
+		return;
+	}
+
+	workers.mutex = Sys_CreateMutex();
+	workers.wake = Sys_CreateCond();
+	workers.done = Sys_CreateCond();
+
+	for ( i = 0 ; i < count ; i++ ) {
+		workers.threads[i] = Sys_CreateThread( Com_WorkerThread, NULL );
+		if ( !workers.threads[i] ) {
+			Com_Printf( S_COLOR_YELLOW "WARNING: could only start %i of %i worker threads\n", i, count );
+			break;
+		}
+	}
+	workers.numThreads = i;
+
+	Com_Printf( "%i worker threads\n", workers.numThreads );
+}
+
+/*
+=================
+Com_ShutdownWorkers
+=================
+*/
+void Com_ShutdownWorkers( void ) {
+	int		i;
+
+	if ( !workers.mutex ) {
+		return;
+	}
+
+	Sys_LockMutex( workers.mutex );
+	workers.quit = qtrue;
+	Sys_BroadcastCond( workers.wake );
+	Sys_UnlockMutex( workers.mutex );
+
+	for ( i = 0 ; i < workers.numThreads ; i++ ) {
+		Sys_JoinThread( workers.threads[i] );
+	}
+
+	Sys_DestroyCond( workers.done );
+	Sys_DestroyCond( workers.wake );
+	Sys_DestroyMutex( workers.mutex );
+	Com_Memset( &workers, 0, sizeof( workers ) );
+}
+
+/*
+=================
+Com_NumWorkers
+
+Returns the number of threads besides the main one that run jobs
+=================
+*/
+int Com_NumWorkers( void ) {
+	return workers.numThreads;
+}
+
+/*
+=================
+Com_RunJobs
+
+Calls func( data, i ) for every i in [0, count) and waits for all of them.
+Without worker threads the jobs are run in order on the calling thread.
+Jobs must not call Com_Error, directly or through a failed Z_Malloc,
+there is nothing to longjmp to on a worker thread.
+=================
+*/
+void Com_RunJobs( jobFunc_t func, void *data, int count ) {
+	int		index;
+
+	if ( !workers.numThreads || count <= 1 ) {
+		for ( index = 0 ; index < count ; index++ ) {
+			func( data, index );
+		}
+		return;
+	}
+
+	Sys_LockMutex( workers.mutex );
+	workers.func = func;
+	workers.data = data;
+	workers.next = 0;
+	workers.finished = 0;
+	workers.count = count;
+	Sys_BroadcastCond( workers.wake );
+
+	// lend a hand instead of sleeping
+	while ( workers.next < workers.count ) {
+		index = workers.next++;
+		Sys_UnlockMutex( workers.mutex );
+
+		func( data, index );
+
+		Sys_LockMutex( workers.mutex );
+		workers.finished++;
+	}
+
+	while ( workers.finished < workers.count ) {
+		Sys_WaitCond( workers.done, workers.mutex );
+	}
+	Sys_UnlockMutex( workers.mutex );
+}
+
 /*
 =================
 Com_InitRand
@@ -2711,6 +4249,7 @@ void Com_Init( char *commandLine ) {
 	com_basegame = Cvar_Get("com_basegame", BASEGAME, CVAR_INIT);
 	com_homepath = Cvar_Get("com_homepath", "", CVAR_INIT|CVAR_PROTECTED);
 
+	Com_InitWorkers();
 	FS_InitFilesystem ();
 
 	Com_InitJournaling();
@@ -2725,6 +4264,7 @@ void Com_Init( char *commandLine ) {
 	}
 	Cmd_AddCommand ("quit", Com_Quit_f);
 	Cmd_AddCommand ("changeVectors", MSG_ReportChangeVectors_f );
+	Cmd_AddCommand ("msgbench", MSG_Bench_f );
 	Cmd_AddCommand ("writeconfig", Com_WriteConfig_f );
 	Cmd_SetCommandCompletionFunc( "writeconfig", Cmd_CompleteCfgName );
 	Cmd_AddCommand("game_restart", Com_GameRestart_f);
@@ -2808,6 +4348,9 @@ void Com_Init( char *commandLine ) {
 
 	Sys_InitPIDFile( FS_GetCurrentGameDir() );
 
+	Com_InitWorkers();
+	Prof_Init();
+
 	// Pick a random port value
 	Com_RandomBytes( (byte*)&qport, sizeof(int) );
 	Netchan_Init( qport & 0xffff );
@@ -2819,6 +4362,9 @@ void Com_Init( char *commandLine ) {
 #ifndef DEDICATED
 	CL_Init();
 #endif
+#ifdef LOADTEST
+	LT_Init();
+#endif
 
 	// set com_frameTime so that if a map is started on the
 	// command line it will still be able to count on com_frameTime
@@ -3087,6 +4633,9 @@ void Com_Frame( void ) {
 	int		timeBeforeEvents;
 	int		timeBeforeClient;
 	int		timeAfter;
+#ifdef LOADTEST
+	int64_t	serverStart;
+#endif
   
 
 	if ( setjmp (abortframe) ) {
@@ -3113,7 +4662,12 @@ void Com_Frame( void ) {
 	if(!com_timedemo->integer)
 	{
 		if(com_dedicated->integer)
+		{
 			minMsec = SV_FrameMsec();
+#ifdef LOADTEST
+			minMsec = LT_FrameMsec(minMsec);
+#endif
+		}
 		else
 		{
 			if(com_minimized->integer && com_maxfpsMinimized->integer > 0)
@@ -3158,11 +4712,15 @@ void Com_Frame( void ) {
 		else
 			NET_Sleep(timeVal - 1);
 	} while(Com_TimeVal(minMsec));
+
+	Prof_Frame();
 	
 	IN_Frame();
 
 	lastTime = com_frameTime;
+	PROF_BEGIN( PROF_EVENTS );
 	com_frameTime = Com_EventLoop();
+	PROF_END( PROF_EVENTS );
 	
 	msec = com_frameTime - lastTime;
 
@@ -3184,7 +4742,15 @@ void Com_Frame( void ) {
 		timeBeforeServer = Sys_Milliseconds ();
 	}
 
+	PROF_BEGIN( PROF_SV_FRAME );
+#ifdef LOADTEST
+	serverStart = Sys_Microseconds();
+	SV_Frame( msec );
+	LT_Frame( msec, Sys_Microseconds() - serverStart );
+#else
 	SV_Frame( msec );
+#endif
+	PROF_END( PROF_SV_FRAME );
 
 	// if "dedicated" has been modified, start up
 	// or shut down the client system.
@@ -3211,7 +4777,9 @@ void Com_Frame( void ) {
 	if ( com_speeds->integer ) {
 		timeBeforeEvents = Sys_Milliseconds ();
 	}
+	PROF_BEGIN( PROF_EVENTS );
 	Com_EventLoop();
+	PROF_END( PROF_EVENTS );
 	Cbuf_Execute ();
 
 
@@ -3273,6 +4841,8 @@ void Com_Frame( void ) {
 
 	Com_ReadFromPipe( );
 
+	Z_LogFrame();
+
 	com_frameNumber++;
 }
 
@@ -3282,6 +4852,8 @@ Com_Shutdown
 =================
 */
 void Com_Shutdown (void) {
+	Com_ShutdownWorkers();
+
 	if (logfile) {
 		FS_FCloseFile (logfile);
 		logfile = 0;
@@ -1228,6 +1228,25 @@ void Cvar_Restart_f(void)
 	Cvar_Restart(qfalse);
 }
 
+/*
+============
+Cvar_CompactStrings
+
+Lets the zone move the cvar strings, see Z_Defrag
+============
+*/
+void Cvar_CompactStrings( void ) {
+	cvar_t	*var;
+
+	for ( var = cvar_vars ; var ; var = var->next ) {
+		var->name = Z_Move( var->name );
+		var->string = Z_Move( var->string );
+		var->resetString = Z_Move( var->resetString );
+		var->latchedString = Z_Move( var->latchedString );
+		var->description = Z_Move( var->description );
+	}
+}
+
 /*
 =====================
 Cvar_InfoString
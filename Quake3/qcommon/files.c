@@ -213,6 +213,10 @@ typedef struct fileInPack_s {
 	char					*name;		// name of the file
 	unsigned long			pos;		// file info position in zip
 	unsigned long			len;		// uncompress file size
+	unsigned long			csize;		// compressed file size
+	unsigned long			localPos;	// local header position in zip
+	int						method;		// 0 for stored, or Z_DEFLATED
+	unsigned				crc;		// crc32 of the contents, 0 for empty files
 	struct	fileInPack_s*	next;		// next file in the hash
 } fileInPack_t;
 
@@ -221,7 +225,10 @@ typedef struct {
 	char			pakFilename[MAX_OSPATH];	// c:\quake3\baseq3\pak0.pk3
 	char			pakBasename[MAX_OSPATH];	// pak0
 	char			pakGamename[MAX_OSPATH];	// baseq3
-	unzFile			handle;						// handle to zip file
+	unzFile			handle;						// handle to zip file, opened on first use
+	const byte		*mapBase;					// whole pk3 mapped on first read
+	int				mapLength;
+	qboolean		mapFailed;					// don't try to map it again
 	int				checksum;					// regular checksum
 	int				pure_checksum;				// checksum for pure
 	int				numfiles;					// number of files in pk3
@@ -246,6 +253,10 @@ typedef struct searchpath_s {
 
 static	char		fs_gamedir[MAX_OSPATH];	// this will be a single file name with no separators
 static	cvar_t		*fs_debug;
+static	cvar_t		*fs_mmap;
+static	cvar_t		*fs_pakIndex;
+static	cvar_t		*fs_ioThreads;
+static	cvar_t		*fs_dedup;
 static	cvar_t		*fs_homepath;
 
 #ifdef __APPLE__
@@ -283,6 +294,12 @@ typedef struct {
 	int			zipFilePos;
 	int			zipFileLen;
 	qboolean	zipFile;
+	const byte	*zipData;		// entry data in the pak mapping, unzip isn't used if set
+	int			zipDataLen;		// compressed size
+	int			zipMethod;
+	int			zipReadPos;		// uncompressed position
+	z_stream	zipStream;
+	unsigned	zipCrc;			// from the central directory
 	char		name[MAX_ZPATH];
 } fileHandleData_t;
 
@@ -860,6 +877,174 @@ void FS_Rename( const char *from, const char *to ) {
 	rename(from_ospath, to_ospath);
 }
 
+/*
+=================
+FS_PakHandle
+
+The unzip handle of a pak is only opened once something has to be read
+through it
+=================
+*/
+static unzFile FS_PakHandle( pack_t *pak ) {
+	if ( !pak->handle ) {
+		pak->handle = unzOpen( pak->pakFilename );
+		if ( !pak->handle ) {
+			Com_Error( ERR_FATAL, "Couldn't open %s", pak->pakFilename );
+		}
+	}
+	return pak->handle;
+}
+
+/*
+=================
+FS_MapPak
+
+Maps the whole pk3 the first time something is read from it
+=================
+*/
+static qboolean FS_MapPak( pack_t *pak ) {
+	if ( pak->mapBase ) {
+		return qtrue;
+	}
+	if ( pak->mapFailed || !fs_mmap->integer ) {
+		return qfalse;
+	}
+
+	pak->mapBase = Sys_MapFile( pak->pakFilename, &pak->mapLength );
+	if ( !pak->mapBase ) {
+		Com_DPrintf( "Couldn't map %s, reading it through unzip\n", pak->pakFilename );
+		pak->mapFailed = qtrue;
+		return qfalse;
+	}
+	return qtrue;
+}
+
+/*
+=================
+FS_OpenMappedEntry
+
+Points a handle straight at the data of a pak entry in the mapping, so
+reads are a memcpy or an inflate with no stdio underneath.  Anything
+unusual (other compression methods, encryption, damaged headers) is left
+to unzip.
+=================
+*/
+static qboolean FS_OpenMappedEntry( fileHandleData_t *fh, pack_t *pak, const fileInPack_t *entry ) {
+	const byte	*local;
+	long		dataPos;
+
+	if ( !FS_MapPak( pak ) ) {
+		return qfalse;
+	}
+	if ( entry->method != 0 && entry->method != Z_DEFLATED ) {
+		return qfalse;
+	}
+	if ( entry->method == 0 && entry->csize != entry->len ) {
+		return qfalse;
+	}
+	if ( entry->localPos + 30 > pak->mapLength ) {
+		return qfalse;
+	}
+
+	local = pak->mapBase + entry->localPos;
+	if ( local[0] != 'P' || local[1] != 'K' || local[2] != 3 || local[3] != 4 || ( local[6] & 1 ) ) {
+		return qfalse;
+	}
+	dataPos = entry->localPos + 30 + ( local[26] | ( local[27] << 8 ) ) + ( local[28] | ( local[29] << 8 ) );
+	if ( dataPos + entry->csize > pak->mapLength ) {
+		return qfalse;
+	}
+
+	fh->zipData = pak->mapBase + dataPos;
+	fh->zipDataLen = entry->csize;
+	fh->zipMethod = entry->method;
+	fh->zipReadPos = 0;
+
+	if ( fh->zipMethod == Z_DEFLATED ) {
+		Com_Memset( &fh->zipStream, 0, sizeof( fh->zipStream ) );
+		fh->zipStream.next_in = (Bytef *)fh->zipData;
+		fh->zipStream.avail_in = fh->zipDataLen;
+
+		// zip entries are raw deflate data without a zlib header
+		if ( inflateInit2( &fh->zipStream, -MAX_WBITS ) != Z_OK ) {
+			fh->zipData = NULL;
+			return qfalse;
+		}
+	}
+	return qtrue;
+}
+
+/*
+=================
+FS_ReadMapped
+=================
+*/
+static int FS_ReadMapped( fileHandleData_t *fh, void *buffer, int len ) {
+	int		err;
+
+	if ( len > fh->zipFileLen - fh->zipReadPos ) {
+		len = fh->zipFileLen - fh->zipReadPos;
+	}
+	if ( len <= 0 ) {
+		return 0;
+	}
+
+	if ( fh->zipMethod == 0 ) {
+		Com_Memcpy( buffer, fh->zipData + fh->zipReadPos, len );
+		fh->zipReadPos += len;
+		return len;
+	}
+
+	fh->zipStream.next_out = buffer;
+	fh->zipStream.avail_out = len;
+	do {
+		err = inflate( &fh->zipStream, Z_SYNC_FLUSH );
+	} while ( err == Z_OK && fh->zipStream.avail_out );
+
+	if ( err != Z_OK && err != Z_STREAM_END ) {
+		Com_Printf( S_COLOR_YELLOW "WARNING: %s: inflate error %i\n", fh->name, err );
+	}
+
+	len -= fh->zipStream.avail_out;
+	fh->zipReadPos += len;
+	return len;
+}
+
+/*
+=================
+FS_RewindMapped
+=================
+*/
+static void FS_RewindMapped( fileHandleData_t *fh ) {
+	fh->zipReadPos = 0;
+	if ( fh->zipMethod == Z_DEFLATED ) {
+		inflateReset( &fh->zipStream );
+		fh->zipStream.next_in = (Bytef *)fh->zipData;
+		fh->zipStream.avail_in = fh->zipDataLen;
+	}
+}
+
+/*
+=================
+FS_IsMappedBuffer
+
+True for buffers FS_ReadFileMapped returned in place
+=================
+*/
+static qboolean FS_IsMappedBuffer( const void *buffer ) {
+	searchpath_t	*search;
+	const byte		*p;
+
+	p = buffer;
+	for ( search = fs_searchpaths ; search ; search = search->next ) {
+		if ( search->pack && search->pack->mapBase && p >= search->pack->mapBase
+			&& p < search->pack->mapBase + search->pack->mapLength ) {
+			return qtrue;
+		}
+	}
+	return qfalse;
+}
+
 /*
 ==============
 FS_FCloseFile
@@ -876,9 +1061,15 @@ void FS_FCloseFile( fileHandle_t f ) {
 	}
 
 	if (fsh[f].zipFile == qtrue) {
-		unzCloseCurrentFile( fsh[f].handleFiles.file.z );
-		if ( fsh[f].handleFiles.unique ) {
-			unzClose( fsh[f].handleFiles.file.z );
+		if ( fsh[f].zipData ) {
+			if ( fsh[f].zipMethod == Z_DEFLATED ) {
+				inflateEnd( &fsh[f].zipStream );
+			}
+		} else {
+			unzCloseCurrentFile( fsh[f].handleFiles.file.z );
+			if ( fsh[f].handleFiles.unique ) {
+				unzClose( fsh[f].handleFiles.file.z );
+			}
 		}
 		Com_Memset( &fsh[f], 0, sizeof( fsh[f] ) );
 		return;
@@ -1116,6 +1307,28 @@ qboolean FS_IsDemoExt(const char *filename, int namelen)
 	return qfalse;
 }
 
+/*
+===========
+FS_DirFileAllowedPure
+
+Return qtrue if filename may come from the directory tree while
+running restricted to the server's pure pk3s
+===========
+*/
+
+static qboolean FS_DirFileAllowedPure(const char *filename)
+{
+	int len;
+
+	len = strlen(filename);
+
+	return FS_IsExt(filename, ".cfg", len) ||		// for config files
+		FS_IsExt(filename, ".menu", len) ||		// menu files
+		FS_IsExt(filename, ".game", len) ||		// menu files
+		FS_IsExt(filename, ".dat", len) ||		// for journal files
+		FS_IsDemoExt(filename, len);			// demos
+}
+
 /*
 ===========
 FS_FOpenFileReadDir
@@ -1279,27 +1492,32 @@ long FS_FOpenFileReadDir(const char *filename, searchpath_t *search, fileHandle_
 					if(strstr(filename, "ui.qvm"))
 						pak->referenced |= FS_UI_REF;
 
-					if(uniqueFILE)
-					{
-						// open a new file on the pakfile
-						fsh[*file].handleFiles.file.z = unzOpen(pak->pakFilename);
-
-						if(fsh[*file].handleFiles.file.z == NULL)
-							Com_Error(ERR_FATAL, "Couldn't open %s", pak->pakFilename);
-					}
-					else
-						fsh[*file].handleFiles.file.z = pak->handle;
-
 					Q_strncpyz(fsh[*file].name, filename, sizeof(fsh[*file].name));
 					fsh[*file].zipFile = qtrue;
-
-					// set the file position in the zip file (also sets the current file info)
-					unzSetOffset(fsh[*file].handleFiles.file.z, pakFile->pos);
-
-					// open the file in the zip
-					unzOpenCurrentFile(fsh[*file].handleFiles.file.z);
 					fsh[*file].zipFilePos = pakFile->pos;
 					fsh[*file].zipFileLen = pakFile->len;
+					fsh[*file].zipCrc = pakFile->crc;
+
+					// mapped entries don't share any state, so they are always unique
+					if(!FS_OpenMappedEntry(&fsh[*file], pak, pakFile))
+					{
+						if(uniqueFILE)
+						{
+							// open a new file on the pakfile
+							fsh[*file].handleFiles.file.z = unzOpen(pak->pakFilename);
+
+							if(fsh[*file].handleFiles.file.z == NULL)
+								Com_Error(ERR_FATAL, "Couldn't open %s", pak->pakFilename);
+						}
+						else
+							fsh[*file].handleFiles.file.z = FS_PakHandle(pak);
+
+						// set the file position in the zip file (also sets the current file info)
+						unzSetOffset(fsh[*file].handleFiles.file.z, pakFile->pos);
+
+						// open the file in the zip
+						unzOpenCurrentFile(fsh[*file].handleFiles.file.z);
+					}
 
 					if(fs_debug->integer)
 					{
@@ -1320,23 +1538,15 @@ long FS_FOpenFileReadDir(const char *filename, searchpath_t *search, fileHandle_
 
 		// if we are running restricted, the only files we
 		// will allow to come from the directory are .cfg files
-		len = strlen(filename);
 		// FIXME TTimo I'm not sure about the fs_numServerPaks test
 		// if you are using FS_ReadFile to find out if a file exists,
 		//   this test can make the search fail although the file is in the directory
 		// I had the problem on https://zerowing.idsoftware.com/bugzilla/show_bug.cgi?id=8
 		// turned out I used FS_FileExists instead
-		if(!unpure && fs_numServerPaks)
+		if(!unpure && fs_numServerPaks && !FS_DirFileAllowedPure(filename))
 		{
-			if(!FS_IsExt(filename, ".cfg", len) &&		// for config files
-			   !FS_IsExt(filename, ".menu", len) &&		// menu files
-			   !FS_IsExt(filename, ".game", len) &&		// menu files
-			   !FS_IsExt(filename, ".dat", len) &&		// for journal files
-			   !FS_IsDemoExt(filename, len))			// demos
-			{
-				*file = 0;
-				return -1;
-			}
+			*file = 0;
+			return -1;
 		}
 
 		dir = search->dir;
@@ -1568,6 +1778,8 @@ int FS_Read( void *buffer, int len, fileHandle_t f ) {
 			buf += read;
 		}
 		return len;
+	} else if (fsh[f].zipData) {
+		return FS_ReadMapped(&fsh[f], buffer, len);
 	} else {
 		return unzReadCurrentFile(fsh[f].handleFiles.file.z, buffer, len);
 	}
@@ -1653,6 +1865,33 @@ int FS_Seek( fileHandle_t f, long offset, int origin ) {
 		return -1;
 	}
 
+	if (fsh[f].zipFile == qtrue && fsh[f].zipData && fsh[f].zipMethod == 0) {
+		// stored entries in a mapped pak can seek anywhere for free
+		int		pos;
+
+		switch( origin ) {
+			case FS_SEEK_END:
+				pos = fsh[f].zipFileLen + offset;
+				break;
+			case FS_SEEK_CUR:
+				pos = fsh[f].zipReadPos + offset;
+				break;
+			case FS_SEEK_SET:
+				pos = offset;
+				break;
+			default:
+				Com_Error( ERR_FATAL, "Bad origin in FS_Seek" );
+				return -1;
+		}
+		if ( pos < 0 ) {
+			pos = 0;
+		} else if ( pos > fsh[f].zipFileLen ) {
+			pos = fsh[f].zipFileLen;
+		}
+		fsh[f].zipReadPos = pos;
+		return offset;
+	}
+
 	if (fsh[f].zipFile == qtrue) {
 		//FIXME: this is really, really crappy
 		//(but better than what was here before)
@@ -1695,8 +1934,12 @@ int FS_Seek( fileHandle_t f, long offset, int origin ) {
 				if ( remainder == currentPosition ) {
 					return offset;
 				}
-				unzSetOffset(fsh[f].handleFiles.file.z, fsh[f].zipFilePos);
-				unzOpenCurrentFile(fsh[f].handleFiles.file.z);
+				if ( fsh[f].zipData ) {
+					FS_RewindMapped( &fsh[f] );
+				} else {
+					unzSetOffset(fsh[f].handleFiles.file.z, fsh[f].zipFilePos);
+					unzOpenCurrentFile(fsh[f].handleFiles.file.z);
+				}
 				//fallthrough
 
 			case FS_SEEK_END:
@@ -1804,105 +2047,792 @@ int	FS_FileIsInPAK(const char *filename, int *pChecksum ) {
 }
 
 /*
-============
-FS_ReadFileDir
+==========================================================================
 
-Filename are relative to the quake search path
-a null buffer will just return the file length without loading
-If searchPath is non-NULL search only in that specific search path
-============
+ASYNCHRONOUS READS
+
+FS_PrefetchFile looks the file up on the calling thread, exactly like FS_FOpenFileRead, and leave the reading and inflating
+to the io threads.  Those only ever see a FILE or a mapped pak entry, so
+they never touch the zone or the search path.  Prefetched files are picked
+up by the next FS_ReadFile of the same name, whatever is left when the
+load is over is dropped by FS_DropPrefetches.
+
+==========================================================================
 */
-long FS_ReadFileDir(const char *qpath, void *searchPath, qboolean unpure, void **buffer)
-{
-	fileHandle_t	h;
-	searchpath_t	*search;
-	byte*			buf;
-	qboolean		isConfig;
-	long				len;
 
-	if ( !fs_searchpaths ) {
-		Com_Error( ERR_FATAL, "Filesystem call made without initialization" );
-	}
+#define	MAX_ASYNC_READS		256
+#define	MAX_IO_THREADS		4
+#define	MAX_PREFETCH_BYTES	( 64 << 20 )		// outstanding prefetched data
 
-	if ( !qpath || !qpath[0] ) {
-		Com_Error( ERR_FATAL, "FS_ReadFile with empty name" );
+typedef enum {
+	ASYNC_FREE,
+	ASYNC_QUEUED,			// waiting for an io thread
+	ASYNC_READING,
+	ASYNC_DONE
+} asyncState_t;
+
+typedef struct {
+	asyncState_t	state;
+	int				sequence;		// the oldest queued read goes first
+	char			qpath[MAX_QPATH];
+
+	// the source, resolved by the caller
+	FILE			*file;			// a loose file, closed by the io thread
+	const byte		*mapData;		// or the data of a mapped pak entry
+	int				csize;
+	int				method;
+	int				length;
+
+	byte			*buffer;		// malloced and 0 terminated, NULL if the read failed
+} fsAsyncRead_t;
+
+static fsAsyncRead_t	fs_asyncReads[MAX_ASYNC_READS];
+static sysMutex_t		*fs_asyncMutex;
+static sysCond_t		*fs_asyncWake;		// a read was queued or the threads should quit
+static sysCond_t		*fs_asyncDone;		// a read has finished
+static sysThread_t		*fs_ioThreadHandles[MAX_IO_THREADS];
+static int				fs_numIOThreads;
+static qboolean			fs_asyncQuit;
+static int				fs_asyncSequence;
+static int				fs_prefetchBytes;
+
+/*
+=================
+FS_AsyncRead
+
+Reads and inflates a request on an io thread
+=================
+*/
+static void FS_AsyncRead( fsAsyncRead_t *req ) {
+	z_stream	zs;
+	byte		*buf;
+	qboolean	ok;
+	int			err;
+
+	buf = malloc( req->length + 1 );
+	ok = ( buf != NULL );
+
+	if ( req->file ) {
+		if ( ok ) {
+			ok = ( fread( buf, 1, req->length, req->file ) == req->length );
+		}
+		fclose( req->file );
+		req->file = NULL;
+	} else if ( ok && req->method == 0 ) {
+		Com_Memcpy( buf, req->mapData, req->length );
+	} else if ( ok ) {
+		Com_Memset( &zs, 0, sizeof( zs ) );
+		zs.next_in = (Bytef *)req->mapData;
+		zs.avail_in = req->csize;
+		zs.next_out = buf;
+		zs.avail_out = req->length;
+
+		ok = ( inflateInit2( &zs, -MAX_WBITS ) == Z_OK );
+		if ( ok ) {
+			err = inflate( &zs, Z_FINISH );
+			ok = ( err == Z_STREAM_END || zs.avail_out == 0 );
+			inflateEnd( &zs );
+		}
 	}
 
-	buf = NULL;	// quiet compiler warning
+	if ( !ok ) {
+		free( buf );
+		return;
+	}
+	buf[req->length] = 0;
+	req->buffer = buf;
+}
 
-	// if this is a .cfg file and we are playing back a journal, read
-	// it from the journal file
-	if ( strstr( qpath, ".cfg" ) ) {
-		isConfig = qtrue;
-		if ( com_journal && com_journal->integer == 2 ) {
-			int		r;
+/*
+=================
+FS_IOThread
+=================
+*/
+static void FS_IOThread( void *arg ) {
+	fsAsyncRead_t	*req;
+	int				i;
 
-			Com_DPrintf( "Loading %s from journal file.\n", qpath );
-			r = FS_Read( &len, sizeof( len ), com_journalDataFile );
-			if ( r != sizeof( len ) ) {
-				if (buffer != NULL) *buffer = NULL;
-				return -1;
-			}
-			// if the file didn't exist when the journal was created
-			if (!len) {
-				if (buffer == NULL) {
-					return 1;			// hack for old journal files
-				}
-				*buffer = NULL;
-				return -1;
+	Sys_LockMutex( fs_asyncMutex );
+	for ( ;; ) {
+		req = NULL;
+		for ( i = 0 ; i < MAX_ASYNC_READS ; i++ ) {
+			if ( fs_asyncReads[i].state == ASYNC_QUEUED
+				&& ( !req || fs_asyncReads[i].sequence - req->sequence < 0 ) ) {
+				req = &fs_asyncReads[i];
 			}
-			if (buffer == NULL) {
-				return len;
-			}
-
-			buf = Hunk_AllocateTempMemory(len+1);
-			*buffer = buf;
+		}
 
-			r = FS_Read( buf, len, com_journalDataFile );
-			if ( r != len ) {
-				Com_Error( ERR_FATAL, "Read from journalDataFile failed" );
+		if ( !req ) {
+			if ( fs_asyncQuit ) {
+				break;
 			}
+			Sys_WaitCond( fs_asyncWake, fs_asyncMutex );
+			continue;
+		}
 
-			fs_loadCount++;
-			fs_loadStack++;
+		req->state = ASYNC_READING;
+		Sys_UnlockMutex( fs_asyncMutex );
 
-			// guarantee that it will have a trailing 0 for string operations
-			buf[len] = 0;
+		FS_AsyncRead( req );
 
-			return len;
-		}
-	} else {
-		isConfig = qfalse;
+		Sys_LockMutex( fs_asyncMutex );
+		req->state = ASYNC_DONE;
+		Sys_BroadcastCond( fs_asyncDone );
 	}
+	Sys_UnlockMutex( fs_asyncMutex );
+}
 
-	search = searchPath;
+/*
+=================
+FS_StartIOThreads
+=================
+*/
+static void FS_StartIOThreads( void ) {
+	int		i, count;
 
-	if(search == NULL)
-	{
-		// look for it in the filesystem or pack files
-		len = FS_FOpenFileRead(qpath, &h, qfalse);
-	}
-	else
-	{
-		// look for it in a specific search path only
-		len = FS_FOpenFileReadDir(qpath, search, &h, qfalse, unpure);
+	if ( fs_asyncMutex ) {
+		return;
 	}
 
-	if ( h == 0 ) {
-		if ( buffer ) {
-			*buffer = NULL;
-		}
-		// if we are journalling and it is a config file, write a zero to the journal file
-		if ( isConfig && com_journal && com_journal->integer == 1 ) {
-			Com_DPrintf( "Writing zero for %s to journal file.\n", qpath );
-			len = 0;
-			FS_Write( &len, sizeof( len ), com_journalDataFile );
-			FS_Flush( com_journalDataFile );
+	fs_asyncMutex = Sys_CreateMutex();
+	fs_asyncWake = Sys_CreateCond();
+	fs_asyncDone = Sys_CreateCond();
+	fs_asyncQuit = qfalse;
+
+	count = fs_ioThreads->integer;
+	for ( i = 0 ; i < count ; i++ ) {
+		fs_ioThreadHandles[i] = Sys_CreateThread( FS_IOThread, NULL );
+		if ( !fs_ioThreadHandles[i] ) {
+			Com_Printf( S_COLOR_YELLOW "WARNING: could only start %i of %i io threads\n", i, count );
+			break;
 		}
-		return -1;
 	}
+	fs_numIOThreads = i;
+}
 
-	if ( !buffer ) {
+/*
+=================
+FS_FreeAsyncRead
+
+The request must not be queued or reading
+=================
+*/
+static void FS_FreeAsyncRead( fsAsyncRead_t *req ) {
+	if ( req->file ) {
+		fclose( req->file );
+	}
+	fs_prefetchBytes -= req->length;
+	free( req->buffer );
+
+	Sys_LockMutex( fs_asyncMutex );
+	Com_Memset( req, 0, sizeof( *req ) );
+	Sys_UnlockMutex( fs_asyncMutex );
+}
+
+/*
+=================
+FS_WaitAsyncRead
+=================
+*/
+static void FS_WaitAsyncRead( fsAsyncRead_t *req ) {
+	Sys_LockMutex( fs_asyncMutex );
+	while ( req->state != ASYNC_DONE ) {
+		Sys_WaitCond( fs_asyncDone, fs_asyncMutex );
+	}
+	Sys_UnlockMutex( fs_asyncMutex );
+}
+
+/*
+=================
+FS_FinishAsyncRead
+
+Hands a completed read over as an FS_ReadFile buffer and frees the request
+=================
+*/
+static long FS_FinishAsyncRead( fsAsyncRead_t *req, void **buffer ) {
+	byte	*buf;
+	long	len;
+
+	if ( !req->buffer ) {
+		*buffer = NULL;
+		FS_FreeAsyncRead( req );
+		return -1;
+	}
+
+	fs_loadCount++;
+	fs_loadStack++;
+
+	len = req->length;
+	buf = Hunk_AllocateTempMemory( len + 1 );
+	Com_Memcpy( buf, req->buffer, len + 1 );
+	*buffer = buf;
+
+	FS_FreeAsyncRead( req );
+	return len;
+}
+
+/*
+=================
+FS_AllocAsyncRead
+
+Returns NULL if every slot is taken
+=================
+*/
+static fsAsyncRead_t *FS_AllocAsyncRead( void ) {
+	int		i;
+
+	Sys_LockMutex( fs_asyncMutex );
+	for ( i = 0 ; i < MAX_ASYNC_READS ; i++ ) {
+		if ( fs_asyncReads[i].state == ASYNC_FREE ) {
+			Sys_UnlockMutex( fs_asyncMutex );
+			return &fs_asyncReads[i];
+		}
+	}
+	Sys_UnlockMutex( fs_asyncMutex );
+
+	return NULL;
+}
+
+/*
+=================
+FS_QueueAsyncRead
+
+Returns the request, or NULL if the file doesn't exist
+=================
+*/
+static fsAsyncRead_t *FS_QueueAsyncRead( const char *qpath ) {
+	fsAsyncRead_t	*req;
+	fileHandle_t	h;
+	long			len;
+
+	FS_StartIOThreads();
+
+	req = FS_AllocAsyncRead();
+	if ( !req ) {
+		return NULL;
+	}
+
+	Com_Memset( req, 0, sizeof( *req ) );
+	Q_strncpyz( req->qpath, qpath, sizeof( req->qpath ) );
+	req->sequence = fs_asyncSequence++;
+
+	len = FS_FOpenFileRead( qpath, &h, qfalse );
+	if ( !h ) {
+		return NULL;
+	}
+	req->length = len;
+
+	if ( fsh[h].zipData ) {
+		req->mapData = fsh[h].zipData;
+		req->csize = fsh[h].zipDataLen;
+		req->method = fsh[h].zipMethod;
+	} else if ( fsh[h].zipFile ) {
+		// unzip isn't thread safe, read it right away
+		req->buffer = malloc( len + 1 );
+		if ( req->buffer ) {
+			FS_Read( req->buffer, len, h );
+			req->buffer[len] = 0;
+		}
+		FS_FCloseFile( h );
+		req->state = ASYNC_DONE;
+		fs_prefetchBytes += len;
+		return req;
+	} else {
+		// the io thread takes over the FILE
+		req->file = fsh[h].handleFiles.file.o;
+		fsh[h].handleFiles.file.o = NULL;
+	}
+	FS_FCloseFile( h );
+
+	fs_prefetchBytes += len;
+
+	if ( !fs_numIOThreads ) {
+		FS_AsyncRead( req );
+		req->state = ASYNC_DONE;
+		return req;
+	}
+
+	Sys_LockMutex( fs_asyncMutex );
+	req->state = ASYNC_QUEUED;
+	Sys_SignalCond( fs_asyncWake );
+	Sys_UnlockMutex( fs_asyncMutex );
+
+	return req;
+}
+
+/*
+=================
+FS_FindPrefetch
+=================
+*/
+static fsAsyncRead_t *FS_FindPrefetch( const char *qpath ) {
+	int		i;
+
+	if ( !fs_asyncMutex ) {
+		return NULL;
+	}
+
+	for ( i = 0 ; i < MAX_ASYNC_READS ; i++ ) {
+		if ( fs_asyncReads[i].state != ASYNC_FREE
+			&& !FS_FilenameCompare( fs_asyncReads[i].qpath, qpath ) ) {
+			return &fs_asyncReads[i];
+		}
+	}
+	return NULL;
+}
+
+/*
+=================
+FS_FlushAsyncReads
+
+Drops everything queued or read so far, the paks they point into are
+about to go away.  With stopThreads the io threads exit as well.
+=================
+*/
+static void FS_FlushAsyncReads( qboolean stopThreads ) {
+	int		i;
+
+	if ( !fs_asyncMutex ) {
+		return;
+	}
+
+	FS_DropPrefetches();
+
+	if ( !stopThreads ) {
+		return;
+	}
+
+	Sys_LockMutex( fs_asyncMutex );
+	fs_asyncQuit = qtrue;
+	Sys_BroadcastCond( fs_asyncWake );
+	Sys_UnlockMutex( fs_asyncMutex );
+
+	for ( i = 0 ; i < fs_numIOThreads ; i++ ) {
+		Sys_JoinThread( fs_ioThreadHandles[i] );
+	}
+	fs_numIOThreads = 0;
+
+	Sys_DestroyCond( fs_asyncDone );
+	Sys_DestroyCond( fs_asyncWake );
+	Sys_DestroyMutex( fs_asyncMutex );
+	fs_asyncMutex = NULL;
+}
+
+/*
+==========================================================================
+
+SHARED CONTENTS
+
+Mods often ship the same files in several pk3s, under the same name or
+another one.  Pk3 entries are keyed by the crc and length from the central
+directory.  Contents that exist more than once are kept once they have
+been read and checked, up to fs_dedup megabytes, and reading any copy
+after that is a memcpy instead of a seek and an inflate.  What is kept
+survives FS_Restart as long as the new search path still shares it.
+
+==========================================================================
+*/
+
+#define	CONTENT_HASH_SIZE	4096
+
+typedef struct fsContent_s {
+	unsigned			crc;
+	int					length;
+	int					copies;			// pk3 entries with these contents
+	byte				*data;			// malloced on the first read if copies > 1
+	int					readUsec;		// what that read took
+	struct fsContent_s	*next;
+} fsContent_t;
+
+static fsContent_t	*fs_contents;
+static fsContent_t	*fs_contentHash[CONTENT_HASH_SIZE];
+static int			fs_numContents;
+static fsContent_t	*fs_keptContents;		// data held over an FS_Restart
+static int			fs_numKeptContents;
+static int			fs_contentBytes;		// held in fs_contents[].data
+static int			fs_contentHits;
+static int64_t		fs_contentHitBytes;
+static int64_t		fs_contentHitUsec;
+
+/*
+=================
+FS_FindContent
+=================
+*/
+static fsContent_t *FS_FindContent( unsigned crc, int length ) {
+	fsContent_t	*content;
+
+	for ( content = fs_contentHash[( crc ^ length ) & ( CONTENT_HASH_SIZE - 1 )] ; content ; content = content->next ) {
+		if ( content->crc == crc && content->length == length ) {
+			return content;
+		}
+	}
+	return NULL;
+}
+
+/*
+=================
+FS_BuildContentTable
+
+Counts the copies of every pk3 entry in the search path
+=================
+*/
+static void FS_BuildContentTable( void ) {
+	searchpath_t	*search;
+	fileInPack_t	*pakFile;
+	fsContent_t		*content, *kept;
+	int				i, hash;
+
+	if ( fs_packFiles ) {
+		fs_contents = malloc( fs_packFiles * sizeof( *fs_contents ) );
+	}
+
+	for ( search = fs_searchpaths ; search && fs_contents ; search = search->next ) {
+		if ( !search->pack ) {
+			continue;
+		}
+		for ( i = 0 ; i < search->pack->numfiles ; i++ ) {
+			pakFile = &search->pack->buildBuffer[i];
+			if ( !pakFile->crc ) {
+				continue;
+			}
+
+			content = FS_FindContent( pakFile->crc, pakFile->len );
+			if ( content ) {
+				content->copies++;
+				continue;
+			}
+
+			content = &fs_contents[fs_numContents++];
+			content->crc = pakFile->crc;
+			content->length = pakFile->len;
+			content->copies = 1;
+			content->data = NULL;
+			content->readUsec = 0;
+
+			hash = ( content->crc ^ content->length ) & ( CONTENT_HASH_SIZE - 1 );
+			content->next = fs_contentHash[hash];
+			fs_contentHash[hash] = content;
+		}
+	}
+
+	// take back what the last search path had read, if it's still shared
+	for ( i = 0 ; i < fs_numKeptContents ; i++ ) {
+		kept = &fs_keptContents[i];
+		content = FS_FindContent( kept->crc, kept->length );
+		if ( content && content->copies > 1 ) {
+			content->data = kept->data;
+			content->readUsec = kept->readUsec;
+		} else {
+			free( kept->data );
+			fs_contentBytes -= kept->length;
+		}
+	}
+	free( fs_keptContents );
+	fs_keptContents = NULL;
+	fs_numKeptContents = 0;
+}
+
+/*
+=================
+FS_FreeContentTable
+
+With keepData the contents read so far are set aside for the next
+FS_BuildContentTable.
+=================
+*/
+static void FS_FreeContentTable( qboolean keepData ) {
+	int		i;
+
+	if ( keepData && fs_contentBytes ) {
+		fs_keptContents = malloc( fs_numContents * sizeof( *fs_keptContents ) );
+	}
+
+	for ( i = 0 ; i < fs_numContents ; i++ ) {
+		if ( !fs_contents[i].data ) {
+			continue;
+		}
+		if ( fs_keptContents ) {
+			fs_keptContents[fs_numKeptContents++] = fs_contents[i];
+		} else {
+			free( fs_contents[i].data );
+			fs_contentBytes -= fs_contents[i].length;
+		}
+	}
+	free( fs_contents );
+
+	fs_contents = NULL;
+	fs_numContents = 0;
+	Com_Memset( fs_contentHash, 0, sizeof( fs_contentHash ) );
+
+	if ( !keepData ) {
+		fs_contentHits = 0;
+		fs_contentHitBytes = 0;
+		fs_contentHitUsec = 0;
+	}
+}
+
+/*
+=================
+FS_SharedContent
+
+The contents behind an open pk3 entry, if another pk3 has them as well
+=================
+*/
+static fsContent_t *FS_SharedContent( fileHandle_t h ) {
+	fsContent_t	*content;
+
+	if ( !fsh[h].zipFile || !fsh[h].zipCrc ) {
+		return NULL;
+	}
+
+	content = FS_FindContent( fsh[h].zipCrc, fsh[h].zipFileLen );
+	if ( !content || content->copies < 2 ) {
+		return NULL;
+	}
+	return content;
+}
+
+/*
+=================
+FS_KeepContent
+
+Holds on to freshly read shared contents, as long as they really have the
+crc every copy claims and fs_dedup has room for them.
+=================
+*/
+static void FS_KeepContent( fsContent_t *content, const byte *buf, int usec ) {
+	if ( content->data ) {
+		return;
+	}
+	if ( fs_contentBytes + content->length > fs_dedup->integer * 1024 * 1024 ) {
+		return;
+	}
+	if ( crc32( 0, buf, content->length ) != content->crc ) {
+		return;
+	}
+
+	content->data = malloc( content->length );
+	if ( !content->data ) {
+		return;
+	}
+	Com_Memcpy( content->data, buf, content->length );
+	content->readUsec = usec;
+	fs_contentBytes += content->length;
+}
+
+/*
+=================
+FS_FileContentKey
+
+Returns the length FS_ReadFile would, or -1 if the file doesn't exist.
+crc is set for files that come from a pk3, two files with the same
+length and a non zero crc can be taken to be the same.
+
+Follows the same search order and pure rules as FS_FOpenFileRead, but
+takes the crc and length from the pk3 directory, so no file is opened
+or decompressed for pk3 files.
+=================
+*/
+long FS_FileContentKey( const char *qpath, unsigned *crc ) {
+	searchpath_t	*search;
+	fileInPack_t	*pakFile;
+	char			*netpath;
+	FILE			*filep;
+	long			hash, len;
+
+	*crc = 0;
+
+	if ( !fs_searchpaths ) {
+		Com_Error( ERR_FATAL, "Filesystem call made without initialization" );
+	}
+
+	// qpaths are not supposed to have a leading slash
+	if ( qpath[0] == '/' || qpath[0] == '\\' ) {
+		qpath++;
+	}
+	if ( strstr( qpath, ".." ) || strstr( qpath, "::" ) ) {
+		return -1;
+	}
+
+	for ( search = fs_searchpaths ; search ; search = search->next ) {
+		if ( search->pack ) {
+			if ( !FS_PakIsPure( search->pack ) ) {
+				continue;
+			}
+			hash = FS_HashFileName( qpath, search->pack->hashSize );
+			for ( pakFile = search->pack->hashTable[hash] ; pakFile ; pakFile = pakFile->next ) {
+				if ( !FS_FilenameCompare( pakFile->name, qpath ) ) {
+					*crc = pakFile->crc;
+					return pakFile->len;
+				}
+			}
+		} else if ( search->dir ) {
+			if ( fs_numServerPaks && !FS_DirFileAllowedPure( qpath ) ) {
+				continue;
+			}
+			netpath = FS_BuildOSPath( search->dir->path, search->dir->gamedir, qpath );
+			filep = Sys_FOpen( netpath, "rb" );
+			if ( filep ) {
+				len = FS_fplength( filep );
+				fclose( filep );
+				return len;
+			}
+		}
+	}
+
+	return -1;
+}
+
+/*
+============
+FS_Dedup_f
+============
+*/
+void FS_Dedup_f( void ) {
+	fsContent_t	*content;
+	int			i, numShared, numHeld;
+	int64_t		sharedBytes;
+
+	numShared = numHeld = 0;
+	sharedBytes = 0;
+	for ( i = 0 ; i < fs_numContents ; i++ ) {
+		content = &fs_contents[i];
+		if ( content->copies > 1 ) {
+			numShared++;
+			sharedBytes += (int64_t)( content->copies - 1 ) * content->length;
+		}
+		if ( content->data ) {
+			numHeld++;
+		}
+	}
+
+	Com_Printf( "%i files in pk3 files, %i distinct\n", fs_packFiles, fs_numContents );
+	Com_Printf( "%i have copies in other pk3s, %i KB in the copies\n", numShared, (int)( sharedBytes / 1024 ) );
+	Com_Printf( "%i held in memory, %i of %i KB\n", numHeld, fs_contentBytes / 1024, fs_dedup->integer * 1024 );
+	Com_Printf( "%i reads served from memory, %i KB not read again, %i msec saved\n",
+		fs_contentHits, (int)( fs_contentHitBytes / 1024 ), (int)( fs_contentHitUsec / 1000 ) );
+}
+
+/*
+============
+FS_ReadFileDir
+
+Filename are relative to the quake search path
+a null buffer will just return the file length without loading
+If searchPath is non-NULL search only in that specific search path
+============
+*/
+long FS_ReadFileDir(const char *qpath, void *searchPath, qboolean unpure, void **buffer)
+{
+	fileHandle_t	h;
+	searchpath_t	*search;
+	byte*			buf;
+	qboolean		isConfig;
+	long				len;
+	fsContent_t		*content;
+	int64_t			start;
+
+	if ( !fs_searchpaths ) {
+		Com_Error( ERR_FATAL, "Filesystem call made without initialization" );
+	}
+
+	if ( !qpath || !qpath[0] ) {
+		Com_Error( ERR_FATAL, "FS_ReadFile with empty name" );
+	}
+
+	buf = NULL;	// quiet compiler warning
+
+	// if this is a .cfg file and we are playing back a journal, read
+	// it from the journal file
+	if ( strstr( qpath, ".cfg" ) ) {
+		isConfig = qtrue;
+		if ( com_journal && com_journal->integer == 2 ) {
+			int		r;
+
+			Com_DPrintf( "Loading %s from journal file.\n", qpath );
+			r = FS_Read( &len, sizeof( len ), com_journalDataFile );
+			if ( r != sizeof( len ) ) {
+				if (buffer != NULL) *buffer = NULL;
+				return -1;
+			}
+			// if the file didn't exist when the journal was created
+			if (!len) {
+				if (buffer == NULL) {
+					return 1;			// hack for old journal files
+				}
+				*buffer = NULL;
+				return -1;
+			}
+			if (buffer == NULL) {
+				return len;
+			}
+
+			buf = Hunk_AllocateTempMemory(len+1);
+			*buffer = buf;
+
+			r = FS_Read( buf, len, com_journalDataFile );
+			if ( r != len ) {
+				Com_Error( ERR_FATAL, "Read from journalDataFile failed" );
+			}
+
+			fs_loadCount++;
+			fs_loadStack++;
+
+			// guarantee that it will have a trailing 0 for string operations
+			buf[len] = 0;
+
+			return len;
+		}
+	} else {
+		isConfig = qfalse;
+	}
+
+	search = searchPath;
+
+	// it may already have been read by the io threads
+	if ( search == NULL && buffer && !isConfig ) {
+		fsAsyncRead_t	*req;
+
+		req = FS_FindPrefetch( qpath );
+		if ( req ) {
+			FS_WaitAsyncRead( req );
+			if ( req->buffer ) {
+				if ( fs_debug->integer ) {
+					Com_Printf( "FS_ReadFile: %s was prefetched\n", qpath );
+				}
+				return FS_FinishAsyncRead( req, buffer );
+			}
+			FS_FreeAsyncRead( req );
+		}
+	}
+
+	if(search == NULL)
+	{
+		// look for it in the filesystem or pack files
+		len = FS_FOpenFileRead(qpath, &h, qfalse);
+	}
+	else
+	{
+		// look for it in a specific search path only
+		len = FS_FOpenFileReadDir(qpath, search, &h, qfalse, unpure);
+	}
+
+	if ( h == 0 ) {
+		if ( buffer ) {
+			*buffer = NULL;
+		}
+		// if we are journalling and it is a config file, write a zero to the journal file
+		if ( isConfig && com_journal && com_journal->integer == 1 ) {
+			Com_DPrintf( "Writing zero for %s to journal file.\n", qpath );
+			len = 0;
+			FS_Write( &len, sizeof( len ), com_journalDataFile );
+			FS_Flush( com_journalDataFile );
+		}
+		return -1;
+	}
+
+	if ( !buffer ) {
 		if ( isConfig && com_journal && com_journal->integer == 1 ) {
 			Com_DPrintf( "Writing len for %s to journal file.\n", qpath );
 			FS_Write( &len, sizeof( len ), com_journalDataFile );
@@ -1918,7 +2848,18 @@ long FS_ReadFileDir(const char *qpath, void *searchPath, qboolean unpure, void *
 	buf = Hunk_AllocateTempMemory(len+1);
 	*buffer = buf;
 
-	FS_Read (buf, len, h);
+	content = FS_SharedContent( h );
+	if ( content && content->data ) {
+		Com_Memcpy( buf, content->data, len );
+		fs_contentHits++;
+		fs_contentHitBytes += len;
+		fs_contentHitUsec += content->readUsec;
+	} else {
+		start = Sys_Microseconds();
+		if ( FS_Read( buf, len, h ) == len && content ) {
+			FS_KeepContent( content, buf, Sys_Microseconds() - start );
+		}
+	}
 
 	// guarantee that it will have a trailing 0 for string operations
 	buf[len] = 0;
@@ -1936,36 +2877,162 @@ long FS_ReadFileDir(const char *qpath, void *searchPath, qboolean unpure, void *
 
 /*
 ============
-FS_ReadFile
+FS_ReadFile
+
+Filename are relative to the quake search path
+a null buffer will just return the file length without loading
+============
+*/
+long FS_ReadFile(const char *qpath, void **buffer)
+{
+	return FS_ReadFileDir(qpath, NULL, qfalse, buffer);
+}
+
+/*
+============
+FS_ReadFileMapped
+
+Stored pk3 entries come back in place in the pak mapping, everything else
+is read like FS_ReadFile.  Entries that aren't 4 byte aligned are copied,
+callers are free to read ints and floats straight out of the buffer.
+============
+*/
+long FS_ReadFileMapped( const char *qpath, const void **buffer )
+{
+	fileHandle_t	h;
+	byte			*buf;
+	long			len;
+
+	if ( !fs_searchpaths ) {
+		Com_Error( ERR_FATAL, "Filesystem call made without initialization" );
+	}
+
+	if ( !qpath || !qpath[0] ) {
+		Com_Error( ERR_FATAL, "FS_ReadFileMapped with empty name" );
+	}
+
+	// configs may have to go through the journal
+	if ( strstr( qpath, ".cfg" ) ) {
+		return FS_ReadFile( qpath, (void **)buffer );
+	}
+
+	len = FS_FOpenFileRead( qpath, &h, qfalse );
+	if ( h == 0 ) {
+		*buffer = NULL;
+		return -1;
+	}
+
+	fs_loadCount++;
+
+	if ( fsh[h].zipData && fsh[h].zipMethod == 0 && !( (intptr_t)fsh[h].zipData & 3 ) ) {
+		if ( fs_debug->integer ) {
+			Com_Printf( "FS_ReadFileMapped: %s used in place\n", qpath );
+		}
+		*buffer = fsh[h].zipData;
+		FS_FCloseFile( h );
+		return len;
+	}
+
+	fs_loadStack++;
+
+	buf = Hunk_AllocateTempMemory( len + 1 );
+	*buffer = buf;
+
+	FS_Read( buf, len, h );
+
+	buf[len] = 0;
+	FS_FCloseFile( h );
+	return len;
+}
+
+/*
+=============
+FS_FreeFile
+=============
+*/
+void FS_FreeFile( void *buffer ) {
+	if ( !fs_searchpaths ) {
+		Com_Error( ERR_FATAL, "Filesystem call made without initialization" );
+	}
+	if ( !buffer ) {
+		Com_Error( ERR_FATAL, "FS_FreeFile( NULL )" );
+	}
+	if ( FS_IsMappedBuffer( buffer ) ) {
+		return;
+	}
+	fs_loadStack--;
+
+	Hunk_FreeTempMemory( buffer );
+
+	// if all of our temp files are free, clear all of our space
+	if ( fs_loadStack == 0 ) {
+		Hunk_ClearTempMemory();
+	}
+}
+
+/*
+============
+FS_PrefetchFile
+
+Starts reading a file that FS_ReadFile will be asked for soon.  Missing
+files, configs and anything past the prefetch budget are ignored.  Returns
+qtrue if the file is being read, qfalse doesn't mean it is missing unless
+the budget has room left.
+============
+*/
+qboolean FS_PrefetchFile( const char *qpath )
+{
+	if ( !fs_searchpaths || !qpath || !qpath[0] || strstr( qpath, ".cfg" ) ) {
+		return qfalse;
+	}
+
+	if ( FS_FindPrefetch( qpath ) ) {
+		return qtrue;
+	}
+	if ( fs_prefetchBytes >= MAX_PREFETCH_BYTES ) {
+		return qfalse;
+	}
+
+	return FS_QueueAsyncRead( qpath ) != NULL;
+}
+
+/*
+============
+FS_DropPrefetches
 
-Filename are relative to the quake search path
-a null buffer will just return the file length without loading
+Frees the prefetched files nobody asked for, called once a load is over.
+Reads that are still queued are given up on.
 ============
 */
-long FS_ReadFile(const char *qpath, void **buffer)
+void FS_DropPrefetches( void )
 {
-	return FS_ReadFileDir(qpath, NULL, qfalse, buffer);
-}
+	fsAsyncRead_t	*req;
+	int				i, count;
 
-/*
-=============
-FS_FreeFile
-=============
-*/
-void FS_FreeFile( void *buffer ) {
-	if ( !fs_searchpaths ) {
-		Com_Error( ERR_FATAL, "Filesystem call made without initialization" );
+	if ( !fs_asyncMutex ) {
+		return;
 	}
-	if ( !buffer ) {
-		Com_Error( ERR_FATAL, "FS_FreeFile( NULL )" );
+
+	Sys_LockMutex( fs_asyncMutex );
+	for ( i = 0 ; i < MAX_ASYNC_READS ; i++ ) {
+		if ( fs_asyncReads[i].state == ASYNC_QUEUED ) {
+			fs_asyncReads[i].state = ASYNC_DONE;
+		}
 	}
-	fs_loadStack--;
+	Sys_UnlockMutex( fs_asyncMutex );
 
-	Hunk_FreeTempMemory( buffer );
+	count = 0;
+	for ( i = 0 ; i < MAX_ASYNC_READS ; i++ ) {
+		req = &fs_asyncReads[i];
+		if ( req->state != ASYNC_FREE ) {
+			FS_WaitAsyncRead( req );
+			FS_FreeAsyncRead( req );
+			count++;
+		}
+	}
 
-	// if all of our temp files are free, clear all of our space
-	if ( fs_loadStack == 0 ) {
-		Hunk_ClearTempMemory();
+	if ( count && fs_debug->integer ) {
+		Com_Printf( "FS_DropPrefetches: %i files were prefetched for nothing\n", count );
 	}
 }
 
@@ -2008,58 +3075,387 @@ ZIP FILE LOADING
 ==========================================================================
 */
 
+#define	PAKINDEX_IDENT		(('X'<<24)+('D'<<16)+('I'<<8)+'P')
+#define	PAKINDEX_VERSION	1
+
+// A copy of a pk3 central directory kept under fs_homepath/pakindex, so
+// startup doesn't have to walk every pk3 through unzip.  The entries are
+// followed by the crcs of the non-empty files, which the checksums are
+// built from, and then the names.
+typedef struct {
+	int		ident;
+	int		version;
+	int		pakSize;		// the index is stale if these change
+	int		pakTime;
+	int		numFiles;
+	int		numCrcs;
+	int		namesLength;
+} pakIndex_t;
+
+typedef struct {
+	int		pos;
+	int		len;
+	int		csize;
+	int		localPos;
+	int		method;
+	int		nameOfs;
+} pakIndexEntry_t;
+
+#define	PAKINDEX_ENTRIES(x)	((pakIndexEntry_t *)((x) + 1))
+#define	PAKINDEX_CRCS(x)	((int *)(PAKINDEX_ENTRIES(x) + (x)->numFiles))
+#define	PAKINDEX_NAMES(x)	((char *)(PAKINDEX_CRCS(x) + (x)->numCrcs))
+#define	PAKINDEX_SIZE(x)	(PAKINDEX_NAMES(x) + (x)->namesLength - (char *)(x))
+
+// one pk3 on its way through FS_ScanPakJob
+typedef struct {
+	char		ospath[MAX_OSPATH];
+	char		indexPath[MAX_OSPATH];
+	qboolean	useIndex;
+	int			pakSize;
+	int			pakTime;
+	pakIndex_t	*index;			// malloced, NULL if this isn't a usable zip
+	qboolean	indexBuilt;		// read from the zip, should be written out
+	qboolean	indexCorrupt;
+} pakScan_t;
+
+/*
+=================
+FS_PakIndexPath
+
+Named after the pk3 and a hash of its full path, paks with the same
+name in different mods get different indexes
+=================
+*/
+static void FS_PakIndexPath( const char *zipfile, char *ospath, int size ) {
+	char	base[MAX_OSPATH];
+	char	name[MAX_OSPATH];
+
+	Q_strncpyz( base, zipfile, sizeof( base ) );
+	COM_StripExtension( COM_SkipPath( base ), name, sizeof( name ) );
+	Q_strncpyz( base, name, MAX_QPATH );
+	Com_sprintf( name, sizeof( name ), "%s-%08x.idx", base,
+		Com_BlockChecksum( zipfile, strlen( zipfile ) ) );
+
+	Q_strncpyz( ospath, FS_BuildOSPath( fs_homepath->string, "pakindex", name ), size );
+}
+
 /*
 =================
-FS_LoadZipFile
+FS_ReadPakIndex
 
-Creates a new pak_t in the search chain for the contents
-of a zip file.
+Returns NULL unless there is an index that matches the pk3 on disk.
+Safe to run as a job.
 =================
 */
-static pack_t *FS_LoadZipFile(const char *zipfile, const char *basename)
+static pakIndex_t *FS_ReadPakIndex( const char *ospath, int pakSize, int pakTime, qboolean *corrupt ) {
+	pakIndex_t		*index;
+	pakIndexEntry_t	*entries;
+	FILE			*f;
+	long			length;
+	int				i;
+
+	f = Sys_FOpen( ospath, "rb" );
+	if ( !f ) {
+		return NULL;
+	}
+
+	fseek( f, 0, SEEK_END );
+	length = ftell( f );
+	fseek( f, 0, SEEK_SET );
+	if ( length < (long)sizeof( pakIndex_t ) ) {
+		fclose( f );
+		return NULL;
+	}
+
+	index = malloc( length );
+	if ( !index || fread( index, 1, length, f ) != (size_t)length ) {
+		fclose( f );
+		free( index );
+		return NULL;
+	}
+	fclose( f );
+
+	if ( index->ident != PAKINDEX_IDENT || index->version != PAKINDEX_VERSION
+		|| index->pakSize != pakSize || index->pakTime != pakTime ) {
+		free( index );
+		return NULL;
+	}
+
+	if ( index->numFiles < 0 || index->numCrcs < 0 || index->numCrcs > index->numFiles
+		|| index->namesLength <= 0 || index->numFiles > ( length - sizeof( pakIndex_t ) ) / sizeof( pakIndexEntry_t )
+		|| PAKINDEX_SIZE( index ) != length || PAKINDEX_NAMES( index )[index->namesLength - 1] ) {
+		*corrupt = qtrue;
+		free( index );
+		return NULL;
+	}
+
+	entries = PAKINDEX_ENTRIES( index );
+	for ( i = 0 ; i < index->numFiles ; i++ ) {
+		if ( entries[i].nameOfs < 0 || entries[i].nameOfs >= index->namesLength ) {
+			*corrupt = qtrue;
+			free( index );
+			return NULL;
+		}
+	}
+
+	return index;
+}
+
+/*
+=================
+FS_WritePakIndex
+=================
+*/
+static void FS_WritePakIndex( char *ospath, const pakIndex_t *index ) {
+	FILE	*f;
+	int		length;
+
+	FS_CreatePath( ospath );
+	f = Sys_FOpen( ospath, "wb" );
+	if ( !f ) {
+		Com_DPrintf( "Couldn't write %s\n", ospath );
+		return;
+	}
+
+	// a short write leaves a file the size check rejects
+	length = PAKINDEX_SIZE( index );
+	fwrite( index, 1, length, f );
+	fclose( f );
+}
+
+#define	ZIP_EOCD_SIZE		22
+#define	ZIP_CDIR_ENTRY_SIZE	46
+#define	ZIP_MAX_COMMENT		0xffff
+
+static int FS_ZipShort( const byte *p ) {
+	return p[0] | ( p[1] << 8 );
+}
+
+static unsigned FS_ZipLong( const byte *p ) {
+	return p[0] | ( p[1] << 8 ) | ( p[2] << 16 ) | ( (unsigned)p[3] << 24 );
+}
+
+/*
+=================
+FS_ReadCentralDirectory
+
+Builds an index straight from the zip central directory.  This reads what
+unzGoToFirstFile / unzGoToNextFile would, without unzip, which allocates
+from the zone and so can't run as a job.
+=================
+*/
+static pakIndex_t *FS_ReadCentralDirectory( const char *ospath, int pakSize, int pakTime ) {
+	pakIndex_t		*index;
+	pakIndexEntry_t	*entry;
+	FILE			*f;
+	byte			*buf, *p, *end;
+	char			*names;
+	int				*crcs;
+	int				tailSize, numEntries, i, nameLen, len;
+	unsigned		cdirSize, cdirOfs, centralPos, before;
+
+	if ( pakSize < ZIP_EOCD_SIZE ) {
+		return NULL;
+	}
+
+	f = Sys_FOpen( ospath, "rb" );
+	if ( !f ) {
+		return NULL;
+	}
+
+	// the end of central directory record is followed by a comment of up to 64k
+	tailSize = MIN( pakSize, ZIP_MAX_COMMENT + ZIP_EOCD_SIZE );
+	buf = malloc( tailSize );
+	if ( !buf || fseek( f, pakSize - tailSize, SEEK_SET ) || fread( buf, 1, tailSize, f ) != tailSize ) {
+		free( buf );
+		fclose( f );
+		return NULL;
+	}
+
+	for ( p = buf + tailSize - ZIP_EOCD_SIZE ; p >= buf ; p-- ) {
+		if ( p[0] == 'P' && p[1] == 'K' && p[2] == 5 && p[3] == 6 ) {
+			break;
+		}
+	}
+	if ( p < buf || FS_ZipShort( p + 4 ) || FS_ZipShort( p + 6 ) || FS_ZipShort( p + 8 ) != FS_ZipShort( p + 10 ) ) {
+		free( buf );
+		fclose( f );
+		return NULL;
+	}
+
+	centralPos = pakSize - tailSize + ( p - buf );
+	numEntries = FS_ZipShort( p + 10 );
+	cdirSize = FS_ZipLong( p + 12 );
+	cdirOfs = FS_ZipLong( p + 16 );
+	free( buf );
+
+	if ( cdirOfs > centralPos || cdirSize > centralPos - cdirOfs ) {
+		fclose( f );
+		return NULL;
+	}
+	// bytes in front of the zip, for self extracting archives
+	before = centralPos - ( cdirOfs + cdirSize );
+
+	buf = malloc( cdirSize + 1 );
+	if ( !buf || fseek( f, cdirOfs + before, SEEK_SET ) || fread( buf, 1, cdirSize, f ) != cdirSize ) {
+		free( buf );
+		fclose( f );
+		return NULL;
+	}
+	fclose( f );
+	end = buf + cdirSize;
+
+	// names can't take more room than the directory they come from
+	index = malloc( sizeof( *index ) + numEntries * ( sizeof( pakIndexEntry_t ) + sizeof( int ) ) + cdirSize + 1 );
+	if ( !index ) {
+		free( buf );
+		return NULL;
+	}
+	index->ident = PAKINDEX_IDENT;
+	index->version = PAKINDEX_VERSION;
+	index->pakSize = pakSize;
+	index->pakTime = pakTime;
+	index->numFiles = 0;
+	index->numCrcs = 0;
+
+	// count first, the crcs go in front of the names
+	for ( i = 0, p = buf ; i < numEntries ; i++ ) {
+		if ( end - p < ZIP_CDIR_ENTRY_SIZE || FS_ZipLong( p ) != 0x02014b50 ) {
+			break;
+		}
+		len = ZIP_CDIR_ENTRY_SIZE + FS_ZipShort( p + 28 ) + FS_ZipShort( p + 30 ) + FS_ZipShort( p + 32 );
+		if ( end - p < len ) {
+			break;
+		}
+		if ( FS_ZipLong( p + 24 ) > 0 ) {
+			index->numCrcs++;
+		}
+		index->numFiles++;
+		p += len;
+	}
+
+	crcs = PAKINDEX_CRCS( index );
+	names = PAKINDEX_NAMES( index );
+	index->namesLength = 0;
+
+	for ( i = 0, p = buf ; i < index->numFiles ; i++ ) {
+		entry = &PAKINDEX_ENTRIES( index )[i];
+		entry->pos = cdirOfs + ( p - buf );
+		entry->method = FS_ZipShort( p + 10 );
+		entry->csize = FS_ZipLong( p + 20 );
+		entry->len = FS_ZipLong( p + 24 );
+		entry->localPos = FS_ZipLong( p + 42 ) + before;
+		entry->nameOfs = index->namesLength;
+		if ( entry->len > 0 ) {
+			*crcs++ = LittleLong( FS_ZipLong( p + 16 ) );
+		}
+
+		nameLen = MIN( FS_ZipShort( p + 28 ), MAX_ZPATH - 1 );
+		Com_Memcpy( names + index->namesLength, p + ZIP_CDIR_ENTRY_SIZE, nameLen );
+		names[index->namesLength + nameLen] = 0;
+		Q_strlwr( names + index->namesLength );
+		index->namesLength += strlen( names + index->namesLength ) + 1;
+
+		p += ZIP_CDIR_ENTRY_SIZE + FS_ZipShort( p + 28 ) + FS_ZipShort( p + 30 ) + FS_ZipShort( p + 32 );
+	}
+	free( buf );
+
+	// an empty pk3 still gets a valid names block
+	if ( !index->namesLength ) {
+		names[index->namesLength++] = 0;
+	}
+
+	return index;
+}
+
+/*
+=================
+FS_InitPakScan
+=================
+*/
+static void FS_InitPakScan( pakScan_t *scan, const char *zipfile, qboolean useIndex ) {
+	Com_Memset( scan, 0, sizeof( *scan ) );
+	Q_strncpyz( scan->ospath, zipfile, sizeof( scan->ospath ) );
+	scan->useIndex = useIndex;
+	if ( useIndex ) {
+		FS_PakIndexPath( zipfile, scan->indexPath, sizeof( scan->indexPath ) );
+	}
+}
+
+/*
+=================
+FS_ScanPakJob
+
+Gets the entry list of a pk3 from its index or its central directory.
+Runs on the worker threads, so nothing here may touch the zone or print.
+=================
+*/
+static void FS_ScanPakJob( void *data, int index ) {
+	pakScan_t	*scan;
+
+	scan = (pakScan_t *)data + index;
+	if ( !Sys_FileStat( scan->ospath, &scan->pakSize, &scan->pakTime ) ) {
+		return;
+	}
+
+	if ( scan->useIndex ) {
+		scan->index = FS_ReadPakIndex( scan->indexPath, scan->pakSize, scan->pakTime, &scan->indexCorrupt );
+		if ( scan->index ) {
+			return;
+		}
+	}
+
+	scan->index = FS_ReadCentralDirectory( scan->ospath, scan->pakSize, scan->pakTime );
+	scan->indexBuilt = ( scan->index != NULL );
+}
+
+/*
+=================
+FS_FinishPakScan
+
+Creates the pak_t for a scanned pk3 on the main thread
+=================
+*/
+static pack_t *FS_FinishPakScan( pakScan_t *scan, const char *basename )
 {
 	fileInPack_t	*buildBuffer;
 	pack_t			*pack;
-	unzFile			uf;
-	int				err;
-	unz_global_info gi;
-	char			filename_inzip[MAX_ZPATH];
-	unz_file_info	file_info;
-	int				i, len;
+	pakIndex_t		*index;
+	pakIndexEntry_t	*entries;
+	int				i, numCrcs;
 	long			hash;
-	int				fs_numHeaderLongs;
 	int				*fs_headerLongs;
+	int				*crcs;
 	char			*namePtr;
 
-	fs_numHeaderLongs = 0;
-
-	uf = unzOpen(zipfile);
-	err = unzGetGlobalInfo (uf,&gi);
+	if ( scan->indexCorrupt ) {
+		Com_Printf( S_COLOR_YELLOW "WARNING: %s is corrupt\n", scan->indexPath );
+	}
 
-	if (err != UNZ_OK)
+	index = scan->index;
+	if ( !index ) {
 		return NULL;
+	}
+	scan->index = NULL;
 
-	len = 0;
-	unzGoToFirstFile(uf);
-	for (i = 0; i < gi.number_entry; i++)
-	{
-		err = unzGetCurrentFileInfo(uf, &file_info, filename_inzip, sizeof(filename_inzip), NULL, 0, NULL, 0);
-		if (err != UNZ_OK) {
-			break;
-		}
-		len += strlen(filename_inzip) + 1;
-		unzGoToNextFile(uf);
+	if ( scan->indexBuilt && scan->useIndex ) {
+		FS_WritePakIndex( scan->indexPath, index );
 	}
 
-	buildBuffer = Z_Malloc( (gi.number_entry * sizeof( fileInPack_t )) + len );
-	namePtr = ((char *) buildBuffer) + gi.number_entry * sizeof( fileInPack_t );
-	fs_headerLongs = Z_Malloc( ( gi.number_entry + 1 ) * sizeof(int) );
-	fs_headerLongs[ fs_numHeaderLongs++ ] = LittleLong( fs_checksumFeed );
+	entries = PAKINDEX_ENTRIES( index );
+
+	buildBuffer = Z_Malloc( (index->numFiles * sizeof( fileInPack_t )) + index->namesLength );
+	namePtr = ((char *) buildBuffer) + index->numFiles * sizeof( fileInPack_t );
+	Com_Memcpy( namePtr, PAKINDEX_NAMES( index ), index->namesLength );
+
+	fs_headerLongs = Z_Malloc( ( index->numCrcs + 1 ) * sizeof(int) );
+	fs_headerLongs[0] = LittleLong( fs_checksumFeed );
+	Com_Memcpy( fs_headerLongs + 1, PAKINDEX_CRCS( index ), index->numCrcs * sizeof(int) );
 
 	// get the hash table size from the number of files in the zip
 	// because lots of custom pk3 files have less than 32 or 64 files
 	for (i = 1; i <= MAX_FILEHASH_SIZE; i <<= 1) {
-		if (i > gi.number_entry) {
+		if (i > index->numFiles) {
 			break;
 		}
 	}
@@ -2071,7 +3467,7 @@ static pack_t *FS_LoadZipFile(const char *zipfile, const char *basename)
 		pack->hashTable[i] = NULL;
 	}
 
-	Q_strncpyz( pack->pakFilename, zipfile, sizeof( pack->pakFilename ) );
+	Q_strncpyz( pack->pakFilename, scan->ospath, sizeof( pack->pakFilename ) );
 	Q_strncpyz( pack->pakBasename, basename, sizeof( pack->pakBasename ) );
 
 	// strip .pk3 if needed
@@ -2079,43 +3475,98 @@ static pack_t *FS_LoadZipFile(const char *zipfile, const char *basename)
 		pack->pakBasename[strlen( pack->pakBasename ) - 4] = 0;
 	}
 
-	pack->handle = uf;
-	pack->numfiles = gi.number_entry;
-	unzGoToFirstFile(uf);
+	pack->numfiles = index->numFiles;
 
-	for (i = 0; i < gi.number_entry; i++)
+	crcs = PAKINDEX_CRCS( index );
+	numCrcs = 0;
+	for (i = 0; i < index->numFiles; i++)
 	{
-		err = unzGetCurrentFileInfo(uf, &file_info, filename_inzip, sizeof(filename_inzip), NULL, 0, NULL, 0);
-		if (err != UNZ_OK) {
-			break;
-		}
-		if (file_info.uncompressed_size > 0) {
-			fs_headerLongs[fs_numHeaderLongs++] = LittleLong(file_info.crc);
-		}
-		Q_strlwr( filename_inzip );
-		hash = FS_HashFileName(filename_inzip, pack->hashSize);
-		buildBuffer[i].name = namePtr;
-		strcpy( buildBuffer[i].name, filename_inzip );
-		namePtr += strlen(filename_inzip) + 1;
+		buildBuffer[i].name = namePtr + entries[i].nameOfs;
+		hash = FS_HashFileName(buildBuffer[i].name, pack->hashSize);
 		// store the file position in the zip
-		buildBuffer[i].pos = unzGetOffset(uf);
-		buildBuffer[i].len = file_info.uncompressed_size;
+		buildBuffer[i].pos = entries[i].pos;
+		buildBuffer[i].len = entries[i].len;
+		buildBuffer[i].csize = entries[i].csize;
+		buildBuffer[i].localPos = entries[i].localPos;
+		buildBuffer[i].method = entries[i].method;
+		// the crcs are only stored for files with contents
+		if ( entries[i].len > 0 && numCrcs < index->numCrcs ) {
+			buildBuffer[i].crc = LittleLong( crcs[numCrcs++] );
+		} else {
+			buildBuffer[i].crc = 0;
+		}
 		buildBuffer[i].next = pack->hashTable[hash];
 		pack->hashTable[hash] = &buildBuffer[i];
-		unzGoToNextFile(uf);
 	}
 
-	pack->checksum = Com_BlockChecksum( &fs_headerLongs[ 1 ], sizeof(*fs_headerLongs) * ( fs_numHeaderLongs - 1 ) );
-	pack->pure_checksum = Com_BlockChecksum( fs_headerLongs, sizeof(*fs_headerLongs) * fs_numHeaderLongs );
+	pack->checksum = Com_BlockChecksum( &fs_headerLongs[ 1 ], sizeof(*fs_headerLongs) * index->numCrcs );
+	pack->pure_checksum = Com_BlockChecksum( fs_headerLongs, sizeof(*fs_headerLongs) * ( index->numCrcs + 1 ) );
 	pack->checksum = LittleLong( pack->checksum );
 	pack->pure_checksum = LittleLong( pack->pure_checksum );
 
 	Z_Free(fs_headerLongs);
+	free(index);
 
 	pack->buildBuffer = buildBuffer;
 	return pack;
 }
 
+/*
+=================
+FS_LoadZipFile
+
+Creates a new pak_t in the search chain for the contents
+of a zip file.
+=================
+*/
+static pack_t *FS_LoadZipFile(const char *zipfile, const char *basename)
+{
+	pakScan_t	scan;
+
+	FS_InitPakScan( &scan, zipfile, fs_pakIndex && fs_pakIndex->integer );
+	FS_ScanPakJob( &scan, 0 );
+	return FS_FinishPakScan( &scan, basename );
+}
+
+/*
+=================
+FS_LoadPaks
+
+Loads a sorted list of pk3s from one directory, the central directories
+are read in parallel.  paks[i] is NULL for anything that isn't a pk3.
+=================
+*/
+static void FS_LoadPaks( const char *path, const char *dir, char **pakfiles, int numfiles,
+						pack_t **paks, qboolean useIndex, qboolean parallel ) {
+	pakScan_t	*scans;
+	int			i;
+
+	if ( !numfiles ) {
+		return;
+	}
+
+	scans = Z_Malloc( numfiles * sizeof( *scans ) );
+	for ( i = 0 ; i < numfiles ; i++ ) {
+		FS_InitPakScan( &scans[i], FS_BuildOSPath( path, dir, pakfiles[i] ), useIndex );
+	}
+
+	if ( parallel ) {
+		Com_RunJobs( FS_ScanPakJob, scans, numfiles );
+	} else {
+		for ( i = 0 ; i < numfiles ; i++ ) {
+			FS_ScanPakJob( scans, i );
+		}
+	}
+
+	// everything that touches the zone happens in order on this thread,
+	// the search path comes out the same however the jobs ran
+	for ( i = 0 ; i < numfiles ; i++ ) {
+		paks[i] = FS_FinishPakScan( &scans[i], pakfiles[i] );
+	}
+
+	Z_Free( scans );
+}
+
 /*
 =================
 FS_FreePak
@@ -2126,7 +3577,12 @@ Frees a pak structure and releases all associated resources
 
 static void FS_FreePak(pack_t *thepak)
 {
-	unzClose(thepak->handle);
+	if (thepak->handle) {
+		unzClose(thepak->handle);
+	}
+	if (thepak->mapBase) {
+		Sys_UnmapFile((void *)thepak->mapBase, thepak->mapLength);
+	}
 	Z_Free(thepak->buildBuffer);
 	Z_Free(thepak);
 }
@@ -2795,7 +4251,7 @@ void FS_Path_f( void ) {
 
 	Com_Printf( "\n" );
 	for ( i = 1 ; i < MAX_FILE_HANDLES ; i++ ) {
-		if ( fsh[i].handleFiles.file.o ) {
+		if ( fsh[i].handleFiles.file.o || fsh[i].zipData ) {
 			Com_Printf( "handle %i: %s\n", i, fsh[i].name );
 		}
 	}
@@ -2878,6 +4334,180 @@ void FS_Which_f( void ) {
 	Com_Printf("File not found: \"%s\"\n", filename);
 }
 
+/*
+============
+FS_WriteBenchPak
+
+A pk3 of small stored text files for fsbench
+============
+*/
+static qboolean FS_WriteBenchPak( const char *ospath, int pakNum, int numFiles ) {
+	FILE		*f;
+	byte		*cdir, *p;
+	byte		header[ZIP_CDIR_ENTRY_SIZE];
+	char		name[MAX_QPATH], data[64];
+	int			i, nameLen, dataLen, ofs;
+	unsigned	crc;
+
+	f = Sys_FOpen( ospath, "wb" );
+	if ( !f ) {
+		return qfalse;
+	}
+
+	cdir = Z_Malloc( numFiles * ( ZIP_CDIR_ENTRY_SIZE + MAX_QPATH ) + ZIP_EOCD_SIZE );
+	p = cdir;
+	ofs = 0;
+
+	for ( i = 0 ; i < numFiles ; i++ ) {
+		Com_sprintf( name, sizeof( name ), "bench/pak%04i/file%04i.txt", pakNum, i );
+		Com_sprintf( data, sizeof( data ), "pak %i file %i\n", pakNum, i );
+		nameLen = strlen( name );
+		dataLen = strlen( data );
+		crc = crc32( 0, (const Bytef *)data, dataLen );
+
+		// local header
+		Com_Memset( header, 0, sizeof( header ) );
+		header[0] = 'P'; header[1] = 'K'; header[2] = 3; header[3] = 4;
+		header[4] = 10;
+		header[14] = crc; header[15] = crc >> 8; header[16] = crc >> 16; header[17] = crc >> 24;
+		header[18] = header[22] = dataLen;
+		header[26] = nameLen;
+		fwrite( header, 1, 30, f );
+		fwrite( name, 1, nameLen, f );
+		fwrite( data, 1, dataLen, f );
+
+		// matching central directory entry
+		Com_Memset( p, 0, ZIP_CDIR_ENTRY_SIZE );
+		p[0] = 'P'; p[1] = 'K'; p[2] = 1; p[3] = 2;
+		p[4] = p[6] = 10;
+		p[16] = crc; p[17] = crc >> 8; p[18] = crc >> 16; p[19] = crc >> 24;
+		p[20] = p[24] = dataLen;
+		p[28] = nameLen;
+		p[42] = ofs; p[43] = ofs >> 8; p[44] = ofs >> 16; p[45] = ofs >> 24;
+		Com_Memcpy( p + ZIP_CDIR_ENTRY_SIZE, name, nameLen );
+		p += ZIP_CDIR_ENTRY_SIZE + nameLen;
+
+		ofs += 30 + nameLen + dataLen;
+	}
+
+	// end of central directory
+	i = p - cdir;
+	Com_Memset( p, 0, ZIP_EOCD_SIZE );
+	p[0] = 'P'; p[1] = 'K'; p[2] = 5; p[3] = 6;
+	p[8] = p[10] = numFiles; p[9] = p[11] = numFiles >> 8;
+	p[12] = i; p[13] = i >> 8; p[14] = i >> 16; p[15] = i >> 24;
+	p[16] = ofs; p[17] = ofs >> 8; p[18] = ofs >> 16; p[19] = ofs >> 24;
+	p += ZIP_EOCD_SIZE;
+
+	fwrite( cdir, 1, p - cdir, f );
+	fclose( f );
+	Z_Free( cdir );
+	return qtrue;
+}
+
+/*
+============
+FS_Bench_f
+
+fsbench [paks] [files per pak]
+
+Times loading a directory of synthetic pk3s from their central
+directories and from the pak indexes, on one thread and on the workers.
+The checksums have to come out the same every time.
+============
+*/
+void FS_Bench_f( void ) {
+	static const struct {
+		const char	*name;
+		qboolean	useIndex;
+		qboolean	parallel;
+	} runs[] = {
+		{ "central directory, 1 thread", qfalse, qfalse },
+		{ "central directory, workers", qfalse, qtrue },
+		{ "writing indexes", qtrue, qfalse },
+		{ "index, 1 thread", qtrue, qfalse },
+		{ "index, workers", qtrue, qtrue }
+	};
+	char		**names;
+	pack_t		**paks;
+	int			*checksums;
+	char		*ospath, indexPath[MAX_OSPATH];
+	int			numPaks, numFiles, i, run, size, time;
+	int64_t		start;
+	qboolean	match;
+
+	numPaks = Cmd_Argc() > 1 ? atoi( Cmd_Argv( 1 ) ) : 400;
+	numFiles = Cmd_Argc() > 2 ? atoi( Cmd_Argv( 2 ) ) : 64;
+	if ( numPaks < 1 || numPaks > MAX_SEARCH_PATHS || numFiles < 1 || numFiles > 4096 ) {
+		Com_Printf( "usage: fsbench [paks (1-%i)] [files per pak (1-4096)]\n", MAX_SEARCH_PATHS );
+		return;
+	}
+
+	names = Z_Malloc( numPaks * sizeof( *names ) );
+	paks = Z_Malloc( numPaks * sizeof( *paks ) );
+	checksums = Z_Malloc( numPaks * 2 * sizeof( *checksums ) );
+
+	Com_Printf( "Writing %i pk3s of %i files...\n", numPaks, numFiles );
+	for ( i = 0 ; i < numPaks ; i++ ) {
+		names[i] = CopyString( va( "bench%04i-%04i.pk3", numFiles, i ) );
+		ospath = FS_BuildOSPath( fs_homepath->string, "fsbench", names[i] );
+		if ( i == 0 ) {
+			FS_CreatePath( ospath );
+		}
+		if ( !Sys_FileStat( ospath, &size, &time ) && !FS_WriteBenchPak( ospath, i, numFiles ) ) {
+			Com_Printf( "Couldn't write %s\n", ospath );
+			break;
+		}
+
+		// the index runs have to start cold
+		FS_PakIndexPath( ospath, indexPath, sizeof( indexPath ) );
+		FS_Remove( indexPath );
+	}
+
+	if ( i == numPaks ) {
+		// the first pass only warms the page cache
+		FS_LoadPaks( fs_homepath->string, "fsbench", names, numPaks, paks, qfalse, qfalse );
+		for ( i = 0 ; i < numPaks ; i++ ) {
+			checksums[i * 2] = paks[i] ? paks[i]->checksum : 0;
+			checksums[i * 2 + 1] = paks[i] ? paks[i]->pure_checksum : 0;
+			if ( paks[i] ) {
+				FS_FreePak( paks[i] );
+			}
+		}
+
+		Com_Printf( "%i worker threads\n", Com_NumWorkers() );
+		for ( run = 0 ; run < ARRAY_LEN( runs ) ; run++ ) {
+			start = Sys_Microseconds();
+			FS_LoadPaks( fs_homepath->string, "fsbench", names, numPaks, paks, runs[run].useIndex, runs[run].parallel );
+			start = Sys_Microseconds() - start;
+
+			match = qtrue;
+			for ( i = 0 ; i < numPaks ; i++ ) {
+				if ( !paks[i] ) {
+					match = qfalse;
+					continue;
+				}
+				if ( paks[i]->checksum != checksums[i * 2] || paks[i]->pure_checksum != checksums[i * 2 + 1] ) {
+					match = qfalse;
+				}
+				FS_FreePak( paks[i] );
+			}
+
+			Com_Printf( "%-28s %9.2f ms%s\n", runs[run].name, start / 1000.0,
+				match ? "" : S_COLOR_RED "  checksums differ" );
+		}
+	}
+
+	for ( i = 0 ; i < numPaks ; i++ ) {
+		if ( names[i] ) {
+			Z_Free( names[i] );
+		}
+	}
+	Z_Free( checksums );
+	Z_Free( paks );
+	Z_Free( names );
+}
+
 
 //===========================================================================
 
@@ -2912,6 +4542,7 @@ void FS_AddGameDirectory( const char *path, const char *dir ) {
 	char			**pakdirs;
 	int				pakdirsi;
 	char			**pakdirstmp;
+	pack_t			**paks;
 
 	int				pakwhich;
 	int				len;
@@ -2934,6 +4565,9 @@ void FS_AddGameDirectory( const char *path, const char *dir ) {
 
 	qsort( pakfiles, numfiles, sizeof(char*), paksort );
 
+	paks = Z_Malloc( ( numfiles + 1 ) * sizeof( *paks ) );
+	FS_LoadPaks( path, dir, pakfiles, numfiles, paks, fs_pakIndex->integer, qtrue );
+
 	if ( fs_numServerPaks ) {
 		numdirs = 0;
 		pakdirs = NULL;
@@ -2968,8 +4602,7 @@ void FS_AddGameDirectory( const char *path, const char *dir ) {
 
 		if (pakwhich) {
 			// The next .pk3 file is before the next .pk3dir
-			pakfile = FS_BuildOSPath(path, dir, pakfiles[pakfilesi]);
-			if ((pak = FS_LoadZipFile(pakfile, pakfiles[pakfilesi])) == 0) {
+			if ((pak = paks[pakfilesi]) == 0) {
 				// This isn't a .pk3! Next!
 				pakfilesi++;
 				continue;
@@ -3018,6 +4651,7 @@ void FS_AddGameDirectory( const char *path, const char *dir ) {
 	// done
 	Sys_FreeFileList( pakfiles );
 	Sys_FreeFileList( pakdirs );
+	Z_Free( paks );
 
 	//
 	// add the directory to the search path
@@ -3226,12 +4860,17 @@ void FS_Shutdown( qboolean closemfp ) {
 	searchpath_t	*p, *next;
 	int	i;
 
+	// reads in flight may point into the paks
+	FS_FlushAsyncReads( closemfp );
+
 	for(i = 0; i < MAX_FILE_HANDLES; i++) {
 		if (fsh[i].fileSize) {
 			FS_FCloseFile(i);
 		}
 	}
 
+	FS_FreeContentTable( !closemfp );
+
 	// free everything
 	for(p = fs_searchpaths; p; p = next)
 	{
@@ -3253,6 +4892,8 @@ void FS_Shutdown( qboolean closemfp ) {
 	Cmd_RemoveCommand( "fdir" );
 	Cmd_RemoveCommand( "touchFile" );
 	Cmd_RemoveCommand( "which" );
+	Cmd_RemoveCommand( "fsbench" );
+	Cmd_RemoveCommand( "fsdedup" );
 
 #ifdef FS_MISSING
 	if (closemfp) {
@@ -3320,6 +4961,12 @@ static void FS_Startup( const char *gameName )
 	fs_packFiles = 0;
 
 	fs_debug = Cvar_Get( "fs_debug", "0", 0 );
+	fs_mmap = Cvar_Get( "fs_mmap", "1", CVAR_ARCHIVE );
+	fs_pakIndex = Cvar_Get( "fs_pakindex", "1", CVAR_ARCHIVE );
+	fs_ioThreads = Cvar_Get( "fs_iothreads", "2", CVAR_ARCHIVE | CVAR_LATCH );
+	Cvar_CheckRange( fs_ioThreads, 0, MAX_IO_THREADS, qtrue );
+	fs_dedup = Cvar_Get( "fs_dedup", "32", CVAR_ARCHIVE );
+	Cvar_CheckRange( fs_dedup, 0, 1024, qtrue );
 	fs_basepath = Cvar_Get ("fs_basepath", Sys_DefaultInstallPath(), CVAR_INIT|CVAR_PROTECTED );
 	fs_basegame = Cvar_Get ("fs_basegame", "", CVAR_INIT );
 	homePath = Sys_DefaultHomePath();
@@ -3424,11 +5071,15 @@ static void FS_Startup( const char *gameName )
 	Cmd_AddCommand ("fdir", FS_NewDir_f );
 	Cmd_AddCommand ("touchFile", FS_TouchFile_f );
 	Cmd_AddCommand ("which", FS_Which_f );
+	Cmd_AddCommand ("fsbench", FS_Bench_f );
+	Cmd_AddCommand ("fsdedup", FS_Dedup_f );
 
 	// https://zerowing.idsoftware.com/bugzilla/show_bug.cgi?id=506
 	// reorder the pure pk3 files according to server order
 	FS_ReorderPurePaks();
 
+	FS_BuildContentTable();
+
 	// print the current search paths
 	FS_Path_f();
 
@@ -3865,6 +5516,9 @@ exception of .cfg and .dat files.
 void FS_PureServerSetLoadedPaks( const char *pakSums, const char *pakNames ) {
 	int		i, c, d;
 
+	// prefetches were looked up under the old pure list
+	FS_FlushAsyncReads( qfalse );
+
 	Cmd_TokenizeString( pakSums );
 
 	c = Cmd_Argc();
@@ -4155,7 +5809,9 @@ int		FS_FOpenFileByMode( const char *qpath, fileHandle_t *f, fsMode_t mode ) {
 
 int		FS_FTell( fileHandle_t f ) {
 	int pos;
-	if (fsh[f].zipFile == qtrue) {
+	if (fsh[f].zipData) {
+		pos = fsh[f].zipReadPos;
+	} else if (fsh[f].zipFile == qtrue) {
 		pos = unztell(fsh[f].handleFiles.file.z);
 	} else {
 		pos = ftell(fsh[f].handleFiles.file.o);
@@ -29,14 +29,17 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 
 static int			bloc = 0;
 
+// the offset based functions only touch the caller's bit offset, so they
+// can be used from several threads at once as long as the huff_t is not
+// being updated; the adaptive whole-buffer functions use the global bloc
+
 void	Huff_putBit( int bit, byte *fout, int *offset) {
-	bloc = *offset;
-	if ((bloc&7) == 0) {
-		fout[(bloc>>3)] = 0;
+	int	o = *offset;
+	if ((o&7) == 0) {
+		fout[(o>>3)] = 0;
 	}
-	fout[(bloc>>3)] |= bit << (bloc&7);
-	bloc++;
-	*offset = bloc;
+	fout[(o>>3)] |= bit << (o&7);
+	*offset = o + 1;
 }
 
 int		Huff_getBloc(void)
@@ -51,27 +54,28 @@ void	Huff_setBloc(int _bloc)
 
 int		Huff_getBit( byte *fin, int *offset) {
 	int t;
-	bloc = *offset;
-	t = (fin[(bloc>>3)] >> (bloc&7)) & 0x1;
-	bloc++;
-	*offset = bloc;
+	int o = *offset;
+	t = (fin[(o>>3)] >> (o&7)) & 0x1;
+	*offset = o + 1;
 	return t;
 }
 
 /* Add a bit to the output file (buffered) */
-static void add_bit (char bit, byte *fout) {
-	if ((bloc&7) == 0) {
-		fout[(bloc>>3)] = 0;
+static void add_bit (char bit, byte *fout, int *offset) {
+	int o = *offset;
+	if ((o&7) == 0) {
+		fout[(o>>3)] = 0;
 	}
-	fout[(bloc>>3)] |= bit << (bloc&7);
-	bloc++;
+	fout[(o>>3)] |= bit << (o&7);
+	*offset = o + 1;
 }
 
 /* Receive one bit from the input file (buffered) */
-static int get_bit (byte *fin) {
+static int get_bit (byte *fin, int *offset) {
 	int t;
-	t = (fin[(bloc>>3)] >> (bloc&7)) & 0x1;
-	bloc++;
+	int o = *offset;
+	t = (fin[(o>>3)] >> (o&7)) & 0x1;
+	*offset = o + 1;
 	return t;
 }
 
@@ -265,7 +269,7 @@ void Huff_addRef(huff_t* huff, byte ch) {
 /* Get a symbol */
 int Huff_Receive (node_t *node, int *ch, byte *fin) {
 	while (node && node->symbol == INTERNAL_NODE) {
-		if (get_bit(fin)) {
+		if (get_bit(fin, &bloc)) {
 			node = node->right;
 		} else {
 			node = node->left;
@@ -280,14 +284,14 @@ int Huff_Receive (node_t *node, int *ch, byte *fin) {
 
 /* Get a symbol */
 void Huff_offsetReceive (node_t *node, int *ch, byte *fin, int *offset, int maxoffset) {
-	bloc = *offset;
+	int o = *offset;
 	while (node && node->symbol == INTERNAL_NODE) {
-		if (bloc >= maxoffset) {
+		if (o >= maxoffset) {
 			*ch = 0;
 			*offset = maxoffset + 1;
 			return;
 		}
-		if (get_bit(fin)) {
+		if (get_bit(fin, &o)) {
 			node = node->right;
 		} else {
 			node = node->left;
@@ -299,23 +303,23 @@ void Huff_offsetReceive (node_t *node, int *ch, byte *fin, int *offset, int maxo
 //		Com_Error(ERR_DROP, "Illegal tree!");
 	}
 	*ch = node->symbol;
-	*offset = bloc;
+	*offset = o;
 }
 
 /* Send the prefix code for this node */
-static void send(node_t *node, node_t *child, byte *fout, int maxoffset) {
+static void send(node_t *node, node_t *child, byte *fout, int *offset, int maxoffset) {
 	if (node->parent) {
-		send(node->parent, node, fout, maxoffset);
+		send(node->parent, node, fout, offset, maxoffset);
 	}
 	if (child) {
-		if (bloc >= maxoffset) {
-			bloc = maxoffset + 1;
+		if (*offset >= maxoffset) {
+			*offset = maxoffset + 1;
 			return;
 		}
 		if (node->right == child) {
-			add_bit(1, fout);
+			add_bit(1, fout, offset);
 		} else {
-			add_bit(0, fout);
+			add_bit(0, fout, offset);
 		}
 	}
 }
@@ -327,17 +331,15 @@ void Huff_transmit (huff_t *huff, int ch, byte *fout, int maxoffset) {
 		/* node_t hasn't been transmitted, send a NYT, then the symbol */
 		Huff_transmit(huff, NYT, fout, maxoffset);
 		for (i = 7; i >= 0; i--) {
-			add_bit((char)((ch >> i) & 0x1), fout);
+			add_bit((char)((ch >> i) & 0x1), fout, &bloc);
 		}
 	} else {
-		send(huff->loc[ch], NULL, fout, maxoffset);
+		send(huff->loc[ch], NULL, fout, &bloc, maxoffset);
 	}
 }
 
 void Huff_offsetTransmit (huff_t *huff, int ch, byte *fout, int *offset, int maxoffset) {
-	bloc = *offset;
-	send(huff->loc[ch], NULL, fout, maxoffset);
-	*offset = bloc;
+	send(huff->loc[ch], NULL, fout, offset, maxoffset);
 }
 
 void Huff_Decompress(msg_t *mbuf, int offset) {
@@ -380,7 +382,7 @@ void Huff_Decompress(msg_t *mbuf, int offset) {
 		if ( ch == NYT ) {								/* We got a NYT, get the symbol associated with it */
 			ch = 0;
 			for ( i = 0; i < 8; i++ ) {
-				ch = (ch<<1) + get_bit(buffer);
+				ch = (ch<<1) + get_bit(buffer, &bloc);
 			}
 		}
     
@@ -392,8 +394,6 @@ void Huff_Decompress(msg_t *mbuf, int offset) {
 	Com_Memcpy(mbuf->data + offset, seq, cch);
 }
 
-extern 	int oldsize;
-
 void Huff_Compress(msg_t *mbuf, int offset) {
 	int			i, ch, size;
 	byte		seq[65536];
@@ -432,6 +432,56 @@ void Huff_Compress(msg_t *mbuf, int offset) {
 	Com_Memcpy(mbuf->data+offset, seq, (bloc>>3));
 }
 
+/*
+Builds the code tables for a pair of trees that have been given the same
+updates.  The encoder codes are taken from the leaves, the decoder lookup is
+filled by walking the tree for every possible run of HUFF_LOOKUP_BITS bits.
+Returns qfalse if a symbol is missing or a code doesn't fit in 32 bits.
+*/
+qboolean Huff_BuildTables( huff_t *encoder, huff_t *decoder, huffTables_t *tables ) {
+	node_t	*node;
+	int		ch, i, len;
+	unsigned int code;
+
+	Com_Memset( tables, 0, sizeof( *tables ) );
+
+	for ( ch = 0; ch < HMAX; ch++ ) {
+		node = encoder->loc[ch];
+		if ( !node ) {
+			return qfalse;
+		}
+		code = 0;
+		len = 0;
+		for ( ; node->parent; node = node->parent ) {
+			if ( ++len > 32 ) {
+				return qfalse;
+			}
+			code = (code << 1) | (node->parent->right == node);
+		}
+		tables->code[ch] = code;
+		tables->codeLen[ch] = len;
+	}
+
+	for ( i = 0; i < HUFF_LOOKUP_SIZE; i++ ) {
+		node = decoder->tree;
+		for ( len = 0; len < HUFF_LOOKUP_BITS && node->symbol == INTERNAL_NODE; len++ ) {
+			node = ((i >> len) & 1) ? node->right : node->left;
+			if ( !node ) {
+				return qfalse;
+			}
+		}
+		if ( node->symbol == INTERNAL_NODE ) {
+			tables->symbol[i] = INTERNAL_NODE;
+			tables->node[i] = node;
+		} else {
+			tables->symbol[i] = node->symbol;
+			tables->symbolLen[i] = len;
+		}
+	}
+
+	return qtrue;
+}
+
 void Huff_Init(huffman_t *huff) {
 
 	Com_Memset(&huff->compressor, 0, sizeof(huff_t));
@@ -23,8 +23,10 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 #include "qcommon.h"
 
 static huffman_t		msgHuff;
+static huffTables_t		msgHuffTables;
 
 static qboolean			msgInit = qfalse;
+static qboolean			msgUseTables = qfalse;	// set once the tables are built
 
 int pcount[256];
 
@@ -37,8 +39,6 @@ Handles byte ordering and avoids alignment errors
 ==============================================================================
 */
 
-int oldsize = 0;
-
 void MSG_initHuffman( void );
 
 void MSG_Init( msg_t *buf, byte *data, int length ) {
@@ -101,12 +101,159 @@ bit functions
 =============================================================================
 */
 
+/*
+=================
+MSG_FlushBits
+
+Stores count bits, at most 57, at a bit offset.  Only the bytes the bits land
+in are touched and, as with Huff_putBit, the rest of the last byte is zeroed.
+=================
+*/
+static void MSG_FlushBits( byte *data, int offset, uint64_t bits, int count ) {
+	byte	*p;
+	int		shift, bytes, i;
+
+	p = data + ( offset >> 3 );
+	shift = offset & 7;
+
+	bits = ( bits << shift ) | ( *p & ( ( 1 << shift ) - 1 ) );
+	bytes = ( shift + count + 7 ) >> 3;
+	for ( i = 0 ; i < bytes ; i++ ) {
+		p[i] = (byte)bits;
+		bits >>= 8;
+	}
+}
+
+/*
+=================
+MSG_WriteHuffBits
+
+Table driven version of the bitstream path of MSG_WriteBits, the codes are
+gathered in a 64 bit buffer instead of being put down one bit at a time
+=================
+*/
+static void MSG_WriteHuffBits( msg_t *msg, unsigned int value, int bits ) {
+	uint64_t	buffer;
+	int			offset, maxoffset;
+	int			count, nbits, len, i;
+
+	offset = msg->bit;
+	maxoffset = msg->maxsize << 3;
+	buffer = 0;
+	count = 0;
+
+	nbits = bits & 7;
+	if ( nbits ) {
+		if ( offset + nbits > maxoffset ) {
+			msg->overflowed = qtrue;
+			return;
+		}
+		buffer = value & ( ( 1 << nbits ) - 1 );
+		count = nbits;
+		value >>= nbits;
+		bits -= nbits;
+	}
+
+	for ( i = 0 ; i < bits ; i += 8 ) {
+		len = msgHuffTables.codeLen[value & 0xff];
+		if ( offset + count + len > maxoffset ) {
+			msg->bit = maxoffset + 1;
+			msg->overflowed = qtrue;
+			return;
+		}
+		if ( count + len > 57 ) {
+			MSG_FlushBits( msg->data, offset, buffer, count );
+			offset += count;
+			buffer = 0;
+			count = 0;
+		}
+		buffer |= (uint64_t)msgHuffTables.code[value & 0xff] << count;
+		count += len;
+		value >>= 8;
+	}
+
+	MSG_FlushBits( msg->data, offset, buffer, count );
+	msg->bit = offset + count;
+	msg->cursize = ( msg->bit >> 3 ) + 1;
+}
+
+/*
+=================
+MSG_PeekBits
+
+Returns at least the next 17 bits of a bitstream, with anything past the end
+of the message read as zero
+=================
+*/
+static ID_INLINE unsigned int MSG_PeekBits( const msg_t *msg, int offset ) {
+	const byte	*p;
+	unsigned int window;
+	int			left;
+
+	p = msg->data + ( offset >> 3 );
+	left = msg->cursize - ( offset >> 3 );
+
+	if ( left >= 3 ) {
+		window = p[0] | ( p[1] << 8 ) | ( p[2] << 16 );
+	} else if ( left == 2 ) {
+		window = p[0] | ( p[1] << 8 );
+	} else if ( left == 1 ) {
+		window = p[0];
+	} else {
+		window = 0;
+	}
+
+	return window >> ( offset & 7 );
+}
+
+/*
+=================
+MSG_WriteBitstream
+
+Appends bits that were already coded into another bitstream message.  The
+message codes don't depend on where they start, so a run of writes can be
+captured once and copied into any number of messages.
+=================
+*/
+void MSG_WriteBitstream( msg_t *msg, const byte *data, int offset, int bits ) {
+	const byte	*p;
+	uint64_t	chunk;
+	int			count, bytes, i;
+
+	if ( msg->overflowed || bits <= 0 ) {
+		return;
+	}
+
+	if ( msg->bit + bits > msg->maxsize << 3 ) {
+		msg->bit = ( msg->maxsize << 3 ) + 1;
+		msg->overflowed = qtrue;
+		return;
+	}
+
+	while ( bits > 0 ) {
+		count = bits > 57 ? 57 : bits;
+
+		p = data + ( offset >> 3 );
+		bytes = ( ( offset & 7 ) + count + 7 ) >> 3;
+		chunk = 0;
+		for ( i = 0 ; i < bytes ; i++ ) {
+			chunk |= (uint64_t)p[i] << ( i * 8 );
+		}
+		chunk = ( chunk >> ( offset & 7 ) ) & ( ( (uint64_t)1 << count ) - 1 );
+
+		MSG_FlushBits( msg->data, msg->bit, chunk, count );
+		msg->bit += count;
+		offset += count;
+		bits -= count;
+	}
+
+	msg->cursize = ( msg->bit >> 3 ) + 1;
+}
+
 // negative bit values include signs
 void MSG_WriteBits( msg_t *msg, int value, int bits ) {
 	int	i;
 
-	oldsize += bits;
-
 	if ( msg->overflowed ) {
 		return;
 	}
@@ -142,6 +289,8 @@ void MSG_WriteBits( msg_t *msg, int value, int bits ) {
 		} else {
 			Com_Error( ERR_DROP, "can't write %d bits", bits );
 		}
+	} else if ( msgUseTables ) {
+		MSG_WriteHuffBits( msg, value & (0xffffffff >> (32 - bits)), bits );
 	} else {
 		value &= (0xffffffff >> (32 - bits));
 		if ( bits&7 ) {
@@ -221,6 +370,44 @@ int MSG_ReadBits( msg_t *msg, int bits ) {
 		}
 		else
 			Com_Error(ERR_DROP, "can't read %d bits", bits);
+	} else if ( msgUseTables ) {
+		int		offset, maxoffset, index, len;
+
+		offset = msg->bit;
+		maxoffset = msg->cursize << 3;
+		nbits = 0;
+		if (bits&7) {
+			nbits = bits&7;
+			if (offset + nbits > maxoffset) {
+				msg->readcount = msg->cursize + 1;
+				return 0;
+			}
+			value = MSG_PeekBits( msg, offset ) & ( ( 1 << nbits ) - 1 );
+			offset += nbits;
+			bits = bits - nbits;
+		}
+		for(i=0;i<bits;i+=8) {
+			index = MSG_PeekBits( msg, offset ) & ( HUFF_LOOKUP_SIZE - 1 );
+			len = msgHuffTables.symbolLen[index];
+			if ( len ) {
+				get = msgHuffTables.symbol[index];
+				offset += len;
+			} else if ( offset + HUFF_LOOKUP_BITS <= maxoffset ) {
+				// longer code, finish it on the tree
+				offset += HUFF_LOOKUP_BITS;
+				Huff_offsetReceive( msgHuffTables.node[index], &get, msg->data, &offset, maxoffset );
+			} else {
+				offset = maxoffset + 1;
+			}
+			if ( offset > maxoffset ) {
+				msg->bit = maxoffset + 1;
+				msg->readcount = msg->cursize + 1;
+				return 0;
+			}
+			value = (unsigned int)value | ((unsigned int)get<<(i+nbits));
+		}
+		msg->bit = offset;
+		msg->readcount = (msg->bit>>3)+1;
 	} else {
 		nbits = 0;
 		if (bits&7) {
@@ -653,7 +840,6 @@ void MSG_WriteDeltaUsercmdKey( msg_t *msg, int key, usercmd_t *from, usercmd_t *
 		from->buttons == to->buttons &&
 		from->weapon == to->weapon) {
 			MSG_WriteBits( msg, 0, 1 );				// no change
-			oldsize += 7;
 			return;
 	}
 	key ^= to->serverTime;
@@ -872,8 +1058,6 @@ void MSG_WriteDeltaEntity( msg_t *msg, struct entityState_s *from, struct entity
 
 	MSG_WriteByte( msg, lc );	// # of changes
 
-	oldsize += numFields;
-
 	for ( i = 0, field = entityStateFields ; i < lc ; i++, field++ ) {
 		fromF = (int *)( (byte *)from + field->offset );
 		toF = (int *)( (byte *)to + field->offset );
@@ -892,7 +1076,6 @@ void MSG_WriteDeltaEntity( msg_t *msg, struct entityState_s *from, struct entity
 
 			if (fullFloat == 0.0f) {
 					MSG_WriteBits( msg, 0, 1 );
-					oldsize += FLOAT_INT_BITS;
 			} else {
 				MSG_WriteBits( msg, 1, 1 );
 				if ( trunc == fullFloat && trunc + FLOAT_INT_BIAS >= 0 && 
@@ -1046,6 +1229,139 @@ void MSG_ReadDeltaEntity( msg_t *msg, entityState_t *from, entityState_t *to,
 	}
 }
 
+/*
+==================
+MSG_ReadPacketEntity
+
+Reads the entity into slot parseNum of the parse buffer, returns qfalse if
+the delta removed it
+==================
+*/
+static qboolean MSG_ReadPacketEntity( msg_t *msg, entityState_t *parseEntities, int parseMask,
+									int parseNum, entityState_t *old, int number, qboolean unchanged ) {
+	entityState_t	*state;
+
+	state = &parseEntities[parseNum & parseMask];
+
+	if ( unchanged ) {
+		*state = *old;
+	} else {
+		MSG_ReadDeltaEntity( msg, old, state, number );
+	}
+
+	return state->number != ( MAX_GENTITIES - 1 );
+}
+
+/*
+==================
+MSG_ReadPacketEntities
+
+Reads the entity list of a snapshot.  It is delta compressed against the
+numOld entities starting at oldFirst in the circular parseEntities buffer,
+and against the baselines for entities the old frame doesn't have.  The
+new entities are added at *parseEntitiesNum, parseMask is the buffer size
+minus one.  verbose prints every entity like cl_shownet 3.
+
+Returns the number of new entities, or -1 if the message ended first
+==================
+*/
+int MSG_ReadPacketEntities( msg_t *msg, entityState_t *parseEntities, int parseMask, int *parseEntitiesNum,
+							int oldFirst, int numOld, entityState_t *baselines, qboolean verbose ) {
+	entityState_t	*oldstate;
+	int				newnum, oldindex, oldnum, numEntities;
+
+	numEntities = 0;
+
+	// delta from the entities present in the old frame
+	oldindex = 0;
+	oldstate = NULL;
+	if ( !numOld ) {
+		oldnum = 99999;
+	} else {
+		oldstate = &parseEntities[oldFirst & parseMask];
+		oldnum = oldstate->number;
+	}
+
+	while ( 1 ) {
+		// read the entity index number
+		newnum = MSG_ReadBits( msg, GENTITYNUM_BITS );
+
+		if ( newnum == ( MAX_GENTITIES - 1 ) ) {
+			break;
+		}
+
+		if ( msg->readcount > msg->cursize ) {
+			return -1;
+		}
+
+		while ( oldnum < newnum ) {
+			// one or more entities from the old packet are unchanged
+			if ( verbose ) {
+				Com_Printf( "%3i:  unchanged: %i\n", msg->readcount, oldnum );
+			}
+			if ( MSG_ReadPacketEntity( msg, parseEntities, parseMask, *parseEntitiesNum, oldstate, oldnum, qtrue ) ) {
+				( *parseEntitiesNum )++;
+				numEntities++;
+			}
+
+			if ( ++oldindex >= numOld ) {
+				oldnum = 99999;
+			} else {
+				oldstate = &parseEntities[( oldFirst + oldindex ) & parseMask];
+				oldnum = oldstate->number;
+			}
+		}
+
+		if ( oldnum == newnum ) {
+			// delta from previous state
+			if ( verbose ) {
+				Com_Printf( "%3i:  delta: %i\n", msg->readcount, newnum );
+			}
+			if ( MSG_ReadPacketEntity( msg, parseEntities, parseMask, *parseEntitiesNum, oldstate, newnum, qfalse ) ) {
+				( *parseEntitiesNum )++;
+				numEntities++;
+			}
+
+			if ( ++oldindex >= numOld ) {
+				oldnum = 99999;
+			} else {
+				oldstate = &parseEntities[( oldFirst + oldindex ) & parseMask];
+				oldnum = oldstate->number;
+			}
+			continue;
+		}
+
+		// oldnum > newnum, delta from baseline
+		if ( verbose ) {
+			Com_Printf( "%3i:  baseline: %i\n", msg->readcount, newnum );
+		}
+		if ( MSG_ReadPacketEntity( msg, parseEntities, parseMask, *parseEntitiesNum, &baselines[newnum], newnum, qfalse ) ) {
+			( *parseEntitiesNum )++;
+			numEntities++;
+		}
+	}
+
+	// any remaining entities in the old frame are copied over
+	while ( oldnum != 99999 ) {
+		if ( verbose ) {
+			Com_Printf( "%3i:  unchanged: %i\n", msg->readcount, oldnum );
+		}
+		if ( MSG_ReadPacketEntity( msg, parseEntities, parseMask, *parseEntitiesNum, oldstate, oldnum, qtrue ) ) {
+			( *parseEntitiesNum )++;
+			numEntities++;
+		}
+
+		if ( ++oldindex >= numOld ) {
+			oldnum = 99999;
+		} else {
+			oldstate = &parseEntities[( oldFirst + oldindex ) & parseMask];
+			oldnum = oldstate->number;
+		}
+	}
+
+	return numEntities;
+}
+
 
 /*
 ============================================================================
@@ -1147,8 +1463,6 @@ void MSG_WriteDeltaPlayerstate( msg_t *msg, struct playerState_s *from, struct p
 
 	MSG_WriteByte( msg, lc );	// # of changes
 
-	oldsize += numFields - lc;
-
 	for ( i = 0, field = playerStateFields ; i < lc ; i++, field++ ) {
 		fromF = (int *)( (byte *)from + field->offset );
 		toF = (int *)( (byte *)to + field->offset );
@@ -1213,7 +1527,6 @@ void MSG_WriteDeltaPlayerstate( msg_t *msg, struct playerState_s *from, struct p
 
 	if (!statsbits && !persistantbits && !ammobits && !powerupbits) {
 		MSG_WriteBits( msg, 0, 1 );	// no change
-		oldsize += 4;
 		return;
 	}
 	MSG_WriteBits( msg, 1, 1 );	// changed
@@ -1677,6 +1990,9 @@ void MSG_initHuffman( void ) {
 			Huff_addRef(&msgHuff.decompressor,	(byte)i);			// Do update
 		}
 	}
+
+	// the trees are never updated again, so they can be flattened
+	msgUseTables = Huff_BuildTables( &msgHuff.compressor, &msgHuff.decompressor, &msgHuffTables );
 }
 
 /*
@@ -1715,3 +2031,205 @@ void MSG_NUinitHuffman() {
 */
 
 //===========================================================================
+
+/*
+=============================================================================
+
+delta benchmark
+
+=============================================================================
+*/
+
+#define	MSGBENCH_ENTITIES	2048
+#define	MSGBENCH_PLAYERS	256
+#define	MSGBENCH_BUFFER		( 1 << 20 )
+
+/*
+=================
+MSG_RandomizeFields
+
+Changes roughly one field in changeRate of a delta record
+=================
+*/
+static void MSG_RandomizeFields( int *seed, void *state, netField_t *fields, int numFields, int changeRate ) {
+	netField_t	*field;
+	floatint_t	*f;
+	int			i, bits;
+
+	for ( i = 0, field = fields ; i < numFields ; i++, field++ ) {
+		if ( Q_rand( seed ) % changeRate ) {
+			continue;
+		}
+		f = (floatint_t *)( (byte *)state + field->offset );
+		bits = abs( field->bits );
+		if ( !bits ) {
+			// mix of values that go out as small integers and full floats
+			if ( Q_rand( seed ) & 1 ) {
+				f->f = ( Q_rand( seed ) % 8192 ) - 4096;
+			} else {
+				f->f = ( Q_random( seed ) - 0.5f ) * 16384.0f;
+			}
+		} else if ( bits == 32 ) {
+			f->i = ( Q_rand( seed ) << 16 ) ^ Q_rand( seed );
+		} else {
+			f->i = Q_rand( seed ) & ( ( 1 << bits ) - 1 );
+		}
+	}
+}
+
+/*
+=================
+MSG_BenchWrite
+
+Writes all the deltas into one message with the tree or the table coder and
+returns the time taken over the passes
+=================
+*/
+static int MSG_BenchWrite( msg_t *msg, entityState_t *ents, playerState_t *players, int passes, qboolean tables, int *playerMsec ) {
+	int		start, entMsec;
+	int		pass, i;
+
+	msgUseTables = tables;
+
+	start = Sys_Milliseconds();
+	for ( pass = 0 ; pass < passes ; pass++ ) {
+		MSG_Clear( msg );
+		for ( i = 0 ; i < MSGBENCH_ENTITIES ; i++ ) {
+			MSG_WriteDeltaEntity( msg, &ents[i*2], &ents[i*2+1], qtrue );
+		}
+	}
+	entMsec = Sys_Milliseconds() - start;
+
+	start = Sys_Milliseconds();
+	for ( pass = 0 ; pass < passes ; pass++ ) {
+		MSG_Clear( msg );
+		for ( i = 0 ; i < MSGBENCH_PLAYERS ; i++ ) {
+			MSG_WriteDeltaPlayerstate( msg, &players[i*2], &players[i*2+1] );
+		}
+	}
+	*playerMsec = Sys_Milliseconds() - start;
+
+	return entMsec;
+}
+
+/*
+=================
+MSG_Bench_f
+
+Times MSG_WriteDeltaEntity and MSG_WriteDeltaPlayerstate on random deltas with
+the bit at a time tree coder and the table coder, and checks that both give
+the same bits and read back the same
+=================
+*/
+void MSG_Bench_f( void ) {
+	entityState_t	*ents, readEnt[2];
+	playerState_t	*players, readPlayer[2];
+	byte			*data[2];
+	msg_t			msg[2];
+	qboolean		hadTables;
+	int				passes, seed, size[2], bits[2];
+	int				treeMsec, tableMsec, treePlayerMsec, tablePlayerMsec;
+	int				mismatches, i, j;
+
+	if ( !msgInit ) {
+		MSG_initHuffman();
+	}
+	if ( !msgUseTables ) {
+		Com_Printf( "Huffman tables couldn't be built, nothing to compare.\n" );
+		return;
+	}
+
+	passes = 50;
+	if ( Cmd_Argc() > 1 ) {
+		passes = atoi( Cmd_Argv( 1 ) );
+		if ( passes < 1 ) {
+			passes = 1;
+		}
+	}
+
+	ents = Hunk_AllocateTempMemory( MSGBENCH_ENTITIES * 2 * sizeof( *ents ) );
+	players = Hunk_AllocateTempMemory( MSGBENCH_PLAYERS * 2 * sizeof( *players ) );
+	data[0] = Hunk_AllocateTempMemory( MSGBENCH_BUFFER );
+	data[1] = Hunk_AllocateTempMemory( MSGBENCH_BUFFER );
+
+	// pairs of states with a few changed fields, like a snapshot delta
+	seed = 0x1234;
+	Com_Memset( ents, 0, MSGBENCH_ENTITIES * 2 * sizeof( *ents ) );
+	for ( i = 0 ; i < MSGBENCH_ENTITIES ; i++ ) {
+		MSG_RandomizeFields( &seed, &ents[i*2], entityStateFields, ARRAY_LEN( entityStateFields ), 2 );
+		ents[i*2+1] = ents[i*2];
+		MSG_RandomizeFields( &seed, &ents[i*2+1], entityStateFields, ARRAY_LEN( entityStateFields ), 8 );
+		ents[i*2].number = ents[i*2+1].number = i % ( MAX_GENTITIES - 1 );
+	}
+	Com_Memset( players, 0, MSGBENCH_PLAYERS * 2 * sizeof( *players ) );
+	for ( i = 0 ; i < MSGBENCH_PLAYERS ; i++ ) {
+		MSG_RandomizeFields( &seed, &players[i*2], playerStateFields, ARRAY_LEN( playerStateFields ), 2 );
+		players[i*2+1] = players[i*2];
+		MSG_RandomizeFields( &seed, &players[i*2+1], playerStateFields, ARRAY_LEN( playerStateFields ), 8 );
+		for ( j = 0 ; j < 4 ; j++ ) {
+			players[i*2+1].stats[Q_rand( &seed ) % MAX_STATS] = Q_rand( &seed ) & 0x7fff;
+			players[i*2+1].ammo[Q_rand( &seed ) % MAX_WEAPONS] = Q_rand( &seed ) & 0x7fff;
+		}
+	}
+
+	hadTables = msgUseTables;
+	MSG_Init( &msg[0], data[0], MSGBENCH_BUFFER );
+	MSG_Init( &msg[1], data[1], MSGBENCH_BUFFER );
+	treeMsec = MSG_BenchWrite( &msg[0], ents, players, passes, qfalse, &treePlayerMsec );
+	tableMsec = MSG_BenchWrite( &msg[1], ents, players, passes, qtrue, &tablePlayerMsec );
+
+	// one more pass of both records to compare
+	mismatches = 0;
+	for ( j = 0 ; j < 2 ; j++ ) {
+		msgUseTables = j;
+		MSG_Clear( &msg[j] );
+		for ( i = 0 ; i < MSGBENCH_ENTITIES ; i++ ) {
+			MSG_WriteDeltaEntity( &msg[j], &ents[i*2], &ents[i*2+1], qtrue );
+		}
+		for ( i = 0 ; i < MSGBENCH_PLAYERS ; i++ ) {
+			MSG_WriteDeltaPlayerstate( &msg[j], &players[i*2], &players[i*2+1] );
+		}
+		size[j] = msg[j].cursize;
+		bits[j] = msg[j].bit;
+		MSG_BeginReading( &msg[j] );
+	}
+	if ( bits[0] != bits[1] || memcmp( data[0], data[1], ( bits[0] + 7 ) >> 3 ) ) {
+		Com_Printf( "^1table coder wrote different bits\n" );
+		mismatches++;
+	}
+
+	// read back, with each reader on its own copy
+	for ( i = 0 ; i < MSGBENCH_ENTITIES ; i++ ) {
+		for ( j = 0 ; j < 2 ; j++ ) {
+			msgUseTables = j;
+			MSG_ReadDeltaEntity( &msg[j], &ents[i*2], &readEnt[j], MSG_ReadBits( &msg[j], GENTITYNUM_BITS ) );
+		}
+		if ( memcmp( &readEnt[0], &readEnt[1], sizeof( readEnt[0] ) ) ) {
+			mismatches++;
+		}
+	}
+	for ( i = 0 ; i < MSGBENCH_PLAYERS ; i++ ) {
+		for ( j = 0 ; j < 2 ; j++ ) {
+			msgUseTables = j;
+			MSG_ReadDeltaPlayerstate( &msg[j], &players[i*2], &readPlayer[j] );
+		}
+		if ( memcmp( &readPlayer[0], &readPlayer[1], sizeof( readPlayer[0] ) ) ) {
+			mismatches++;
+		}
+	}
+	if ( msg[0].readcount != msg[1].readcount || msg[0].readcount > msg[0].cursize ) {
+		mismatches++;
+	}
+
+	msgUseTables = hadTables;
+
+	Hunk_FreeTempMemory( data[1] );
+	Hunk_FreeTempMemory( data[0] );
+	Hunk_FreeTempMemory( players );
+	Hunk_FreeTempMemory( ents );
+
+	Com_Printf( "%i passes, %i bytes per pass\n", passes, size[0] );
+	Com_Printf( "%i entity deltas:      tree %5i msec, tables %5i msec\n", MSGBENCH_ENTITIES, treeMsec, tableMsec );
+	Com_Printf( "%i playerstate deltas:  tree %5i msec, tables %5i msec\n", MSGBENCH_PLAYERS, treePlayerMsec, tablePlayerMsec );
+	Com_Printf( "%i mismatches\n", mismatches );
+}
@@ -559,7 +559,9 @@ void NET_SendPacket( netsrc_t sock, int length, const void *data, netadr_t to )
 		NET_QueuePacket( length, data, to, sv_packetdelay->integer );
 	}
 	else {
+		PROF_BEGIN( PROF_NET_SEND );
 		Sys_SendPacket( length, data, to );
+		PROF_END( PROF_NET_SEND );
 	}
 }
 
@@ -20,6 +20,10 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 ===========================================================================
 */
 
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#	define _GNU_SOURCE		// recvmmsg and sendmmsg
+#endif
+
 #include "../qcommon/q_shared.h"
 #include "../qcommon/qcommon.h"
 
@@ -89,6 +93,10 @@ typedef int SOCKET;
 typedef int	ioctlarg_t;
 #	define socketError			errno
 
+#	if defined(__linux__) && defined(MSG_WAITFORONE)
+#		define NET_BATCH_IO
+#	endif
+
 #endif
 
 static qboolean usingSocks = qfalse;
@@ -145,6 +153,38 @@ typedef struct
 static nip_localaddr_t localIP[MAX_IPS];
 static int numIP;
 
+#ifdef NET_BATCH_IO
+// with net_batch set, datagrams are moved several at a time: incoming ones
+// are read into a queue that NET_GetPacket hands out one by one, outgoing
+// ones are held between NET_BeginSendBatch and NET_FlushSendBatch
+#define	NET_BATCH			32
+#define	NET_BATCH_SENDLEN	1400	// bigger packets are sent right away
+
+typedef struct {
+	int						count, next;
+	struct mmsghdr			msgs[NET_BATCH];
+	struct iovec			iov[NET_BATCH];
+	struct sockaddr_storage	from[NET_BATCH];
+	byte					data[NET_BATCH][MAX_MSGLEN + 1];
+} netRecvBatch_t;
+
+typedef struct {
+	qboolean				active;
+	SOCKET					socket;
+	int						count;
+	struct mmsghdr			msgs[NET_BATCH];
+	struct iovec			iov[NET_BATCH];
+	struct sockaddr_storage	to[NET_BATCH];
+	netadrtype_t			type[NET_BATCH];
+	byte					data[NET_BATCH][NET_BATCH_SENDLEN];
+} netSendBatch_t;
+
+static netRecvBatch_t	ipRecvBatch, ip6RecvBatch;
+static netSendBatch_t	sendBatch;
+
+static cvar_t	*net_batch;
+#endif
+
 
 //=============================================================================
 
@@ -513,6 +553,76 @@ qboolean	NET_IsLocalAddress( netadr_t adr ) {
 
 //=============================================================================
 
+#ifdef NET_BATCH_IO
+/*
+==================
+NET_GetBatchedPacket
+
+Hands out the next packet read by recvmmsg, reading a new batch when the
+queue is empty.  Packets already queued are returned even if net_batch has
+been turned off since.
+==================
+*/
+static qboolean NET_GetBatchedPacket( netRecvBatch_t *batch, SOCKET sock, fd_set *fdr, netadr_t *net_from, msg_t *net_message )
+{
+	struct sockaddr_storage *from;
+	int		ret, err, len, i;
+
+	while ( 1 ) {
+		if ( batch->next >= batch->count ) {
+			batch->count = batch->next = 0;
+
+			if ( !net_batch->integer || sock == INVALID_SOCKET || !FD_ISSET( sock, fdr ) ) {
+				return qfalse;
+			}
+
+			for ( i = 0 ; i < NET_BATCH ; i++ ) {
+				batch->iov[i].iov_base = batch->data[i];
+				batch->iov[i].iov_len = sizeof( batch->data[i] );
+				memset( &batch->msgs[i], 0, sizeof( batch->msgs[i] ) );
+				batch->msgs[i].msg_hdr.msg_name = &batch->from[i];
+				batch->msgs[i].msg_hdr.msg_namelen = sizeof( batch->from[i] );
+				batch->msgs[i].msg_hdr.msg_iov = &batch->iov[i];
+				batch->msgs[i].msg_hdr.msg_iovlen = 1;
+			}
+
+			ret = recvmmsg( sock, batch->msgs, NET_BATCH, MSG_DONTWAIT, NULL );
+			if ( ret == SOCKET_ERROR ) {
+				err = socketError;
+
+				if( err != EAGAIN && err != ECONNRESET )
+					Com_Printf( "NET_GetPacket: %s\n", NET_ErrorString() );
+				return qfalse;
+			}
+			if ( ret <= 0 ) {
+				return qfalse;
+			}
+			batch->count = ret;
+		}
+
+		i = batch->next++;
+		from = &batch->from[i];
+		len = batch->msgs[i].msg_len;
+
+		if ( from->ss_family == AF_INET ) {
+			memset( ((struct sockaddr_in *)from)->sin_zero, 0, 8 );
+		}
+		SockadrToNetadr( (struct sockaddr *) from, net_from );
+		net_message->readcount = 0;
+
+		// skip rather than stop, the rest of the queue still has to be read
+		if( len >= net_message->maxsize ) {
+			Com_Printf( "Oversize packet from %s\n", NET_AdrToString (*net_from) );
+			continue;
+		}
+
+		Com_Memcpy( net_message->data, batch->data[i], len );
+		net_message->cursize = len;
+		return qtrue;
+	}
+}
+#endif
+
 /*
 ==================
 NET_GetPacket
@@ -526,8 +636,20 @@ qboolean NET_GetPacket(netadr_t *net_from, msg_t *net_message, fd_set *fdr)
 	struct sockaddr_storage from;
 	socklen_t	fromlen;
 	int		err;
+	qboolean	batchIP = qfalse, batchIP6 = qfalse;
+
+#ifdef NET_BATCH_IO
+	// the socks relay header is only handled by the single packet path
+	if ( NET_GetBatchedPacket( &ipRecvBatch, usingSocks ? INVALID_SOCKET : ip_socket, fdr, net_from, net_message ) )
+		return qtrue;
+	if ( NET_GetBatchedPacket( &ip6RecvBatch, ip6_socket, fdr, net_from, net_message ) )
+		return qtrue;
+
+	batchIP = net_batch->integer && !usingSocks;
+	batchIP6 = net_batch->integer;
+#endif
 	
-	if(ip_socket != INVALID_SOCKET && FD_ISSET(ip_socket, fdr))
+	if(!batchIP && ip_socket != INVALID_SOCKET && FD_ISSET(ip_socket, fdr))
 	{
 		fromlen = sizeof(from);
 		ret = recvfrom( ip_socket, (void *)net_message->data, net_message->maxsize, 0, (struct sockaddr *) &from, &fromlen );
@@ -571,7 +693,7 @@ qboolean NET_GetPacket(netadr_t *net_from, msg_t *net_message, fd_set *fdr)
 		}
 	}
 	
-	if(ip6_socket != INVALID_SOCKET && FD_ISSET(ip6_socket, fdr))
+	if(!batchIP6 && ip6_socket != INVALID_SOCKET && FD_ISSET(ip6_socket, fdr))
 	{
 		fromlen = sizeof(from);
 		ret = recvfrom(ip6_socket, (void *)net_message->data, net_message->maxsize, 0, (struct sockaddr *) &from, &fromlen);
@@ -635,6 +757,99 @@ qboolean NET_GetPacket(netadr_t *net_from, msg_t *net_message, fd_set *fdr)
 
 static char socksBuf[4096];
 
+#ifdef NET_BATCH_IO
+/*
+==================
+NET_SendBatch
+
+Sends the queued packets with as few sendmmsg calls as possible
+==================
+*/
+static void NET_SendBatch( void ) {
+	int		sent, ret, err;
+
+	sent = 0;
+	while ( sent < sendBatch.count ) {
+		ret = sendmmsg( sendBatch.socket, &sendBatch.msgs[sent], sendBatch.count - sent, 0 );
+		if ( ret == SOCKET_ERROR ) {
+			err = socketError;
+
+			// the same errors Sys_SendPacket is silent about
+			if ( err != EAGAIN && !( err == EADDRNOTAVAIL && sendBatch.type[sent] == NA_BROADCAST ) ) {
+				Com_Printf( "Sys_SendPacket: %s\n", NET_ErrorString() );
+			}
+
+			// drop the packet that failed and go on with the rest
+			sent++;
+			continue;
+		}
+		sent += ret;
+	}
+
+	sendBatch.count = 0;
+}
+
+/*
+==================
+NET_BatchPacket
+==================
+*/
+static void NET_BatchPacket( SOCKET sock, int length, const void *data, struct sockaddr_storage *addr, socklen_t addrlen, netadrtype_t type ) {
+	int		i;
+
+	if ( sendBatch.count && ( sendBatch.socket != sock || sendBatch.count == NET_BATCH ) ) {
+		NET_SendBatch();
+	}
+
+	i = sendBatch.count++;
+	sendBatch.socket = sock;
+	sendBatch.type[i] = type;
+	sendBatch.to[i] = *addr;
+	Com_Memcpy( sendBatch.data[i], data, length );
+
+	sendBatch.iov[i].iov_base = sendBatch.data[i];
+	sendBatch.iov[i].iov_len = length;
+	memset( &sendBatch.msgs[i], 0, sizeof( sendBatch.msgs[i] ) );
+	sendBatch.msgs[i].msg_hdr.msg_name = &sendBatch.to[i];
+	sendBatch.msgs[i].msg_hdr.msg_namelen = addrlen;
+	sendBatch.msgs[i].msg_hdr.msg_iov = &sendBatch.iov[i];
+	sendBatch.msgs[i].msg_hdr.msg_iovlen = 1;
+}
+#endif
+
+/*
+==================
+NET_BeginSendBatch
+
+Holds back the packets given to Sys_SendPacket until NET_FlushSendBatch when
+batched sending is available and net_batch is set
+==================
+*/
+void NET_BeginSendBatch( void ) {
+#ifdef NET_BATCH_IO
+	sendBatch.active = net_batch && net_batch->integer;
+#endif
+}
+
+/*
+==================
+NET_FlushSendBatch
+
+A batch that fills up is sent from Sys_SendPacket, inside the profile
+scope of NET_SendPacket, only the last one is timed here
+==================
+*/
+void NET_FlushSendBatch( void ) {
+#ifdef NET_BATCH_IO
+	if ( sendBatch.count ) {
+		PROF_BEGIN( PROF_NET_SEND );
+		NET_SendBatch();
+		PROF_END( PROF_NET_SEND );
+	}
+	sendBatch.active = qfalse;
+#endif
+}
+
 /*
 ==================
 Sys_SendPacket
@@ -673,6 +888,15 @@ void Sys_SendPacket( int length, const void *data, netadr_t to ) {
 		ret = sendto( ip_socket, socksBuf, length+10, 0, &socksRelayAddr, sizeof(socksRelayAddr) );
 	}
 	else {
+#ifdef NET_BATCH_IO
+		if ( sendBatch.active && length <= NET_BATCH_SENDLEN ) {
+			if(addr.ss_family == AF_INET)
+				NET_BatchPacket( ip_socket, length, data, &addr, sizeof(struct sockaddr_in), to.type );
+			else if(addr.ss_family == AF_INET6)
+				NET_BatchPacket( ip6_socket, length, data, &addr, sizeof(struct sockaddr_in6), to.type );
+			return;
+		}
+#endif
 		if(addr.ss_family == AF_INET)
 			ret = sendto( ip_socket, data, length, 0, (struct sockaddr *) &addr, sizeof(struct sockaddr_in) );
 		else if(addr.ss_family == AF_INET6)
@@ -1480,6 +1704,10 @@ static qboolean NET_GetCvars( void ) {
 
 	net_dropsim = Cvar_Get("net_dropsim", "", CVAR_TEMP);
 
+#ifdef NET_BATCH_IO
+	net_batch = Cvar_Get( "net_batch", "1", CVAR_ARCHIVE );
+#endif
+
 	return modified ? qtrue : qfalse;
 }
 
@@ -1529,6 +1757,12 @@ void NET_Config( qboolean enableNetworking ) {
 	}
 
 	if( stop ) {
+#ifdef NET_BATCH_IO
+		NET_FlushSendBatch();
+		ipRecvBatch.count = ipRecvBatch.next = 0;
+		ip6RecvBatch.count = ip6RecvBatch.next = 0;
+#endif
+
 		if ( ip_socket != INVALID_SOCKET ) {
 			closesocket( ip_socket );
 			ip_socket = INVALID_SOCKET;
@@ -1587,6 +1821,7 @@ void NET_Init( void ) {
 	NET_Config( qtrue );
 	
 	Cmd_AddCommand ("net_restart", NET_Restart_f);
+	Cmd_AddCommand ("netbench", NET_Bench_f);
 }
 
 
@@ -1622,6 +1857,7 @@ void NET_Event(fd_set *fdr)
 	netadr_t from = {0};
 	msg_t netmsg;
 	
+	PROF_BEGIN(PROF_NET_RECV);
 	while(1)
 	{
 		MSG_Init(&netmsg, bufData, sizeof(bufData));
@@ -1643,6 +1879,7 @@ void NET_Event(fd_set *fdr)
 		else
 			break;
 	}
+	PROF_END(PROF_NET_RECV);
 }
 
 /*
@@ -1707,3 +1944,233 @@ void NET_Restart_f(void)
 {
 	NET_Config(qtrue);
 }
+
+/*
+====================
+NET_OpenPrivateSocket
+
+Opens an IPv4 socket on an ephemeral port that is not part of the select
+set.  The owner reads and writes it directly; the load tester gives every
+simulated player its own port this way.  Returns -1 on failure.
+====================
+*/
+#define	MAX_PRIVATE_SOCKETS		MAX_CLIENTS
+
+typedef struct {
+	qboolean	inuse;
+	SOCKET		sock;
+} privateSocket_t;
+
+static privateSocket_t	privateSockets[MAX_PRIVATE_SOCKETS];
+
+int NET_OpenPrivateSocket( void )
+{
+	struct sockaddr_in	address;
+	ioctlarg_t			_true = 1;
+	SOCKET				newsocket;
+	int					i;
+
+	for ( i = 0 ; i < MAX_PRIVATE_SOCKETS ; i++ ) {
+		if ( !privateSockets[i].inuse ) {
+			break;
+		}
+	}
+	if ( i == MAX_PRIVATE_SOCKETS ) {
+		return -1;
+	}
+
+	if( ( newsocket = socket( PF_INET, SOCK_DGRAM, IPPROTO_UDP ) ) == INVALID_SOCKET ) {
+		Com_Printf( "WARNING: NET_OpenPrivateSocket: socket: %s\n", NET_ErrorString() );
+		return -1;
+	}
+	if( ioctlsocket( newsocket, FIONBIO, &_true ) == SOCKET_ERROR ) {
+		Com_Printf( "WARNING: NET_OpenPrivateSocket: ioctl FIONBIO: %s\n", NET_ErrorString() );
+		closesocket( newsocket );
+		return -1;
+	}
+
+	memset( &address, 0, sizeof( address ) );
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = INADDR_ANY;
+	address.sin_port = 0;
+	if( bind( newsocket, (void *)&address, sizeof( address ) ) == SOCKET_ERROR ) {
+		Com_Printf( "WARNING: NET_OpenPrivateSocket: bind: %s\n", NET_ErrorString() );
+		closesocket( newsocket );
+		return -1;
+	}
+
+	privateSockets[i].inuse = qtrue;
+	privateSockets[i].sock = newsocket;
+	return i;
+}
+
+/*
+====================
+NET_ClosePrivateSocket
+====================
+*/
+void NET_ClosePrivateSocket( int handle )
+{
+	if ( handle < 0 || handle >= MAX_PRIVATE_SOCKETS || !privateSockets[handle].inuse ) {
+		return;
+	}
+	closesocket( privateSockets[handle].sock );
+	privateSockets[handle].inuse = qfalse;
+}
+
+/*
+====================
+NET_SendPrivatePacket
+====================
+*/
+void NET_SendPrivatePacket( int handle, int length, const void *data, netadr_t to )
+{
+	struct sockaddr_storage	addr;
+
+	if ( handle < 0 || handle >= MAX_PRIVATE_SOCKETS || !privateSockets[handle].inuse || to.type != NA_IP ) {
+		return;
+	}
+
+	memset( &addr, 0, sizeof( addr ) );
+	NetadrToSockadr( &to, (struct sockaddr *) &addr );
+
+	if( sendto( privateSockets[handle].sock, data, length, 0, (struct sockaddr *) &addr, sizeof(struct sockaddr_in) ) == SOCKET_ERROR ) {
+		if( socketError != EAGAIN ) {
+			Com_Printf( "NET_SendPrivatePacket: %s\n", NET_ErrorString() );
+		}
+	}
+}
+
+/*
+====================
+NET_GetPrivatePacket
+
+Non-blocking read of one packet from a private socket
+====================
+*/
+qboolean NET_GetPrivatePacket( int handle, netadr_t *net_from, msg_t *net_message )
+{
+	struct sockaddr_storage from;
+	socklen_t	fromlen;
+	int			ret, err;
+
+	if ( handle < 0 || handle >= MAX_PRIVATE_SOCKETS || !privateSockets[handle].inuse ) {
+		return qfalse;
+	}
+
+	while ( 1 ) {
+		fromlen = sizeof( from );
+		ret = recvfrom( privateSockets[handle].sock, (void *)net_message->data, net_message->maxsize, 0, (struct sockaddr *) &from, &fromlen );
+		if ( ret == SOCKET_ERROR ) {
+			err = socketError;
+
+			if( err != EAGAIN && err != ECONNRESET )
+				Com_Printf( "NET_GetPrivatePacket: %s\n", NET_ErrorString() );
+			return qfalse;
+		}
+
+		memset( ((struct sockaddr_in *)&from)->sin_zero, 0, 8 );
+		SockadrToNetadr( (struct sockaddr *) &from, net_from );
+		net_message->readcount = 0;
+
+		if( ret >= net_message->maxsize ) {
+			Com_Printf( "Oversize packet from %s\n", NET_AdrToString (*net_from) );
+			continue;
+		}
+
+		net_message->cursize = ret;
+		return qtrue;
+	}
+}
+
+/*
+====================
+NET_Bench_f
+
+Loopback load generator.  Sends packets from the IPv4 socket to itself in
+rounds and reads them back through NET_GetPacket, once with a system call
+per packet and once batched when that is available.
+====================
+*/
+#define	NET_BENCH_ROUND		32
+
+void NET_Bench_f( void )
+{
+	byte		packet[1400];
+	byte		bufData[MAX_MSGLEN + 1];
+	netadr_t	to, from;
+	msg_t		netmsg;
+	fd_set		fdr;
+	char		oldBatch[MAX_CVAR_VALUE_STRING];
+	int			packets, size, modes, mode;
+	int			sent, received, start, msec, i;
+
+	if ( ip_socket == INVALID_SOCKET || usingSocks ) {
+		Com_Printf( "netbench needs a direct IPv4 socket.\n" );
+		return;
+	}
+
+	packets = 100000;
+	size = 200;
+	if ( Cmd_Argc() > 1 ) {
+		packets = atoi( Cmd_Argv( 1 ) );
+	}
+	if ( Cmd_Argc() > 2 ) {
+		size = atoi( Cmd_Argv( 2 ) );
+	}
+	if ( packets < 1 ) {
+		packets = 1;
+	}
+	size = Com_Clamp( 8, sizeof( packet ), size );
+
+	NET_StringToAdr( va( "127.0.0.1:%i", net_port->integer ), &to, NA_IP );
+	for ( i = 0 ; i < size ; i++ ) {
+		packet[i] = i;
+	}
+	Com_Memcpy( packet, "NETB", 4 );
+
+	Cvar_VariableStringBuffer( "net_batch", oldBatch, sizeof( oldBatch ) );
+#ifdef NET_BATCH_IO
+	modes = 2;
+#else
+	modes = 1;
+#endif
+
+	for ( mode = 0 ; mode < modes ; mode++ ) {
+		if ( modes > 1 ) {
+			Cvar_Set( "net_batch", mode ? "1" : "0" );
+		}
+
+		sent = received = 0;
+		start = Sys_Milliseconds();
+		while ( sent < packets ) {
+			NET_BeginSendBatch();
+			for ( i = 0 ; i < NET_BENCH_ROUND && sent < packets ; i++, sent++ ) {
+				Sys_SendPacket( size, packet, to );
+			}
+			NET_FlushSendBatch();
+
+			// loopback delivery is immediate, read back everything
+			FD_ZERO( &fdr );
+			FD_SET( ip_socket, &fdr );
+			while ( 1 ) {
+				MSG_Init( &netmsg, bufData, sizeof( bufData ) );
+				if ( !NET_GetPacket( &from, &netmsg, &fdr ) ) {
+					break;
+				}
+				if ( netmsg.cursize == size && !memcmp( netmsg.data, "NETB", 4 ) ) {
+					received++;
+				}
+			}
+		}
+		msec = Sys_Milliseconds() - start;
+
+		Com_Printf( "%-18s %i sent, %i received in %i msec, %i packets/sec\n",
+			mode ? "sendmmsg/recvmmsg:" : "sendto/recvfrom:", sent, received, msec,
+			msec ? (int)( received * 1000.0 / msec ) : 0 );
+	}
+
+	if ( modes > 1 ) {
+		Cvar_Set( "net_batch", oldBatch );
+	}
+}
@@ -0,0 +1,346 @@
+/*
+===========================================================================
+Copyright (C) 1999-2005 Id Software, Inc.
+
+This file is part of Quake III Arena source code.
+
+Quake III Arena source code is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the License,
+or (at your option) any later version.
+
+Quake III Arena source code is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Quake III Arena source code; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+===========================================================================
+*/
+// profile.c -- scoped frame timers
+//
+// PROF_BEGIN / PROF_END pairs around the main frame stages record into a
+// ring buffer of completed scopes and a latency histogram per zone.  With
+// com_profile 0 the macros cost a single test.  Scopes nest, and only the
+// main thread records; worker jobs are timed by the zone that runs them.
+//
+// "profile" prints percentiles per zone, "profile dump" writes the ring
+// buffer as a Chrome trace (chrome://tracing, ui.perfetto.dev).
+
+#include "q_shared.h"
+#include "qcommon.h"
+
+#define	PROF_RING_SIZE		65536			// completed scopes kept for dumps
+#define	PROF_MAX_DEPTH		32
+
+// histogram buckets are exact below 32 usec, then 16 per power of two
+#define	PROF_SUB_BUCKETS	16
+#define	PROF_BUCKETS		( 29 * PROF_SUB_BUCKETS )
+
+typedef struct {
+	int64_t		start;
+	int			duration;
+	short		zone;
+	short		depth;
+} profEvent_t;
+
+typedef struct {
+	int			calls;
+	int64_t		total;
+	int			max;
+	int			buckets[PROF_BUCKETS];
+} profZoneStats_t;
+
+typedef struct {
+	profZone_t	zone;
+	int64_t		start;
+} profScope_t;
+
+static const char *profZoneNames[PROF_NUM_ZONES] = {
+	"events",
+	"net_recv",
+	"net_send",
+	"sv_frame",
+	"sv_packet",
+	"sv_bots",
+	"sv_game",
+	"sv_snapshots",
+	"botlib_update",
+	"vm_call"
+};
+
+qboolean		prof_active;
+
+static cvar_t	*com_profile;
+
+static profEvent_t		*profRing;
+static int				profRingHead;		// total events recorded
+static profZoneStats_t	profStats[PROF_NUM_ZONES];
+static profScope_t		profStack[PROF_MAX_DEPTH];
+static int				profDepth;
+static int				profFrames;
+
+/*
+=================
+Prof_Bucket
+=================
+*/
+static int Prof_Bucket( int usec ) {
+	int		shift;
+
+	for ( shift = 0 ; usec >= 2 * PROF_SUB_BUCKETS ; shift++ ) {
+		usec >>= 1;
+	}
+	return shift * PROF_SUB_BUCKETS + usec;
+}
+
+/*
+=================
+Prof_BucketLimit
+
+Largest value that lands in the bucket
+=================
+*/
+static int Prof_BucketLimit( int bucket ) {
+	int		shift;
+
+	if ( bucket < 2 * PROF_SUB_BUCKETS ) {
+		return bucket;
+	}
+	shift = bucket / PROF_SUB_BUCKETS - 1;
+	return ( ( ( bucket % PROF_SUB_BUCKETS + PROF_SUB_BUCKETS + 1 ) << shift ) - 1 );
+}
+
+/*
+=================
+Prof_Percentile
+=================
+*/
+static int Prof_Percentile( const profZoneStats_t *stats, float frac ) {
+	int		i, want, sum;
+
+	want = ceil( stats->calls * frac );
+	for ( i = 0, sum = 0 ; i < PROF_BUCKETS ; i++ ) {
+		sum += stats->buckets[i];
+		if ( sum >= want ) {
+			return MIN( Prof_BucketLimit( i ), stats->max );
+		}
+	}
+	return stats->max;
+}
+
+/*
+=================
+Prof_Begin
+=================
+*/
+void Prof_Begin( profZone_t zone ) {
+	if ( profDepth >= PROF_MAX_DEPTH ) {
+		profDepth++;		// keep the pairing, but don't record
+		return;
+	}
+	profStack[profDepth].zone = zone;
+	profStack[profDepth].start = Sys_Microseconds();
+	profDepth++;
+}
+
+/*
+=================
+Prof_End
+=================
+*/
+void Prof_End( profZone_t zone ) {
+	profZoneStats_t	*stats;
+	profEvent_t		*ev;
+	profScope_t		*scope;
+	int				duration, bucket;
+
+	if ( profDepth <= 0 ) {
+		return;		// began before profiling was switched on
+	}
+	profDepth--;
+	if ( profDepth >= PROF_MAX_DEPTH ) {
+		return;
+	}
+
+	scope = &profStack[profDepth];
+	if ( scope->zone != zone ) {
+		// an error longjmp skipped some ends, forget the broken nesting
+		profDepth = 0;
+		return;
+	}
+
+	duration = Sys_Microseconds() - scope->start;
+
+	stats = &profStats[zone];
+	stats->calls++;
+	stats->total += duration;
+	if ( duration > stats->max ) {
+		stats->max = duration;
+	}
+	bucket = Prof_Bucket( duration );
+	stats->buckets[MIN( bucket, PROF_BUCKETS - 1 )]++;
+
+	ev = &profRing[profRingHead & ( PROF_RING_SIZE - 1 )];
+	ev->start = scope->start;
+	ev->duration = duration;
+	ev->zone = zone;
+	ev->depth = profDepth;
+	profRingHead++;
+}
+
+/*
+=================
+Prof_Reset
+=================
+*/
+static void Prof_Reset( void ) {
+	Com_Memset( profStats, 0, sizeof( profStats ) );
+	profRingHead = 0;
+	profFrames = 0;
+}
+
+/*
+=================
+Prof_Frame
+
+Called at the top of every Com_Frame.  Switching com_profile only takes
+effect here so no scope is ever left half open.
+=================
+*/
+void Prof_Frame( void ) {
+	profDepth = 0;
+
+	if ( com_profile->integer && !profRing ) {
+		profRing = malloc( PROF_RING_SIZE * sizeof( *profRing ) );
+		if ( !profRing ) {
+			Com_Printf( S_COLOR_YELLOW "WARNING: couldn't allocate the profile ring buffer\n" );
+			Cvar_Set( "com_profile", "0" );
+		}
+		Prof_Reset();
+	}
+
+	prof_active = com_profile->integer && profRing;
+	if ( prof_active ) {
+		profFrames++;
+	}
+}
+
+/*
+=================
+Prof_Print
+=================
+*/
+static void Prof_Print( void ) {
+	profZoneStats_t	*stats;
+	int				i;
+
+	Com_Printf( "%i frames profiled, times in usec\n", profFrames );
+	Com_Printf( "zone             calls/frame     avg     p50     p90     p99     max\n" );
+	for ( i = 0 ; i < PROF_NUM_ZONES ; i++ ) {
+		stats = &profStats[i];
+		if ( !stats->calls ) {
+			continue;
+		}
+		Com_Printf( "%-16s %11.2f %7i %7i %7i %7i %7i\n", profZoneNames[i],
+			profFrames ? (float)stats->calls / profFrames : 0.0f,
+			(int)( stats->total / stats->calls ),
+			Prof_Percentile( stats, 0.5f ), Prof_Percentile( stats, 0.9f ),
+			Prof_Percentile( stats, 0.99f ), stats->max );
+	}
+}
+
+/*
+=================
+Prof_Dump
+
+Writes the ring buffer as Chrome trace "complete" events.  Parents are
+recorded after their children, the viewer sorts them out by time.
+=================
+*/
+static void Prof_Dump( const char *filename ) {
+	fileHandle_t	f;
+	profEvent_t		*ev;
+	int64_t			base;
+	int				first, i;
+
+	if ( !profRing || !profRingHead ) {
+		Com_Printf( "Nothing profiled, set com_profile 1 first.\n" );
+		return;
+	}
+
+	f = FS_FOpenFileWrite( filename );
+	if ( !f ) {
+		Com_Printf( "Couldn't write %s.\n", filename );
+		return;
+	}
+
+	first = profRingHead > PROF_RING_SIZE ? profRingHead - PROF_RING_SIZE : 0;
+	base = profRing[first & ( PROF_RING_SIZE - 1 )].start;
+	for ( i = first ; i < profRingHead ; i++ ) {
+		ev = &profRing[i & ( PROF_RING_SIZE - 1 )];
+		if ( ev->start < base ) {
+			base = ev->start;
+		}
+	}
+
+	FS_Printf( f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n" );
+	for ( i = first ; i < profRingHead ; i++ ) {
+		ev = &profRing[i & ( PROF_RING_SIZE - 1 )];
+		FS_Printf( f, "%s{\"name\":\"%s\",\"cat\":\"engine\",\"ph\":\"X\",\"pid\":1,\"tid\":1,"
+			"\"ts\":%lld,\"dur\":%i,\"args\":{\"depth\":%i}}\n", i == first ? "" : ",",
+			profZoneNames[ev->zone], (long long)( ev->start - base ), ev->duration, ev->depth );
+	}
+	FS_Printf( f, "]}\n" );
+	FS_FCloseFile( f );
+
+	Com_Printf( "Wrote %i events to %s\n", profRingHead - first, filename );
+}
+
+/*
+=================
+Prof_Profile_f
+
+profile
+profile reset
+profile dump [filename]
+=================
+*/
+static void Prof_Profile_f( void ) {
+	char	filename[MAX_QPATH];
+
+	if ( !Q_stricmp( Cmd_Argv( 1 ), "reset" ) ) {
+		Prof_Reset();
+		return;
+	}
+
+	if ( !Q_stricmp( Cmd_Argv( 1 ), "dump" ) ) {
+		Q_strncpyz( filename, Cmd_Argc() > 2 ? Cmd_Argv( 2 ) : "profile", sizeof( filename ) );
+		COM_DefaultExtension( filename, sizeof( filename ), ".json" );
+		Prof_Dump( filename );
+		return;
+	}
+
+	if ( Cmd_Argc() > 1 ) {
+		Com_Printf( "usage: profile [reset | dump [filename]]\n" );
+		return;
+	}
+
+	if ( !profFrames ) {
+		Com_Printf( "Nothing profiled, set com_profile 1 first.\n" );
+		return;
+	}
+	Prof_Print();
+}
+
+/*
+=================
+Prof_Init
+=================
+*/
+void Prof_Init( void ) {
+	com_profile = Cvar_Get( "com_profile", "0", 0 );
+	Cmd_AddCommand( "profile", Prof_Profile_f );
+}
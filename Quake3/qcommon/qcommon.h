@@ -67,6 +67,7 @@ struct entityState_s;
 struct playerState_s;
 
 void MSG_WriteBits( msg_t *msg, int value, int bits );
+void MSG_WriteBitstream( msg_t *msg, const byte *data, int offset, int bits );
 
 void MSG_WriteChar (msg_t *sb, int c);
 void MSG_WriteByte (msg_t *sb, int c);
@@ -102,12 +103,15 @@ void MSG_WriteDeltaEntity( msg_t *msg, struct entityState_s *from, struct entity
 						   , qboolean force );
 void MSG_ReadDeltaEntity( msg_t *msg, entityState_t *from, entityState_t *to, 
 						 int number );
+int MSG_ReadPacketEntities( msg_t *msg, entityState_t *parseEntities, int parseMask, int *parseEntitiesNum,
+							int oldFirst, int numOld, entityState_t *baselines, qboolean verbose );
 
 void MSG_WriteDeltaPlayerstate( msg_t *msg, struct playerState_s *from, struct playerState_s *to );
 void MSG_ReadDeltaPlayerstate( msg_t *msg, struct playerState_s *from, struct playerState_s *to );
 
 
 void MSG_ReportChangeVectors_f( void );
+void MSG_Bench_f( void );
 
 //============================================================================
 
@@ -186,6 +190,13 @@ qboolean	NET_GetLoopPacket (netsrc_t sock, netadr_t *net_from, msg_t *net_messag
 void		NET_JoinMulticast6(void);
 void		NET_LeaveMulticast6(void);
 void		NET_Sleep(int msec);
+void		NET_BeginSendBatch( void );
+void		NET_FlushSendBatch( void );
+void		NET_Bench_f( void );
+int			NET_OpenPrivateSocket( void );
+void		NET_ClosePrivateSocket( int handle );
+void		NET_SendPrivatePacket( int handle, int length, const void *data, netadr_t to );
+qboolean	NET_GetPrivatePacket( int handle, netadr_t *net_from, msg_t *net_message );
 
 
 #define	MAX_MSGLEN				16384		// max length of a message, which may
@@ -365,6 +376,9 @@ void	VM_Clear(void);
 void	VM_Forced_Unload_Start(void);
 void	VM_Forced_Unload_Done(void);
 vm_t	*VM_Restart(vm_t *vm, qboolean unpure);
+vmInterpret_t	VM_Type( vm_t *vm );
+byte			*VM_StaticData( vm_t *vm, int *length );
+void			VM_SyscallProfile( vm_t *vm, int callnum, int64_t start );
 
 intptr_t		QDECL VM_Call( vm_t *vm, int callNum, ... );
 
@@ -443,6 +457,9 @@ typedef void (*completionFunc_t)( char *args, int argNum );
 // don't allow VMs to remove system commands
 void	Cmd_RemoveCommandSafe( const char *cmd_name );
 
+void	Cmd_CompactCommands( void );
+// moves the commands around in the zone, see Z_Defrag
+
 void	Cmd_CommandCompletion( void(*callback)(const char *s) );
 // callback with each valid string
 void Cmd_SetCommandCompletionFunc( const char *command,
@@ -569,6 +586,9 @@ void Cvar_SetDescription( cvar_t *var, const char *var_description );
 void	Cvar_Restart(qboolean unsetVM);
 void	Cvar_Restart_f( void );
 
+void	Cvar_CompactStrings( void );
+// moves the cvar strings around in the zone, see Z_Defrag
+
 void Cvar_CompleteCvarName( char *args, int argNum );
 
 extern	int			cvar_modifiedFlags;
@@ -674,11 +694,26 @@ long	FS_ReadFile(const char *qpath, void **buffer);
 // the buffer should be considered read-only, because it may be cached
 // for other uses.
 
+long	FS_ReadFileMapped( const char *qpath, const void **buffer );
+// like FS_ReadFile, but an uncompressed pk3 entry is returned in place in
+// the pak mapping.  The buffer really is read-only and there is no trailing
+// 0.  Free it with FS_FreeFile as usual.
+
+qboolean	FS_PrefetchFile( const char *qpath );
+void	FS_DropPrefetches( void );
+// starts reading a file in the background, the next FS_ReadFile of it
+// takes the data from there.  FS_DropPrefetches frees what wasn't used.
+
+long	FS_FileContentKey( const char *qpath, unsigned *crc );
+// returns the length FS_ReadFile would, or -1 if the file is missing.
+// Files from pk3s get the crc of their contents, which can be used to spot
+// the same file under another name.  Loose files get 0.
+
 void	FS_ForceFlush( fileHandle_t f );
 // forces flush on files we're writing to.
 
 void	FS_FreeFile( void *buffer );
-// frees the memory returned by FS_ReadFile
+// frees the memory returned by FS_ReadFile or FS_ReadFileMapped
 
 void	FS_WriteFile( const char *qpath, const void *buffer, int size );
 // writes a complete file, creating any subdirectories needed
@@ -906,7 +941,8 @@ typedef enum {
 	TAG_BOTLIB,
 	TAG_RENDERER,
 	TAG_SMALL,
-	TAG_STATIC
+	TAG_STATIC,
+	TAG_SLAB				// zone blocks cut up for small allocations
 } memtag_t;
 
 /*
@@ -948,6 +984,10 @@ void Z_Free( void *ptr );
 void Z_FreeTags( int tag );
 int Z_AvailableMemory( void );
 void Z_LogHeap( void );
+void Z_FlushThreadCache( void );
+void *Z_Move( void *ptr );
+void Z_Defrag( void );
+void Z_MapChange( void );
 
 void Hunk_Clear( void );
 void Hunk_ClearToMark( void );
@@ -966,6 +1006,42 @@ void Com_Init( char *commandLine );
 void Com_Frame( void );
 void Com_Shutdown( void );
 
+// worker threads, see Com_RunJobs
+typedef void (*jobFunc_t)( void *data, int index );
+
+extern	cvar_t	*com_workers;
+
+void Com_InitWorkers( void );
+void Com_ShutdownWorkers( void );
+int Com_NumWorkers( void );
+void Com_RunJobs( jobFunc_t func, void *data, int count );
+
+// scoped frame timers, see profile.c
+typedef enum {
+	PROF_EVENTS,
+	PROF_NET_RECV,
+	PROF_NET_SEND,
+	PROF_SV_FRAME,
+	PROF_SV_PACKET,
+	PROF_SV_BOTS,
+	PROF_SV_GAME,
+	PROF_SV_SNAPSHOTS,
+	PROF_BOTLIB_UPDATE,
+	PROF_VM_CALL,
+
+	PROF_NUM_ZONES
+} profZone_t;
+
+extern	qboolean	prof_active;
+
+#define	PROF_BEGIN( zone )	do { if ( prof_active ) Prof_Begin( zone ); } while ( 0 )
+#define	PROF_END( zone )	do { if ( prof_active ) Prof_End( zone ); } while ( 0 )
+
+void Prof_Init( void );
+void Prof_Frame( void );
+void Prof_Begin( profZone_t zone );
+void Prof_End( profZone_t zone );
+
 
 /*
 ==============================================================
@@ -1054,6 +1130,15 @@ int SV_FrameMsec(void);
 qboolean SV_GameCommand( void );
 int SV_SendQueuedPackets(void);
 
+#ifdef LOADTEST
+//
+// load test client interface
+//
+void LT_Init( void );
+int LT_FrameMsec( int minMsec );
+void LT_Frame( int msec, int serverUsec );
+#endif
+
 //
 // UI interface
 //
@@ -1098,6 +1183,8 @@ void	Sys_Print( const char *msg );
 // Sys_Milliseconds should only be used for profiling purposes,
 // any game related timing information should come from event timestamps
 int		Sys_Milliseconds (void);
+// monotonic, for timing short sections of code
+int64_t	Sys_Microseconds (void);
 
 qboolean Sys_RandomBytes( byte *string, int len );
 
@@ -1118,6 +1205,9 @@ void		Sys_ShowIP(void);
 
 FILE	*Sys_FOpen( const char *ospath, const char *mode );
 qboolean Sys_Mkdir( const char *path );
+qboolean Sys_FileStat( const char *ospath, int *size, int *mtime );
+void	*Sys_MapFile( const char *ospath, int *length );
+void	Sys_UnmapFile( void *base, int length );
 FILE	*Sys_Mkfifo( const char *ospath );
 char	*Sys_Cwd( void );
 void	Sys_SetDefaultInstallPath(const char *path);
@@ -1165,6 +1255,23 @@ dialogResult_t Sys_Dialog( dialogType_t type, const char *message, const char *t
 void Sys_RemovePIDFile( const char *gamedir );
 void Sys_InitPIDFile( const char *gamedir );
 
+// thread primitives used by the worker pool in common.c
+typedef struct sysThread_s	sysThread_t;
+typedef struct sysMutex_s	sysMutex_t;
+typedef struct sysCond_s	sysCond_t;
+
+sysThread_t	*Sys_CreateThread( void (*function)( void *arg ), void *arg );
+void	Sys_JoinThread( sysThread_t *thread );
+sysMutex_t	*Sys_CreateMutex( void );
+void	Sys_DestroyMutex( sysMutex_t *mutex );
+void	Sys_LockMutex( sysMutex_t *mutex );
+void	Sys_UnlockMutex( sysMutex_t *mutex );
+sysCond_t	*Sys_CreateCond( void );
+void	Sys_DestroyCond( sysCond_t *cond );
+void	Sys_WaitCond( sysCond_t *cond, sysMutex_t *mutex );
+void	Sys_SignalCond( sysCond_t *cond );
+void	Sys_BroadcastCond( sysCond_t *cond );
+
 /* This is based on the Adaptive Huffman algorithm described in Sayood's Data
  * Compression book.  The ranks are not actually stored, but implicitly defined
  * by the location of a node within a doubly-linked list */
@@ -1212,6 +1319,22 @@ void	Huff_offsetTransmit (huff_t *huff, int ch, byte *fout, int *offset, int max
 void	Huff_putBit( int bit, byte *fout, int *offset);
 int		Huff_getBit( byte *fout, int *offset);
 
+// flattened codes for a tree that is no longer updated, so whole symbols
+// can be coded without walking the tree a bit at a time
+#define	HUFF_LOOKUP_BITS	11
+#define	HUFF_LOOKUP_SIZE	(1<<HUFF_LOOKUP_BITS)
+
+typedef struct {
+	unsigned int	code[HMAX];					// first bit sent is bit 0
+	byte			codeLen[HMAX];
+
+	short			symbol[HUFF_LOOKUP_SIZE];	// indexed by the next HUFF_LOOKUP_BITS bits
+	byte			symbolLen[HUFF_LOOKUP_SIZE];	// 0 if the code is longer than the lookup
+	node_t			*node[HUFF_LOOKUP_SIZE];	// where to go on for longer codes
+} huffTables_t;
+
+qboolean	Huff_BuildTables( huff_t *encoder, huff_t *decoder, huffTables_t *tables );
+
 // don't use if you don't know what you're doing.
 int		Huff_getBloc(void);
 void	Huff_setBloc(int _bloc);
@@ -73,6 +73,7 @@ void VM_Init( void ) {
 	Cvar_Get( "vm_cgame", "2", CVAR_ARCHIVE );	// !@# SHIP WITH SET TO 2
 	Cvar_Get( "vm_game", "2", CVAR_ARCHIVE );	// !@# SHIP WITH SET TO 2
 	Cvar_Get( "vm_ui", "2", CVAR_ARCHIVE );		// !@# SHIP WITH SET TO 2
+	Cvar_Get( "vm_cache", "1", CVAR_ARCHIVE );	// keep compiled code under vmcache/
 
 	Cmd_AddCommand ("vmprofile", VM_VmProfile_f );
 	Cmd_AddCommand ("vminfo", VM_VmInfo_f );
@@ -349,12 +350,58 @@ intptr_t QDECL VM_DllSyscall( intptr_t arg, ... ) {
     args[i] = va_arg(ap, intptr_t);
   va_end(ap);
   
-  return currentVM->systemCall( args );
+  return VM_SystemCall( currentVM, args );
 #else // original id code
-	return currentVM->systemCall( &arg );
+	return VM_SystemCall( currentVM, &arg );
 #endif
 }
 
+/*
+============
+VM_SystemCall
+
+Every backend enters the engine through here, so syscalls can be
+counted and timed while com_profile is on
+============
+*/
+intptr_t VM_SystemCall( vm_t *vm, intptr_t *args ) {
+	int64_t		start;
+	intptr_t	r;
+	int			callnum;
+
+	if ( !prof_active ) {
+		return vm->systemCall( args );
+	}
+
+	// a 32 bit qvm passes its own stack, which a nested call can overwrite
+	callnum = args[0];
+	start = Sys_Microseconds();
+	r = vm->systemCall( args );
+	VM_SyscallProfile( vm, callnum, start );
+
+	return r;
+}
+
+/*
+============
+VM_SyscallProfile
+
+Accounts one syscall that started at start, also used by engine functions
+handed directly to native modules
+============
+*/
+void VM_SyscallProfile( vm_t *vm, int callnum, int64_t start ) {
+	vmSyscallStats_t	*stats;
+
+	if ( callnum < 0 || callnum >= MAX_VM_SYSCALLS ) {
+		return;
+	}
+
+	stats = &vm->syscallStats[callnum];
+	stats->calls++;
+	stats->usec += Sys_Microseconds() - start;
+}
+
 
 /*
 =================
@@ -686,6 +733,37 @@ vm_t *VM_Create( const char *module, intptr_t (*systemCalls)(intptr_t *),
 	return vm;
 }
 
+/*
+==============
+VM_Type
+
+How the module actually ended up running, VM_Create falls back when the
+requested kind can't be loaded
+==============
+*/
+vmInterpret_t VM_Type( vm_t *vm ) {
+	if ( vm->dllHandle ) {
+		return VMI_NATIVE;
+	}
+	return vm->compiled ? VMI_COMPILED : VMI_BYTECODE;
+}
+
+/*
+==============
+VM_StaticData
+
+The data and bss segments of a qvm, everything below the program stack
+==============
+*/
+byte *VM_StaticData( vm_t *vm, int *length ) {
+	if ( vm->dllHandle ) {
+		*length = 0;
+		return NULL;
+	}
+	*length = vm->stackBottom;
+	return vm->dataBase;
+}
+
 /*
 ==============
 VM_Free
@@ -822,6 +900,7 @@ intptr_t QDECL VM_Call( vm_t *vm, int callnum, ... )
 	}
 
 	++vm->callLevel;
+	PROF_BEGIN( PROF_VM_CALL );
 	// if we have a dll loaded, call it directly
 	if ( vm->entryPoint ) {
 		//rcg010207 -  see dissertation at top of VM_DllSyscall() in this file.
@@ -865,6 +944,7 @@ intptr_t QDECL VM_Call( vm_t *vm, int callnum, ... )
 			r = VM_CallInterpreted( vm, &a.callnum );
 #endif
 	}
+	PROF_END( PROF_VM_CALL );
 	--vm->callLevel;
 
 	if ( oldVM != NULL )
@@ -891,26 +971,14 @@ static int QDECL VM_ProfileSort( const void *a, const void *b ) {
 
 /*
 ==============
-VM_VmProfile_f
-
+VM_PrintSymbolProfile
 ==============
 */
-void VM_VmProfile_f( void ) {
-	vm_t		*vm;
+static void VM_PrintSymbolProfile( vm_t *vm ) {
 	vmSymbol_t	**sorted, *sym;
 	int			i;
 	double		total;
 
-	if ( !lastVM ) {
-		return;
-	}
-
-	vm = lastVM;
-
-	if ( !vm->numSymbols ) {
-		return;
-	}
-
 	sorted = Z_Malloc( vm->numSymbols * sizeof( *sorted ) );
 	sorted[0] = vm->symbols;
 	total = sorted[0]->profileCount;
@@ -936,6 +1004,101 @@ void VM_VmProfile_f( void ) {
 	Z_Free( sorted );
 }
 
+static vm_t	*syscallSortVM;
+
+static int QDECL VM_SyscallSort( const void *a, const void *b ) {
+	int64_t		ta, tb;
+
+	ta = syscallSortVM->syscallStats[*(const int *)a].usec;
+	tb = syscallSortVM->syscallStats[*(const int *)b].usec;
+
+	if ( ta > tb ) {
+		return -1;
+	}
+	if ( ta < tb ) {
+		return 1;
+	}
+	return 0;
+}
+
+/*
+==============
+VM_PrintSyscallProfile
+
+Syscalls made since the last report, most expensive first.  Times
+include whatever the engine did on behalf of the module, nested VM
+calls too.
+==============
+*/
+static void VM_PrintSyscallProfile( vm_t *vm ) {
+	vmSyscallStats_t	*stats;
+	int			sorted[MAX_VM_SYSCALLS];
+	int			i, count, calls;
+	int64_t		total;
+
+	count = 0;
+	calls = 0;
+	total = 0;
+	for ( i = 0 ; i < MAX_VM_SYSCALLS ; i++ ) {
+		if ( vm->syscallStats[i].calls ) {
+			sorted[count++] = i;
+			calls += vm->syscallStats[i].calls;
+			total += vm->syscallStats[i].usec;
+		}
+	}
+
+	if ( !count ) {
+		Com_Printf( "No %s syscalls profiled, set com_profile 1 first.\n", vm->name );
+		return;
+	}
+
+	syscallSortVM = vm;
+	qsort( sorted, count, sizeof( *sorted ), VM_SyscallSort );
+
+	Com_Printf( "%s syscalls\n", vm->name );
+	Com_Printf( "   %%  number     calls      msec   usec/call\n" );
+	for ( i = 0 ; i < count ; i++ ) {
+		stats = &vm->syscallStats[sorted[i]];
+		Com_Printf( "%3i%% %6i %9i %9.1f %11.2f\n",
+			total ? (int)( 100 * stats->usec / total ) : 0, sorted[i],
+			stats->calls, stats->usec / 1000.0, (double)stats->usec / stats->calls );
+	}
+	Com_Printf( "      total %9i %9.1f\n", calls, total / 1000.0 );
+
+	Com_Memset( vm->syscallStats, 0, sizeof( vm->syscallStats ) );
+}
+
+/*
+==============
+VM_VmProfile_f
+
+vmprofile [module]
+==============
+*/
+void VM_VmProfile_f( void ) {
+	vm_t		*vm;
+	int			i;
+
+	vm = lastVM;
+	if ( Cmd_Argc() > 1 ) {
+		for ( i = 0, vm = NULL ; i < MAX_VM ; i++ ) {
+			if ( vmTable[i].name[0] && !Q_stricmp( vmTable[i].name, Cmd_Argv( 1 ) ) ) {
+				vm = &vmTable[i];
+			}
+		}
+	}
+
+	if ( !vm ) {
+		return;
+	}
+
+	if ( vm->numSymbols ) {
+		VM_PrintSymbolProfile( vm );
+	}
+
+	VM_PrintSyscallProfile( vm );
+}
+
 /*
 ==============
 VM_VmInfo_f
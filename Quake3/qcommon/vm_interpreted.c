@@ -22,6 +22,32 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 #include "vm_local.h"
 
 //#define	DEBUG_VM
+
+// with labels as values every handler jumps straight to the next one
+// instead of going back through the switch, the debug checks need the switch
+#if defined( __GNUC__ ) && !defined( DEBUG_VM )
+#define	VM_THREADED
+#endif
+
+// superinstructions, VM_PrepareInterpreter fuses common pairs into these
+enum {
+	OPI_LOCAL_LOAD4 = OP_CVFI + 1,
+	OPI_CONST_ADD,
+
+	// constant compared against the top of the stack, in OP_EQ .. OP_GEU order
+	OPI_CONST_EQ,
+	OPI_CONST_NE,
+	OPI_CONST_LTI,
+	OPI_CONST_LEI,
+	OPI_CONST_GTI,
+	OPI_CONST_GEI,
+	OPI_CONST_LTU,
+	OPI_CONST_LEU,
+	OPI_CONST_GTU,
+	OPI_CONST_GEU,
+
+	OPI_NUM_OPCODES
+};
 #ifdef DEBUG_VM
 static char	*opnames[256] = {
 	"OP_UNDEF", 
@@ -168,7 +194,7 @@ VM_PrepareInterpreter
 ====================
 */
 void VM_PrepareInterpreter( vm_t *vm, vmHeader_t *header ) {
-	int		op;
+	int		op, next;
 	int		byte_pc;
 	int		int_pc;
 	byte	*code;
@@ -194,6 +220,8 @@ void VM_PrepareInterpreter( vm_t *vm, vmHeader_t *header ) {
 		codeBase[int_pc] = op;
 		if(byte_pc > header->codeLength)
 			Com_Error(ERR_DROP, "VM_PrepareInterpreter: pc > header->codeLength");
+		if(op > OP_CVFI)
+			Com_Error(ERR_DROP, "VM_PrepareInterpreter: bad opcode %i at instruction %i", op, instruction - 1);
 
 		byte_pc++;
 		int_pc++;
@@ -287,6 +315,31 @@ void VM_PrepareInterpreter( vm_t *vm, vmHeader_t *header ) {
 		}
 
 	}
+
+	// Fuse common pairs into superinstructions.  The second instruction stays
+	// where it is so jumps to it still work, the fused one just skips over it.
+	for ( instruction = 0 ; instruction < header->instructionCount - 1 ; instruction++ ) {
+		int_pc = vm->instructionPointers[ instruction ];
+		op = codeBase[ int_pc ];
+		next = codeBase[ vm->instructionPointers[ instruction + 1 ] ];
+
+		switch ( op ) {
+		case OP_LOCAL:
+			if ( next == OP_LOAD4 ) {
+				codeBase[ int_pc ] = OPI_LOCAL_LOAD4;
+			}
+			break;
+		case OP_CONST:
+			if ( next == OP_ADD ) {
+				codeBase[ int_pc ] = OPI_CONST_ADD;
+			} else if ( next >= OP_EQ && next <= OP_GEU ) {
+				codeBase[ int_pc ] = OPI_CONST_EQ + ( next - OP_EQ );
+			}
+			break;
+		default:
+			break;
+		}
+	}
 }
 
 /*
@@ -315,6 +368,27 @@ locals from sp
 
 #define	DEBUGSTR va("%s%i", VM_Indent(vm), opStackOfs)
 
+#ifdef VM_THREADED
+#define	OPCASE( op )	case op: lbl_##op:
+#define	NEXT2()			goto *dispatchTable[ codeImage[ programCounter++ ] ]
+#else
+#define	OPCASE( op )	case op:
+#define	NEXT2()			goto nextInstruction2
+#endif
+
+// reload the cached top of the stack before the next instruction
+#define	NEXT()			do { r0 = opStack[opStackOfs]; r1 = opStack[(uint8_t) (opStackOfs - 1)]; NEXT2(); } while ( 0 )
+
+// superinstruction for a constant followed by a conditional jump
+#define	CONST_BRANCH( cond ) \
+			opStackOfs--; \
+			if ( cond ) { \
+				programCounter = codeImage[ programCounter + 2 ]; \
+			} else { \
+				programCounter += 3; \
+			} \
+			NEXT();
+
 int	VM_CallInterpreted( vm_t *vm, int *args ) {
 	byte		stack[OPSTACK_SIZE + 15];
 	int		*opStack;
@@ -329,6 +403,39 @@ int	VM_CallInterpreted( vm_t *vm, int *args ) {
 	int		arg;
 #ifdef DEBUG_VM
 	vmSymbol_t	*profileSymbol;
+#endif
+#ifdef VM_THREADED
+#define	OPLABEL( op )	[op] = &&lbl_##op
+	static const void *dispatchTable[OPI_NUM_OPCODES] = {
+		OPLABEL( OP_UNDEF ), OPLABEL( OP_IGNORE ), OPLABEL( OP_BREAK ),
+		OPLABEL( OP_ENTER ), OPLABEL( OP_LEAVE ), OPLABEL( OP_CALL ),
+		OPLABEL( OP_PUSH ), OPLABEL( OP_POP ), OPLABEL( OP_CONST ),
+		OPLABEL( OP_LOCAL ), OPLABEL( OP_JUMP ),
+		OPLABEL( OP_EQ ), OPLABEL( OP_NE ),
+		OPLABEL( OP_LTI ), OPLABEL( OP_LEI ), OPLABEL( OP_GTI ), OPLABEL( OP_GEI ),
+		OPLABEL( OP_LTU ), OPLABEL( OP_LEU ), OPLABEL( OP_GTU ), OPLABEL( OP_GEU ),
+		OPLABEL( OP_EQF ), OPLABEL( OP_NEF ),
+		OPLABEL( OP_LTF ), OPLABEL( OP_LEF ), OPLABEL( OP_GTF ), OPLABEL( OP_GEF ),
+		OPLABEL( OP_LOAD1 ), OPLABEL( OP_LOAD2 ), OPLABEL( OP_LOAD4 ),
+		OPLABEL( OP_STORE1 ), OPLABEL( OP_STORE2 ), OPLABEL( OP_STORE4 ),
+		OPLABEL( OP_ARG ), OPLABEL( OP_BLOCK_COPY ),
+		OPLABEL( OP_SEX8 ), OPLABEL( OP_SEX16 ),
+		OPLABEL( OP_NEGI ), OPLABEL( OP_ADD ), OPLABEL( OP_SUB ),
+		OPLABEL( OP_DIVI ), OPLABEL( OP_DIVU ), OPLABEL( OP_MODI ), OPLABEL( OP_MODU ),
+		OPLABEL( OP_MULI ), OPLABEL( OP_MULU ),
+		OPLABEL( OP_BAND ), OPLABEL( OP_BOR ), OPLABEL( OP_BXOR ), OPLABEL( OP_BCOM ),
+		OPLABEL( OP_LSH ), OPLABEL( OP_RSHI ), OPLABEL( OP_RSHU ),
+		OPLABEL( OP_NEGF ), OPLABEL( OP_ADDF ), OPLABEL( OP_SUBF ),
+		OPLABEL( OP_DIVF ), OPLABEL( OP_MULF ),
+		OPLABEL( OP_CVIF ), OPLABEL( OP_CVFI ),
+		OPLABEL( OPI_LOCAL_LOAD4 ), OPLABEL( OPI_CONST_ADD ),
+		OPLABEL( OPI_CONST_EQ ), OPLABEL( OPI_CONST_NE ),
+		OPLABEL( OPI_CONST_LTI ), OPLABEL( OPI_CONST_LEI ),
+		OPLABEL( OPI_CONST_GTI ), OPLABEL( OPI_CONST_GEI ),
+		OPLABEL( OPI_CONST_LTU ), OPLABEL( OPI_CONST_LEU ),
+		OPLABEL( OPI_CONST_GTU ), OPLABEL( OPI_CONST_GEU )
+	};
+#undef OPLABEL
 #endif
 
 	// interpret the code
@@ -377,10 +484,11 @@ int	VM_CallInterpreted( vm_t *vm, int *args ) {
 		int		opcode,	r0, r1;
 //		unsigned int	r2;
 
-nextInstruction:
 		r0 = opStack[opStackOfs];
 		r1 = opStack[(uint8_t) (opStackOfs - 1)];
+#ifndef VM_THREADED
 nextInstruction2:
+#endif
 #ifdef DEBUG_VM
 		if ( (unsigned)programCounter >= vm->codeLength ) {
 			Com_Error( ERR_DROP, "VM pc out of range" );
@@ -403,6 +511,9 @@ nextInstruction2:
 		profileSymbol->profileCount++;
 #endif
 		opcode = codeImage[ programCounter++ ];
+#ifdef VM_THREADED
+		goto *dispatchTable[ opcode ];
+#endif
 
 		switch ( opcode ) {
 #ifdef DEBUG_VM
@@ -410,25 +521,28 @@ nextInstruction2:
 			Com_Error( ERR_DROP, "Bad VM instruction" );  // this should be scanned on load!
 			return 0;
 #endif
-		case OP_BREAK:
+		OPCASE( OP_UNDEF )
+		OPCASE( OP_IGNORE )
+			NEXT();
+		OPCASE( OP_BREAK )
 			vm->breakCount++;
-			goto nextInstruction2;
-		case OP_CONST:
+			NEXT2();
+		OPCASE( OP_CONST )
 			opStackOfs++;
 			r1 = r0;
 			r0 = opStack[opStackOfs] = r2;
 			
 			programCounter += 1;
-			goto nextInstruction2;
-		case OP_LOCAL:
+			NEXT2();
+		OPCASE( OP_LOCAL )
 			opStackOfs++;
 			r1 = r0;
 			r0 = opStack[opStackOfs] = r2+programStack;
 
 			programCounter += 1;
-			goto nextInstruction2;
+			NEXT2();
 
-		case OP_LOAD4:
+		OPCASE( OP_LOAD4 )
 #ifdef DEBUG_VM
 			if(opStack[opStackOfs] & 3)
 			{
@@ -437,41 +551,41 @@ nextInstruction2:
 			}
 #endif
 			r0 = opStack[opStackOfs] = *(int *) &image[ r0 & dataMask ];
-			goto nextInstruction2;
-		case OP_LOAD2:
+			NEXT2();
+		OPCASE( OP_LOAD2 )
 			r0 = opStack[opStackOfs] = *(unsigned short *)&image[ r0 & dataMask ];
-			goto nextInstruction2;
-		case OP_LOAD1:
+			NEXT2();
+		OPCASE( OP_LOAD1 )
 			r0 = opStack[opStackOfs] = image[ r0 & dataMask ];
-			goto nextInstruction2;
+			NEXT2();
 
-		case OP_STORE4:
+		OPCASE( OP_STORE4 )
 			*(int *)&image[ r1 & dataMask ] = r0;
 			opStackOfs -= 2;
-			goto nextInstruction;
-		case OP_STORE2:
+			NEXT();
+		OPCASE( OP_STORE2 )
 			*(short *)&image[ r1 & dataMask ] = r0;
 			opStackOfs -= 2;
-			goto nextInstruction;
-		case OP_STORE1:
+			NEXT();
+		OPCASE( OP_STORE1 )
 			image[ r1 & dataMask ] = r0;
 			opStackOfs -= 2;
-			goto nextInstruction;
+			NEXT();
 
-		case OP_ARG:
+		OPCASE( OP_ARG )
 			// single byte offset from programStack
 			*(int *)&image[ (codeImage[programCounter] + programStack) & dataMask ] = r0;
 			opStackOfs--;
 			programCounter += 1;
-			goto nextInstruction;
+			NEXT();
 
-		case OP_BLOCK_COPY:
+		OPCASE( OP_BLOCK_COPY )
 			VM_BlockCopy(r1, r0, r2);
 			programCounter += 1;
 			opStackOfs -= 2;
-			goto nextInstruction;
+			NEXT();
 
-		case OP_CALL:
+		OPCASE( OP_CALL )
 			// save current program counter
 			*(int *)&image[ programStack ] = programCounter;
 			
@@ -508,10 +622,10 @@ nextInstruction2:
 						for (i = 0; i < ARRAY_LEN(argarr); ++i) {
 							argarr[i] = *(++imagePtr);
 						}
-						r = vm->systemCall( argarr );
+						r = VM_SystemCall( vm, argarr );
 					} else {
 						intptr_t* argptr = (intptr_t *)&image[ programStack + 4 ];
-						r = vm->systemCall( argptr );
+						r = VM_SystemCall( vm, argptr );
 					}
 				}
 
@@ -537,17 +651,17 @@ nextInstruction2:
 			} else {
 				programCounter = vm->instructionPointers[ programCounter ];
 			}
-			goto nextInstruction;
+			NEXT();
 
 		// push and pop are only needed for discarded or bad function return values
-		case OP_PUSH:
+		OPCASE( OP_PUSH )
 			opStackOfs++;
-			goto nextInstruction;
-		case OP_POP:
+			NEXT();
+		OPCASE( OP_POP )
 			opStackOfs--;
-			goto nextInstruction;
+			NEXT();
 
-		case OP_ENTER:
+		OPCASE( OP_ENTER )
 #ifdef DEBUG_VM
 			profileSymbol = VM_ValueToFunctionSymbol( vm, programCounter );
 #endif
@@ -570,8 +684,8 @@ nextInstruction2:
 //				vm->callLevel++;
 			}
 #endif
-			goto nextInstruction;
-		case OP_LEAVE:
+			NEXT();
+		OPCASE( OP_LEAVE )
 			// remove our stack frame
 			v1 = r2;
 
@@ -593,7 +707,7 @@ nextInstruction2:
 				Com_Error( ERR_DROP, "VM program counter out of range in OP_LEAVE" );
 				return 0;
 			}
-			goto nextInstruction;
+			NEXT();
 
 		/*
 		===================================================================
@@ -601,7 +715,7 @@ nextInstruction2:
 		===================================================================
 		*/
 
-		case OP_JUMP:
+		OPCASE( OP_JUMP )
 			if ( (unsigned)r0 >= vm->instructionCount )
 			{
 				Com_Error( ERR_DROP, "VM program counter out of range in OP_JUMP" );
@@ -611,280 +725,321 @@ nextInstruction2:
 			programCounter = vm->instructionPointers[ r0 ];
 
 			opStackOfs--;
-			goto nextInstruction;
+			NEXT();
 
-		case OP_EQ:
+		OPCASE( OP_EQ )
 			opStackOfs -= 2;
 			if ( r1 == r0 ) {
 				programCounter = r2;	//vm->instructionPointers[r2];
-				goto nextInstruction;
+				NEXT();
 			} else {
 				programCounter += 1;
-				goto nextInstruction;
+				NEXT();
 			}
 
-		case OP_NE:
+		OPCASE( OP_NE )
 			opStackOfs -= 2;
 			if ( r1 != r0 ) {
 				programCounter = r2;	//vm->instructionPointers[r2];
-				goto nextInstruction;
+				NEXT();
 			} else {
 				programCounter += 1;
-				goto nextInstruction;
+				NEXT();
 			}
 
-		case OP_LTI:
+		OPCASE( OP_LTI )
 			opStackOfs -= 2;
 			if ( r1 < r0 ) {
 				programCounter = r2;	//vm->instructionPointers[r2];
-				goto nextInstruction;
+				NEXT();
 			} else {
 				programCounter += 1;
-				goto nextInstruction;
+				NEXT();
 			}
 
-		case OP_LEI:
+		OPCASE( OP_LEI )
 			opStackOfs -= 2;
 			if ( r1 <= r0 ) {
 				programCounter = r2;	//vm->instructionPointers[r2];
-				goto nextInstruction;
+				NEXT();
 			} else {
 				programCounter += 1;
-				goto nextInstruction;
+				NEXT();
 			}
 
-		case OP_GTI:
+		OPCASE( OP_GTI )
 			opStackOfs -= 2;
 			if ( r1 > r0 ) {
 				programCounter = r2;	//vm->instructionPointers[r2];
-				goto nextInstruction;
+				NEXT();
 			} else {
 				programCounter += 1;
-				goto nextInstruction;
+				NEXT();
 			}
 
-		case OP_GEI:
+		OPCASE( OP_GEI )
 			opStackOfs -= 2;
 			if ( r1 >= r0 ) {
 				programCounter = r2;	//vm->instructionPointers[r2];
-				goto nextInstruction;
+				NEXT();
 			} else {
 				programCounter += 1;
-				goto nextInstruction;
+				NEXT();
 			}
 
-		case OP_LTU:
+		OPCASE( OP_LTU )
 			opStackOfs -= 2;
 			if ( ((unsigned)r1) < ((unsigned)r0) ) {
 				programCounter = r2;	//vm->instructionPointers[r2];
-				goto nextInstruction;
+				NEXT();
 			} else {
 				programCounter += 1;
-				goto nextInstruction;
+				NEXT();
 			}
 
-		case OP_LEU:
+		OPCASE( OP_LEU )
 			opStackOfs -= 2;
 			if ( ((unsigned)r1) <= ((unsigned)r0) ) {
 				programCounter = r2;	//vm->instructionPointers[r2];
-				goto nextInstruction;
+				NEXT();
 			} else {
 				programCounter += 1;
-				goto nextInstruction;
+				NEXT();
 			}
 
-		case OP_GTU:
+		OPCASE( OP_GTU )
 			opStackOfs -= 2;
 			if ( ((unsigned)r1) > ((unsigned)r0) ) {
 				programCounter = r2;	//vm->instructionPointers[r2];
-				goto nextInstruction;
+				NEXT();
 			} else {
 				programCounter += 1;
-				goto nextInstruction;
+				NEXT();
 			}
 
-		case OP_GEU:
+		OPCASE( OP_GEU )
 			opStackOfs -= 2;
 			if ( ((unsigned)r1) >= ((unsigned)r0) ) {
 				programCounter = r2;	//vm->instructionPointers[r2];
-				goto nextInstruction;
+				NEXT();
 			} else {
 				programCounter += 1;
-				goto nextInstruction;
+				NEXT();
 			}
 
-		case OP_EQF:
+		OPCASE( OP_EQF )
 			opStackOfs -= 2;
 			
 			if(((float *) opStack)[(uint8_t) (opStackOfs + 1)] == ((float *) opStack)[(uint8_t) (opStackOfs + 2)])
 			{
 				programCounter = r2;	//vm->instructionPointers[r2];
-				goto nextInstruction;
+				NEXT();
 			} else {
 				programCounter += 1;
-				goto nextInstruction;
+				NEXT();
 			}
 
-		case OP_NEF:
+		OPCASE( OP_NEF )
 			opStackOfs -= 2;
 
 			if(((float *) opStack)[(uint8_t) (opStackOfs + 1)] != ((float *) opStack)[(uint8_t) (opStackOfs + 2)])
 			{
 				programCounter = r2;	//vm->instructionPointers[r2];
-				goto nextInstruction;
+				NEXT();
 			} else {
 				programCounter += 1;
-				goto nextInstruction;
+				NEXT();
 			}
 
-		case OP_LTF:
+		OPCASE( OP_LTF )
 			opStackOfs -= 2;
 
 			if(((float *) opStack)[(uint8_t) (opStackOfs + 1)] < ((float *) opStack)[(uint8_t) (opStackOfs + 2)])
 			{
 				programCounter = r2;	//vm->instructionPointers[r2];
-				goto nextInstruction;
+				NEXT();
 			} else {
 				programCounter += 1;
-				goto nextInstruction;
+				NEXT();
 			}
 
-		case OP_LEF:
+		OPCASE( OP_LEF )
 			opStackOfs -= 2;
 
 			if(((float *) opStack)[(uint8_t) ((uint8_t) (opStackOfs + 1))] <= ((float *) opStack)[(uint8_t) ((uint8_t) (opStackOfs + 2))])
 			{
 				programCounter = r2;	//vm->instructionPointers[r2];
-				goto nextInstruction;
+				NEXT();
 			} else {
 				programCounter += 1;
-				goto nextInstruction;
+				NEXT();
 			}
 
-		case OP_GTF:
+		OPCASE( OP_GTF )
 			opStackOfs -= 2;
 
 			if(((float *) opStack)[(uint8_t) (opStackOfs + 1)] > ((float *) opStack)[(uint8_t) (opStackOfs + 2)])
 			{
 				programCounter = r2;	//vm->instructionPointers[r2];
-				goto nextInstruction;
+				NEXT();
 			} else {
 				programCounter += 1;
-				goto nextInstruction;
+				NEXT();
 			}
 
-		case OP_GEF:
+		OPCASE( OP_GEF )
 			opStackOfs -= 2;
 
 			if(((float *) opStack)[(uint8_t) (opStackOfs + 1)] >= ((float *) opStack)[(uint8_t) (opStackOfs + 2)])
 			{
 				programCounter = r2;	//vm->instructionPointers[r2];
-				goto nextInstruction;
+				NEXT();
 			} else {
 				programCounter += 1;
-				goto nextInstruction;
+				NEXT();
 			}
 
 
 		//===================================================================
 
-		case OP_NEGI:
+		OPCASE( OP_NEGI )
 			opStack[opStackOfs] = -r0;
-			goto nextInstruction;
-		case OP_ADD:
+			NEXT();
+		OPCASE( OP_ADD )
 			opStackOfs--;
 			opStack[opStackOfs] = r1 + r0;
-			goto nextInstruction;
-		case OP_SUB:
+			NEXT();
+		OPCASE( OP_SUB )
 			opStackOfs--;
 			opStack[opStackOfs] = r1 - r0;
-			goto nextInstruction;
-		case OP_DIVI:
+			NEXT();
+		OPCASE( OP_DIVI )
 			opStackOfs--;
 			opStack[opStackOfs] = r1 / r0;
-			goto nextInstruction;
-		case OP_DIVU:
+			NEXT();
+		OPCASE( OP_DIVU )
 			opStackOfs--;
 			opStack[opStackOfs] = ((unsigned) r1) / ((unsigned) r0);
-			goto nextInstruction;
-		case OP_MODI:
+			NEXT();
+		OPCASE( OP_MODI )
 			opStackOfs--;
 			opStack[opStackOfs] = r1 % r0;
-			goto nextInstruction;
-		case OP_MODU:
+			NEXT();
+		OPCASE( OP_MODU )
 			opStackOfs--;
 			opStack[opStackOfs] = ((unsigned) r1) % ((unsigned) r0);
-			goto nextInstruction;
-		case OP_MULI:
+			NEXT();
+		OPCASE( OP_MULI )
 			opStackOfs--;
 			opStack[opStackOfs] = r1 * r0;
-			goto nextInstruction;
-		case OP_MULU:
+			NEXT();
+		OPCASE( OP_MULU )
 			opStackOfs--;
 			opStack[opStackOfs] = ((unsigned) r1) * ((unsigned) r0);
-			goto nextInstruction;
+			NEXT();
 
-		case OP_BAND:
+		OPCASE( OP_BAND )
 			opStackOfs--;
 			opStack[opStackOfs] = ((unsigned) r1) & ((unsigned) r0);
-			goto nextInstruction;
-		case OP_BOR:
+			NEXT();
+		OPCASE( OP_BOR )
 			opStackOfs--;
 			opStack[opStackOfs] = ((unsigned) r1) | ((unsigned) r0);
-			goto nextInstruction;
-		case OP_BXOR:
+			NEXT();
+		OPCASE( OP_BXOR )
 			opStackOfs--;
 			opStack[opStackOfs] = ((unsigned) r1) ^ ((unsigned) r0);
-			goto nextInstruction;
-		case OP_BCOM:
+			NEXT();
+		OPCASE( OP_BCOM )
 			opStack[opStackOfs] = ~((unsigned) r0);
-			goto nextInstruction;
+			NEXT();
 
-		case OP_LSH:
+		OPCASE( OP_LSH )
 			opStackOfs--;
 			opStack[opStackOfs] = r1 << r0;
-			goto nextInstruction;
-		case OP_RSHI:
+			NEXT();
+		OPCASE( OP_RSHI )
 			opStackOfs--;
 			opStack[opStackOfs] = r1 >> r0;
-			goto nextInstruction;
-		case OP_RSHU:
+			NEXT();
+		OPCASE( OP_RSHU )
 			opStackOfs--;
 			opStack[opStackOfs] = ((unsigned) r1) >> r0;
-			goto nextInstruction;
+			NEXT();
 
-		case OP_NEGF:
+		OPCASE( OP_NEGF )
 			((float *) opStack)[opStackOfs] =  -((float *) opStack)[opStackOfs];
-			goto nextInstruction;
-		case OP_ADDF:
+			NEXT();
+		OPCASE( OP_ADDF )
 			opStackOfs--;
 			((float *) opStack)[opStackOfs] = ((float *) opStack)[opStackOfs] + ((float *) opStack)[(uint8_t) (opStackOfs + 1)];
-			goto nextInstruction;
-		case OP_SUBF:
+			NEXT();
+		OPCASE( OP_SUBF )
 			opStackOfs--;
 			((float *) opStack)[opStackOfs] = ((float *) opStack)[opStackOfs] - ((float *) opStack)[(uint8_t) (opStackOfs + 1)];
-			goto nextInstruction;
-		case OP_DIVF:
+			NEXT();
+		OPCASE( OP_DIVF )
 			opStackOfs--;
 			((float *) opStack)[opStackOfs] = ((float *) opStack)[opStackOfs] / ((float *) opStack)[(uint8_t) (opStackOfs + 1)];
-			goto nextInstruction;
-		case OP_MULF:
+			NEXT();
+		OPCASE( OP_MULF )
 			opStackOfs--;
 			((float *) opStack)[opStackOfs] = ((float *) opStack)[opStackOfs] * ((float *) opStack)[(uint8_t) (opStackOfs + 1)];
-			goto nextInstruction;
+			NEXT();
 
-		case OP_CVIF:
+		OPCASE( OP_CVIF )
 			((float *) opStack)[opStackOfs] = (float) opStack[opStackOfs];
-			goto nextInstruction;
-		case OP_CVFI:
+			NEXT();
+		OPCASE( OP_CVFI )
 			opStack[opStackOfs] = Q_ftol(((float *) opStack)[opStackOfs]);
-			goto nextInstruction;
-		case OP_SEX8:
+			NEXT();
+		OPCASE( OP_SEX8 )
 			opStack[opStackOfs] = (signed char) opStack[opStackOfs];
-			goto nextInstruction;
-		case OP_SEX16:
+			NEXT();
+		OPCASE( OP_SEX16 )
 			opStack[opStackOfs] = (short) opStack[opStackOfs];
-			goto nextInstruction;
+			NEXT();
+
+		/*
+		===================================================================
+		SUPERINSTRUCTIONS
+
+		The operand of the first instruction follows the opcode as usual,
+		the second instruction is skipped.
+		===================================================================
+		*/
+
+		OPCASE( OPI_LOCAL_LOAD4 )
+			opStackOfs++;
+			r1 = r0;
+			r0 = opStack[opStackOfs] = *(int *) &image[ ( r2 + programStack ) & dataMask ];
+			programCounter += 2;
+			NEXT2();
+		OPCASE( OPI_CONST_ADD )
+			r0 = opStack[opStackOfs] = r0 + r2;
+			programCounter += 2;
+			NEXT2();
+
+		OPCASE( OPI_CONST_EQ )
+			CONST_BRANCH( r0 == r2 )
+		OPCASE( OPI_CONST_NE )
+			CONST_BRANCH( r0 != r2 )
+		OPCASE( OPI_CONST_LTI )
+			CONST_BRANCH( r0 < r2 )
+		OPCASE( OPI_CONST_LEI )
+			CONST_BRANCH( r0 <= r2 )
+		OPCASE( OPI_CONST_GTI )
+			CONST_BRANCH( r0 > r2 )
+		OPCASE( OPI_CONST_GEI )
+			CONST_BRANCH( r0 >= r2 )
+		OPCASE( OPI_CONST_LTU )
+			CONST_BRANCH( (unsigned) r0 < (unsigned) r2 )
+		OPCASE( OPI_CONST_LEU )
+			CONST_BRANCH( (unsigned) r0 <= (unsigned) r2 )
+		OPCASE( OPI_CONST_GTU )
+			CONST_BRANCH( (unsigned) r0 > (unsigned) r2 )
+		OPCASE( OPI_CONST_GEU )
+			CONST_BRANCH( (unsigned) r0 >= (unsigned) r2 )
 		}
 	}
 
@@ -131,6 +131,13 @@ typedef enum {
 
 typedef int	vmptr_t;
 
+#define	MAX_VM_SYSCALLS		1024		// highest syscall number that gets profiled
+
+typedef struct {
+	int			calls;
+	int64_t		usec;
+} vmSyscallStats_t;
+
 typedef struct vmSymbol_s {
 	struct vmSymbol_s	*next;
 	int		symValue;
@@ -183,6 +190,8 @@ struct vm_s {
 
 	byte		*jumpTableTargets;
 	int			numJumpTableTargets;
+
+	vmSyscallStats_t	syscallStats[MAX_VM_SYSCALLS];	// only counted with com_profile
 };
 
 
@@ -199,5 +208,6 @@ vmSymbol_t *VM_ValueToFunctionSymbol( vm_t *vm, int value );
 int VM_SymbolToValue( vm_t *vm, const char *symbol );
 const char *VM_ValueToSymbol( vm_t *vm, int value );
 void VM_LogSyscalls( int *args );
+intptr_t VM_SystemCall( vm_t *vm, intptr_t *args );
 
 void VM_BlockCopy(unsigned int dest, unsigned int src, size_t n);
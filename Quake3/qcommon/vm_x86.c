@@ -58,7 +58,7 @@ x86_64:
 
 */
 
-#define VMFREE_BUFFERS() do {Z_Free(buf); Z_Free(jused);} while(0)
+#define VMFREE_BUFFERS() do {Z_Free(buf); Z_Free(jused); Z_Free(relocs);} while(0)
 static	byte	*buf = NULL;
 static	byte	*jused = NULL;
 static	int		jusedSize = 0;
@@ -89,6 +89,37 @@ typedef enum
 
 static	ELastCommand	LastCommand;
 
+/*
+  Everything the generated code refers to by absolute address.  Each use is
+  recorded as a relocation so the code can be written to the cache and
+  rebased when it is loaded into another process.
+*/
+typedef enum
+{
+	JREL_DOSYSCALL,
+	JREL_SYSCALLNUM,
+	JREL_PROGRAMSTACK,
+	JREL_OPSTACKOFS,
+	JREL_OPSTACKBASE,
+	JREL_ARG,
+	JREL_FTOL,
+	JREL_DATABASE,
+	JREL_INSTRUCTIONS,
+
+	JREL_NUM_KINDS
+} EJitReloc;
+
+typedef struct
+{
+	int		offset;
+	int		kind;
+	int		addend;
+} jitReloc_t;
+
+static	jitReloc_t	*relocs = NULL;
+static	int		numRelocs, maxRelocs;
+static	qboolean	relocsOverflowed;
+
 static int iss8(int32_t v)
 {
 	return (SCHAR_MIN <= v && v <= SCHAR_MAX);
@@ -266,6 +297,40 @@ static void EmitPushStack(vm_t *vm)
 	STACK_PUSH(1);		// add bl, 1
 }
 
+/*
+=================
+EAXHoldsTop
+
+The previous instruction left its result both in eax and on the opStack,
+so the next one doesn't have to load it again
+=================
+*/
+static qboolean EAXHoldsTop(void)
+{
+	switch(pop1)
+	{
+		case OP_DIVI:
+		case OP_DIVU:
+		case OP_MULI:
+		case OP_MULU:
+		case OP_ADD:
+		case OP_SUB:
+		case OP_BAND:
+		case OP_BOR:
+		case OP_BXOR:
+		case OP_BCOM:
+		case OP_LSH:
+		case OP_RSHI:
+		case OP_RSHU:
+		case OP_STORE4:
+		case OP_STORE2:
+		case OP_STORE1:
+			return qtrue;
+		default:
+			return qfalse;
+	}
+}
+
 static void EmitMovEAXStack(vm_t *vm, int andit)
 {
 	if(!jlabel)
@@ -288,8 +353,7 @@ static void EmitMovEAXStack(vm_t *vm, int andit)
 			
 			return;
 		}
-		else if(pop1 != OP_DIVI && pop1 != OP_DIVU && pop1 != OP_MULI && pop1 != OP_MULU &&
-			pop1 != OP_STORE4 && pop1 != OP_STORE2 && pop1 != OP_STORE1)
+		else if(!EAXHoldsTop())
 		{	
 			EmitString("8B 04 9F");	// mov eax, dword ptr [edi + ebx * 4]
 		}
@@ -315,8 +379,7 @@ void EmitMovECXStack(vm_t *vm)
 			EmitString("89 C1");		// mov ecx, eax
 			return;
 		}
-		if(pop1 == OP_DIVI || pop1 == OP_DIVU || pop1 == OP_MULI || pop1 == OP_MULU ||
-			pop1 == OP_STORE4 || pop1 == OP_STORE2 || pop1 == OP_STORE1) 
+		if(EAXHoldsTop())
 		{	
 			EmitString("89 C1");		// mov ecx, eax
 			return;
@@ -338,8 +401,7 @@ void EmitMovEDXStack(vm_t *vm, int andit)
 
 			EmitString("8B D0");	// mov edx, eax
 		}
-		else if(pop1 == OP_DIVI || pop1 == OP_DIVU || pop1 == OP_MULI || pop1 == OP_MULU ||
-			pop1 == OP_STORE4 || pop1 == OP_STORE2 || pop1 == OP_STORE1)
+		else if(EAXHoldsTop())
 		{	
 			EmitString("8B D0");	// mov edx, eax
 		}
@@ -432,10 +494,10 @@ static void DoSyscall(void)
 		for(index = 1; index < ARRAY_LEN(args); index++)
 			args[index] = data[index];
 			
-		*ret = savedVM->systemCall(args);
+		*ret = VM_SystemCall(savedVM, args);
 #else
 		data[0] = ~vm_syscallNum;
-		*ret = savedVM->systemCall((intptr_t *) data);
+		*ret = VM_SystemCall(savedVM, (intptr_t *) data);
 #endif
 	}
 	else
@@ -460,6 +522,63 @@ static void DoSyscall(void)
 	currentVM = savedVM;
 }
 
+/*
+=================
+JitRelocTarget
+=================
+*/
+static byte *JitRelocTarget(vm_t *vm, int kind)
+{
+	switch(kind)
+	{
+		case JREL_DOSYSCALL:
+			return (byte *) DoSyscall;
+		case JREL_SYSCALLNUM:
+			return (byte *) &vm_syscallNum;
+		case JREL_PROGRAMSTACK:
+			return (byte *) &vm_programStack;
+		case JREL_OPSTACKOFS:
+			return (byte *) &vm_opStackOfs;
+		case JREL_OPSTACKBASE:
+			return (byte *) &vm_opStackBase;
+		case JREL_ARG:
+			return (byte *) &vm_arg;
+		case JREL_FTOL:
+			return (byte *) Q_VMftol;
+		case JREL_DATABASE:
+			return vm->dataBase;
+		case JREL_INSTRUCTIONS:
+			return (byte *) vm->instructionPointers;
+		default:
+			return NULL;
+	}
+}
+
+/*
+=================
+EmitReloc
+Absolute pointer to a JitRelocTarget, remembered for the code cache
+=================
+*/
+static void EmitReloc(vm_t *vm, int kind, int addend)
+{
+	// peephole rewinds may have dropped code a relocation pointed into
+	while(numRelocs > 0 && relocs[numRelocs - 1].offset >= compiledOfs)
+		numRelocs--;
+
+	if(numRelocs < maxRelocs)
+	{
+		relocs[numRelocs].offset = compiledOfs;
+		relocs[numRelocs].kind = kind;
+		relocs[numRelocs].addend = addend;
+		numRelocs++;
+	}
+	else
+		relocsOverflowed = qtrue;
+
+	EmitPtr(JitRelocTarget(vm, kind) + addend);
+}
+
 /*
 =================
 EmitCallRel
@@ -484,7 +603,7 @@ int EmitCallDoSyscall(vm_t *vm)
 {
 	// use edx register to store DoSyscall address
 	EmitRexString(0x48, "BA");		// mov edx, DoSyscall
-	EmitPtr(DoSyscall);
+	EmitReloc(vm, JREL_DOSYSCALL, 0);
 
 	// Push important registers to stack as we can't really make
 	// any assumptions about calling conventions.
@@ -499,23 +618,23 @@ int EmitCallDoSyscall(vm_t *vm)
 	// write arguments to global vars
 	// syscall number
 	EmitString("A3");			// mov [0x12345678], eax
-	EmitPtr(&vm_syscallNum);
+	EmitReloc(vm, JREL_SYSCALLNUM, 0);
 	// vm_programStack value
 	EmitString("89 F0");			// mov eax, esi
 	EmitString("A3");			// mov [0x12345678], eax
-	EmitPtr(&vm_programStack);
+	EmitReloc(vm, JREL_PROGRAMSTACK, 0);
 	// vm_opStackOfs 
 	EmitString("88 D8");			// mov al, bl
 	EmitString("A2");			// mov [0x12345678], al
-	EmitPtr(&vm_opStackOfs);
+	EmitReloc(vm, JREL_OPSTACKOFS, 0);
 	// vm_opStackBase
 	EmitRexString(0x48, "89 F8");		// mov eax, edi
 	EmitRexString(0x48, "A3");		// mov [0x12345678], eax
-	EmitPtr(&vm_opStackBase);
+	EmitReloc(vm, JREL_OPSTACKBASE, 0);
 	// vm_arg
 	EmitString("89 C8");			// mov eax, ecx
 	EmitString("A3");			// mov [0x12345678], eax
-	EmitPtr(&vm_arg);
+	EmitReloc(vm, JREL_ARG, 0);
 	
 	// align the stack pointer to a 16-byte-boundary
 	EmitString("55");			// push ebp
@@ -591,7 +710,7 @@ int EmitCallProcedure(vm_t *vm, int sysCallOfs)
 	EmitRexString(0x49, "FF 14 C0");	// call qword ptr [r8 + eax * 8]
 #else
 	EmitString("FF 14 85");			// call dword ptr [vm->instructionPointers + eax * 4]
-	Emit4((intptr_t) vm->instructionPointers);
+	EmitReloc(vm, JREL_INSTRUCTIONS, 0);
 #endif
 	EmitString("8B 04 9F");			// mov eax, dword ptr [edi + ebx * 4]
 	EmitString("C3");			// ret
@@ -659,17 +778,23 @@ void EmitCallIns(vm_t *vm, int cdest)
 =================
 EmitCallConst
 Call to constant instruction number or syscall
+
+Known syscalls go straight to the DoSyscall stub instead of through
+the runtime dispatch in EmitCallProcedure
 =================
 */
 
-void EmitCallConst(vm_t *vm, int cdest, int callProcOfsSyscall)
+void EmitCallConst(vm_t *vm, int cdest, int sysCallOfs)
 {
 	if(cdest < 0)
 	{
 		EmitString("B8");	// mov eax, cdest
 		Emit4(cdest);
 
-		EmitCallRel(vm, callProcOfsSyscall);
+		EmitCallRel(vm, sysCallOfs);
+
+		// have opStack reg point at return value
+		STACK_PUSH(1);		// add bl, 1
 	}
 	else
 		EmitCallIns(vm, cdest);
@@ -727,7 +852,7 @@ instead of opStack operations, which will save expensive operations on memory
 =================
 */
 
-qboolean ConstOptimize(vm_t *vm, int callProcOfsSyscall)
+qboolean ConstOptimize(vm_t *vm, int sysCallOfs)
 {
 	int v;
 	int op1;
@@ -748,7 +873,7 @@ qboolean ConstOptimize(vm_t *vm, int callProcOfsSyscall)
 		Emit4(Constant4() & vm->dataMask);
 #else
 		EmitString("B8");				// mov eax, 0x12345678
-		EmitPtr(vm->dataBase + (Constant4() & vm->dataMask));
+		EmitReloc(vm, JREL_DATABASE, Constant4() & vm->dataMask);
 		EmitString("8B 00");				// mov eax, dword ptr [eax]
 #endif
 		EmitCommand(LAST_COMMAND_MOV_STACK_EAX);	// mov dword ptr [edi + ebx * 4], eax
@@ -764,7 +889,7 @@ qboolean ConstOptimize(vm_t *vm, int callProcOfsSyscall)
 		Emit4(Constant4() & vm->dataMask);
 #else
 		EmitString("B8");				// mov eax, 0x12345678
-		EmitPtr(vm->dataBase + (Constant4() & vm->dataMask));
+		EmitReloc(vm, JREL_DATABASE, Constant4() & vm->dataMask);
 		EmitString("0F B7 00");				// movzx eax, word ptr [eax]
 #endif
 		EmitCommand(LAST_COMMAND_MOV_STACK_EAX);	// mov dword ptr [edi + ebx * 4], eax
@@ -780,7 +905,7 @@ qboolean ConstOptimize(vm_t *vm, int callProcOfsSyscall)
 		Emit4(Constant4() & vm->dataMask);
 #else
 		EmitString("B8");				// mov eax, 0x12345678
-		EmitPtr(vm->dataBase + (Constant4() & vm->dataMask));
+		EmitReloc(vm, JREL_DATABASE, Constant4() & vm->dataMask);
 		EmitString("0F B6 00");				// movzx eax, byte ptr [eax]
 #endif
 		EmitCommand(LAST_COMMAND_MOV_STACK_EAX);	// mov dword ptr [edi + ebx * 4], eax
@@ -796,7 +921,7 @@ qboolean ConstOptimize(vm_t *vm, int callProcOfsSyscall)
 		Emit4(Constant4());
 #else
 		EmitString("C7 80");				// mov dword ptr [eax + 0x12345678], 0x12345678
-		Emit4((intptr_t) vm->dataBase);
+		EmitReloc(vm, JREL_DATABASE, 0);
 		Emit4(Constant4());
 #endif
 		EmitCommand(LAST_COMMAND_SUB_BL_1);		// sub bl, 1
@@ -812,7 +937,7 @@ qboolean ConstOptimize(vm_t *vm, int callProcOfsSyscall)
 		Emit2(Constant4());
 #else
 		EmitString("66 C7 80");				// mov word ptr [eax + 0x12345678], 0x1234
-		Emit4((intptr_t) vm->dataBase);
+		EmitReloc(vm, JREL_DATABASE, 0);
 		Emit2(Constant4());
 #endif
 		EmitCommand(LAST_COMMAND_SUB_BL_1);		// sub bl, 1
@@ -828,7 +953,7 @@ qboolean ConstOptimize(vm_t *vm, int callProcOfsSyscall)
 		Emit1(Constant4());
 #else
 		EmitString("C6 80");				// mov byte ptr [eax + 0x12345678], 0x12
-		Emit4((intptr_t) vm->dataBase);
+		EmitReloc(vm, JREL_DATABASE, 0);
 		Emit1(Constant4());
 #endif
 		EmitCommand(LAST_COMMAND_SUB_BL_1);		// sub bl, 1
@@ -1049,7 +1174,7 @@ qboolean ConstOptimize(vm_t *vm, int callProcOfsSyscall)
 
 	case OP_CALL:
 		v = Constant4();
-		EmitCallConst(vm, v, callProcOfsSyscall);
+		EmitCallConst(vm, v, sysCallOfs);
 
 		pc += 1;                  // OP_CALL
 		instruction += 1;
@@ -1062,6 +1187,264 @@ qboolean ConstOptimize(vm_t *vm, int callProcOfsSyscall)
 	return qfalse;
 }
 
+/*
+=================
+VM_AllocCompiled
+
+Copy finished code to an exact sized buffer with the appropriate
+permission bits
+=================
+*/
+static void VM_AllocCompiled(vm_t *vm, const byte *src, int length)
+{
+	vm->codeLength = length;
+#ifdef VM_X86_MMAP
+	vm->codeBase = mmap(NULL, length, PROT_WRITE, MAP_SHARED|MAP_ANONYMOUS, -1, 0);
+	if(vm->codeBase == MAP_FAILED)
+		Com_Error(ERR_FATAL, "VM_CompileX86: can't mmap memory");
+#elif _WIN32
+	// allocate memory with EXECUTE permissions under windows.
+	vm->codeBase = VirtualAlloc(NULL, length, MEM_COMMIT, PAGE_EXECUTE_READWRITE);
+	if(!vm->codeBase)
+		Com_Error(ERR_FATAL, "VM_CompileX86: VirtualAlloc failed");
+#else
+	vm->codeBase = malloc(length);
+	if(!vm->codeBase)
+	        Com_Error(ERR_FATAL, "VM_CompileX86: malloc failed");
+#endif
+
+	Com_Memcpy( vm->codeBase, src, length );
+
+#ifdef VM_X86_MMAP
+	if(mprotect(vm->codeBase, length, PROT_READ|PROT_EXEC))
+		Com_Error(ERR_FATAL, "VM_CompileX86: mprotect failed");
+#elif _WIN32
+	{
+		DWORD oldProtect = 0;
+		
+		// remove write permissions.
+		if(!VirtualProtect(vm->codeBase, length, PAGE_EXECUTE_READ, &oldProtect))
+			Com_Error(ERR_FATAL, "VM_CompileX86: VirtualProtect failed");
+	}
+#endif
+
+	vm->destroy = VM_Destroy_Compiled;
+}
+
+/*
+=================
+JIT code cache
+
+The compiled code for a qvm is written to vmcache/ under fs_homepath,
+named after the checksum of the qvm image.  The next VM_Create of the
+same qvm patches the recorded relocations for this process and maps the
+code directly instead of compiling again.  Bump JITCACHE_VERSION with
+any change to the code generator.
+=================
+*/
+
+#define JITCACHE_IDENT		(('T'<<24)+('I'<<16)+('J'<<8)+'Q')
+#define JITCACHE_VERSION	2
+
+typedef struct
+{
+	int		ident;
+	int		version;
+	int		pointerSize;
+	unsigned	checksum;
+	int		instructionCount;
+	int		dataMask;
+	int		entryOfs;
+	int		codeLength;
+	int		numRelocs;
+	// int		instructionOffsets[instructionCount];
+	// jitReloc_t	relocs[numRelocs];
+	// byte		code[codeLength];
+} jitCacheHeader_t;
+
+/*
+=================
+VM_JitChecksum
+=================
+*/
+static unsigned VM_JitChecksum(vm_t *vm, vmHeader_t *header)
+{
+	int	length;
+
+	length = header->dataOffset + header->dataLength + header->litLength;
+	if(header->vmMagic == VM_MAGIC_VER2)
+		length += header->jtrgLength;
+
+	length = MAX(length, header->codeOffset + header->codeLength);
+
+	return Com_BlockChecksum(header, length);
+}
+
+/*
+=================
+VM_JitCacheName
+=================
+*/
+static void VM_JitCacheName(vm_t *vm, unsigned checksum, char *name, int size)
+{
+	Com_sprintf(name, size, "vmcache/%s-%08x.%s", vm->name, checksum, ARCH_STRING);
+}
+
+/*
+=================
+VM_LoadJitCache
+=================
+*/
+static qboolean VM_LoadJitCache(vm_t *vm, unsigned checksum)
+{
+	char		name[MAX_OSPATH];
+	fileHandle_t	f;
+	jitCacheHeader_t	*h;
+	jitReloc_t	*rel;
+	int		*offsets;
+	byte		*data, *image;
+	long		length, expected;
+	void		*ptr;
+	qboolean	valid;
+	int		i;
+
+	VM_JitCacheName(vm, checksum, name, sizeof(name));
+
+	length = FS_SV_FOpenFileRead(name, &f);
+	if(!f)
+		return qfalse;
+
+	if(length < sizeof(*h))
+	{
+		FS_FCloseFile(f);
+		return qfalse;
+	}
+
+	data = Z_Malloc(length);
+	if(FS_Read(data, length, f) != length)
+	{
+		FS_FCloseFile(f);
+		Z_Free(data);
+		return qfalse;
+	}
+	FS_FCloseFile(f);
+
+	h = (jitCacheHeader_t *) data;
+
+	expected = -1;
+	if(h->ident == JITCACHE_IDENT && h->version == JITCACHE_VERSION
+		&& h->pointerSize == sizeof(void *) && h->checksum == checksum
+		&& h->instructionCount == vm->instructionCount && h->dataMask == vm->dataMask
+		&& h->codeLength > 0 && h->codeLength <= length
+		&& h->numRelocs >= 0 && h->numRelocs <= length / sizeof(*rel)
+		&& h->entryOfs >= 0 && h->entryOfs < h->codeLength)
+	{
+		expected = sizeof(*h) + h->instructionCount * sizeof(*offsets)
+			+ h->numRelocs * sizeof(*rel) + h->codeLength;
+	}
+
+	if(expected != length)
+	{
+		Com_Printf(S_COLOR_YELLOW "Warning: ignoring stale code cache %s\n", name);
+		Z_Free(data);
+		return qfalse;
+	}
+
+	offsets = (int *) (h + 1);
+	rel = (jitReloc_t *) (offsets + h->instructionCount);
+	image = (byte *) (rel + h->numRelocs);
+
+	valid = qtrue;
+	for(i = 0; i < h->instructionCount && valid; i++)
+	{
+		if(offsets[i] < 0 || offsets[i] > h->codeLength)
+			valid = qfalse;
+	}
+
+	for(i = 0; i < h->numRelocs && valid; i++)
+	{
+		if(rel[i].kind < 0 || rel[i].kind >= JREL_NUM_KINDS
+			|| rel[i].offset < 0 || rel[i].offset > h->codeLength - (int) sizeof(ptr))
+			valid = qfalse;
+		else if(rel[i].kind == JREL_DATABASE && (rel[i].addend < 0 || rel[i].addend > vm->dataMask))
+			valid = qfalse;
+		else
+		{
+			ptr = JitRelocTarget(vm, rel[i].kind) + rel[i].addend;
+			Com_Memcpy(image + rel[i].offset, &ptr, sizeof(ptr));
+		}
+	}
+
+	if(!valid)
+	{
+		Com_Printf(S_COLOR_YELLOW "Warning: code cache %s is corrupt\n", name);
+		Z_Free(data);
+		return qfalse;
+	}
+
+	VM_AllocCompiled(vm, image, h->codeLength);
+	vm->entryOfs = h->entryOfs;
+
+	for(i = 0; i < h->instructionCount; i++)
+		vm->instructionPointers[i] = (intptr_t) vm->codeBase + offsets[i];
+
+	Com_Printf("VM file %s loaded %i bytes of code from %s\n", vm->name, h->codeLength, name);
+
+	Z_Free(data);
+	return qtrue;
+}
+
+/*
+=================
+VM_WriteJitCache
+
+Writes the code just compiled into buf, while the instruction
+pointers are still offsets
+=================
+*/
+static void VM_WriteJitCache(vm_t *vm, unsigned checksum)
+{
+	char		name[MAX_OSPATH];
+	fileHandle_t	f;
+	jitCacheHeader_t	h;
+	int		*offsets;
+	int		i;
+
+	if(relocsOverflowed)
+		return;
+
+	VM_JitCacheName(vm, checksum, name, sizeof(name));
+
+	f = FS_SV_FOpenFileWrite(name);
+	if(!f)
+	{
+		Com_DPrintf("Couldn't write code cache %s\n", name);
+		return;
+	}
+
+	h.ident = JITCACHE_IDENT;
+	h.version = JITCACHE_VERSION;
+	h.pointerSize = sizeof(void *);
+	h.checksum = checksum;
+	h.instructionCount = vm->instructionCount;
+	h.dataMask = vm->dataMask;
+	h.entryOfs = vm->entryOfs;
+	h.codeLength = compiledOfs;
+	h.numRelocs = numRelocs;
+
+	offsets = Z_Malloc(vm->instructionCount * sizeof(*offsets));
+	for(i = 0; i < vm->instructionCount; i++)
+		offsets[i] = vm->instructionPointers[i];
+
+	FS_Write(&h, sizeof(h), f);
+	FS_Write(offsets, vm->instructionCount * sizeof(*offsets), f);
+	FS_Write(relocs, numRelocs * sizeof(*relocs), f);
+	FS_Write(buf, compiledOfs, f);
+	FS_FCloseFile(f);
+
+	Z_Free(offsets);
+}
+
 /*
 =================
 VM_Compile
@@ -1073,7 +1456,16 @@ void VM_Compile(vm_t *vm, vmHeader_t *header)
 	int		maxLength;
 	int		v;
 	int		i;
-        int		callProcOfsSyscall, callProcOfs, callDoSyscallOfs;
+        int		callProcOfs, callDoSyscallOfs;
+	int		preambleRelocs;
+	unsigned	checksum;
+	qboolean	useCache;
+
+	useCache = Cvar_VariableIntegerValue("vm_cache");
+	checksum = VM_JitChecksum(vm, header);
+
+	if(useCache && VM_LoadJitCache(vm, checksum))
+		return;
 
 	jusedSize = header->instructionCount + 2;
 
@@ -1082,6 +1474,12 @@ void VM_Compile(vm_t *vm, vmHeader_t *header)
 	buf = Z_Malloc(maxLength);
 	jused = Z_Malloc(jusedSize);
 	code = Z_Malloc(header->codeLength+32);
+
+	// at most one absolute address per instruction, plus the syscall stub
+	maxRelocs = header->instructionCount + 16;
+	relocs = Z_Malloc(maxRelocs * sizeof(*relocs));
+	numRelocs = 0;
+	relocsOverflowed = qfalse;
 	
 	Com_Memset(jused, 0, jusedSize);
 	Com_Memset(buf, 0, maxLength);
@@ -1104,8 +1502,9 @@ void VM_Compile(vm_t *vm, vmHeader_t *header)
 
 	callDoSyscallOfs = compiledOfs;
 	callProcOfs = EmitCallDoSyscall(vm);
-	callProcOfsSyscall = EmitCallProcedure(vm, callDoSyscallOfs);
+	EmitCallProcedure(vm, callDoSyscallOfs);
 	vm->entryOfs = compiledOfs;
+	preambleRelocs = numRelocs;
 
 	for(pass=0; pass < 3; pass++) {
 	oc0 = -23423;
@@ -1118,6 +1517,7 @@ void VM_Compile(vm_t *vm, vmHeader_t *header)
 	instruction = 0;
 	//code = (byte *)header + header->codeOffset;
 	compiledOfs = vm->entryOfs;
+	numRelocs = preambleRelocs;
 
 	LastCommand = LAST_COMMAND_NONE;
 
@@ -1157,7 +1557,7 @@ void VM_Compile(vm_t *vm, vmHeader_t *header)
 			Emit4(Constant4());
 			break;
 		case OP_CONST:
-			if(ConstOptimize(vm, callProcOfsSyscall))
+			if(ConstOptimize(vm, callDoSyscallOfs))
 				break;
 
 			EmitPushStack(vm);
@@ -1187,7 +1587,7 @@ void VM_Compile(vm_t *vm, vmHeader_t *header)
 			EmitRexString(0x41, "89 04 11");		// mov dword ptr [r9 + edx], eax
 #else
 			EmitString("89 82");				// mov dword ptr [edx + 0x12345678], eax
-			Emit4((intptr_t) vm->dataBase);
+			EmitReloc(vm, JREL_DATABASE, 0);
 #endif
 			EmitCommand(LAST_COMMAND_SUB_BL_1);		// sub bl, 1
 			break;
@@ -1225,7 +1625,7 @@ void VM_Compile(vm_t *vm, vmHeader_t *header)
 					EmitRexString(0x41, "FF 04 11");	// inc dword ptr [r9 + edx]
 #else
 					EmitString("FF 82");			// inc dword ptr [edx + 0x12345678]
-					Emit4((intptr_t) vm->dataBase);
+					EmitReloc(vm, JREL_DATABASE, 0);
 #endif
 				}
 				else
@@ -1234,7 +1634,7 @@ void VM_Compile(vm_t *vm, vmHeader_t *header)
 					EmitRexString(0x41, "8B 04 11");	// mov eax, dword ptr [r9 + edx]
 #else
 					EmitString("8B 82");			// mov eax, dword ptr [edx + 0x12345678]
-					Emit4((intptr_t) vm->dataBase);
+					EmitReloc(vm, JREL_DATABASE, 0);
 #endif
 					EmitString("05");			// add eax, v
 					Emit4(v);
@@ -1245,7 +1645,7 @@ void VM_Compile(vm_t *vm, vmHeader_t *header)
 						EmitRexString(0x41, "89 04 11");	// mov dword ptr [r9 + edx], eax
 #else
 						EmitString("89 82");			// mov dword ptr [edx + 0x12345678], eax
-						Emit4((intptr_t) vm->dataBase);
+						EmitReloc(vm, JREL_DATABASE, 0);
 #endif
 					}
 					else
@@ -1257,7 +1657,7 @@ void VM_Compile(vm_t *vm, vmHeader_t *header)
 						EmitRexString(0x41, "89 04 11");	// mov dword ptr [r9 + edx], eax
 #else
 						EmitString("89 82");			// mov dword ptr [edx + 0x12345678], eax
-						Emit4((intptr_t) vm->dataBase);
+						EmitReloc(vm, JREL_DATABASE, 0);
 #endif
 					}
 				}
@@ -1287,7 +1687,7 @@ void VM_Compile(vm_t *vm, vmHeader_t *header)
 					EmitRexString(0x41, "FF 0C 11");	// dec dword ptr [r9 + edx]
 #else
 					EmitString("FF 8A");			// dec dword ptr [edx + 0x12345678]
-					Emit4((intptr_t) vm->dataBase);
+					EmitReloc(vm, JREL_DATABASE, 0);
 #endif
 				}
 				else
@@ -1296,7 +1696,7 @@ void VM_Compile(vm_t *vm, vmHeader_t *header)
 					EmitRexString(0x41, "8B 04 11");	// mov eax, dword ptr [r9 + edx]
 #else
 					EmitString("8B 82");			// mov eax, dword ptr [edx + 0x12345678]
-					Emit4((intptr_t) vm->dataBase);
+					EmitReloc(vm, JREL_DATABASE, 0);
 #endif
 					EmitString("2D");			// sub eax, v
 					Emit4(v);
@@ -1307,7 +1707,7 @@ void VM_Compile(vm_t *vm, vmHeader_t *header)
 						EmitRexString(0x41, "89 04 11");	// mov dword ptr [r9 + edx], eax
 #else
 						EmitString("89 82");			// mov dword ptr [edx + 0x12345678], eax
-						Emit4((intptr_t) vm->dataBase);
+						EmitReloc(vm, JREL_DATABASE, 0);
 #endif
 					}
 					else
@@ -1319,7 +1719,7 @@ void VM_Compile(vm_t *vm, vmHeader_t *header)
 						EmitRexString(0x41, "89 04 11");	// mov dword ptr [r9 + edx], eax
 #else
 						EmitString("89 82");			// mov dword ptr [edx + 0x12345678], eax
-						Emit4((intptr_t) vm->dataBase);
+						EmitReloc(vm, JREL_DATABASE, 0);
 #endif
 					}
 				}
@@ -1339,7 +1739,7 @@ void VM_Compile(vm_t *vm, vmHeader_t *header)
 				EmitRexString(0x41, "8B 04 01");		// mov eax, dword ptr [r9 + eax]
 #else
 				EmitString("8B 80");				// mov eax, dword ptr [eax + 0x1234567]
-				Emit4((intptr_t) vm->dataBase);
+				EmitReloc(vm, JREL_DATABASE, 0);
 #endif
 				EmitCommand(LAST_COMMAND_MOV_STACK_EAX);	// mov dword ptr [edi + ebx * 4], eax
 				break;
@@ -1350,7 +1750,7 @@ void VM_Compile(vm_t *vm, vmHeader_t *header)
 			EmitRexString(0x41, "8B 04 01");		// mov eax, dword ptr [r9 + eax]
 #else
 			EmitString("8B 80");				// mov eax, dword ptr [eax + 0x12345678]
-			Emit4((intptr_t) vm->dataBase);
+			EmitReloc(vm, JREL_DATABASE, 0);
 #endif
 			EmitCommand(LAST_COMMAND_MOV_STACK_EAX);	// mov dword ptr [edi + ebx * 4], eax
 			break;
@@ -1360,7 +1760,7 @@ void VM_Compile(vm_t *vm, vmHeader_t *header)
 			EmitRexString(0x41, "0F B7 04 01");		// movzx eax, word ptr [r9 + eax]
 #else
 			EmitString("0F B7 80");				// movzx eax, word ptr [eax + 0x12345678]
-			Emit4((intptr_t) vm->dataBase);
+			EmitReloc(vm, JREL_DATABASE, 0);
 #endif
 			EmitCommand(LAST_COMMAND_MOV_STACK_EAX);	// mov dword ptr [edi + ebx * 4], eax
 			break;
@@ -1370,7 +1770,7 @@ void VM_Compile(vm_t *vm, vmHeader_t *header)
 			EmitRexString(0x41, "0F B6 04 01");		// movzx eax, byte ptr [r9 + eax]
 #else
 			EmitString("0F B6 80");				// movzx eax, byte ptr [eax + 0x12345678]
-			Emit4((intptr_t) vm->dataBase);
+			EmitReloc(vm, JREL_DATABASE, 0);
 #endif
 			EmitCommand(LAST_COMMAND_MOV_STACK_EAX);	// mov dword ptr [edi + ebx * 4], eax
 			break;
@@ -1382,7 +1782,7 @@ void VM_Compile(vm_t *vm, vmHeader_t *header)
 			EmitRexString(0x41, "89 04 11");		// mov dword ptr [r9 + edx], eax
 #else
 			EmitString("89 82");				// mov dword ptr [edx + 0x12345678], eax
-			Emit4((intptr_t) vm->dataBase);
+			EmitReloc(vm, JREL_DATABASE, 0);
 #endif
 			EmitCommand(LAST_COMMAND_SUB_BL_2);		// sub bl, 2
 			break;
@@ -1395,7 +1795,7 @@ void VM_Compile(vm_t *vm, vmHeader_t *header)
 			EmitRexString(0x41, "89 04 11");
 #else
 			EmitString("66 89 82");				// mov word ptr [edx + 0x12345678], eax
-			Emit4((intptr_t) vm->dataBase);
+			EmitReloc(vm, JREL_DATABASE, 0);
 #endif
 			EmitCommand(LAST_COMMAND_SUB_BL_2);		// sub bl, 2
 			break;
@@ -1407,7 +1807,7 @@ void VM_Compile(vm_t *vm, vmHeader_t *header)
 			EmitRexString(0x41, "88 04 11");		// mov byte ptr [r9 + edx], eax
 #else
 			EmitString("88 82");				// mov byte ptr [edx + 0x12345678], eax
-			Emit4((intptr_t) vm->dataBase);
+			EmitReloc(vm, JREL_DATABASE, 0);
 #endif
 			EmitCommand(LAST_COMMAND_SUB_BL_2);		// sub bl, 2
 			break;
@@ -1474,12 +1874,15 @@ void VM_Compile(vm_t *vm, vmHeader_t *header)
 			break;
 		case OP_ADD:
 			EmitMovEAXStack(vm, 0);				// mov eax, dword ptr [edi + ebx * 4]
-			EmitString("01 44 9F FC");			// add dword ptr -4[edi + ebx * 4], eax
+			EmitString("03 44 9F FC");			// add eax, dword ptr -4[edi + ebx * 4]
+			EmitString("89 44 9F FC");			// mov dword ptr -4[edi + ebx * 4], eax
 			EmitCommand(LAST_COMMAND_SUB_BL_1);		// sub bl, 1
 			break;
 		case OP_SUB:
 			EmitMovEAXStack(vm, 0);				// mov eax, dword ptr [edi + ebx * 4]
-			EmitString("29 44 9F FC");			// sub dword ptr -4[edi + ebx * 4], eax
+			EmitString("F7 D8");				// neg eax
+			EmitString("03 44 9F FC");			// add eax, dword ptr -4[edi + ebx * 4]
+			EmitString("89 44 9F FC");			// mov dword ptr -4[edi + ebx * 4], eax
 			EmitCommand(LAST_COMMAND_SUB_BL_1);		// sub bl, 1
 			break;
 		case OP_DIVI:
@@ -1524,35 +1927,46 @@ void VM_Compile(vm_t *vm, vmHeader_t *header)
 			break;
 		case OP_BAND:
 			EmitMovEAXStack(vm, 0);				// mov eax, dword ptr [edi + ebx * 4]
-			EmitString("21 44 9F FC");			// and dword ptr -4[edi + ebx * 4],eax
+			EmitString("23 44 9F FC");			// and eax, dword ptr -4[edi + ebx * 4]
+			EmitString("89 44 9F FC");			// mov dword ptr -4[edi + ebx * 4], eax
 			EmitCommand(LAST_COMMAND_SUB_BL_1);		// sub bl, 1
 			break;
 		case OP_BOR:
 			EmitMovEAXStack(vm, 0);				// mov eax, dword ptr [edi + ebx * 4]
-			EmitString("09 44 9F FC");			// or dword ptr -4[edi + ebx * 4],eax
+			EmitString("0B 44 9F FC");			// or eax, dword ptr -4[edi + ebx * 4]
+			EmitString("89 44 9F FC");			// mov dword ptr -4[edi + ebx * 4], eax
 			EmitCommand(LAST_COMMAND_SUB_BL_1);		// sub bl, 1
 			break;
 		case OP_BXOR:
 			EmitMovEAXStack(vm, 0);				// mov eax, dword ptr [edi + ebx * 4]
-			EmitString("31 44 9F FC");			// xor dword ptr -4[edi + ebx * 4],eax
+			EmitString("33 44 9F FC");			// xor eax, dword ptr -4[edi + ebx * 4]
+			EmitString("89 44 9F FC");			// mov dword ptr -4[edi + ebx * 4], eax
 			EmitCommand(LAST_COMMAND_SUB_BL_1);		// sub bl, 1
 			break;
 		case OP_BCOM:
-			EmitString("F7 14 9F");				// not dword ptr [edi + ebx * 4]
+			EmitMovEAXStack(vm, 0);				// mov eax, dword ptr [edi + ebx * 4]
+			EmitString("F7 D0");				// not eax
+			EmitCommand(LAST_COMMAND_MOV_STACK_EAX);	// mov dword ptr [edi + ebx * 4], eax
 			break;
 		case OP_LSH:
 			EmitMovECXStack(vm);
-			EmitString("D3 64 9F FC");			// shl dword ptr -4[edi + ebx * 4], cl
+			EmitString("8B 44 9F FC");			// mov eax, dword ptr -4[edi + ebx * 4]
+			EmitString("D3 E0");				// shl eax, cl
+			EmitString("89 44 9F FC");			// mov dword ptr -4[edi + ebx * 4], eax
 			EmitCommand(LAST_COMMAND_SUB_BL_1);		// sub bl, 1
 			break;
 		case OP_RSHI:
 			EmitMovECXStack(vm);
-			EmitString("D3 7C 9F FC");			// sar dword ptr -4[edi + ebx * 4], cl
+			EmitString("8B 44 9F FC");			// mov eax, dword ptr -4[edi + ebx * 4]
+			EmitString("D3 F8");				// sar eax, cl
+			EmitString("89 44 9F FC");			// mov dword ptr -4[edi + ebx * 4], eax
 			EmitCommand(LAST_COMMAND_SUB_BL_1);		// sub bl, 1
 			break;
 		case OP_RSHU:
 			EmitMovECXStack(vm);
-			EmitString("D3 6C 9F FC");			// shr dword ptr -4[edi + ebx * 4], cl
+			EmitString("8B 44 9F FC");			// mov eax, dword ptr -4[edi + ebx * 4]
+			EmitString("D3 E8");				// shr eax, cl
+			EmitString("89 44 9F FC");			// mov dword ptr -4[edi + ebx * 4], eax
 			EmitCommand(LAST_COMMAND_SUB_BL_1);		// sub bl, 1
 			break;
 		case OP_NEGF:
@@ -1596,7 +2010,7 @@ void VM_Compile(vm_t *vm, vmHeader_t *header)
 #else // FTOL_PTR
 			// call the library conversion function
 			EmitRexString(0x48, "BA");			// mov edx, Q_VMftol
-			EmitPtr(Q_VMftol);
+			EmitReloc(vm, JREL_FTOL, 0);
 			EmitRexString(0x48, "FF D2");			// call edx
 			EmitCommand(LAST_COMMAND_MOV_STACK_EAX);	// mov dword ptr [edi + ebx * 4], eax
 #endif
@@ -1632,7 +2046,7 @@ void VM_Compile(vm_t *vm, vmHeader_t *header)
 #else
 			EmitString("73 07");			// jae +7
 			EmitString("FF 24 85");			// jmp dword ptr [instructionPointers + eax * 4]
-			Emit4((intptr_t) vm->instructionPointers);
+			EmitReloc(vm, JREL_INSTRUCTIONS, 0);
 #endif
 			EmitCallErrJump(vm, callDoSyscallOfs);
 			break;
@@ -1645,45 +2059,15 @@ void VM_Compile(vm_t *vm, vmHeader_t *header)
 	}
 	}
 
-	// copy to an exact sized buffer with the appropriate permission bits
-	vm->codeLength = compiledOfs;
-#ifdef VM_X86_MMAP
-	vm->codeBase = mmap(NULL, compiledOfs, PROT_WRITE, MAP_SHARED|MAP_ANONYMOUS, -1, 0);
-	if(vm->codeBase == MAP_FAILED)
-		Com_Error(ERR_FATAL, "VM_CompileX86: can't mmap memory");
-#elif _WIN32
-	// allocate memory with EXECUTE permissions under windows.
-	vm->codeBase = VirtualAlloc(NULL, compiledOfs, MEM_COMMIT, PAGE_EXECUTE_READWRITE);
-	if(!vm->codeBase)
-		Com_Error(ERR_FATAL, "VM_CompileX86: VirtualAlloc failed");
-#else
-	vm->codeBase = malloc(compiledOfs);
-	if(!vm->codeBase)
-	        Com_Error(ERR_FATAL, "VM_CompileX86: malloc failed");
-#endif
-
-	Com_Memcpy( vm->codeBase, buf, compiledOfs );
+	VM_AllocCompiled(vm, buf, compiledOfs);
 
-#ifdef VM_X86_MMAP
-	if(mprotect(vm->codeBase, compiledOfs, PROT_READ|PROT_EXEC))
-		Com_Error(ERR_FATAL, "VM_CompileX86: mprotect failed");
-#elif _WIN32
-	{
-		DWORD oldProtect = 0;
-		
-		// remove write permissions.
-		if(!VirtualProtect(vm->codeBase, compiledOfs, PAGE_EXECUTE_READ, &oldProtect))
-			Com_Error(ERR_FATAL, "VM_CompileX86: VirtualProtect failed");
-	}
-#endif
+	if(useCache)
+		VM_WriteJitCache(vm, checksum);
 
 	Z_Free( code );
-	Z_Free( buf );
-	Z_Free( jused );
+	VMFREE_BUFFERS();
 	Com_Printf( "VM file %s compiled to %i bytes of code\n", vm->name, compiledOfs );
 
-	vm->destroy = VM_Destroy_Compiled;
-
 	// offset all the instruction pointers for the new location
 	for ( i = 0 ; i < header->instructionCount ; i++ ) {
 		vm->instructionPointers[i] += (intptr_t) vm->codeBase;
@@ -60,7 +60,11 @@ typedef struct image_s {
 	imgType_t   type;
 	imgFlags_t  flags;
 
+	unsigned	contentCrc;				// from the pk3 the image came from, 0 if none
+	int			contentLength;
+
 	struct image_s*	next;
+	struct image_s*	nextContent;
 } image_t;
 
 // any change in the LIGHTMAP_* defines here MUST be reflected in
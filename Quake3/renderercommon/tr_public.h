@@ -24,7 +24,7 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 
 #include "tr_types.h"
 
-#define	REF_API_VERSION		8
+#define	REF_API_VERSION		10
 
 //
 // these are the functions exported by the refresh module
@@ -159,6 +159,8 @@ typedef struct {
 	void	(*FS_FreeFileList)( char **filelist );
 	void	(*FS_WriteFile)( const char *qpath, const void *buffer, int size );
 	qboolean (*FS_FileExists)( const char *file );
+	qboolean	(*FS_PrefetchFile)( const char *name );
+	long	(*FS_FileContentKey)( const char *name, unsigned *crc );
 
 	// cinematic stuff
 	void	(*CIN_UploadCinematic)(int handle);
@@ -1434,6 +1434,37 @@ static	void R_LoadNodesAndLeafs (lump_t *nodeLump, lump_t *leafLump) {
 
 //=============================================================================
 
+/*
+=================
+R_PrefetchShaderImages
+
+Shaders without a script load a single image of the same name, start
+reading it before the surfaces ask for it.  Every image format R_LoadImage
+tries before the one that exists costs a lookup.
+=================
+*/
+static	void R_PrefetchShaderImages( lump_t *l ) {
+	int		i, count;
+	dshader_t	*in;
+	char	strippedName[MAX_QPATH];
+
+	in = (void *)(fileBase + l->fileofs);
+	if (l->filelen % sizeof(*in))
+		return;
+	count = l->filelen / sizeof(*in);
+
+	for ( i=0 ; i<count ; i++ ) {
+		if ( !Q_stricmp( in[i].shader, "noshader" ) ) {
+			continue;
+		}
+		COM_StripExtension( in[i].shader, strippedName, sizeof( strippedName ) );
+		if ( R_ShaderHasScript( strippedName ) ) {
+			continue;
+		}
+		R_PrefetchImage( in[i].shader );
+	}
+}
+
 /*
 =================
 R_LoadShaders
@@ -1847,6 +1878,8 @@ void RE_LoadWorldMap( const char *name ) {
 		((int *)header)[i] = LittleLong ( ((int *)header)[i]);
 	}
 
+	R_PrefetchShaderImages( &header->lumps[LUMP_SHADERS] );
+
 	// load into heap
 	R_LoadShaders( &header->lumps[LUMP_SHADERS] );
 	R_LoadLightmaps( &header->lumps[LUMP_LIGHTMAPS] );
@@ -31,6 +31,19 @@ int		gl_filter_max = GL_LINEAR;
 #define FILE_HASH_SIZE		1024
 static	image_t*		hashTable[FILE_HASH_SIZE];
 
+// images with the same pk3 contents under different names share a texture,
+// the other names are remembered so they don't have to be looked up again
+typedef struct imageAlias_s {
+	char					name[MAX_QPATH];
+	image_t					*image;
+	struct imageAlias_s		*next;
+} imageAlias_t;
+
+static	image_t*		contentHashTable[FILE_HASH_SIZE];
+static	imageAlias_t*	aliasHashTable[FILE_HASH_SIZE];
+static	int				numSharedImages;
+static	int				sharedImageBytes;
+
 /*
 ** R_GammaCorrect
 */
@@ -279,7 +292,8 @@ void R_ImageList_f( void ) {
 
 	ri.Printf (PRINT_ALL, " ---------\n");
 	ri.Printf (PRINT_ALL, " approx %i bytes\n", estTotalSize);
-	ri.Printf (PRINT_ALL, " %i total images\n\n", tr.numImages );
+	ri.Printf (PRINT_ALL, " %i total images\n", tr.numImages );
+	ri.Printf (PRINT_ALL, " %i shared by contents, approx %i bytes not uploaded\n\n", numSharedImages, sharedImageBytes );
 }
 
 //=======================================================================
@@ -1194,6 +1208,104 @@ void R_LoadImage( const char *name, byte **pic, int *width, int *height )
 }
 
 
+/*
+===============
+R_ImageContentKey
+
+Finds the file R_LoadImage would load for name, and the contents key of
+it when it comes from a pk3.
+===============
+*/
+static qboolean R_ImageContentKey( const char *name, unsigned *crc, int *length )
+{
+	int orgLoader = -1;
+	int i;
+	long len;
+	char localName[ MAX_QPATH ];
+	const char *ext;
+
+	Q_strncpyz( localName, name, MAX_QPATH );
+
+	ext = COM_GetExtension( localName );
+
+	if( *ext )
+	{
+		for( i = 0; i < numImageLoaders; i++ )
+		{
+			if( !Q_stricmp( ext, imageLoaders[ i ].ext ) )
+			{
+				orgLoader = i;
+				len = ri.FS_FileContentKey( localName, crc );
+				if( len >= 0 )
+				{
+					*length = len;
+					return *crc != 0;
+				}
+				COM_StripExtension( name, localName, MAX_QPATH );
+				break;
+			}
+		}
+	}
+
+	for( i = 0; i < numImageLoaders; i++ )
+	{
+		if (i == orgLoader)
+			continue;
+
+		len = ri.FS_FileContentKey( va( "%s.%s", localName, imageLoaders[ i ].ext ), crc );
+		if( len >= 0 )
+		{
+			*length = len;
+			return *crc != 0;
+		}
+	}
+
+	return qfalse;
+}
+
+/*
+===============
+R_PrefetchImage
+
+Starts reading the one file R_LoadImage will load for name
+===============
+*/
+void R_PrefetchImage( const char *name )
+{
+	int orgLoader = -1;
+	int i;
+	char localName[ MAX_QPATH ];
+	const char *ext;
+
+	Q_strncpyz( localName, name, MAX_QPATH );
+
+	ext = COM_GetExtension( localName );
+
+	if( *ext )
+	{
+		for( i = 0; i < numImageLoaders; i++ )
+		{
+			if( !Q_stricmp( ext, imageLoaders[ i ].ext ) )
+			{
+				orgLoader = i;
+				if( ri.FS_PrefetchFile( localName ) )
+					return;
+				COM_StripExtension( name, localName, MAX_QPATH );
+				break;
+			}
+		}
+	}
+
+	for( i = 0; i < numImageLoaders; i++ )
+	{
+		if (i == orgLoader)
+			continue;
+
+		if( ri.FS_PrefetchFile( va( "%s.%s", localName, imageLoaders[ i ].ext ) ) )
+			return;
+	}
+}
+
 /*
 ===============
 R_FindImageFile
@@ -1208,6 +1320,10 @@ image_t	*R_FindImageFile( const char *name, imgType_t type, imgFlags_t flags )
 	int		width, height;
 	byte	*pic;
 	long	hash;
+	unsigned	crc;
+	int		length;
+	qboolean	haveKey;
+	imageAlias_t	*alias;
 
 	if (!name) {
 		return NULL;
@@ -1230,6 +1346,34 @@ image_t	*R_FindImageFile( const char *name, imgType_t type, imgFlags_t flags )
 		}
 	}
 
+	for (alias=aliasHashTable[hash]; alias; alias=alias->next) {
+		if ( !strcmp( name, alias->name ) &&
+			alias->image->type == type && alias->image->flags == flags ) {
+			return alias->image;
+		}
+	}
+
+	//
+	// the same file may have been loaded under another name
+	//
+	haveKey = R_ImageContentKey( name, &crc, &length );
+	if ( haveKey ) {
+		for (image=contentHashTable[crc & (FILE_HASH_SIZE-1)]; image; image=image->nextContent) {
+			if ( image->contentCrc == crc && image->contentLength == length &&
+				image->type == type && image->flags == flags ) {
+				numSharedImages++;
+				sharedImageBytes += image->uploadWidth * image->uploadHeight * 4;
+
+				alias = ri.Hunk_Alloc( sizeof( *alias ), h_low );
+				Q_strncpyz( alias->name, name, sizeof( alias->name ) );
+				alias->image = image;
+				alias->next = aliasHashTable[hash];
+				aliasHashTable[hash] = alias;
+				return image;
+			}
+		}
+	}
+
 	//
 	// load the pic from disk
 	//
@@ -1240,6 +1384,13 @@ image_t	*R_FindImageFile( const char *name, imgType_t type, imgFlags_t flags )
 
 	image = R_CreateImage( ( char * ) name, pic, width, height, type, flags, 0 );
 	ri.Free( pic );
+
+	if ( haveKey ) {
+		image->contentCrc = crc;
+		image->contentLength = length;
+		image->nextContent = contentHashTable[crc & (FILE_HASH_SIZE-1)];
+		contentHashTable[crc & (FILE_HASH_SIZE-1)] = image;
+	}
 	return image;
 }
 
@@ -1528,6 +1679,10 @@ R_InitImages
 */
 void	R_InitImages( void ) {
 	Com_Memset(hashTable, 0, sizeof(hashTable));
+	Com_Memset(contentHashTable, 0, sizeof(contentHashTable));
+	Com_Memset(aliasHashTable, 0, sizeof(aliasHashTable));
+	numSharedImages = 0;
+	sharedImageBytes = 0;
 	// build brightness translation tables
 	R_SetColorMappings();
 
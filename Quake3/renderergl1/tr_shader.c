@@ -2384,6 +2384,32 @@ static shader_t *FinishShader( void ) {
 
 //========================================================================================
 
+/*
+====================
+R_ShaderHasScript
+
+True if a shader file defines name.  Only the hash is looked at, every
+shader ScanAndLoadShaderFiles found is in it.
+====================
+*/
+qboolean R_ShaderHasScript( const char *name ) {
+	char	*p;
+	int		i, hash;
+
+	hash = generateHashValue(name, MAX_SHADERTEXT_HASH);
+
+	if ( !shaderTextHashTable[hash] ) {
+		return qfalse;
+	}
+	for ( i = 0; shaderTextHashTable[hash][i]; i++ ) {
+		p = shaderTextHashTable[hash][i];
+		if ( !Q_stricmp( COM_ParseExt( &p, qtrue ), name ) ) {
+			return qtrue;
+		}
+	}
+	return qfalse;
+}
+
 /*
 ====================
 FindShaderInShaderText
@@ -2971,6 +2997,15 @@ static void ScanAndLoadShaderFiles( void )
 		numShaderFiles = MAX_SHADER_FILES;
 	}
 
+	// start reading all of them, so inflating overlaps with the parsing below
+	for ( i = 0; i < numShaderFiles; i++ )
+	{
+		char filename[MAX_QPATH];
+
+		Com_sprintf( filename, sizeof( filename ), "scripts/%s", shaderFiles[i] );
+		ri.FS_PrefetchFile( filename );
+	}
+
 	// load and parse shader files
 	for ( i = 0; i < numShaderFiles; i++ )
 	{
@@ -48,16 +48,22 @@ typedef struct voipServerPacket_s
 } voipServerPacket_t;
 #endif
 
+// an entity's place in the world spatial index, see sv_world.c
+typedef struct worldLink_s {
+	struct worldLink_s	*prev, *next;
+	void		*node;				// NULL when not linked
+	int			number;
+	vec3_t		absmin, absmax;		// bounds the entity was linked with
+} worldLink_t;
+
 typedef struct svEntity_s {
-	struct worldSector_s *worldSector;
-	struct svEntity_s *nextEntityInWorldSector;
+	worldLink_t	worldLink;
 	
 	entityState_t	baseline;		// for delta compression of initial sighting
 	int			numClusters;		// if -1, use headnode instead
 	int			clusternums[MAX_ENT_CLUSTERS];
 	int			lastCluster;		// if all the clusters don't fit in clusternums
 	int			areanum, areanum2;
-	int			snapshotCounter;	// used to prevent double adding from portal views
 } svEntity_t;
 
 typedef enum {
@@ -75,7 +81,6 @@ typedef struct {
 	// https://zerowing.idsoftware.com/bugzilla/show_bug.cgi?id=475
 	// the serverId associated with the current checksumFeed (always <= serverId)
 	int       checksumFeedServerId;	
-	int				snapshotCounter;	// incremented for each snapshot built
 	int				timeResidual;		// <= 1000 / sv_frame->value
 	int				nextFrameTime;		// when time > nextFrameTime, process world
 	char			*configstrings[MAX_CONFIGSTRINGS];
@@ -238,6 +243,7 @@ typedef struct {
 	int			numSnapshotEntities;		// sv_maxclients->integer*PACKET_BACKUP*MAX_SNAPSHOT_ENTITIES
 	int			nextSnapshotEntities;		// next snapshotEntities to use
 	entityState_t	*snapshotEntities;		// [numSnapshotEntities]
+	unsigned	*snapshotEntityHashes;		// [numSnapshotEntities] for the delta cache
 	int			nextHeartbeatTime;
 	challenge_t	challenges[MAX_CHALLENGES];	// to prevent invalid IPs from connecting
 	netadr_t	redirectAddress;			// for rcon return messages
@@ -245,6 +251,13 @@ typedef struct {
 	netadr_t	authorizeAddress;			// authorize server address
 #endif
 	int			masterResolveTime[MAX_MASTER_SERVERS]; // next svs.time that server should do dns lookup for master server
+	// vmbench and vmdiff state, an error ends in SV_Shutdown, which frees
+	// and clears it
+	qboolean	fixedGameSeed;				// the same level on every vmdiff run
+	qboolean	forceGameInterpret;			// load the game with gameInterpret instead of vm_game
+	vmInterpret_t	gameInterpret;
+	unsigned	*vmDiffSums;				// data checksum after every frame of the first run
+	byte		*vmDiffReference;			// data after the last frame of the first run
 } serverStatic_t;
 
 #define SERVER_MAXBANS	1024
@@ -278,6 +291,10 @@ extern	cvar_t	*sv_master[MAX_MASTER_SERVERS];
 extern	cvar_t	*sv_reconnectlimit;
 extern	cvar_t	*sv_showloss;
 extern	cvar_t	*sv_padPackets;
+extern	cvar_t	*sv_speeds;
+extern	cvar_t	*sv_worldIndex;
+extern	cvar_t	*sv_traceCache;
+extern	cvar_t	*sv_deltaCache;
 extern	cvar_t	*sv_killserver;
 extern	cvar_t	*sv_mapname;
 extern	cvar_t	*sv_mapChecksum;
@@ -400,6 +417,9 @@ void SV_WriteFrameToClient (client_t *client, msg_t *msg);
 void SV_SendMessageToClient( msg_t *msg, client_t *client );
 void SV_SendClientMessages( void );
 void SV_SendClientSnapshot( client_t *client );
+void SV_InitDeltaCache( void );
+void SV_ShutdownDeltaCache( void );
+void SV_DeltaCache_f( void );
 
 //
 // sv_game.c
@@ -413,6 +433,8 @@ void		SV_InitGameProgs ( void );
 void		SV_ShutdownGameProgs ( void );
 void		SV_RestartGameProgs( void );
 qboolean	SV_inPVS (const vec3_t p1, const vec3_t p2);
+void		SV_VMBench_f( void );
+void		SV_VMDiff_f( void );
 
 //
 // sv_bot.c
@@ -426,6 +448,9 @@ int			SV_BotLibSetup( void );
 int			SV_BotLibShutdown( void );
 int			SV_BotGetSnapshotEntity( int client, int ent );
 int			SV_BotGetConsoleMessage( int client, char *buf, int size );
+void		SV_RouteBench_f( void );
+void		SV_AASRecord_f( void );
+void		SV_AASBench_f( void );
 
 int BotImport_DebugPolygonCreate(int color, int numPoints, vec3_t *points);
 void BotImport_DebugPolygonDelete(int id);
@@ -456,6 +481,12 @@ clipHandle_t SV_ClipHandleForEntity( const sharedEntity_t *ent );
 
 
 void SV_SectorList_f( void );
+void SV_WorldRecord_f( void );
+void SV_WorldBench_f( void );
+void SV_TraceRecord_f( void );
+void SV_TraceBench_f( void );
+void SV_TraceCache_f( void );
+void SV_ClearTraceCache( void );
 
 
 int SV_AreaEntities( const vec3_t mins, const vec3_t maxs, int *entityList, int maxcount );
@@ -417,6 +417,42 @@ static void BotImport_DebugLineShow(int line, vec3_t start, vec3_t end, int colo
 	BotImport_DebugPolygonShow(line, color, 4, points);
 }
 
+/*
+==================
+BotImport_CreateMutex
+==================
+*/
+static void *BotImport_CreateMutex(void) {
+	return Sys_CreateMutex();
+}
+
+/*
+==================
+BotImport_DestroyMutex
+==================
+*/
+static void BotImport_DestroyMutex(void *mutex) {
+	Sys_DestroyMutex((sysMutex_t *)mutex);
+}
+
+/*
+==================
+BotImport_LockMutex
+==================
+*/
+static void BotImport_LockMutex(void *mutex) {
+	Sys_LockMutex((sysMutex_t *)mutex);
+}
+
+/*
+==================
+BotImport_UnlockMutex
+==================
+*/
+static void BotImport_UnlockMutex(void *mutex) {
+	Sys_UnlockMutex((sysMutex_t *)mutex);
+}
+
 /*
 ==================
 SV_BotClientCommand
@@ -438,6 +474,83 @@ void SV_BotFrame( int time ) {
 	VM_Call( gvm, BOTAI_START_FRAME, time );
 }
 
+/*
+==================
+SV_RouteBench_f
+
+Compares the goal directed route search with the routing cache updates
+for random routes on the next bot frame
+==================
+*/
+void SV_RouteBench_f( void ) {
+	if ( !bot_enable || !botlib_export ) {
+		Com_Printf( "Bots are not enabled.\n" );
+		return;
+	}
+
+	if ( sv.state != SS_GAME ) {
+		Com_Printf( "Server is not running.\n" );
+		return;
+	}
+
+	botlib_export->BotLibVarSet( "routesearchbench", Cmd_Argc() > 1 ? Cmd_Argv( 1 ) : "1000" );
+}
+
+/*
+==================
+SV_AASRecord_f
+
+Records the AAS point and trace queries of the bots and the game to
+aasrecords/<name>.arec, without a name stops recording
+==================
+*/
+void SV_AASRecord_f( void ) {
+	if ( !bot_enable || !botlib_export ) {
+		Com_Printf( "Bots are not enabled.\n" );
+		return;
+	}
+
+	if ( Cmd_Argc() > 2 ) {
+		Com_Printf( "Usage: aasrecord <name>, without a name stops recording\n" );
+		return;
+	}
+
+	if ( Cmd_Argc() == 2 && sv.state != SS_GAME ) {
+		Com_Printf( "Server is not running.\n" );
+		return;
+	}
+
+	botlib_export->BotLibVarSet( "aasrecord", Cmd_Argc() == 2 ? Cmd_Argv( 1 ) : "" );
+}
+
+/*
+==================
+SV_AASBench_f
+
+Replays recorded AAS queries with and without the area grid on the next
+bot frame
+==================
+*/
+void SV_AASBench_f( void ) {
+	if ( !bot_enable || !botlib_export ) {
+		Com_Printf( "Bots are not enabled.\n" );
+		return;
+	}
+
+	if ( Cmd_Argc() < 2 ) {
+		Com_Printf( "Usage: aasbench <name> [passes]\n" );
+		return;
+	}
+
+	if ( sv.state != SS_GAME ) {
+		Com_Printf( "Server is not running.\n" );
+		return;
+	}
+
+	botlib_export->BotLibVarSet( "aasbenchpasses", Cmd_Argc() > 2 ? Cmd_Argv( 2 ) : "1" );
+	botlib_export->BotLibVarSet( "aasbench", Cmd_Argv( 1 ) );
+}
+
 /*
 ===============
 SV_BotLibSetup
@@ -454,6 +567,9 @@ int SV_BotLibSetup( void ) {
 	}
 
 	botlib_export->BotLibVarSet( "basegame", com_basegame->string );
+	botlib_export->BotLibVarSet( "routetables", Cvar_VariableString( "bot_routetables" ) );
+	botlib_export->BotLibVarSet( "warmroutingcache", Cvar_VariableString( "bot_warmroutingcache" ) );
+	botlib_export->BotLibVarSet( "routesearch", Cvar_VariableString( "bot_routesearch" ) );
 
 	return botlib_export->BotLibSetup();
 }
@@ -494,6 +610,9 @@ void SV_BotInitCvars(void) {
 	Cvar_Get("bot_forcewrite", "0", 0);					//force writing aas file
 	Cvar_Get("bot_aasoptimize", "0", 0);				//no aas file optimisation
 	Cvar_Get("bot_saveroutingcache", "0", 0);			//save routing cache
+	Cvar_Get("bot_routetables", "1", 0);				//route tables, 2 also writes them
+	Cvar_Get("bot_warmroutingcache", "1", 0);			//warm and save the routing cache at map start
+	Cvar_Get("bot_routesearch", "1", 0);				//search for routes without a routing cache
 	Cvar_Get("bot_thinktime", "100", CVAR_CHEAT);		//msec the bots thinks
 	Cvar_Get("bot_reloadcharacters", "0", 0);			//reload the bot characters each time
 	Cvar_Get("bot_testichat", "0", 0);					//test ichats
@@ -557,6 +676,14 @@ void SV_BotInitBotLib(void) {
 	botlib_import.DebugPolygonCreate = BotImport_DebugPolygonCreate;
 	botlib_import.DebugPolygonDelete = BotImport_DebugPolygonDelete;
 
+	//worker threads, routing caches are built on them
+	botlib_import.CreateMutex = BotImport_CreateMutex;
+	botlib_import.DestroyMutex = BotImport_DestroyMutex;
+	botlib_import.LockMutex = BotImport_LockMutex;
+	botlib_import.UnlockMutex = BotImport_UnlockMutex;
+	botlib_import.NumWorkers = Com_NumWorkers;
+	botlib_import.RunJobs = Com_RunJobs;
+
 	botlib_export = (botlib_export_t *)GetBotLibAPI( BOTLIB_API_VERSION, &botlib_import );
 	assert(botlib_export); 	// somehow we end up with a zero import.
 }
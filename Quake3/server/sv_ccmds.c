@@ -1544,6 +1544,17 @@ void SV_AddOperatorCommands( void ) {
 	Cmd_AddCommand ("dumpuser", SV_DumpUser_f);
 	Cmd_AddCommand ("map_restart", SV_MapRestart_f);
 	Cmd_AddCommand ("sectorlist", SV_SectorList_f);
+	Cmd_AddCommand ("worldrecord", SV_WorldRecord_f);
+	Cmd_AddCommand ("worldbench", SV_WorldBench_f);
+	Cmd_AddCommand ("tracerecord", SV_TraceRecord_f);
+	Cmd_AddCommand ("tracebench", SV_TraceBench_f);
+	Cmd_AddCommand ("tracecache", SV_TraceCache_f);
+	Cmd_AddCommand ("deltacache", SV_DeltaCache_f);
+	Cmd_AddCommand ("vmbench", SV_VMBench_f);
+	Cmd_AddCommand ("vmdiff", SV_VMDiff_f);
+	Cmd_AddCommand ("routebench", SV_RouteBench_f);
+	Cmd_AddCommand ("aasrecord", SV_AASRecord_f);
+	Cmd_AddCommand ("aasbench", SV_AASBench_f);
 	Cmd_AddCommand ("map", SV_Map_f);
 	Cmd_SetCommandCompletionFunc( "map", SV_CompleteMapName );
 #ifndef PRE_RELEASE_DEMO
@@ -1593,6 +1604,12 @@ void SV_RemoveOperatorCommands( void ) {
 	Cmd_RemoveCommand ("dumpuser");
 	Cmd_RemoveCommand ("map_restart");
 	Cmd_RemoveCommand ("sectorlist");
+	Cmd_RemoveCommand ("worldrecord");
+	Cmd_RemoveCommand ("worldbench");
+	Cmd_RemoveCommand ("tracerecord");
+	Cmd_RemoveCommand ("tracebench");
+	Cmd_RemoveCommand ("tracecache");
+	Cmd_RemoveCommand ("deltacache");
 	Cmd_RemoveCommand ("say");
 #endif
 }
@@ -274,6 +274,102 @@ void SV_GetUsercmd( int clientNum, usercmd_t *cmd ) {
 	*cmd = svs.clients[clientNum].lastUsercmd;
 }
 
+/*
+===============
+Direct imports
+
+Native game modules call these instead of going through VM_DllSyscall
+and SV_GameSystemCalls, see GAME_DIRECT_IMPORTS.  They are still
+accounted to their syscall numbers for vmprofile.
+===============
+*/
+
+#define	DIRECT_BEGIN()			int64_t	directStart = prof_active ? Sys_Microseconds() : 0
+#define	DIRECT_END( callnum )	do { if ( prof_active ) VM_SyscallProfile( gvm, callnum, directStart ); } while ( 0 )
+
+static void SV_DirectTrace( trace_t *results, const vec3_t start, const vec3_t mins, const vec3_t maxs, const vec3_t end, int passEntityNum, int contentmask ) {
+	DIRECT_BEGIN();
+	SV_Trace( results, start, (float *)mins, (float *)maxs, end, passEntityNum, contentmask, qfalse );
+	DIRECT_END( G_TRACE );
+}
+
+static void SV_DirectTraceCapsule( trace_t *results, const vec3_t start, const vec3_t mins, const vec3_t maxs, const vec3_t end, int passEntityNum, int contentmask ) {
+	DIRECT_BEGIN();
+	SV_Trace( results, start, (float *)mins, (float *)maxs, end, passEntityNum, contentmask, qtrue );
+	DIRECT_END( G_TRACECAPSULE );
+}
+
+static int SV_DirectPointContents( const vec3_t point, int passEntityNum ) {
+	int		contents;
+	DIRECT_BEGIN();
+	contents = SV_PointContents( point, passEntityNum );
+	DIRECT_END( G_POINT_CONTENTS );
+	return contents;
+}
+
+static qboolean SV_DirectInPVS( const vec3_t p1, const vec3_t p2 ) {
+	qboolean	visible;
+	DIRECT_BEGIN();
+	visible = SV_inPVS( p1, p2 );
+	DIRECT_END( G_IN_PVS );
+	return visible;
+}
+
+static void SV_DirectLinkEntity( sharedEntity_t *ent ) {
+	DIRECT_BEGIN();
+	SV_LinkEntity( ent );
+	DIRECT_END( G_LINKENTITY );
+}
+
+static void SV_DirectUnlinkEntity( sharedEntity_t *ent ) {
+	DIRECT_BEGIN();
+	SV_UnlinkEntity( ent );
+	DIRECT_END( G_UNLINKENTITY );
+}
+
+static int SV_DirectEntitiesInBox( const vec3_t mins, const vec3_t maxs, int *list, int maxcount ) {
+	int		count;
+	DIRECT_BEGIN();
+	count = SV_AreaEntities( mins, maxs, list, maxcount );
+	DIRECT_END( G_ENTITIES_IN_BOX );
+	return count;
+}
+
+static qboolean SV_DirectEntityContact( const vec3_t mins, const vec3_t maxs, const sharedEntity_t *ent ) {
+	qboolean	touch;
+	DIRECT_BEGIN();
+	touch = SV_EntityContact( (float *)mins, (float *)maxs, ent, qfalse );
+	DIRECT_END( G_ENTITY_CONTACT );
+	return touch;
+}
+
+static qboolean SV_DirectEntityContactCapsule( const vec3_t mins, const vec3_t maxs, const sharedEntity_t *ent ) {
+	qboolean	touch;
+	DIRECT_BEGIN();
+	touch = SV_EntityContact( (float *)mins, (float *)maxs, ent, qtrue );
+	DIRECT_END( G_ENTITY_CONTACTCAPSULE );
+	return touch;
+}
+
+static void SV_DirectGetUsercmd( int clientNum, usercmd_t *cmd ) {
+	DIRECT_BEGIN();
+	SV_GetUsercmd( clientNum, cmd );
+	DIRECT_END( G_GET_USERCMD );
+}
+
+static const gameDirectImports_t	sv_directImports = {
+	SV_DirectTrace,
+	SV_DirectTraceCapsule,
+	SV_DirectPointContents,
+	SV_DirectInPVS,
+	SV_DirectLinkEntity,
+	SV_DirectUnlinkEntity,
+	SV_DirectEntitiesInBox,
+	SV_DirectEntityContact,
+	SV_DirectEntityContactCapsule,
+	SV_DirectGetUsercmd
+};
+
 //==============================================
 
 static int	FloatAsInt( float f ) {
@@ -428,6 +524,13 @@ intptr_t SV_GameSystemCalls( intptr_t *args ) {
 	case G_SNAPVECTOR:
 		Q_SnapVector(VMA(1));
 		return 0;
+	case G_DIRECT_IMPORTS:
+		// a qvm can't call into the engine directly
+		if ( VM_Type( gvm ) != VMI_NATIVE || args[2] != GAME_DIRECT_IMPORTS_VERSION ) {
+			return 0;
+		}
+		Com_Memcpy( VMA(1), &sv_directImports, sizeof( sv_directImports ) );
+		return 1;
 
 		//====================================
 
@@ -452,11 +555,25 @@ intptr_t SV_GameSystemCalls( intptr_t *args ) {
 		return botlib_export->PC_SourceFileAndLine( args[1], VMA(2), VMA(3) );
 
 	case BOTLIB_START_FRAME:
-		return botlib_export->BotLibStartFrame( VMF(1) );
+		{
+			int		r;
+
+			PROF_BEGIN( PROF_BOTLIB_UPDATE );
+			r = botlib_export->BotLibStartFrame( VMF(1) );
+			PROF_END( PROF_BOTLIB_UPDATE );
+			return r;
+		}
 	case BOTLIB_LOAD_MAP:
 		return botlib_export->BotLibLoadMap( VMA(1) );
 	case BOTLIB_UPDATENTITY:
-		return botlib_export->BotLibUpdateEntity( args[1], VMA(2) );
+		{
+			int		r;
+
+			PROF_BEGIN( PROF_BOTLIB_UPDATE );
+			r = botlib_export->BotLibUpdateEntity( args[1], VMA(2) );
+			PROF_END( PROF_BOTLIB_UPDATE );
+			return r;
+		}
 	case BOTLIB_TEST:
 		return botlib_export->Test( args[1], VMA(2), VMA(3), VMA(4) );
 
@@ -885,10 +1002,15 @@ static void SV_InitGameVM( qboolean restart ) {
 	for ( i = 0 ; i < sv_maxclients->integer ; i++ ) {
 		svs.clients[i].gentity = NULL;
 	}
+
+	// offer native modules the hot syscalls as plain calls
+	if ( VM_Type( gvm ) == VMI_NATIVE && VM_Call( gvm, GAME_DIRECT_IMPORTS, GAME_DIRECT_IMPORTS_VERSION ) == 1 ) {
+		Com_DPrintf( "Game module uses direct imports\n" );
+	}
 	
 	// use the current msec count for a random seed
 	// init for this gamestate
-	VM_Call (gvm, GAME_INIT, sv.time, Com_Milliseconds(), restart);
+	VM_Call (gvm, GAME_INIT, sv.time, svs.fixedGameSeed ? 1 : Com_Milliseconds(), restart);
 }
 
 
@@ -925,6 +1047,7 @@ Called on a normal map change, not on a map_restart
 */
 void SV_InitGameProgs( void ) {
 	cvar_t	*var;
+	vmInterpret_t	interpret;
 	//FIXME these are temp while I make bots run in vm
 	extern int	bot_enable;
 
@@ -936,8 +1059,14 @@ void SV_InitGameProgs( void ) {
 		bot_enable = 0;
 	}
 
-	// load the dll or bytecode
-	gvm = VM_Create( "qagame", SV_GameSystemCalls, Cvar_VariableValue( "vm_game" ) );
+	// load the dll or bytecode, the vm tests pick it without touching the
+	// archived vm_game
+	if ( svs.forceGameInterpret ) {
+		interpret = svs.gameInterpret;
+	} else {
+		interpret = Cvar_VariableValue( "vm_game" );
+	}
+	gvm = VM_Create( "qagame", SV_GameSystemCalls, interpret );
 	if ( !gvm ) {
 		Com_Error( ERR_FATAL, "VM_Create on game failed" );
 	}
@@ -946,6 +1075,173 @@ void SV_InitGameProgs( void ) {
 }
 
 
+/*
+===============
+SV_VMBench_f
+
+Loads the current map again with the game module interpreted, compiled
+and native, and times the same number of game frames from the start of
+the level on each.  The map is loaded the normal way afterwards, so this
+is best run without clients.
+===============
+*/
+void SV_VMBench_f( void ) {
+	static const vmInterpret_t	modes[] = { VMI_BYTECODE, VMI_COMPILED, VMI_NATIVE };
+	static const char			*modeNames[] = { "native", "interpreted", "compiled" };
+	char			mapname[MAX_QPATH];
+	vmInterpret_t	loaded[ARRAY_LEN( modes )];
+	int64_t			usec[ARRAY_LEN( modes )];
+	int64_t			start;
+	int				frames, frameMsec, i, f;
+
+	if ( sv.state != SS_GAME ) {
+		Com_Printf( "Server is not running.\n" );
+		return;
+	}
+
+	frames = 1000;
+	if ( Cmd_Argc() > 1 ) {
+		frames = atoi( Cmd_Argv( 1 ) );
+		if ( frames < 1 ) {
+			frames = 1;
+		}
+	}
+	frameMsec = 1000 / MAX( sv_fps->integer, 1 );
+
+	Q_strncpyz( mapname, sv_mapname->string, sizeof( mapname ) );
+
+	svs.forceGameInterpret = qtrue;
+	for ( i = 0 ; i < ARRAY_LEN( modes ) ; i++ ) {
+		svs.gameInterpret = modes[i];
+		SV_SpawnServer( mapname, qfalse );
+		loaded[i] = VM_Type( gvm );
+
+		start = Sys_Microseconds();
+		for ( f = 0 ; f < frames ; f++ ) {
+			sv.time += frameMsec;
+			VM_Call( gvm, GAME_RUN_FRAME, sv.time );
+		}
+		usec[i] = Sys_Microseconds() - start;
+	}
+
+	svs.forceGameInterpret = qfalse;
+	SV_SpawnServer( mapname, qfalse );
+
+	Com_Printf( "%i game frames of %i msec on %s\n", frames, frameMsec, mapname );
+	for ( i = 0 ; i < ARRAY_LEN( modes ) ; i++ ) {
+		Com_Printf( "%-12s %8.1f msec %8.1f usec/frame", modeNames[modes[i]],
+			usec[i] / 1000.0, (double)usec[i] / frames );
+		if ( loaded[i] != modes[i] ) {
+			Com_Printf( " (ran %s)", modeNames[loaded[i]] );
+		}
+		Com_Printf( "\n" );
+	}
+}
+
+/*
+===============
+SV_VMDiff_f
+
+Differential test for the qvm compiler.  Loads the current map with the
+game module interpreted and then compiled, runs the same game frames on
+both and compares the qvm data after every frame.  Reports the first
+frame where the two diverge and the words that differ at the end.
+Like vmbench, this reloads the map and is best run without clients.
+===============
+*/
+void SV_VMDiff_f( void ) {
+	static const vmInterpret_t	modes[] = { VMI_BYTECODE, VMI_COMPILED };
+	char			mapname[MAX_QPATH];
+	byte			*data;
+	int				length, referenceLength;
+	int				frames, frameMsec, diverged, differ, i, f;
+
+	if ( sv.state != SS_GAME ) {
+		Com_Printf( "Server is not running.\n" );
+		return;
+	}
+
+	frames = 100;
+	if ( Cmd_Argc() > 1 ) {
+		frames = Com_Clamp( 1, 100000, atoi( Cmd_Argv( 1 ) ) );
+	}
+	frameMsec = 1000 / MAX( sv_fps->integer, 1 );
+
+	Q_strncpyz( mapname, sv_mapname->string, sizeof( mapname ) );
+
+	// the buffers belong to svs so an error in one of the runs frees them
+	svs.vmDiffSums = Z_Malloc( ( frames + 1 ) * sizeof( *svs.vmDiffSums ) );
+	referenceLength = 0;
+	diverged = -1;
+
+	svs.fixedGameSeed = qtrue;
+	svs.forceGameInterpret = qtrue;
+	for ( i = 0 ; i < ARRAY_LEN( modes ) ; i++ ) {
+		svs.gameInterpret = modes[i];
+		SV_SpawnServer( mapname, qfalse );
+
+		data = VM_StaticData( gvm, &length );
+		if ( VM_Type( gvm ) != modes[i] || !data ) {
+			Com_Printf( "Couldn't load the game module %s.\n",
+				modes[i] == VMI_BYTECODE ? "interpreted" : "compiled" );
+			break;
+		}
+
+		for ( f = 0 ; f <= frames ; f++ ) {
+			if ( f > 0 ) {
+				sv.time += frameMsec;
+				VM_Call( gvm, GAME_RUN_FRAME, sv.time );
+			}
+
+			if ( i == 0 ) {
+				svs.vmDiffSums[f] = Com_BlockChecksum( data, length );
+			} else if ( diverged < 0 && svs.vmDiffSums[f] != Com_BlockChecksum( data, length ) ) {
+				diverged = f;
+			}
+		}
+
+		if ( i == 0 ) {
+			svs.vmDiffReference = Z_Malloc( length );
+			Com_Memcpy( svs.vmDiffReference, data, length );
+			referenceLength = length;
+		}
+	}
+	svs.fixedGameSeed = qfalse;
+	svs.forceGameInterpret = qfalse;
+
+	if ( i == ARRAY_LEN( modes ) ) {
+		if ( length != referenceLength ) {
+			Com_Printf( "Data segments differ in size: %i and %i bytes\n", referenceLength, length );
+		} else if ( diverged < 0 ) {
+			Com_Printf( "%i game frames on %s, compiled matches interpreted\n", frames, mapname );
+		} else {
+			Com_Printf( S_COLOR_RED "%i game frames on %s, compiled diverges from interpreted at %s\n",
+				frames, mapname, diverged ? va( "frame %i", diverged ) : "init" );
+
+			for ( f = 0, differ = 0 ; f + 4 <= length ; f += 4 ) {
+				if ( *(int *)( svs.vmDiffReference + f ) == *(int *)( data + f ) ) {
+					continue;
+				}
+				if ( differ < 16 ) {
+					Com_Printf( "  0x%08x: %08x interpreted, %08x compiled\n", f,
+						*(int *)( svs.vmDiffReference + f ), *(int *)( data + f ) );
+				}
+				differ++;
+			}
+			Com_Printf( "%i words differ after the last frame\n", differ );
+		}
+	}
+
+	if ( svs.vmDiffReference ) {
+		Z_Free( svs.vmDiffReference );
+		svs.vmDiffReference = NULL;
+	}
+	Z_Free( svs.vmDiffSums );
+	svs.vmDiffSums = NULL;
+
+	SV_SpawnServer( mapname, qfalse );
+}
+
 /*
 ====================
 SV_GameCommand
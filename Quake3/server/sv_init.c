@@ -278,6 +278,8 @@ static void SV_Startup( void ) {
 	}
 	svs.initialized = qtrue;
 
+	SV_InitDeltaCache();
+
 	// Don't respect sv_killserver unless a server is actually running
 	if ( sv_killserver->integer ) {
 		Cvar_Set( "sv_killserver", "0" );
@@ -421,6 +423,9 @@ void SV_SpawnServer( char *server, qboolean killBots ) {
 	// clear collision map data
 	CM_ClearMap();
 
+	// nothing is allocating now, a good time to compact the zone
+	Z_MapChange();
+
 	// init client structures and svs.numSnapshotEntities 
 	if ( !Cvar_VariableValue("sv_running") ) {
 		SV_Startup();
@@ -436,6 +441,7 @@ void SV_SpawnServer( char *server, qboolean killBots ) {
 
 	// allocate the snapshot entities on the hunk
 	svs.snapshotEntities = Hunk_Alloc( sizeof(entityState_t)*svs.numSnapshotEntities, h_high );
+	svs.snapshotEntityHashes = Hunk_Alloc( sizeof(unsigned)*svs.numSnapshotEntities, h_high );
 	svs.nextSnapshotEntities = 0;
 
 	// toggle the server bit so clients can detect that a
@@ -680,6 +686,10 @@ void SV_Init (void)
 	sv_reconnectlimit = Cvar_Get ("sv_reconnectlimit", "3", 0);
 	sv_showloss = Cvar_Get ("sv_showloss", "0", 0);
 	sv_padPackets = Cvar_Get ("sv_padPackets", "0", 0);
+	sv_speeds = Cvar_Get ("sv_speeds", "0", 0);
+	sv_worldIndex = Cvar_Get ("sv_worldIndex", "0", CVAR_ARCHIVE );
+	sv_traceCache = Cvar_Get ("sv_traceCache", "0", CVAR_ARCHIVE );
+	sv_deltaCache = Cvar_Get ("sv_deltaCache", "1", CVAR_ARCHIVE );
 	sv_killserver = Cvar_Get ("sv_killserver", "0", 0);
 	sv_mapChecksum = Cvar_Get ("sv_mapChecksum", "", CVAR_ROM);
 	sv_lanForceRate = Cvar_Get ("sv_lanForceRate", "1", CVAR_ARCHIVE );
@@ -755,6 +765,7 @@ void SV_Shutdown( char *finalmsg ) {
 	SV_RemoveOperatorCommands();
 	SV_MasterShutdown();
 	SV_ShutdownGameProgs();
+	SV_ShutdownDeltaCache();
 
 	// free current level
 	SV_ClearServer();
@@ -769,6 +780,12 @@ void SV_Shutdown( char *finalmsg ) {
 		
 		Z_Free(svs.clients);
 	}
+	if ( svs.vmDiffSums ) {
+		Z_Free( svs.vmDiffSums );
+	}
+	if ( svs.vmDiffReference ) {
+		Z_Free( svs.vmDiffReference );
+	}
 	Com_Memset( &svs, 0, sizeof( svs ) );
 
 	Cvar_Set( "sv_running", "0" );
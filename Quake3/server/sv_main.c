@@ -45,6 +45,10 @@ cvar_t	*sv_master[MAX_MASTER_SERVERS];	// master server ip address
 cvar_t	*sv_reconnectlimit;		// minimum seconds between connect messages
 cvar_t	*sv_showloss;			// report when usercmds are lost
 cvar_t	*sv_padPackets;			// add nop bytes to messages
+cvar_t	*sv_speeds;				// print the snapshot timing breakdown
+cvar_t	*sv_worldIndex;			// spatial index used for entity area queries
+cvar_t	*sv_traceCache;			// reuse identical traces within a frame
+cvar_t	*sv_deltaCache;			// share entity delta encodings between clients
 cvar_t	*sv_killserver;			// menu system can set to 1 to shut server down
 cvar_t	*sv_mapname;
 cvar_t	*sv_mapChecksum;
@@ -1088,7 +1092,14 @@ void SV_Frame( int msec ) {
 
 	sv.timeResidual += msec;
 
-	if (!com_dedicated->integer) SV_BotFrame (sv.time + sv.timeResidual);
+	// traces are only cached for a single frame
+	SV_ClearTraceCache();
+
+	if (!com_dedicated->integer) {
+		PROF_BEGIN( PROF_SV_BOTS );
+		SV_BotFrame (sv.time + sv.timeResidual);
+		PROF_END( PROF_SV_BOTS );
+	}
 
 	// if time is about to hit the 32nd bit, kick all clients
 	// and clear sv.time, rather
@@ -1131,7 +1142,11 @@ void SV_Frame( int msec ) {
 	// update ping based on the all received frames
 	SV_CalcPings();
 
-	if (com_dedicated->integer) SV_BotFrame (sv.time);
+	if (com_dedicated->integer) {
+		PROF_BEGIN( PROF_SV_BOTS );
+		SV_BotFrame (sv.time);
+		PROF_END( PROF_SV_BOTS );
+	}
 
 	// run the game simulation in chunks
 	while ( sv.timeResidual >= frameMsec ) {
@@ -1140,7 +1155,9 @@ void SV_Frame( int msec ) {
 		sv.time += frameMsec;
 
 		// let everything in the world think and move
+		PROF_BEGIN( PROF_SV_GAME );
 		VM_Call (gvm, GAME_RUN_FRAME, sv.time);
+		PROF_END( PROF_SV_GAME );
 	}
 
 	if ( com_speeds->integer ) {
@@ -1151,7 +1168,9 @@ void SV_Frame( int msec ) {
 	SV_CheckTimeouts();
 
 	// send messages back to the clients
+	PROF_BEGIN( PROF_SV_SNAPSHOTS );
 	SV_SendClientMessages();
+	PROF_END( PROF_SV_SNAPSHOTS );
 
 	// send a heartbeat to the master if needed
 	SV_MasterHeartbeat(HEARTBEAT_FOR_MASTER);
@@ -45,6 +45,227 @@ A normal server packet will look like:
 =============================================================================
 */
 
+/*
+=============================================================================
+
+Entity delta cache
+
+Clients that were acked on the same frame mostly need the same entity
+deltas.  The first snapshot written in a frame encodes a delta normally and
+keeps the bits, the ones after that copy them into their own message.  The
+key is the exact from and to states, so the messages are unchanged.
+
+The cache is split into stripes, each with its own lock, entries and bit
+storage, because snapshots are written on the worker threads.  A stripe is
+emptied the first time it is used in a new frame.
+
+=============================================================================
+*/
+
+#define	DELTA_CACHE_STRIPES		16
+#define	DELTA_CACHE_ENTRIES		128		// per stripe, must be a power of two
+#define	DELTA_CACHE_PROBES		4
+#define	DELTA_CACHE_BYTES		32768	// per stripe
+
+typedef struct {
+	int				frame;			// valid if this is deltaCacheFrame
+	unsigned		hash;
+	qboolean		force;
+	entityState_t	from, to;
+	int				offset;			// bits in the stripe data
+	int				bits;
+} deltaCacheEntry_t;
+
+typedef struct {
+	sysMutex_t		*lock;
+	int				frame;
+	int				used;			// bits of data
+	int				hits, misses, full;
+	deltaCacheEntry_t	entries[DELTA_CACHE_ENTRIES];
+	byte			data[DELTA_CACHE_BYTES];
+} deltaCacheStripe_t;
+
+static deltaCacheStripe_t	deltaCache[DELTA_CACHE_STRIPES];
+static int					deltaCacheFrame = 1;
+
+/*
+=============
+SV_InitDeltaCache
+=============
+*/
+void SV_InitDeltaCache( void ) {
+	int		i;
+
+	for ( i = 0 ; i < DELTA_CACHE_STRIPES ; i++ ) {
+		if ( !deltaCache[i].lock ) {
+			deltaCache[i].lock = Sys_CreateMutex();
+		}
+	}
+}
+
+/*
+=============
+SV_ShutdownDeltaCache
+
+No snapshots may be written while the locks go away
+=============
+*/
+void SV_ShutdownDeltaCache( void ) {
+	int		i;
+
+	for ( i = 0 ; i < DELTA_CACHE_STRIPES ; i++ ) {
+		if ( deltaCache[i].lock ) {
+			Sys_DestroyMutex( deltaCache[i].lock );
+			deltaCache[i].lock = NULL;
+		}
+	}
+}
+
+/*
+=============
+SV_EntityStateHash
+=============
+*/
+static unsigned SV_EntityStateHash( const entityState_t *s ) {
+	const int	*p;
+	unsigned	hash;
+	int			i;
+
+	p = (const int *)s;
+	hash = 2166136261u;
+	for ( i = 0 ; i < sizeof( *s ) / 4 ; i++ ) {
+		hash = ( hash ^ p[i] ) * 16777619u;
+	}
+
+	return hash;
+}
+
+/*
+=============
+SV_WriteCachedDeltaEntity
+
+MSG_WriteDeltaEntity through the delta cache, the hashes are the
+SV_EntityStateHash of the states
+=============
+*/
+static void SV_WriteCachedDeltaEntity( msg_t *msg, entityState_t *from, unsigned fromHash,
+									entityState_t *to, unsigned toHash, qboolean force ) {
+	deltaCacheStripe_t	*stripe;
+	deltaCacheEntry_t	*entry, *slot;
+	msg_t				store;
+	unsigned			hash;
+	int					start, bits;
+	int					i;
+
+	// unchanged entities don't write anything
+	if ( !force && fromHash == toHash && !memcmp( from, to, sizeof( *to ) ) ) {
+		return;
+	}
+
+	if ( !sv_deltaCache->integer || msg->oob || msg->overflowed ) {
+		MSG_WriteDeltaEntity( msg, from, to, force );
+		return;
+	}
+
+	hash = ( fromHash * 31 ) ^ toHash ^ force;
+	stripe = &deltaCache[hash & ( DELTA_CACHE_STRIPES - 1 )];
+	hash /= DELTA_CACHE_STRIPES;
+
+	Sys_LockMutex( stripe->lock );
+
+	if ( stripe->frame != deltaCacheFrame ) {
+		stripe->frame = deltaCacheFrame;
+		stripe->used = 0;
+	}
+
+	slot = NULL;
+	for ( i = 0 ; i < DELTA_CACHE_PROBES ; i++ ) {
+		entry = &stripe->entries[( hash + i ) & ( DELTA_CACHE_ENTRIES - 1 )];
+		if ( entry->frame != deltaCacheFrame ) {
+			if ( !slot ) {
+				slot = entry;
+			}
+			continue;
+		}
+		if ( entry->hash == hash && entry->force == force
+			&& !memcmp( &entry->to, to, sizeof( *to ) ) && !memcmp( &entry->from, from, sizeof( *from ) ) ) {
+			stripe->hits++;
+			MSG_WriteBitstream( msg, stripe->data, entry->offset, entry->bits );
+			Sys_UnlockMutex( stripe->lock );
+			return;
+		}
+	}
+	stripe->misses++;
+
+	Sys_UnlockMutex( stripe->lock );
+
+	start = msg->bit;
+	MSG_WriteDeltaEntity( msg, from, to, force );
+	if ( msg->overflowed ) {
+		return;
+	}
+	bits = msg->bit - start;
+
+	Sys_LockMutex( stripe->lock );
+
+	if ( stripe->frame != deltaCacheFrame || stripe->used + bits > DELTA_CACHE_BYTES * 8 ) {
+		stripe->full++;
+		Sys_UnlockMutex( stripe->lock );
+		return;
+	}
+
+	// another thread may have filled the free slot in the meantime
+	if ( !slot || slot->frame == deltaCacheFrame ) {
+		slot = &stripe->entries[hash & ( DELTA_CACHE_ENTRIES - 1 )];
+	}
+
+	store.data = stripe->data;
+	store.maxsize = DELTA_CACHE_BYTES;
+	store.bit = stripe->used;
+	store.overflowed = qfalse;
+	MSG_WriteBitstream( &store, msg->data, start, bits );
+
+	slot->frame = deltaCacheFrame;
+	slot->hash = hash;
+	slot->force = force;
+	slot->from = *from;
+	slot->to = *to;
+	slot->offset = stripe->used;
+	slot->bits = bits;
+	stripe->used += bits;
+
+	Sys_UnlockMutex( stripe->lock );
+}
+
+/*
+=============
+SV_DeltaCache_f
+=============
+*/
+void SV_DeltaCache_f( void ) {
+	int		hits, misses, full;
+	int		i;
+
+	hits = misses = full = 0;
+	for ( i = 0 ; i < DELTA_CACHE_STRIPES ; i++ ) {
+		hits += deltaCache[i].hits;
+		misses += deltaCache[i].misses;
+		full += deltaCache[i].full;
+	}
+
+	Com_Printf( "delta cache %s\n", sv_deltaCache->integer ? "on" : "off" );
+	Com_Printf( "%i hits, %i misses, %.1f%% hit rate, %i not stored\n", hits, misses,
+		hits + misses ? 100.0f * hits / ( hits + misses ) : 0.0f, full );
+
+	// commands never run while snapshots are written, and the locks only
+	// exist while the server does
+	if ( Cmd_Argc() > 1 && !Q_stricmp( Cmd_Argv( 1 ), "reset" ) ) {
+		for ( i = 0 ; i < DELTA_CACHE_STRIPES ; i++ ) {
+			deltaCache[i].hits = deltaCache[i].misses = deltaCache[i].full = 0;
+		}
+	}
+}
+
 /*
 =============
 SV_EmitPacketEntities
@@ -57,6 +278,7 @@ static void SV_EmitPacketEntities( clientSnapshot_t *from, clientSnapshot_t *to,
 	int		oldindex, newindex;
 	int		oldnum, newnum;
 	int		from_num_entities;
+	unsigned	oldhash, newhash;
 
 	// generate the delta update
 	if ( !from ) {
@@ -67,6 +289,7 @@ static void SV_EmitPacketEntities( clientSnapshot_t *from, clientSnapshot_t *to,
 
 	newent = NULL;
 	oldent = NULL;
+	newhash = oldhash = 0;
 	newindex = 0;
 	oldindex = 0;
 	while ( newindex < to->num_entities || oldindex < from_num_entities ) {
@@ -74,6 +297,7 @@ static void SV_EmitPacketEntities( clientSnapshot_t *from, clientSnapshot_t *to,
 			newnum = 9999;
 		} else {
 			newent = &svs.snapshotEntities[(to->first_entity+newindex) % svs.numSnapshotEntities];
+			newhash = svs.snapshotEntityHashes[(to->first_entity+newindex) % svs.numSnapshotEntities];
 			newnum = newent->number;
 		}
 
@@ -81,6 +305,7 @@ static void SV_EmitPacketEntities( clientSnapshot_t *from, clientSnapshot_t *to,
 			oldnum = 9999;
 		} else {
 			oldent = &svs.snapshotEntities[(from->first_entity+oldindex) % svs.numSnapshotEntities];
+			oldhash = svs.snapshotEntityHashes[(from->first_entity+oldindex) % svs.numSnapshotEntities];
 			oldnum = oldent->number;
 		}
 
@@ -88,7 +313,7 @@ static void SV_EmitPacketEntities( clientSnapshot_t *from, clientSnapshot_t *to,
 			// delta update from old position
 			// because the force parm is qfalse, this will not result
 			// in any bytes being emitted if the entity has not changed at all
-			MSG_WriteDeltaEntity (msg, oldent, newent, qfalse );
+			SV_WriteCachedDeltaEntity (msg, oldent, oldhash, newent, newhash, qfalse );
 			oldindex++;
 			newindex++;
 			continue;
@@ -96,7 +321,8 @@ static void SV_EmitPacketEntities( clientSnapshot_t *from, clientSnapshot_t *to,
 
 		if ( newnum < oldnum ) {
 			// this is a new entity, send it from the baseline
-			MSG_WriteDeltaEntity (msg, &sv.svEntities[newnum].baseline, newent, qtrue );
+			SV_WriteCachedDeltaEntity (msg, &sv.svEntities[newnum].baseline,
+				SV_EntityStateHash( &sv.svEntities[newnum].baseline ), newent, newhash, qtrue );
 			newindex++;
 			continue;
 		}
@@ -116,17 +342,16 @@ static void SV_EmitPacketEntities( clientSnapshot_t *from, clientSnapshot_t *to,
 
 /*
 ==================
-SV_WriteSnapshotToClient
+SV_SnapshotDeltaFrame
+
+Picks the previous frame the new snapshot will be delta compressed against.
+Must be called right after the snapshot entities of the new frame have been
+stored, so the check against the circular entity buffer is exact.
 ==================
 */
-static void SV_WriteSnapshotToClient( client_t *client, msg_t *msg ) {
-	clientSnapshot_t	*frame, *oldframe;
+static clientSnapshot_t *SV_SnapshotDeltaFrame( client_t *client, int *lastframeOut ) {
+	clientSnapshot_t	*oldframe;
 	int					lastframe;
-	int					i;
-	int					snapFlags;
-
-	// this is the snapshot we are creating
-	frame = &client->frames[ client->netchan.outgoingSequence & PACKET_MASK ];
 
 	// try to use a previous frame as the source for delta compressing the snapshot
 	if ( client->deltaMessage <= 0 || client->state != CS_ACTIVE ) {
@@ -152,6 +377,25 @@ static void SV_WriteSnapshotToClient( client_t *client, msg_t *msg ) {
 		}
 	}
 
+	*lastframeOut = lastframe;
+	return oldframe;
+}
+
+/*
+==================
+SV_WriteSnapshotToClient
+
+Only reads shared server state, so it can be run on a worker thread
+==================
+*/
+static void SV_WriteSnapshotToClient( client_t *client, msg_t *msg, clientSnapshot_t *oldframe, int lastframe ) {
+	clientSnapshot_t	*frame;
+	int					i;
+	int					snapFlags;
+
+	// this is the snapshot we are creating
+	frame = &client->frames[ client->netchan.outgoingSequence & PACKET_MASK ];
+
 	MSG_WriteByte (msg, svc_snapshot);
 
 	// NOTE, MRE: now sent at the start of every message from server to client
@@ -238,6 +482,8 @@ Build a client snapshot structure
 typedef struct {
 	int		numSnapshotEntities;
 	int		snapshotEntities[MAX_SNAPSHOT_ENTITIES];	
+	byte	added[MAX_GENTITIES/8];		// prevents double adding from portal views
+	const char	*error;					// raised by the caller, the gathering may run on a worker
 } snapshotEntityNumbers_t;
 
 /*
@@ -268,12 +514,14 @@ static int QDECL SV_QsortEntityNumbers( const void *a, const void *b ) {
 SV_AddEntToSnapshot
 ===============
 */
-static void SV_AddEntToSnapshot( svEntity_t *svEnt, sharedEntity_t *gEnt, snapshotEntityNumbers_t *eNums ) {
+static void SV_AddEntToSnapshot( sharedEntity_t *gEnt, snapshotEntityNumbers_t *eNums ) {
+	int		num = gEnt->s.number;
+
 	// if we have already added this entity to this snapshot, don't add again
-	if ( svEnt->snapshotCounter == sv.snapshotCounter ) {
+	if ( eNums->added[num >> 3] & (1 << (num & 7)) ) {
 		return;
 	}
-	svEnt->snapshotCounter = sv.snapshotCounter;
+	eNums->added[num >> 3] |= 1 << (num & 7);
 
 	// if we are full, silently discard entities
 	if ( eNums->numSnapshotEntities == MAX_SNAPSHOT_ENTITIES ) {
@@ -348,8 +596,10 @@ static void SV_AddEntitiesVisibleFromPoint( vec3_t origin, clientSnapshot_t *fra
 		}
 		// entities can be flagged to be sent to a given mask of clients
 		if ( ent->r.svFlags & SVF_CLIENTMASK ) {
-			if (frame->ps.clientNum >= 32)
-				Com_Error( ERR_DROP, "SVF_CLIENTMASK: clientNum >= 32" );
+			if (frame->ps.clientNum >= 32) {
+				eNums->error = "SVF_CLIENTMASK: clientNum >= 32";
+				continue;
+			}
 			if (~ent->r.singleClient & (1 << frame->ps.clientNum))
 				continue;
 		}
@@ -357,13 +607,13 @@ static void SV_AddEntitiesVisibleFromPoint( vec3_t origin, clientSnapshot_t *fra
 		svEnt = SV_SvEntityForGentity( ent );
 
 		// don't double add an entity through portals
-		if ( svEnt->snapshotCounter == sv.snapshotCounter ) {
+		if ( eNums->added[e >> 3] & (1 << (e & 7)) ) {
 			continue;
 		}
 
 		// broadcast entities are always sent
 		if ( ent->r.svFlags & SVF_BROADCAST ) {
-			SV_AddEntToSnapshot( svEnt, ent, eNums );
+			SV_AddEntToSnapshot( ent, eNums );
 			continue;
 		}
 
@@ -409,7 +659,7 @@ static void SV_AddEntitiesVisibleFromPoint( vec3_t origin, clientSnapshot_t *fra
 		}
 
 		// add it
-		SV_AddEntToSnapshot( svEnt, ent, eNums );
+		SV_AddEntToSnapshot( ent, eNums );
 
 		// if it's a portal entity, add everything visible from its camera position
 		if ( ent->r.svFlags & SVF_PORTAL ) {
@@ -428,7 +678,7 @@ static void SV_AddEntitiesVisibleFromPoint( vec3_t origin, clientSnapshot_t *fra
 
 /*
 =============
-SV_BuildClientSnapshot
+SV_GatherSnapshotEntities
 
 Decides which entities are going to be visible to the client, and
 copies off the playerstate and areabits.
@@ -436,29 +686,28 @@ copies off the playerstate and areabits.
 This properly handles multiple recursive portals, but the render
 currently doesn't.
 
+Doesn't write any shared server state, so it can be run on a worker thread
+for several clients at once.  Returns qfalse if the client has no entity
+to view from.
+
 For viewing through other player's eyes, clent can be something other than client->gentity
 =============
 */
-static void SV_BuildClientSnapshot( client_t *client ) {
+static qboolean SV_GatherSnapshotEntities( client_t *client, snapshotEntityNumbers_t *entityNumbers ) {
 	vec3_t						org;
 	clientSnapshot_t			*frame;
-	snapshotEntityNumbers_t		entityNumbers;
 	int							i;
-	sharedEntity_t				*ent;
-	entityState_t				*state;
-	svEntity_t					*svEnt;
 	sharedEntity_t				*clent;
 	int							clientNum;
 	playerState_t				*ps;
 
-	// bump the counter used to prevent double adding
-	sv.snapshotCounter++;
-
 	// this is the frame we are creating
 	frame = &client->frames[ client->netchan.outgoingSequence & PACKET_MASK ];
 
 	// clear everything in this snapshot
-	entityNumbers.numSnapshotEntities = 0;
+	entityNumbers->numSnapshotEntities = 0;
+	entityNumbers->error = NULL;
+	Com_Memset( entityNumbers->added, 0, sizeof( entityNumbers->added ) );
 	Com_Memset( frame->areabits, 0, sizeof( frame->areabits ) );
 
   // https://zerowing.idsoftware.com/bugzilla/show_bug.cgi?id=62
@@ -466,7 +715,7 @@ static void SV_BuildClientSnapshot( client_t *client ) {
 	
 	clent = client->gentity;
 	if ( !clent || client->state == CS_ZOMBIE ) {
-		return;
+		return qfalse;
 	}
 
 	// grab the current playerState_t
@@ -477,11 +726,10 @@ static void SV_BuildClientSnapshot( client_t *client ) {
 	// be regenerated from the playerstate
 	clientNum = frame->ps.clientNum;
 	if ( clientNum < 0 || clientNum >= MAX_GENTITIES ) {
-		Com_Error( ERR_DROP, "SV_SvEntityForGentity: bad gEnt" );
+		entityNumbers->error = "SV_SvEntityForGentity: bad gEnt";
+		return qtrue;
 	}
-	svEnt = &sv.svEntities[ clientNum ];
-
-	svEnt->snapshotCounter = sv.snapshotCounter;
+	entityNumbers->added[clientNum >> 3] |= 1 << (clientNum & 7);
 
 	// find the client's viewpoint
 	VectorCopy( ps->origin, org );
@@ -489,14 +737,14 @@ static void SV_BuildClientSnapshot( client_t *client ) {
 
 	// add all the entities directly visible to the eye, which
 	// may include portal entities that merge other viewpoints
-	SV_AddEntitiesVisibleFromPoint( org, frame, &entityNumbers, qfalse );
+	SV_AddEntitiesVisibleFromPoint( org, frame, entityNumbers, qfalse );
 
 	// if there were portals visible, there may be out of order entities
 	// in the list which will need to be resorted for the delta compression
-	// to work correctly.  This also catches the error condition
-	// of an entity being included twice.
-	qsort( entityNumbers.snapshotEntities, entityNumbers.numSnapshotEntities, 
-		sizeof( entityNumbers.snapshotEntities[0] ), SV_QsortEntityNumbers );
+	// to work correctly.  Entities can't be included twice because of the
+	// added bits.
+	qsort( entityNumbers->snapshotEntities, entityNumbers->numSnapshotEntities, 
+		sizeof( entityNumbers->snapshotEntities[0] ), SV_QsortEntityNumbers );
 
 	// now that all viewpoint's areabits have been OR'd together, invert
 	// all of them to make it a mask vector, which is what the renderer wants
@@ -504,13 +752,37 @@ static void SV_BuildClientSnapshot( client_t *client ) {
 		((int *)frame->areabits)[i] = ((int *)frame->areabits)[i] ^ -1;
 	}
 
+	return qtrue;
+}
+
+/*
+=============
+SV_StoreSnapshotEntities
+
+Copies the entity states of a gathered snapshot into the circular
+svs.snapshotEntities buffer, and raises any error found while gathering
+=============
+*/
+static void SV_StoreSnapshotEntities( client_t *client, snapshotEntityNumbers_t *entityNumbers ) {
+	clientSnapshot_t			*frame;
+	int							i;
+	sharedEntity_t				*ent;
+	entityState_t				*state;
+
+	if ( entityNumbers->error ) {
+		Com_Error( ERR_DROP, "%s", entityNumbers->error );
+	}
+
+	frame = &client->frames[ client->netchan.outgoingSequence & PACKET_MASK ];
+
 	// copy the entity states out
 	frame->num_entities = 0;
 	frame->first_entity = svs.nextSnapshotEntities;
-	for ( i = 0 ; i < entityNumbers.numSnapshotEntities ; i++ ) {
-		ent = SV_GentityNum(entityNumbers.snapshotEntities[i]);
+	for ( i = 0 ; i < entityNumbers->numSnapshotEntities ; i++ ) {
+		ent = SV_GentityNum(entityNumbers->snapshotEntities[i]);
 		state = &svs.snapshotEntities[svs.nextSnapshotEntities % svs.numSnapshotEntities];
 		*state = ent->s;
+		svs.snapshotEntityHashes[svs.nextSnapshotEntities % svs.numSnapshotEntities] = SV_EntityStateHash( state );
 		svs.nextSnapshotEntities++;
 		// this should never hit, map should always be restarted first in SV_Frame
 		if ( svs.nextSnapshotEntities >= 0x7FFFFFFE ) {
@@ -520,6 +792,45 @@ static void SV_BuildClientSnapshot( client_t *client ) {
 	}
 }
 
+/*
+=============
+SV_FixEntityNumbers
+
+SV_AddEntitiesVisibleFromPoint repairs a bad ent->s.number when it comes
+across one, do it up front before handing snapshots out to worker threads
+=============
+*/
+static void SV_FixEntityNumbers( void ) {
+	int				e;
+	sharedEntity_t	*ent;
+
+	if ( !sv.state ) {
+		return;
+	}
+
+	for ( e = 0 ; e < sv.num_entities ; e++ ) {
+		ent = SV_GentityNum(e);
+
+		if ( ent->r.linked && ent->s.number != e ) {
+			Com_DPrintf ("FIXING ENT->S.NUMBER!!!\n");
+			ent->s.number = e;
+		}
+	}
+}
+
+/*
+=============
+SV_BuildClientSnapshot
+=============
+*/
+static void SV_BuildClientSnapshot( client_t *client ) {
+	snapshotEntityNumbers_t		entityNumbers;
+
+	if ( SV_GatherSnapshotEntities( client, &entityNumbers ) ) {
+		SV_StoreSnapshotEntities( client, &entityNumbers );
+	}
+}
+
 #ifdef USE_VOIP
 /*
 ==================
@@ -586,6 +897,46 @@ void SV_SendMessageToClient(msg_t *msg, client_t *client)
 }
 
 
+/*
+=======================
+SV_WriteClientMessage
+
+Writes everything but the VoIP data of a snapshot message.  Only touches
+the client itself, so it can be run on a worker thread.
+=======================
+*/
+static void SV_WriteClientMessage( client_t *client, msg_t *msg, clientSnapshot_t *oldframe, int lastframe ) {
+	// NOTE, MRE: all server->client messages now acknowledge
+	// let the client know which reliable clientCommands we have received
+	MSG_WriteLong( msg, client->lastClientCommand );
+
+	// (re)send any reliable server commands
+	SV_UpdateServerCommandsToClient( client, msg );
+
+	// send over all the relevant entityState_t
+	// and the playerState_t
+	SV_WriteSnapshotToClient( client, msg, oldframe, lastframe );
+}
+
+/*
+=======================
+SV_FinishClientMessage
+=======================
+*/
+static void SV_FinishClientMessage( client_t *client, msg_t *msg ) {
+#ifdef USE_VOIP
+	SV_WriteVoipToClient( client, msg );
+#endif
+
+	// check for overflow
+	if ( msg->overflowed ) {
+		Com_Printf ("WARNING: msg overflowed for %s\n", client->name);
+		MSG_Clear (msg);
+	}
+
+	SV_SendMessageToClient( msg, client );
+}
+
 /*
 =======================
 SV_SendClientSnapshot
@@ -597,6 +948,8 @@ Also called by SV_FinalMessage
 void SV_SendClientSnapshot( client_t *client ) {
 	byte		msg_buf[MAX_MSGLEN];
 	msg_t		msg;
+	clientSnapshot_t	*oldframe;
+	int			lastframe;
 
 	// build the snapshot
 	SV_BuildClientSnapshot( client );
@@ -610,30 +963,87 @@ void SV_SendClientSnapshot( client_t *client ) {
 	MSG_Init (&msg, msg_buf, sizeof(msg_buf));
 	msg.allowoverflow = qtrue;
 
-	// NOTE, MRE: all server->client messages now acknowledge
-	// let the client know which reliable clientCommands we have received
-	MSG_WriteLong( &msg, client->lastClientCommand );
+	oldframe = SV_SnapshotDeltaFrame( client, &lastframe );
+	SV_WriteClientMessage( client, &msg, oldframe, lastframe );
+	SV_FinishClientMessage( client, &msg );
+}
 
-	// (re)send any reliable server commands
-	SV_UpdateServerCommandsToClient( client, &msg );
 
-	// send over all the relevant entityState_t
-	// and the playerState_t
-	SV_WriteSnapshotToClient( client, &msg );
+/*
+=============================================================================
 
-#ifdef USE_VOIP
-	SV_WriteVoipToClient( client, &msg );
-#endif
+Snapshots for all clients are built in stages so the expensive parts can be
+spread over the worker threads (see Com_RunJobs):
 
-	// check for overflow
-	if ( msg.overflowed ) {
-		Com_Printf ("WARNING: msg overflowed for %s\n", client->name);
-		MSG_Clear (&msg);
-	}
+gather	- find the visible entities of each client		(parallel)
+store	- copy their states into svs.snapshotEntities	(serial, client order)
+write	- delta encode each message into its own buffer	(parallel)
+send	- VoIP, netchan and sockets						(serial, client order)
+
+The messages are bit for bit the ones SV_SendClientSnapshot would produce
+one client after another.
+
+=============================================================================
+*/
+
+typedef struct {
+	client_t				*client;
+	qboolean				gathered;
+	snapshotEntityNumbers_t	entityNumbers;
+	clientSnapshot_t		*oldframe;
+	int						lastframe;
+	msg_t					msg;
+	byte					msgBuf[MAX_MSGLEN];
+} snapshotJob_t;
+
+static snapshotJob_t	snapshotJobs[MAX_CLIENTS];
+
+/*
+=======================
+SV_GatherSnapshotJob
+=======================
+*/
+static void SV_GatherSnapshotJob( void *data, int index ) {
+	snapshotJob_t	*job = (snapshotJob_t *)data + index;
 
-	SV_SendMessageToClient( &msg, client );
+	job->gathered = SV_GatherSnapshotEntities( job->client, &job->entityNumbers );
 }
 
+/*
+=======================
+SV_WriteSnapshotJob
+=======================
+*/
+static void SV_WriteSnapshotJob( void *data, int index ) {
+	snapshotJob_t	*job = ((snapshotJob_t **)data)[index];
+
+	SV_WriteClientMessage( job->client, &job->msg, job->oldframe, job->lastframe );
+}
+
+/*
+=======================
+SV_SnapshotJobFirstEntity
+
+Returns the oldest svs.snapshotEntities index the job will read while
+writing, or -1 if it doesn't read any
+=======================
+*/
+static int SV_SnapshotJobFirstEntity( snapshotJob_t *job ) {
+	clientSnapshot_t	*frame;
+	int					first = -1;
+
+	frame = &job->client->frames[ job->client->netchan.outgoingSequence & PACKET_MASK ];
+	if ( frame->num_entities ) {
+		first = frame->first_entity;
+	}
+	if ( job->oldframe && job->oldframe->num_entities ) {
+		if ( first == -1 || job->oldframe->first_entity < first ) {
+			first = job->oldframe->first_entity;
+		}
+	}
+
+	return first;
+}
 
 /*
 =======================
@@ -644,8 +1054,14 @@ void SV_SendClientMessages(void)
 {
 	int		i;
 	client_t	*c;
-
-	// send a message to each connected client
+	snapshotJob_t	*job;
+	snapshotJob_t	*pending[MAX_CLIENTS];
+	int		numJobs, numPending;
+	int		first, oldest;
+	int		start, gathered, stored, written, flushStart, flushTime;
+
+	// find the clients that get a message this frame
+	numJobs = 0;
 	for(i=0; i < sv_maxclients->integer; i++)
 	{
 		c = &svs.clients[i];
@@ -677,9 +1093,90 @@ void SV_SendClientMessages(void)
 			}
 		}
 
-		// generate and send a new message
-		SV_SendClientSnapshot(c);
+		snapshotJobs[numJobs++].client = c;
+	}
+
+	if ( !numJobs ) {
+		return;
+	}
+
+	start = Sys_Milliseconds();
+
+	// deltas are only shared between the snapshots of one frame
+	deltaCacheFrame++;
+
+	// find the visible entities for every client
+	SV_FixEntityNumbers();
+	Com_RunJobs( SV_GatherSnapshotJob, snapshotJobs, numJobs );
+
+	gathered = Sys_Milliseconds();
+	flushTime = 0;
+
+	// store the entity states and pick the delta frames in client order
+	numPending = 0;
+	oldest = -1;
+	for ( i = 0 ; i < numJobs ; i++ ) {
+		job = &snapshotJobs[i];
+		c = job->client;
+
+		if ( job->gathered ) {
+			// storing may overwrite entities a pending message still has to
+			// read, in which case those messages are written first
+			if ( numPending && oldest != -1 && oldest < svs.nextSnapshotEntities +
+				job->entityNumbers.numSnapshotEntities - svs.numSnapshotEntities ) {
+				flushStart = Sys_Milliseconds();
+				Com_RunJobs( SV_WriteSnapshotJob, pending, numPending );
+				flushTime += Sys_Milliseconds() - flushStart;
+
+				numPending = 0;
+				oldest = -1;
+			}
+			SV_StoreSnapshotEntities( c, &job->entityNumbers );
+		}
+
+		// bots need to have their snapshots build, but
+		// the query them directly without needing to be sent
+		if ( c->gentity && c->gentity->r.svFlags & SVF_BOT ) {
+			continue;
+		}
+
+		MSG_Init( &job->msg, job->msgBuf, sizeof( job->msgBuf ) );
+		job->msg.allowoverflow = qtrue;
+		job->oldframe = SV_SnapshotDeltaFrame( c, &job->lastframe );
+
+		first = SV_SnapshotJobFirstEntity( job );
+		if ( first != -1 && ( oldest == -1 || first < oldest ) ) {
+			oldest = first;
+		}
+		pending[numPending++] = job;
+	}
+
+	stored = Sys_Milliseconds();
+
+	// delta encode the messages
+	Com_RunJobs( SV_WriteSnapshotJob, pending, numPending );
+
+	written = Sys_Milliseconds();
+
+	// send them out in client order, the packets go to the
+	// sockets together at the end where that's supported
+	NET_BeginSendBatch();
+	for ( i = 0 ; i < numJobs ; i++ ) {
+		job = &snapshotJobs[i];
+		c = job->client;
+
+		if ( !( c->gentity && c->gentity->r.svFlags & SVF_BOT ) ) {
+			SV_FinishClientMessage( c, &job->msg );
+		}
+
 		c->lastSnapshotTime = svs.time;
 		c->rateDelayed = qfalse;
 	}
+	NET_FlushSendBatch();
+
+	if ( sv_speeds->integer ) {
+		Com_Printf( "snapshots:%3i gather:%3i store:%3i write:%3i send:%3i workers:%i\n",
+			numJobs, gathered - start, stored - gathered - flushTime,
+			written - stored + flushTime, Sys_Milliseconds() - written, Com_NumWorkers() );
+	}
 }
@@ -54,9 +54,20 @@ clipHandle_t SV_ClipHandleForEntity( const sharedEntity_t *ent ) {
 ENTITY CHECKING
 
 To avoid linearly searching through lists of entities during environment testing,
-the world is carved up with an evenly spaced, axially aligned bsp tree.  Entities
-are kept in chains either at the final leafs, or at the first node that splits
-them, which prevents having to deal with multiple fragments of a single entity.
+the world is carved up by a spatial index.  Two are available, picked with
+sv_worldIndex when a map is loaded:
+
+0	An evenly spaced, axially aligned bsp tree.  Entities are kept in chains
+	either at the final leafs, or at the first node that splits them, which
+	prevents having to deal with multiple fragments of a single entity.
+
+1	A loose octree.  Each octant's bounds are grown by half its size on every
+	side, so an entity can always be kept in the deepest octant that is at
+	least as large as it is and holds its center, instead of piling up in the
+	nodes near the root when it happens to straddle a split.
+
+Every index keeps the entity bounds it was linked with, so it can be driven
+without a running game by the worldbench command.
 
 ===============================================================================
 */
@@ -65,37 +76,150 @@ typedef struct worldSector_s {
 	int		axis;		// -1 = leaf node
 	float	dist;
 	struct worldSector_s	*children[2];
-	svEntity_t	*entities;
+	worldLink_t	*links;
 } worldSector_t;
 
 #define	AREA_DEPTH	4
 #define	AREA_NODES	64
 
-worldSector_t	sv_worldSectors[AREA_NODES];
-int			sv_numworldSectors;
+typedef struct {
+	worldLink_t	*links;
+} worldOctant_t;
+
+#define	OCTREE_DEPTH	5
+#define	OCTREE_NODES	37449		// ( 8^(OCTREE_DEPTH+1) - 1 ) / 7
+
+typedef struct world_s {
+	int				index;			// sv_worldIndex when the world was cleared
+	vec3_t			mins, maxs;
+
+	worldSector_t	sectors[AREA_NODES];
+	int				numSectors;
+
+	worldOctant_t	*octants;		// all levels, root first
+	int				levelLinks[OCTREE_DEPTH+1];
+	float			octantSize[OCTREE_DEPTH+1];
+} world_t;
+
+typedef struct {
+	const float	*mins;
+	const float	*maxs;
+	int			*list;
+	int			count, maxcount;
+	int			tested;			// links compared against the bounds, for worldbench
+} areaParms_t;
+
+typedef struct {
+	const char	*name;
+	void		(*clear)( world_t *w );
+	void		(*link)( world_t *w, worldLink_t *link );
+	void		(*unlink)( world_t *w, worldLink_t *link );
+	void		(*query)( world_t *w, areaParms_t *ap );
+} worldIndex_t;
+
+static world_t	sv_world;
+
+static fileHandle_t	sv_worldRecord;
 
 
 /*
 ===============
-SV_SectorList_f
+SV_RecordWorldEvent
+
+Every event is written as the same eight little endian words:
+type, entity number, mins and maxs
 ===============
 */
-void SV_SectorList_f( void ) {
-	int				i, c;
-	worldSector_t	*sec;
-	svEntity_t		*ent;
+#define	WORLDRECORD_ID			(('C'<<24)+('E'<<16)+('R'<<8)+'W')
+#define	WORLDRECORD_VERSION		1
+
+static void SV_RecordWorldEvent( int type, int number, const vec3_t mins, const vec3_t maxs ) {
+	floatint_t	event[8];
+	int			i;
+
+	if ( !sv_worldRecord ) {
+		return;
+	}
+
+	event[0].i = LittleLong( type );
+	event[1].i = LittleLong( number );
+	for ( i = 0 ; i < 3 ; i++ ) {
+		event[2+i].f = LittleFloat( mins[i] );
+		event[5+i].f = LittleFloat( maxs[i] );
+	}
+	FS_Write( event, sizeof( event ), sv_worldRecord );
+}
+
+
+/*
+====================
+SV_AreaLinks
 
-	for ( i = 0 ; i < AREA_NODES ; i++ ) {
-		sec = &sv_worldSectors[i];
+Adds the links in a chain that touch the area bounds, returns qfalse if
+the list is full
+====================
+*/
+static qboolean SV_AreaLinks( worldLink_t *links, areaParms_t *ap ) {
+	worldLink_t	*check;
+
+	for ( check = links ; check ; check = check->next ) {
+		ap->tested++;
+
+		if ( check->absmin[0] > ap->maxs[0]
+		|| check->absmin[1] > ap->maxs[1]
+		|| check->absmin[2] > ap->maxs[2]
+		|| check->absmax[0] < ap->mins[0]
+		|| check->absmax[1] < ap->mins[1]
+		|| check->absmax[2] < ap->mins[2]) {
+			continue;
+		}
 
-		c = 0;
-		for ( ent = sec->entities ; ent ; ent = ent->nextEntityInWorldSector ) {
-			c++;
+		if ( ap->count == ap->maxcount ) {
+			Com_Printf ("SV_AreaEntities: MAXCOUNT\n");
+			return qfalse;
 		}
-		Com_Printf( "sector %i: %i entities\n", i, c );
+
+		ap->list[ap->count] = check->number;
+		ap->count++;
 	}
+
+	return qtrue;
 }
 
+/*
+====================
+SV_RemoveLink
+====================
+*/
+static void SV_RemoveLink( worldLink_t **head, worldLink_t *link ) {
+	if ( link->prev ) {
+		link->prev->next = link->next;
+	} else {
+		*head = link->next;
+	}
+	if ( link->next ) {
+		link->next->prev = link->prev;
+	}
+	link->prev = link->next = NULL;
+	link->node = NULL;
+}
+
+/*
+====================
+SV_InsertLink
+====================
+*/
+static void SV_InsertLink( worldLink_t **head, worldLink_t *link, void *node ) {
+	link->node = node;
+	link->prev = NULL;
+	link->next = *head;
+	if ( *head ) {
+		(*head)->prev = link;
+	}
+	*head = link;
+}
+
+
 /*
 ===============
 SV_CreateworldSector
@@ -103,13 +227,13 @@ SV_CreateworldSector
 Builds a uniformly subdivided tree for the given world size
 ===============
 */
-static worldSector_t *SV_CreateworldSector( int depth, vec3_t mins, vec3_t maxs ) {
+static worldSector_t *SV_CreateworldSector( world_t *w, int depth, vec3_t mins, vec3_t maxs ) {
 	worldSector_t	*anode;
 	vec3_t		size;
 	vec3_t		mins1, maxs1, mins2, maxs2;
 
-	anode = &sv_worldSectors[sv_numworldSectors];
-	sv_numworldSectors++;
+	anode = &w->sectors[w->numSectors];
+	w->numSectors++;
 
 	if (depth == AREA_DEPTH) {
 		anode->axis = -1;
@@ -132,12 +256,438 @@ static worldSector_t *SV_CreateworldSector( int depth, vec3_t mins, vec3_t maxs
 	
 	maxs1[anode->axis] = mins2[anode->axis] = anode->dist;
 	
-	anode->children[0] = SV_CreateworldSector (depth+1, mins2, maxs2);
-	anode->children[1] = SV_CreateworldSector (depth+1, mins1, maxs1);
+	anode->children[0] = SV_CreateworldSector (w, depth+1, mins2, maxs2);
+	anode->children[1] = SV_CreateworldSector (w, depth+1, mins1, maxs1);
 
 	return anode;
 }
 
+static void SV_SectorClear( world_t *w ) {
+	Com_Memset( w->sectors, 0, sizeof( w->sectors ) );
+	w->numSectors = 0;
+	SV_CreateworldSector( w, 0, w->mins, w->maxs );
+}
+
+static void SV_SectorLink( world_t *w, worldLink_t *link ) {
+	worldSector_t	*node;
+
+	// find the first world sector node that the ent's box crosses
+	node = w->sectors;
+	while (1)
+	{
+		if (node->axis == -1)
+			break;
+		if ( link->absmin[node->axis] > node->dist)
+			node = node->children[0];
+		else if ( link->absmax[node->axis] < node->dist)
+			node = node->children[1];
+		else
+			break;		// crosses the node
+	}
+
+	SV_InsertLink( &node->links, link, node );
+}
+
+static void SV_SectorUnlink( world_t *w, worldLink_t *link ) {
+	worldSector_t	*node = link->node;
+
+	SV_RemoveLink( &node->links, link );
+}
+
+static void SV_SectorQuery_r( worldSector_t *node, areaParms_t *ap ) {
+	if ( !SV_AreaLinks( node->links, ap ) ) {
+		return;
+	}
+	
+	if (node->axis == -1) {
+		return;		// terminal node
+	}
+
+	// recurse down both sides
+	if ( ap->maxs[node->axis] > node->dist ) {
+		SV_SectorQuery_r ( node->children[0], ap );
+	}
+	if ( ap->mins[node->axis] < node->dist ) {
+		SV_SectorQuery_r ( node->children[1], ap );
+	}
+}
+
+static void SV_SectorQuery( world_t *w, areaParms_t *ap ) {
+	SV_SectorQuery_r( w->sectors, ap );
+}
+
+
+/*
+===============
+SV_OctantNum
+
+Returns the index into world_t->octants for the octant at (x,y,z) of a level
+===============
+*/
+static int SV_OctantNum( int level, int x, int y, int z ) {
+	return ( ( 1 << ( 3 * level ) ) - 1 ) / 7 + ( ( ( z << level ) + y ) << level ) + x;
+}
+
+/*
+===============
+SV_OctantCoord
+
+The cell a point is in along one axis of a level with octants of size,
+links and queries both have to round the same way
+===============
+*/
+static int SV_OctantCoord( world_t *w, int axis, float size, float v ) {
+	return floor( ( v - w->mins[axis] ) / size );
+}
+
+static void SV_OctreeClear( world_t *w ) {
+	int		level;
+	vec3_t	size;
+
+	if ( !w->octants ) {
+		Com_Error( ERR_DROP, "SV_OctreeClear: no octants" );
+	}
+	Com_Memset( w->octants, 0, OCTREE_NODES * sizeof( *w->octants ) );
+	Com_Memset( w->levelLinks, 0, sizeof( w->levelLinks ) );
+
+	// octants are cubes, maps are usually much flatter than they are wide
+	VectorSubtract( w->maxs, w->mins, size );
+	size[0] = MAX( size[0], MAX( size[1], size[2] ) );
+	for ( level = 0 ; level <= OCTREE_DEPTH ; level++ ) {
+		w->octantSize[level] = size[0] / ( 1 << level );
+	}
+}
+
+static void SV_OctreeLink( world_t *w, worldLink_t *link ) {
+	int			level, i;
+	int			cell[3];
+	float		center, size;
+	worldOctant_t	*octant;
+
+	// find the deepest octant that is as large as the entity on every axis,
+	// anything that doesn't have its center inside the world goes to the root
+	for ( level = OCTREE_DEPTH ; level > 0 ; level-- ) {
+		for ( i = 0 ; i < 3 ; i++ ) {
+			size = w->octantSize[level];
+			if ( link->absmax[i] - link->absmin[i] > size ) {
+				break;
+			}
+			center = 0.5f * ( link->absmin[i] + link->absmax[i] );
+			cell[i] = SV_OctantCoord( w, i, size, center );
+			if ( cell[i] < 0 || cell[i] >= ( 1 << level ) ) {
+				break;
+			}
+		}
+		if ( i == 3 ) {
+			break;
+		}
+	}
+	if ( !level ) {
+		cell[0] = cell[1] = cell[2] = 0;
+	}
+
+	octant = &w->octants[SV_OctantNum( level, cell[0], cell[1], cell[2] )];
+	SV_InsertLink( &octant->links, link, octant );
+	w->levelLinks[level]++;
+}
+
+static void SV_OctreeUnlink( world_t *w, worldLink_t *link ) {
+	worldOctant_t	*octant = link->node;
+	int			level;
+
+	SV_RemoveLink( &octant->links, link );
+
+	for ( level = OCTREE_DEPTH ; level > 0 ; level-- ) {
+		if ( octant - w->octants >= SV_OctantNum( level, 0, 0, 0 ) ) {
+			break;
+		}
+	}
+	w->levelLinks[level]--;
+}
+
+static void SV_OctreeQuery( world_t *w, areaParms_t *ap ) {
+	int			level, i, x, y, z, n;
+	int			lo[3], hi[3];
+	float		size;
+
+	// the root also holds everything outside the world, so it is never culled
+	if ( !SV_AreaLinks( w->octants[0].links, ap ) ) {
+		return;
+	}
+
+	for ( level = 1 ; level <= OCTREE_DEPTH ; level++ ) {
+		if ( !w->levelLinks[level] ) {
+			continue;
+		}
+
+		// octants are loose by half their size on every side, so the center of
+		// anything linked at this level that touches the box is at most half
+		// a size outside of it
+		n = 1 << level;
+		for ( i = 0 ; i < 3 ; i++ ) {
+			size = w->octantSize[level];
+			lo[i] = SV_OctantCoord( w, i, size, ap->mins[i] - 0.5f * size );
+			hi[i] = SV_OctantCoord( w, i, size, ap->maxs[i] + 0.5f * size );
+			if ( lo[i] < 0 ) {
+				lo[i] = 0;
+			}
+			if ( hi[i] > n - 1 ) {
+				hi[i] = n - 1;
+			}
+			if ( lo[i] > hi[i] ) {
+				break;
+			}
+		}
+		if ( i != 3 ) {
+			continue;
+		}
+
+		for ( z = lo[2] ; z <= hi[2] ; z++ ) {
+			for ( y = lo[1] ; y <= hi[1] ; y++ ) {
+				for ( x = lo[0] ; x <= hi[0] ; x++ ) {
+					if ( !SV_AreaLinks( w->octants[SV_OctantNum( level, x, y, z )].links, ap ) ) {
+						return;
+					}
+				}
+			}
+		}
+	}
+}
+
+
+static const worldIndex_t	worldIndexes[] = {
+	{ "sectors",	SV_SectorClear, SV_SectorLink, SV_SectorUnlink, SV_SectorQuery },
+	{ "octree",		SV_OctreeClear, SV_OctreeLink, SV_OctreeUnlink, SV_OctreeQuery }
+};
+
+#define	NUM_WORLD_INDEXES	ARRAY_LEN( worldIndexes )
+
+
+/*
+===============
+SV_SectorList_f
+===============
+*/
+void SV_SectorList_f( void ) {
+	int				i, c, total;
+	worldLink_t		*link;
+
+	Com_Printf( "world index: %s\n", worldIndexes[sv_world.index].name );
+
+	if ( sv_world.index == 0 ) {
+		for ( i = 0 ; i < sv_world.numSectors ; i++ ) {
+			c = 0;
+			for ( link = sv_world.sectors[i].links ; link ; link = link->next ) {
+				c++;
+			}
+			Com_Printf( "sector %i: %i entities\n", i, c );
+		}
+		return;
+	}
+
+	if ( !sv_world.octants ) {
+		return;
+	}
+
+	for ( i = 0 ; i <= OCTREE_DEPTH ; i++ ) {
+		int		first, last, used;
+
+		first = SV_OctantNum( i, 0, 0, 0 );
+		last = SV_OctantNum( i + 1, 0, 0, 0 );
+		total = used = 0;
+		for ( c = first ; c < last ; c++ ) {
+			for ( link = sv_world.octants[c].links ; link ; link = link->next ) {
+				total++;
+			}
+			if ( sv_world.octants[c].links ) {
+				used++;
+			}
+		}
+		Com_Printf( "level %i: %i entities in %i of %i octants\n", i, total, used, last - first );
+	}
+}
+
+/*
+===============
+SV_WorldRecord_f
+
+Records entity links and area queries to a file for worldbench
+===============
+*/
+void SV_WorldRecord_f( void ) {
+	char	name[MAX_QPATH];
+	int		header[2];
+
+	if ( sv_worldRecord ) {
+		FS_FCloseFile( sv_worldRecord );
+		sv_worldRecord = 0;
+		Com_Printf( "Stopped world recording.\n" );
+		if ( Cmd_Argc() < 2 ) {
+			return;
+		}
+	}
+
+	if ( Cmd_Argc() != 2 ) {
+		Com_Printf( "Usage: worldrecord <name>, without a name stops recording\n" );
+		return;
+	}
+
+	Com_sprintf( name, sizeof( name ), "worldrecords/%s.wrec", Cmd_Argv( 1 ) );
+	sv_worldRecord = FS_FOpenFileWrite( name );
+	if ( !sv_worldRecord ) {
+		Com_Printf( "Couldn't open %s for writing.\n", name );
+		return;
+	}
+
+	header[0] = LittleLong( WORLDRECORD_ID );
+	header[1] = LittleLong( WORLDRECORD_VERSION );
+	FS_Write( header, sizeof( header ), sv_worldRecord );
+
+	// queries need the world bounds before anything can be replayed
+	if ( sv.state != SS_DEAD ) {
+		int		i;
+
+		SV_RecordWorldEvent( 'C', 0, sv_world.mins, sv_world.maxs );
+		for ( i = 0 ; i < sv.num_entities ; i++ ) {
+			worldLink_t	*link = &sv.svEntities[i].worldLink;
+
+			if ( link->node ) {
+				SV_RecordWorldEvent( 'L', link->number, link->absmin, link->absmax );
+			}
+		}
+	}
+
+	Com_Printf( "Recording world to %s.\n", name );
+}
+
+/*
+===============
+SV_WorldBench_f
+
+Replays a worldrecord file against every spatial index
+===============
+*/
+void SV_WorldBench_f( void ) {
+	char		name[MAX_QPATH];
+	floatint_t	*buffer, *event;
+	int			len, numEvents;
+	int			passes, pass, i, j, e;
+	int			list[MAX_GENTITIES];
+	world_t		*w;
+	worldLink_t	*links, *link;
+	areaParms_t	ap;
+	vec3_t		mins, maxs;
+	int			start, msec, numLinks, numQueries, tested, found;
+
+	if ( Cmd_Argc() < 2 ) {
+		Com_Printf( "Usage: worldbench <name> [passes]\n" );
+		return;
+	}
+
+	passes = 1;
+	if ( Cmd_Argc() > 2 ) {
+		passes = atoi( Cmd_Argv( 2 ) );
+		if ( passes < 1 ) {
+			passes = 1;
+		}
+	}
+
+	Com_sprintf( name, sizeof( name ), "worldrecords/%s.wrec", Cmd_Argv( 1 ) );
+	len = FS_ReadFile( name, (void **)&buffer );
+	if ( !buffer ) {
+		Com_Printf( "Couldn't read %s.\n", name );
+		return;
+	}
+	if ( len < 8 || LittleLong( buffer[0].i ) != WORLDRECORD_ID
+		|| LittleLong( buffer[1].i ) != WORLDRECORD_VERSION ) {
+		Com_Printf( "%s is not a version %i world recording.\n", name, WORLDRECORD_VERSION );
+		FS_FreeFile( buffer );
+		return;
+	}
+	numEvents = ( len - 8 ) / ( 8 * sizeof( *buffer ) );
+
+	w = Z_Malloc( sizeof( *w ) );
+	w->octants = Z_Malloc( OCTREE_NODES * sizeof( *w->octants ) );
+	links = Z_Malloc( MAX_GENTITIES * sizeof( *links ) );
+
+	Com_Printf( "%i events, %i passes\n", numEvents, passes );
+
+	for ( i = 0 ; i < NUM_WORLD_INDEXES ; i++ ) {
+		const worldIndex_t	*index = &worldIndexes[i];
+		qboolean			cleared = qfalse;
+
+		numLinks = numQueries = tested = found = 0;
+		start = Sys_Milliseconds();
+
+		for ( pass = 0 ; pass < passes ; pass++ ) {
+			for ( e = 0, event = buffer + 2 ; e < numEvents ; e++, event += 8 ) {
+				int		type = LittleLong( event[0].i );
+				int		number = LittleLong( event[1].i );
+
+				for ( j = 0 ; j < 3 ; j++ ) {
+					mins[j] = LittleFloat( event[2+j].f );
+					maxs[j] = LittleFloat( event[5+j].f );
+				}
+
+				if ( type == 'C' ) {
+					VectorCopy( mins, w->mins );
+					VectorCopy( maxs, w->maxs );
+					Com_Memset( links, 0, MAX_GENTITIES * sizeof( *links ) );
+					index->clear( w );
+					cleared = qtrue;
+					continue;
+				}
+				if ( !cleared || number < 0 || number >= MAX_GENTITIES ) {
+					continue;
+				}
+
+				link = &links[number];
+				switch ( type ) {
+				case 'L':
+					if ( link->node ) {
+						index->unlink( w, link );
+					}
+					link->number = number;
+					VectorCopy( mins, link->absmin );
+					VectorCopy( maxs, link->absmax );
+					index->link( w, link );
+					numLinks++;
+					break;
+				case 'U':
+					if ( link->node ) {
+						index->unlink( w, link );
+					}
+					break;
+				case 'Q':
+					ap.mins = mins;
+					ap.maxs = maxs;
+					ap.list = list;
+					ap.count = 0;
+					ap.maxcount = MAX_GENTITIES;
+					ap.tested = 0;
+					index->query( w, &ap );
+					numQueries++;
+					tested += ap.tested;
+					found += ap.count;
+					break;
+				}
+			}
+			cleared = qfalse;
+		}
+
+		msec = Sys_Milliseconds() - start;
+		Com_Printf( "%-8s %7i links %7i queries %5i msec %6.1f tested/query %5.1f found/query\n",
+			index->name, numLinks, numQueries, msec,
+			numQueries ? (float)tested / numQueries : 0.0f,
+			numQueries ? (float)found / numQueries : 0.0f );
+	}
+
+	Z_Free( links );
+	Z_Free( w->octants );
+	Z_Free( w );
+	FS_FreeFile( buffer );
+}
+
 /*
 ===============
 SV_ClearWorld
@@ -146,15 +696,232 @@ SV_ClearWorld
 */
 void SV_ClearWorld( void ) {
 	clipHandle_t	h;
-	vec3_t			mins, maxs;
 
-	Com_Memset( sv_worldSectors, 0, sizeof(sv_worldSectors) );
-	sv_numworldSectors = 0;
+	SV_ClearTraceCache();
+
+	sv_world.index = sv_worldIndex->integer;
+	if ( sv_world.index < 0 || sv_world.index >= NUM_WORLD_INDEXES ) {
+		Com_Printf( "sv_worldIndex %i out of range, using 0\n", sv_world.index );
+		sv_world.index = 0;
+	}
 
 	// get world map bounds
 	h = CM_InlineModel( 0 );
-	CM_ModelBounds( h, mins, maxs );
-	SV_CreateworldSector( 0, mins, maxs );
+	CM_ModelBounds( h, sv_world.mins, sv_world.maxs );
+
+	// the octants live on the hunk, which was just cleared for the new map
+	sv_world.octants = NULL;
+	if ( sv_world.index == 1 ) {
+		sv_world.octants = Hunk_Alloc( OCTREE_NODES * sizeof( *sv_world.octants ), h_high );
+	}
+
+	worldIndexes[sv_world.index].clear( &sv_world );
+
+	SV_RecordWorldEvent( 'C', 0, sv_world.mins, sv_world.maxs );
+}
+
+
+/*
+============================================================================
+
+TRACE CACHE
+
+With sv_traceCache set, SV_Trace results are kept until the next server
+frame so that the same trace done again, as bots tend to do with visibility
+checks, can be answered without clipping.  A result is thrown away as soon
+as an entity is linked or unlinked anywhere in the box of the move.  Changes
+that games make to entities without relinking them aren't seen until the
+next frame.
+============================================================================
+*/
+
+#define	TRACE_CACHE_SIZE	1024		// must be a power of two
+#define	TRACE_CACHE_PROBES	8
+
+typedef struct {
+	qboolean	valid;
+	int			live;			// index in traceCacheLive
+	vec3_t		start, end;
+	vec3_t		mins, maxs;
+	int			passEntityNum;
+	int			contentmask;
+	int			capsule;
+	vec3_t		boxmins, boxmaxs;	// bounds of the entire move
+	trace_t		trace;
+} cachedTrace_t;
+
+static cachedTrace_t	traceCache[TRACE_CACHE_SIZE];
+static int				traceCacheLive[TRACE_CACHE_SIZE];
+static int				numTraceCacheLive;
+
+static int	traceCacheHits, traceCacheMisses, traceCacheDropped;
+
+/*
+==================
+SV_TraceCacheHash
+==================
+*/
+static int SV_TraceCacheHash( const vec3_t start, const vec3_t end, const vec3_t mins, const vec3_t maxs,
+							int passEntityNum, int contentmask, int capsule ) {
+	const float	*v[4];
+	floatint_t	f;
+	unsigned	hash;
+	int			i, j;
+
+	v[0] = start;
+	v[1] = end;
+	v[2] = mins;
+	v[3] = maxs;
+
+	hash = 2166136261u;
+	for ( i = 0 ; i < 4 ; i++ ) {
+		for ( j = 0 ; j < 3 ; j++ ) {
+			f.f = v[i][j];
+			hash = ( hash ^ f.ui ) * 16777619u;
+		}
+	}
+	hash = ( hash ^ passEntityNum ) * 16777619u;
+	hash = ( hash ^ contentmask ) * 16777619u;
+	hash = ( hash ^ capsule ) * 16777619u;
+
+	return ( hash ^ ( hash >> 16 ) ) & ( TRACE_CACHE_SIZE - 1 );
+}
+
+/*
+==================
+SV_DropCachedTrace
+==================
+*/
+static void SV_DropCachedTrace( cachedTrace_t *ct ) {
+	int		last;
+
+	ct->valid = qfalse;
+
+	last = traceCacheLive[--numTraceCacheLive];
+	traceCacheLive[ct->live] = last;
+	traceCache[last].live = ct->live;
+}
+
+/*
+==================
+SV_ClearTraceCache
+
+Called at the start of every server frame
+==================
+*/
+void SV_ClearTraceCache( void ) {
+	int		i;
+
+	for ( i = 0 ; i < numTraceCacheLive ; i++ ) {
+		traceCache[traceCacheLive[i]].valid = qfalse;
+	}
+	numTraceCacheLive = 0;
+}
+
+/*
+==================
+SV_InvalidateTraceCache
+
+Drops every cached trace whose move touches the bounds
+==================
+*/
+static void SV_InvalidateTraceCache( const vec3_t absmin, const vec3_t absmax ) {
+	cachedTrace_t	*ct;
+	int				i;
+
+	for ( i = 0 ; i < numTraceCacheLive ; ) {
+		ct = &traceCache[traceCacheLive[i]];
+		if ( ct->boxmins[0] > absmax[0] || ct->boxmins[1] > absmax[1] || ct->boxmins[2] > absmax[2]
+			|| ct->boxmaxs[0] < absmin[0] || ct->boxmaxs[1] < absmin[1] || ct->boxmaxs[2] < absmin[2] ) {
+			i++;
+			continue;
+		}
+		// the last live trace moves into this spot
+		SV_DropCachedTrace( ct );
+		traceCacheDropped++;
+	}
+}
+
+/*
+==================
+SV_CachedTrace
+
+Returns the cache entry for a trace, which is only valid if a matching trace
+was stored this frame
+==================
+*/
+static cachedTrace_t *SV_CachedTrace( const vec3_t start, const vec3_t end, const vec3_t mins, const vec3_t maxs,
+							int passEntityNum, int contentmask, int capsule ) {
+	cachedTrace_t	*ct, *free;
+	int				hash, i;
+
+	hash = SV_TraceCacheHash( start, end, mins, maxs, passEntityNum, contentmask, capsule );
+
+	free = NULL;
+	for ( i = 0 ; i < TRACE_CACHE_PROBES ; i++ ) {
+		ct = &traceCache[( hash + i ) & ( TRACE_CACHE_SIZE - 1 )];
+		if ( !ct->valid ) {
+			if ( !free ) {
+				free = ct;
+			}
+			continue;
+		}
+		if ( VectorCompare( ct->start, start ) && VectorCompare( ct->end, end )
+			&& VectorCompare( ct->mins, mins ) && VectorCompare( ct->maxs, maxs )
+			&& ct->passEntityNum == passEntityNum && ct->contentmask == contentmask
+			&& ct->capsule == capsule ) {
+			return ct;
+		}
+	}
+
+	// all the probed slots are busy, take over the first one
+	if ( !free ) {
+		free = &traceCache[hash];
+		SV_DropCachedTrace( free );
+	}
+
+	VectorCopy( start, free->start );
+	VectorCopy( end, free->end );
+	VectorCopy( mins, free->mins );
+	VectorCopy( maxs, free->maxs );
+	free->passEntityNum = passEntityNum;
+	free->contentmask = contentmask;
+	free->capsule = capsule;
+	return free;
+}
+
+/*
+==================
+SV_StoreCachedTrace
+==================
+*/
+static void SV_StoreCachedTrace( cachedTrace_t *ct, const trace_t *trace, const vec3_t boxmins, const vec3_t boxmaxs ) {
+	ct->trace = *trace;
+	VectorCopy( boxmins, ct->boxmins );
+	VectorCopy( boxmaxs, ct->boxmaxs );
+
+	ct->valid = qtrue;
+	ct->live = numTraceCacheLive;
+	traceCacheLive[numTraceCacheLive++] = ct - traceCache;
+}
+
+/*
+==================
+SV_TraceCache_f
+==================
+*/
+void SV_TraceCache_f( void ) {
+	int		total;
+
+	total = traceCacheHits + traceCacheMisses;
+
+	Com_Printf( "trace cache %s, %i cached\n", sv_traceCache->integer ? "on" : "off", numTraceCacheLive );
+	Com_Printf( "%i hits, %i misses, %.1f%% hit rate, %i dropped by links\n", traceCacheHits, traceCacheMisses,
+		total ? 100.0f * traceCacheHits / total : 0.0f, traceCacheDropped );
+
+	if ( Cmd_Argc() > 1 && !Q_stricmp( Cmd_Argv( 1 ), "reset" ) ) {
+		traceCacheHits = traceCacheMisses = traceCacheDropped = 0;
+	}
 }
 
 
@@ -166,32 +933,22 @@ SV_UnlinkEntity
 */
 void SV_UnlinkEntity( sharedEntity_t *gEnt ) {
 	svEntity_t		*ent;
-	svEntity_t		*scan;
-	worldSector_t	*ws;
 
 	ent = SV_SvEntityForGentity( gEnt );
 
 	gEnt->r.linked = qfalse;
 
-	ws = ent->worldSector;
-	if ( !ws ) {
+	if ( !ent->worldLink.node ) {
 		return;		// not linked in anywhere
 	}
-	ent->worldSector = NULL;
 
-	if ( ws->entities == ent ) {
-		ws->entities = ent->nextEntityInWorldSector;
-		return;
-	}
+	worldIndexes[sv_world.index].unlink( &sv_world, &ent->worldLink );
 
-	for ( scan = ws->entities ; scan ; scan = scan->nextEntityInWorldSector ) {
-		if ( scan->nextEntityInWorldSector == ent ) {
-			scan->nextEntityInWorldSector = ent->nextEntityInWorldSector;
-			return;
-		}
+	if ( numTraceCacheLive ) {
+		SV_InvalidateTraceCache( ent->worldLink.absmin, ent->worldLink.absmax );
 	}
 
-	Com_Printf( "WARNING: SV_UnlinkEntity: not found in worldSector\n" );
+	SV_RecordWorldEvent( 'U', ent->worldLink.number, vec3_origin, vec3_origin );
 }
 
 
@@ -203,7 +960,6 @@ SV_LinkEntity
 */
 #define MAX_TOTAL_ENT_LEAFS		128
 void SV_LinkEntity( sharedEntity_t *gEnt ) {
-	worldSector_t	*node;
 	int			leafs[MAX_TOTAL_ENT_LEAFS];
 	int			cluster;
 	int			num_leafs;
@@ -215,7 +971,7 @@ void SV_LinkEntity( sharedEntity_t *gEnt ) {
 
 	ent = SV_SvEntityForGentity( gEnt );
 
-	if ( ent->worldSector ) {
+	if ( ent->worldLink.node ) {
 		SV_UnlinkEntity( gEnt );	// unlink from old position
 	}
 
@@ -332,24 +1088,16 @@ void SV_LinkEntity( sharedEntity_t *gEnt ) {
 
 	gEnt->r.linkcount++;
 
-	// find the first world sector node that the ent's box crosses
-	node = sv_worldSectors;
-	while (1)
-	{
-		if (node->axis == -1)
-			break;
-		if ( gEnt->r.absmin[node->axis] > node->dist)
-			node = node->children[0];
-		else if ( gEnt->r.absmax[node->axis] < node->dist)
-			node = node->children[1];
-		else
-			break;		// crosses the node
-	}
-	
 	// link it in
-	ent->worldSector = node;
-	ent->nextEntityInWorldSector = node->entities;
-	node->entities = ent;
+	VectorCopy( gEnt->r.absmin, ent->worldLink.absmin );
+	VectorCopy( gEnt->r.absmax, ent->worldLink.absmax );
+	ent->worldLink.number = ent - sv.svEntities;
+	worldIndexes[sv_world.index].link( &sv_world, &ent->worldLink );
+	SV_RecordWorldEvent( 'L', ent->worldLink.number, gEnt->r.absmin, gEnt->r.absmax );
+
+	if ( numTraceCacheLive ) {
+		SV_InvalidateTraceCache( gEnt->r.absmin, gEnt->r.absmax );
+	}
 
 	gEnt->r.linked = qtrue;
 }
@@ -364,60 +1112,6 @@ bounds.  This does NOT mean that they actually touch in the case of bmodels.
 ============================================================================
 */
 
-typedef struct {
-	const float	*mins;
-	const float	*maxs;
-	int			*list;
-	int			count, maxcount;
-} areaParms_t;
-
-
-/*
-====================
-SV_AreaEntities_r
-
-====================
-*/
-static void SV_AreaEntities_r( worldSector_t *node, areaParms_t *ap ) {
-	svEntity_t	*check, *next;
-	sharedEntity_t *gcheck;
-
-	for ( check = node->entities  ; check ; check = next ) {
-		next = check->nextEntityInWorldSector;
-
-		gcheck = SV_GEntityForSvEntity( check );
-
-		if ( gcheck->r.absmin[0] > ap->maxs[0]
-		|| gcheck->r.absmin[1] > ap->maxs[1]
-		|| gcheck->r.absmin[2] > ap->maxs[2]
-		|| gcheck->r.absmax[0] < ap->mins[0]
-		|| gcheck->r.absmax[1] < ap->mins[1]
-		|| gcheck->r.absmax[2] < ap->mins[2]) {
-			continue;
-		}
-
-		if ( ap->count == ap->maxcount ) {
-			Com_Printf ("SV_AreaEntities: MAXCOUNT\n");
-			return;
-		}
-
-		ap->list[ap->count] = check - sv.svEntities;
-		ap->count++;
-	}
-	
-	if (node->axis == -1) {
-		return;		// terminal node
-	}
-
-	// recurse down both sides
-	if ( ap->maxs[node->axis] > node->dist ) {
-		SV_AreaEntities_r ( node->children[0], ap );
-	}
-	if ( ap->mins[node->axis] < node->dist ) {
-		SV_AreaEntities_r ( node->children[1], ap );
-	}
-}
-
 /*
 ================
 SV_AreaEntities
@@ -431,14 +1125,16 @@ int SV_AreaEntities( const vec3_t mins, const vec3_t maxs, int *entityList, int
 	ap.list = entityList;
 	ap.count = 0;
 	ap.maxcount = maxcount;
+	ap.tested = 0;
+
+	worldIndexes[sv_world.index].query( &sv_world, &ap );
 
-	SV_AreaEntities_r( sv_worldSectors, &ap );
+	SV_RecordWorldEvent( 'Q', 0, mins, maxs );
 
 	return ap.count;
 }
 
 
-
 //===========================================================================
 
 
@@ -585,6 +1281,241 @@ static void SV_ClipMoveToEntities( moveclip_t *clip ) {
 }
 
 
+/*
+============================================================================
+
+TRACE RECORDING
+
+The world part of every SV_Trace can be recorded and replayed with
+tracebench, once a trace at a time and batched with CM_TraceBatch.
+============================================================================
+*/
+
+#define	TRACERECORD_ID			(('C'<<24)+('E'<<16)+('R'<<8)+'T')
+#define	TRACERECORD_VERSION		1
+
+typedef struct {
+	vec3_t	start, end;
+	vec3_t	mins, maxs;
+	int		contentmask;
+	int		capsule;
+} recordedTrace_t;
+
+static fileHandle_t	sv_traceRecord;
+
+/*
+==================
+SV_RecordTrace
+==================
+*/
+static void SV_RecordTrace( const vec3_t start, const vec3_t end, const vec3_t mins, const vec3_t maxs, int contentmask, int capsule ) {
+	floatint_t	rec[14];
+	int			i;
+
+	for ( i = 0 ; i < 3 ; i++ ) {
+		rec[i].f = LittleFloat( start[i] );
+		rec[3+i].f = LittleFloat( end[i] );
+		rec[6+i].f = LittleFloat( mins[i] );
+		rec[9+i].f = LittleFloat( maxs[i] );
+	}
+	rec[12].i = LittleLong( contentmask );
+	rec[13].i = LittleLong( capsule );
+	FS_Write( rec, sizeof( rec ), sv_traceRecord );
+}
+
+/*
+==================
+SV_TraceRecord_f
+==================
+*/
+void SV_TraceRecord_f( void ) {
+	char	name[MAX_QPATH];
+	char	mapname[MAX_QPATH];
+	int		header[2];
+
+	if ( sv_traceRecord ) {
+		FS_FCloseFile( sv_traceRecord );
+		sv_traceRecord = 0;
+		Com_Printf( "Stopped trace recording.\n" );
+		if ( Cmd_Argc() < 2 ) {
+			return;
+		}
+	}
+
+	if ( Cmd_Argc() != 2 ) {
+		Com_Printf( "Usage: tracerecord <name>, without a name stops recording\n" );
+		return;
+	}
+
+	if ( sv.state != SS_GAME ) {
+		Com_Printf( "Server is not running.\n" );
+		return;
+	}
+
+	Com_sprintf( name, sizeof( name ), "tracerecords/%s.trec", Cmd_Argv( 1 ) );
+	sv_traceRecord = FS_FOpenFileWrite( name );
+	if ( !sv_traceRecord ) {
+		Com_Printf( "Couldn't open %s for writing.\n", name );
+		return;
+	}
+
+	// the traces only make sense on the map they were recorded on
+	header[0] = LittleLong( TRACERECORD_ID );
+	header[1] = LittleLong( TRACERECORD_VERSION );
+	Com_Memset( mapname, 0, sizeof( mapname ) );
+	Q_strncpyz( mapname, sv_mapname->string, sizeof( mapname ) );
+	FS_Write( header, sizeof( header ), sv_traceRecord );
+	FS_Write( mapname, sizeof( mapname ), sv_traceRecord );
+
+	Com_Printf( "Recording traces to %s.\n", name );
+}
+
+/*
+==================
+SV_TraceBench_f
+
+Replays recorded traces through the world one by one and then in batches
+of consecutive traces that share a box and content mask, and checks that
+both give the same results
+==================
+*/
+void SV_TraceBench_f( void ) {
+	char			name[MAX_QPATH];
+	byte			*buffer;
+	floatint_t		*rec;
+	recordedTrace_t	*traces, *t;
+	vec3_t			*starts, *ends;
+	trace_t			*single, *batched;
+	int				len, numTraces, numBatches;
+	int				passes, pass, i, j, k;
+	int				start, singleMsec, batchMsec, mismatches;
+
+	if ( Cmd_Argc() < 2 ) {
+		Com_Printf( "Usage: tracebench <name> [passes]\n" );
+		return;
+	}
+
+	if ( sv.state != SS_GAME ) {
+		Com_Printf( "Server is not running.\n" );
+		return;
+	}
+
+	passes = 1;
+	if ( Cmd_Argc() > 2 ) {
+		passes = atoi( Cmd_Argv( 2 ) );
+		if ( passes < 1 ) {
+			passes = 1;
+		}
+	}
+
+	Com_sprintf( name, sizeof( name ), "tracerecords/%s.trec", Cmd_Argv( 1 ) );
+	len = FS_ReadFile( name, NULL );
+	if ( len < 8 + MAX_QPATH ) {
+		Com_Printf( "Couldn't read %s.\n", name );
+		return;
+	}
+
+	// recordings can be far larger than the zone
+	numTraces = ( len - 8 - MAX_QPATH ) / ( 14 * sizeof( *rec ) );
+	traces = Hunk_AllocateTempMemory( numTraces * sizeof( *traces ) );
+	starts = Hunk_AllocateTempMemory( numTraces * sizeof( *starts ) );
+	ends = Hunk_AllocateTempMemory( numTraces * sizeof( *ends ) );
+	single = Hunk_AllocateTempMemory( numTraces * sizeof( *single ) );
+	batched = Hunk_AllocateTempMemory( numTraces * sizeof( *batched ) );
+
+	FS_ReadFile( name, (void **)&buffer );
+	rec = (floatint_t *)buffer;
+	if ( LittleLong( rec[0].i ) != TRACERECORD_ID || LittleLong( rec[1].i ) != TRACERECORD_VERSION ) {
+		Com_Printf( "%s is not a version %i trace recording.\n", name, TRACERECORD_VERSION );
+		numTraces = 0;
+	} else {
+		buffer[8 + MAX_QPATH - 1] = 0;
+		if ( Q_stricmp( (char *)buffer + 8, sv_mapname->string ) ) {
+			Com_Printf( "%s was recorded on %s.\n", name, (char *)buffer + 8 );
+			numTraces = 0;
+		}
+	}
+	if ( !numTraces ) {
+		FS_FreeFile( buffer );
+		Hunk_FreeTempMemory( batched );
+		Hunk_FreeTempMemory( single );
+		Hunk_FreeTempMemory( ends );
+		Hunk_FreeTempMemory( starts );
+		Hunk_FreeTempMemory( traces );
+		return;
+	}
+
+	rec = (floatint_t *)( buffer + 8 + MAX_QPATH );
+
+	for ( i = 0, t = traces ; i < numTraces ; i++, t++, rec += 14 ) {
+		for ( j = 0 ; j < 3 ; j++ ) {
+			t->start[j] = starts[i][j] = LittleFloat( rec[j].f );
+			t->end[j] = ends[i][j] = LittleFloat( rec[3+j].f );
+			t->mins[j] = LittleFloat( rec[6+j].f );
+			t->maxs[j] = LittleFloat( rec[9+j].f );
+		}
+		t->contentmask = LittleLong( rec[12].i );
+		t->capsule = LittleLong( rec[13].i );
+	}
+	FS_FreeFile( buffer );
+
+	start = Sys_Milliseconds();
+	for ( pass = 0 ; pass < passes ; pass++ ) {
+		for ( i = 0, t = traces ; i < numTraces ; i++, t++ ) {
+			CM_BoxTrace( &single[i], t->start, t->end, t->mins, t->maxs, 0, t->contentmask, t->capsule );
+		}
+	}
+	singleMsec = Sys_Milliseconds() - start;
+
+	numBatches = 0;
+	start = Sys_Milliseconds();
+	for ( pass = 0 ; pass < passes ; pass++ ) {
+		for ( i = 0 ; i < numTraces ; i = j ) {
+			t = &traces[i];
+			for ( j = i + 1 ; j < numTraces ; j++ ) {
+				if ( !VectorCompare( traces[j].mins, t->mins ) || !VectorCompare( traces[j].maxs, t->maxs )
+					|| traces[j].contentmask != t->contentmask || traces[j].capsule != t->capsule ) {
+					break;
+				}
+			}
+			CM_TraceBatch( &batched[i], &starts[i], &ends[i], j - i, t->mins, t->maxs, 0, t->contentmask, t->capsule );
+			numBatches++;
+		}
+	}
+	batchMsec = Sys_Milliseconds() - start;
+
+	mismatches = 0;
+	for ( i = 0 ; i < numTraces ; i++ ) {
+		trace_t	*a = &single[i], *b = &batched[i];
+
+		if ( a->allsolid != b->allsolid || a->startsolid != b->startsolid || a->fraction != b->fraction
+			|| !VectorCompare( a->endpos, b->endpos ) || a->surfaceFlags != b->surfaceFlags || a->contents != b->contents ) {
+			mismatches++;
+			continue;
+		}
+		for ( k = 0 ; k < 3 ; k++ ) {
+			if ( a->plane.normal[k] != b->plane.normal[k] ) {
+				break;
+			}
+		}
+		if ( k != 3 || a->plane.dist != b->plane.dist ) {
+			mismatches++;
+		}
+	}
+
+	Com_Printf( "%i traces, %i passes, %.1f traces per batch\n", numTraces, passes,
+		numBatches ? (float)numTraces * passes / numBatches : 0.0f );
+	Com_Printf( "single:  %5i msec\n", singleMsec );
+	Com_Printf( "batched: %5i msec\n", batchMsec );
+	Com_Printf( "%i mismatched results\n", mismatches );
+
+	Hunk_FreeTempMemory( batched );
+	Hunk_FreeTempMemory( single );
+	Hunk_FreeTempMemory( ends );
+	Hunk_FreeTempMemory( starts );
+	Hunk_FreeTempMemory( traces );
+}
+
 /*
 ==================
 SV_Trace
@@ -596,6 +1527,7 @@ passEntityNum and entities owned by passEntityNum are explicitly not checked.
 void SV_Trace( trace_t *results, const vec3_t start, vec3_t mins, vec3_t maxs, const vec3_t end, int passEntityNum, int contentmask, int capsule ) {
 	moveclip_t	clip;
 	int			i;
+	cachedTrace_t	*ct;
 
 	if ( !mins ) {
 		mins = vec3_origin;
@@ -604,14 +1536,21 @@ void SV_Trace( trace_t *results, const vec3_t start, vec3_t mins, vec3_t maxs, c
 		maxs = vec3_origin;
 	}
 
+	ct = NULL;
+	if ( sv_traceCache->integer ) {
+		ct = SV_CachedTrace( start, end, mins, maxs, passEntityNum, contentmask, capsule );
+		if ( ct->valid ) {
+			traceCacheHits++;
+			*results = ct->trace;
+			return;
+		}
+		traceCacheMisses++;
+	}
+
 	Com_Memset ( &clip, 0, sizeof ( moveclip_t ) );
 
-	// clip to world
-	CM_BoxTrace( &clip.trace, start, end, mins, maxs, 0, contentmask, capsule );
-	clip.trace.entityNum = clip.trace.fraction != 1.0 ? ENTITYNUM_WORLD : ENTITYNUM_NONE;
-	if ( clip.trace.fraction == 0 ) {
-		*results = clip.trace;
-		return;		// blocked immediately by the world
+	if ( sv_traceRecord ) {
+		SV_RecordTrace( start, end, mins, maxs, contentmask, capsule );
 	}
 
 	clip.contentmask = contentmask;
@@ -637,8 +1576,18 @@ void SV_Trace( trace_t *results, const vec3_t start, vec3_t mins, vec3_t maxs, c
 		}
 	}
 
-	// clip to other solid entities
-	SV_ClipMoveToEntities ( &clip );
+	// clip to world
+	CM_BoxTrace( &clip.trace, start, end, mins, maxs, 0, contentmask, capsule );
+	clip.trace.entityNum = clip.trace.fraction != 1.0 ? ENTITYNUM_WORLD : ENTITYNUM_NONE;
+
+	// clip to other solid entities unless blocked immediately by the world
+	if ( clip.trace.fraction != 0 ) {
+		SV_ClipMoveToEntities ( &clip );
+	}
+
+	if ( ct ) {
+		SV_StoreCachedTrace( ct, &clip.trace, clip.boxmins, clip.boxmaxs );
+	}
 
 	*results = clip.trace;
 }
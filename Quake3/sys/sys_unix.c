@@ -33,11 +33,13 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 #include <unistd.h>
 #include <sys/mman.h>
 #include <sys/time.h>
+#include <time.h>
 #include <pwd.h>
 #include <libgen.h>
 #include <fcntl.h>
 #include <fenv.h>
 #include <sys/wait.h>
+#include <pthread.h>
 
 qboolean stdinIsATTY;
 
@@ -178,6 +180,20 @@ int Sys_Milliseconds (void)
 	return curtime;
 }
 
+/*
+================
+Sys_Microseconds
+================
+*/
+int64_t Sys_Microseconds (void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
 /*
 ==================
 Sys_RandomBytes
@@ -284,6 +300,67 @@ qboolean Sys_Mkdir( const char *path )
 	return qtrue;
 }
 
+/*
+==================
+Sys_FileStat
+
+Size and modification time of a regular file
+==================
+*/
+qboolean Sys_FileStat( const char *ospath, int *size, int *mtime )
+{
+	struct stat buf;
+
+	if( stat( ospath, &buf ) || !S_ISREG( buf.st_mode ) )
+		return qfalse;
+
+	*size = buf.st_size;
+	*mtime = buf.st_mtime;
+	return qtrue;
+}
+
+/*
+==================
+Sys_MapFile
+
+Maps a whole file read only, NULL when that isn't possible
+==================
+*/
+void *Sys_MapFile( const char *ospath, int *length )
+{
+	struct stat buf;
+	void	*base;
+	int		fd;
+
+	fd = open( ospath, O_RDONLY );
+	if( fd == -1 )
+		return NULL;
+
+	if( fstat( fd, &buf ) || buf.st_size <= 0 || buf.st_size > 0x7fffffff )
+	{
+		close( fd );
+		return NULL;
+	}
+
+	base = mmap( NULL, buf.st_size, PROT_READ, MAP_SHARED, fd, 0 );
+	close( fd );
+	if( base == MAP_FAILED )
+		return NULL;
+
+	*length = buf.st_size;
+	return base;
+}
+
+/*
+==================
+Sys_UnmapFile
+==================
+*/
+void Sys_UnmapFile( void *base, int length )
+{
+	munmap( base, length );
+}
+
 /*
 ==================
 Sys_Mkfifo
@@ -941,6 +1018,145 @@ qboolean Sys_PIDIsRunning( int pid )
 	return kill( pid, 0 ) == 0;
 }
 
+/*
+==============================================================================
+
+THREADS
+
+==============================================================================
+*/
+
+struct sysThread_s {
+	pthread_t	handle;
+	void		(*function)( void *arg );
+	void		*arg;
+};
+
+struct sysMutex_s {
+	pthread_mutex_t	handle;
+};
+
+struct sysCond_s {
+	pthread_cond_t	handle;
+};
+
+static void *Sys_ThreadMain( void *arg )
+{
+	sysThread_t *thread = arg;
+
+	thread->function( thread->arg );
+	return NULL;
+}
+
+/*
+==============
+Sys_CreateThread
+==============
+*/
+sysThread_t *Sys_CreateThread( void (*function)( void *arg ), void *arg )
+{
+	sysThread_t *thread;
+
+	thread = malloc( sizeof( *thread ) );
+	if( !thread )
+		return NULL;
+
+	thread->function = function;
+	thread->arg = arg;
+
+	if( pthread_create( &thread->handle, NULL, Sys_ThreadMain, thread ) != 0 )
+	{
+		free( thread );
+		return NULL;
+	}
+
+	return thread;
+}
+
+/*
+==============
+Sys_JoinThread
+
+Waits for the thread to return and frees it
+==============
+*/
+void Sys_JoinThread( sysThread_t *thread )
+{
+	pthread_join( thread->handle, NULL );
+	free( thread );
+}
+
+/*
+==============
+Sys_CreateMutex
+==============
+*/
+sysMutex_t *Sys_CreateMutex( void )
+{
+	sysMutex_t *mutex;
+
+	mutex = malloc( sizeof( *mutex ) );
+	if( !mutex )
+		Sys_Error( "Sys_CreateMutex: out of memory" );
+
+	pthread_mutex_init( &mutex->handle, NULL );
+	return mutex;
+}
+
+void Sys_DestroyMutex( sysMutex_t *mutex )
+{
+	pthread_mutex_destroy( &mutex->handle );
+	free( mutex );
+}
+
+void Sys_LockMutex( sysMutex_t *mutex )
+{
+	pthread_mutex_lock( &mutex->handle );
+}
+
+void Sys_UnlockMutex( sysMutex_t *mutex )
+{
+	pthread_mutex_unlock( &mutex->handle );
+}
+
+/*
+==============
+Sys_CreateCond
+==============
+*/
+sysCond_t *Sys_CreateCond( void )
+{
+	sysCond_t *cond;
+
+	cond = malloc( sizeof( *cond ) );
+	if( !cond )
+		Sys_Error( "Sys_CreateCond: out of memory" );
+
+	pthread_cond_init( &cond->handle, NULL );
+	return cond;
+}
+
+void Sys_DestroyCond( sysCond_t *cond )
+{
+	pthread_cond_destroy( &cond->handle );
+	free( cond );
+}
+
+void Sys_WaitCond( sysCond_t *cond, sysMutex_t *mutex )
+{
+	pthread_cond_wait( &cond->handle, &mutex->handle );
+}
+
+void Sys_SignalCond( sysCond_t *cond )
+{
+	pthread_cond_signal( &cond->handle );
+}
+
+void Sys_BroadcastCond( sysCond_t *cond )
+{
+	pthread_cond_broadcast( &cond->handle );
+}
+
 /*
 =================
 Sys_DllExtension
@@ -242,6 +242,24 @@ int Sys_Milliseconds (void)
 	return sys_curtime;
 }
 
+/*
+================
+Sys_Microseconds
+================
+*/
+int64_t Sys_Microseconds (void)
+{
+	static LARGE_INTEGER	frequency;
+	LARGE_INTEGER			counter;
+
+	if (!frequency.QuadPart)
+		QueryPerformanceFrequency(&frequency);
+	QueryPerformanceCounter(&counter);
+
+	return (int64_t)(counter.QuadPart / frequency.QuadPart) * 1000000 +
+		(counter.QuadPart % frequency.QuadPart) * 1000000 / frequency.QuadPart;
+}
+
 /*
 ================
 Sys_RandomBytes
@@ -384,6 +402,78 @@ qboolean Sys_Mkdir( const char *path )
 	return qtrue;
 }
 
+/*
+==============
+Sys_FileStat
+
+Size and modification time of a regular file
+==============
+*/
+qboolean Sys_FileStat( const char *ospath, int *size, int *mtime )
+{
+	WIN32_FILE_ATTRIBUTE_DATA	data;
+	ULARGE_INTEGER				time;
+
+	if( !GetFileAttributesEx( ospath, GetFileExInfoStandard, &data ) ||
+		( data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY ) )
+		return qfalse;
+
+	time.LowPart = data.ftLastWriteTime.dwLowDateTime;
+	time.HighPart = data.ftLastWriteTime.dwHighDateTime;
+
+	*size = data.nFileSizeLow;
+	*mtime = (int)( time.QuadPart / 10000000 - 11644473600LL );
+	return qtrue;
+}
+
+/*
+==============
+Sys_MapFile
+
+Maps a whole file read only, NULL when that isn't possible
+==============
+*/
+void *Sys_MapFile( const char *ospath, int *length )
+{
+	HANDLE	file, mapping;
+	DWORD	sizeHigh, size;
+	void	*base;
+
+	file = CreateFile( ospath, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL );
+	if( file == INVALID_HANDLE_VALUE )
+		return NULL;
+
+	size = GetFileSize( file, &sizeHigh );
+	if( size == INVALID_FILE_SIZE || sizeHigh || !size || size > 0x7fffffff )
+	{
+		CloseHandle( file );
+		return NULL;
+	}
+
+	mapping = CreateFileMapping( file, NULL, PAGE_READONLY, 0, 0, NULL );
+	CloseHandle( file );
+	if( !mapping )
+		return NULL;
+
+	base = MapViewOfFile( mapping, FILE_MAP_READ, 0, 0, 0 );
+	CloseHandle( mapping );
+	if( !base )
+		return NULL;
+
+	*length = size;
+	return base;
+}
+
+/*
+==============
+Sys_UnmapFile
+==============
+*/
+void Sys_UnmapFile( void *base, int length )
+{
+	UnmapViewOfFile( base );
+}
+
 /*
 ==================
 Sys_Mkfifo
@@ -851,6 +941,146 @@ qboolean Sys_PIDIsRunning( int pid )
 	return qfalse;
 }
 
+/*
+==============================================================================
+
+THREADS
+
+==============================================================================
+*/
+
+struct sysThread_s {
+	HANDLE	handle;
+	void	(*function)( void *arg );
+	void	*arg;
+};
+
+struct sysMutex_s {
+	CRITICAL_SECTION	handle;
+};
+
+struct sysCond_s {
+	CONDITION_VARIABLE	handle;
+};
+
+static DWORD WINAPI Sys_ThreadMain( LPVOID arg )
+{
+	sysThread_t *thread = arg;
+
+	thread->function( thread->arg );
+	return 0;
+}
+
+/*
+==============
+Sys_CreateThread
+==============
+*/
+sysThread_t *Sys_CreateThread( void (*function)( void *arg ), void *arg )
+{
+	sysThread_t *thread;
+
+	thread = malloc( sizeof( *thread ) );
+	if( !thread )
+		return NULL;
+
+	thread->function = function;
+	thread->arg = arg;
+	thread->handle = CreateThread( NULL, 0, Sys_ThreadMain, thread, 0, NULL );
+
+	if( !thread->handle )
+	{
+		free( thread );
+		return NULL;
+	}
+
+	return thread;
+}
+
+/*
+==============
+Sys_JoinThread
+
+Waits for the thread to return and frees it
+==============
+*/
+void Sys_JoinThread( sysThread_t *thread )
+{
+	WaitForSingleObject( thread->handle, INFINITE );
+	CloseHandle( thread->handle );
+	free( thread );
+}
+
+/*
+==============
+Sys_CreateMutex
+==============
+*/
+sysMutex_t *Sys_CreateMutex( void )
+{
+	sysMutex_t *mutex;
+
+	mutex = malloc( sizeof( *mutex ) );
+	if( !mutex )
+		Sys_Error( "Sys_CreateMutex: out of memory" );
+
+	InitializeCriticalSection( &mutex->handle );
+	return mutex;
+}
+
+void Sys_DestroyMutex( sysMutex_t *mutex )
+{
+	DeleteCriticalSection( &mutex->handle );
+	free( mutex );
+}
+
+void Sys_LockMutex( sysMutex_t *mutex )
+{
+	EnterCriticalSection( &mutex->handle );
+}
+
+void Sys_UnlockMutex( sysMutex_t *mutex )
+{
+	LeaveCriticalSection( &mutex->handle );
+}
+
+/*
+==============
+Sys_CreateCond
+==============
+*/
+sysCond_t *Sys_CreateCond( void )
+{
+	sysCond_t *cond;
+
+	cond = malloc( sizeof( *cond ) );
+	if( !cond )
+		Sys_Error( "Sys_CreateCond: out of memory" );
+
+	InitializeConditionVariable( &cond->handle );
+	return cond;
+}
+
+void Sys_DestroyCond( sysCond_t *cond )
+{
+	free( cond );
+}
+
+void Sys_WaitCond( sysCond_t *cond, sysMutex_t *mutex )
+{
+	SleepConditionVariableCS( &cond->handle, &mutex->handle, INFINITE );
+}
+
+void Sys_SignalCond( sysCond_t *cond )
+{
+	WakeConditionVariable( &cond->handle );
+}
+
+void Sys_BroadcastCond( sysCond_t *cond )
+{
+	WakeAllConditionVariable( &cond->handle );
+}
+
 /*
 =================
 Sys_DllExtension